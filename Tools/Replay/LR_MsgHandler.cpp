@@ -107,12 +107,18 @@ void LR_MsgHandler_BARO::process_message(uint8_t *msg)
     if (!field_value(msg, "SMS", last_update_ms)) {
         last_update_ms = 0;
     }
+    // aligned sample time, zero if the baro didn't have one
+    uint32_t last_sample_ms;
+    if (!field_value(msg, "SS", last_sample_ms)) {
+        last_sample_ms = 0;
+    }
     AP::baro().setHIL(0,
 		require_field_float(msg, "Press"),
 		require_field_int16_t(msg, "Temp") * 0.01f,
 		require_field_float(msg, "Alt"),
 		require_field_float(msg, "CRt"),
-                last_update_ms);
+                last_update_ms,
+                last_sample_ms);
 }
 
 
@@ -344,6 +350,23 @@ void LR_MsgHandler_MAG::process_message(uint8_t *msg)
     update_from_msg_compass(0, msg);
 }
 
+/*
+  MAGT follows each MAG message with the aligned sample time of that
+  instance, zero if the compass didn't have one
+ */
+void LR_MsgHandler_MAGT::process_message(uint8_t *msg)
+{
+    wait_timestamp_from_msg(msg);
+
+    const uint8_t instance = require_field_uint8_t(msg, "I");
+    if (instance >= COMPASS_MAX_INSTANCES) {
+        return;
+    }
+    uint32_t sample_usec;
+    require_field(msg, "SS", sample_usec);
+    compass.setHIL_sample_usec(instance, sample_usec);
+}
+
 #include <AP_AHRS/AP_AHRS.h>
 #include "VehicleType.h"
 
@@ -395,6 +395,19 @@ public:
     void process_message(uint8_t *msg) override;
 };
 
+class LR_MsgHandler_MAGT : public LR_MsgHandler
+{
+public:
+    LR_MsgHandler_MAGT(log_Format &_f, AP_Logger &_logger,
+                    uint64_t &_last_timestamp_usec, Compass &_compass)
+	: LR_MsgHandler(_f, _logger, _last_timestamp_usec), compass(_compass) { };
+
+    void process_message(uint8_t *msg) override;
+
+private:
+    Compass &compass;
+};
+
 
 
 class LR_MsgHandler_MSG : public LR_MsgHandler
@@ -124,7 +124,7 @@ static const char *generated_names[] = {
     "POS",
     "CHEK",
     "IMT", "IMT2", "IMT3",
-    "MAG", "MAG2",
+    "MAG", "MAG2", "MAGT",
     "BARO", "BAR2",
     "GPS","GPA",
     NULL,
@@ -377,6 +377,9 @@ bool LogReader::handle_log_format_msg(const struct log_Format &f)
 	} else if (streq(name, "MAG2")) {
 	  msgparser[f.type] = new LR_MsgHandler_MAG2(formats[f.type], logger,
 						 last_timestamp_usec, compass);
+	} else if (streq(name, "MAGT")) {
+	  msgparser[f.type] = new LR_MsgHandler_MAGT(formats[f.type], logger,
+						 last_timestamp_usec, compass);
 	} else if (streq(name, "NTUN")) {
 	    // the label "NTUN" is used by rover, copter and plane -
 	    // and they all look different!  creation of a parser is
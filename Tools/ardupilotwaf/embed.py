@@ -36,6 +36,14 @@ def embed_file(out, f, idx, embedded_name):
 
     write_encode(out, 'static const uint8_t ap_romfs_%u[] = {' % idx)
 
+    if embedded_name.endswith(".luac"):
+        # precompiled lua is loaded straight from flash, so leave it
+        # uncompressed
+        for c in bytearray(contents):
+            write_encode(out, '%u,' % c)
+        write_encode(out, '};\n\n');
+        return True
+
     # compress it
     compressed = tempfile.NamedTemporaryFile()
     f = open(compressed.name, "wb")
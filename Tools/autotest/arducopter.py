@@ -5,6 +5,7 @@ from __future__ import print_function
 import math
 import os
 import shutil
+import signal
 import time
 import traceback
 
@@ -3053,6 +3054,69 @@ class AutoTestCopter(AutoTest):
         if ex is not None:
             raise ex
 
+    def test_sitl_snapshot(self):
+        """Take a SITL snapshot with terrain and compass calibration running"""
+        if self.valgrind or self.gdb:
+            # the process we would signal is the debugger, not SITL
+            self.progress("Skipping snapshot under valgrind or gdb")
+            return
+        ex = None
+        self.context_push()
+        try:
+            self.set_parameter("TERRAIN_ENABLE", 1)
+            self.reboot_sitl()
+            self.wait_ready_to_arm()
+
+            # terrain reads and writes its blocks through the
+            # filesystem queue once it has a location
+            m = self.mav.recv_match(type='TERRAIN_REPORT', blocking=True, timeout=30)
+            if m is None:
+                raise NotAchievedException("No TERRAIN_REPORT")
+            self.delay_sim_time(5)
+
+            self.run_cmd(mavutil.mavlink.MAV_CMD_DO_START_MAG_CAL,
+                         1, # bitmask of compasses to calibrate
+                         0,
+                         0,
+                         0,
+                         0,
+                         0,
+                         0,
+                         timeout=1)
+            self.delay_sim_time(2)
+
+            self.progress("Taking snapshot")
+            os.kill(self.sitl.pid, signal.SIGUSR1)
+            i = self.sitl.expect(["SITL snapshot: taken as pid ([0-9]+)",
+                                  "SITL snapshot: not supported with threads running",
+                                  "SITL snapshot: fork failed"],
+                                 timeout=30)
+            if i != 0:
+                raise NotAchievedException("Snapshot not taken: %s" % self.sitl.after)
+            snapshot_pid = int(self.sitl.match.group(1))
+            self.progress("Snapshot parked as pid %u" % snapshot_pid)
+            os.kill(snapshot_pid, signal.SIGTERM)
+
+            # the vehicle carries on after the snapshot
+            self.run_cmd(mavutil.mavlink.MAV_CMD_DO_CANCEL_MAG_CAL,
+                         1, # bitmask of compasses to cancel
+                         0,
+                         0,
+                         0,
+                         0,
+                         0,
+                         0)
+            self.wait_ready_to_arm()
+        except Exception as e:
+            self.progress("Exception caught: %s" % (
+                self.get_exception_stacktrace(e)))
+            ex = e
+
+        self.context_pop()
+        self.reboot_sitl()
+        if ex is not None:
+            raise ex
+
     def fly_brake_mode(self):
         # test brake mode
         self.progress("Testing brake mode")
@@ -3674,6 +3738,10 @@ class AutoTestCopter(AutoTest):
              "Test onboard compass calibration",
              self.test_onboard_compass_calibration),
 
+            ("SITLSnapshot",
+             "Take a SITL snapshot with terrain enabled",
+             self.test_sitl_snapshot),
+
             ("LogDownLoad",
              "Log download",
              lambda: self.log_download(
@@ -0,0 +1,181 @@
+#!/usr/bin/env python
+'''
+MAVLink FTP test client, standing in for a GCS against SITL.
+
+Downloads a file with burst reads, interrupting the first burst part
+way through to exercise resume, fills any gaps with ReadFile and
+checks the assembled file against CalcFileCRC32. Prints the
+throughput of the burst phases.
+
+  sim_vehicle.py -v ArduCopter
+  ./Tools/scripts/mavftp_loopback.py --master tcp:127.0.0.1:5762 logs/00000001.BIN
+'''
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+from pymavlink import mavutil
+
+OP_TerminateSession = 1
+OP_ResetSessions = 2
+OP_OpenFileRO = 4
+OP_ReadFile = 5
+OP_CalcFileCRC32 = 14
+OP_BurstReadFile = 15
+OP_Ack = 128
+OP_Nack = 129
+
+HDR = struct.Struct('<HBBBBBBI')
+MAX_DATA = 239
+
+
+def ap_crc32(data, crc=0):
+    '''crc_crc32() from AP_Math, which is zlib's CRC without the inversions'''
+    return (~zlib.crc32(data, ~crc & 0xFFFFFFFF)) & 0xFFFFFFFF
+
+
+class Reply(object):
+    def __init__(self, payload):
+        (self.seq, self.session, self.opcode, self.size, self.req_opcode,
+         self.burst_complete, _, self.offset) = HDR.unpack(bytes(bytearray(payload[:HDR.size])))
+        self.data = bytes(bytearray(payload[HDR.size:HDR.size+self.size]))
+
+
+class FTPClient(object):
+    def __init__(self, master):
+        self.mav = mavutil.mavlink_connection(master, source_system=255)
+        self.mav.wait_heartbeat()
+        self.seq = 0
+
+    def send(self, opcode, session=0, offset=0, data=b'', size=None):
+        self.seq = (self.seq + 1) & 0xFFFF
+        if size is None:
+            size = len(data)
+        payload = HDR.pack(self.seq, session, opcode, size, 0, 0, 0, offset) + data
+        payload = bytearray(payload.ljust(251, b'\0'))
+        self.mav.mav.file_transfer_protocol_send(0, self.mav.target_system,
+                                                 self.mav.target_component, payload)
+
+    def recv(self, timeout):
+        m = self.mav.recv_match(type='FILE_TRANSFER_PROTOCOL', blocking=True, timeout=timeout)
+        if m is None:
+            return None
+        return Reply(m.payload)
+
+    def request(self, opcode, session=0, offset=0, data=b'', size=None, retries=5):
+        for _ in range(retries):
+            self.send(opcode, session, offset, data, size)
+            deadline = time.time() + 1.0
+            while time.time() < deadline:
+                r = self.recv(deadline - time.time())
+                if r is not None and r.req_opcode == opcode and r.seq == ((self.seq + 1) & 0xFFFF):
+                    return r
+        raise RuntimeError("no reply to opcode %u" % opcode)
+
+    def burst(self, session, offset, max_bytes, chunks):
+        '''burst read from offset, stopping after max_bytes if non-zero,
+        returning bytes received and time taken'''
+        data = struct.pack('<I', max_bytes) if max_bytes else b''
+        t0 = time.time()
+        received = 0
+        self.send(OP_BurstReadFile, session, offset, data)
+        while True:
+            r = self.recv(2.0)
+            if r is None:
+                break
+            if r.req_opcode != OP_BurstReadFile:
+                continue
+            if r.opcode == OP_Ack:
+                chunks[r.offset] = r.data
+                received += len(r.data)
+            if r.burst_complete or r.opcode == OP_Nack:
+                break
+        return received, time.time() - t0
+
+
+def missing_ranges(chunks, file_size):
+    '''return (offset, length) gaps in the received chunks'''
+    gaps = []
+    pos = 0
+    for ofs in sorted(chunks.keys()):
+        if ofs > pos:
+            gaps.append((pos, ofs - pos))
+        pos = max(pos, ofs + len(chunks[ofs]))
+    if pos < file_size:
+        gaps.append((pos, file_size - pos))
+    return gaps
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--master', default='tcp:127.0.0.1:5762', help='MAVLink connection')
+    parser.add_argument('--burst-bytes', type=int, default=0,
+                        help='maximum bytes per burst, 0 for half the file then the rest')
+    parser.add_argument('path', help='file on the vehicle to download')
+    args = parser.parse_args()
+
+    ftp = FTPClient(args.master)
+    ftp.request(OP_ResetSessions)
+
+    name = args.path.encode()
+    r = ftp.request(OP_OpenFileRO, data=name)
+    if r.opcode != OP_Ack:
+        print("open failed: error %u" % bytearray(r.data)[0])
+        sys.exit(1)
+    session = r.session
+    file_size = struct.unpack('<I', r.data[:4])[0]
+    print("%s: %u bytes" % (args.path, file_size))
+
+    chunks = {}
+    first_burst = args.burst_bytes or max(file_size // 2, 1)
+
+    # first burst stops part way, as if the link had dropped
+    total, elapsed = ftp.burst(session, 0, first_burst, chunks)
+
+    # resume in a new session from the first byte we don't have
+    ftp.request(OP_TerminateSession, session=session)
+    r = ftp.request(OP_OpenFileRO, data=name)
+    session = r.session
+    while True:
+        gaps = missing_ranges(chunks, file_size)
+        if not gaps:
+            break
+        n, dt = ftp.burst(session, gaps[0][0], args.burst_bytes, chunks)
+        total += n
+        elapsed += dt
+        if n == 0:
+            break
+
+    # fill anything lost in the bursts
+    for (ofs, length) in missing_ranges(chunks, file_size):
+        while length > 0:
+            r = ftp.request(OP_ReadFile, session=session, offset=ofs, size=min(length, MAX_DATA))
+            if r.opcode != OP_Ack:
+                print("read failed at %u" % ofs)
+                sys.exit(1)
+            chunks[ofs] = r.data
+            ofs += len(r.data)
+            length -= len(r.data)
+
+    ftp.request(OP_TerminateSession, session=session)
+
+    data = bytearray(file_size)
+    for ofs in sorted(chunks.keys()):
+        data[ofs:ofs+len(chunks[ofs])] = chunks[ofs]
+    data = bytes(data[:file_size])
+    r = ftp.request(OP_CalcFileCRC32, data=name)
+    remote_crc = struct.unpack('<I', r.data[:4])[0]
+    local_crc = ap_crc32(data)
+    print("burst %u bytes in %.2fs, %.1f kB/s" % (total, elapsed, total / max(elapsed, 1e-3) / 1024))
+    if local_crc != remote_crc:
+        print("CRC mismatch: local 0x%08x remote 0x%08x" % (local_crc, remote_crc))
+        sys.exit(1)
+    print("CRC OK 0x%08x" % local_crc)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+'''
+create a terrain/PRELOAD.DEM pack for TERRAIN_PRELOAD from an ESRI
+ASCII grid.
+
+Any GeoTIFF DEM or bathymetry raster in WGS84 can be converted to an
+ASCII grid with:
+
+  gdal_translate -of AAIGrid -ot Int16 input.tif input.asc
+'''
+
+import struct
+import sys
+
+import argparse
+
+PRELOAD_MAGIC = 0x4D454454
+PRELOAD_VERSION = 1
+PRELOAD_HEADER = '<IHHiiiiHHhH'
+
+# largest pack, so that any sample can be reached with a 32 bit off_t
+PRELOAD_MAX_SIZE = 0x7FFFFFFF
+
+def read_ascii_grid(filename):
+    '''read an ESRI ASCII grid, returning header dict and rows north first'''
+    hdr = {}
+    rows = []
+    with open(filename) as f:
+        for line in f:
+            fields = line.split()
+            if not fields:
+                continue
+            key = fields[0].lower()
+            if len(hdr) < 6 and key in ['ncols', 'nrows', 'xllcorner', 'yllcorner',
+                                        'xllcenter', 'yllcenter', 'cellsize', 'nodata_value']:
+                hdr[key] = float(fields[1])
+                continue
+            rows.append([int(round(float(v))) for v in fields])
+    return hdr, rows
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', help='ESRI ASCII grid in WGS84 degrees')
+    parser.add_argument('output', nargs='?', default='PRELOAD.DEM', help='output pack')
+    args = parser.parse_args()
+
+    hdr, rows = read_ascii_grid(args.input)
+    ncols = int(hdr['ncols'])
+    nrows = int(hdr['nrows'])
+    cellsize = hdr['cellsize']
+    if 'xllcenter' in hdr:
+        lon = hdr['xllcenter']
+        lat = hdr['yllcenter']
+    else:
+        lon = hdr['xllcorner'] + 0.5*cellsize
+        lat = hdr['yllcorner'] + 0.5*cellsize
+    nodata = int(hdr.get('nodata_value', -32768))
+    if len(rows) != nrows or any(len(r) != ncols for r in rows):
+        print("Bad grid size in %s" % args.input)
+        sys.exit(1)
+    size = struct.calcsize(PRELOAD_HEADER) + nrows * ncols * 2
+    if nrows > 65535 or ncols > 65535 or size > PRELOAD_MAX_SIZE:
+        print("Grid too large, split it into smaller packs")
+        sys.exit(1)
+
+    step = int(round(cellsize * 1.0e7))
+    with open(args.output, 'wb') as f:
+        f.write(struct.pack(PRELOAD_HEADER,
+                            PRELOAD_MAGIC, PRELOAD_VERSION, 0,
+                            int(round(lat * 1.0e7)), int(round(lon * 1.0e7)),
+                            step, step,
+                            nrows, ncols,
+                            nodata, 0))
+        # ASCII grids are stored north first, packs south first
+        for r in reversed(rows):
+            f.write(struct.pack('<%uh' % ncols, *[max(-32768, min(32767, v)) for v in r]))
+    print("Wrote %s with %ux%u samples" % (args.output, nrows, ncols))
+
+if __name__ == '__main__':
+    main()
@@ -112,6 +112,38 @@ void AP_OADatabase::queue_push(const Location &loc, const uint32_t timestamp_ms,
         return;
     }
 
+    const OA_DbItem item = {loc, timestamp_ms, 0, 0, get_importance(distance, angle)};
+    {
+        WITH_SEMAPHORE(_queue.sem);
+        _queue.items->push(item);
+    }
+}
+
+// push a batch of readings into the database
+void AP_OADatabase::queue_push(const Location &loc, const float bearing, const uint32_t timestamp_ms, const AP_Proximity_Map::reading *readings, uint16_t count)
+{
+    if (!healthy()) {
+        return;
+    }
+
+    WITH_SEMAPHORE(_queue.sem);
+    for (uint16_t i=0; i<count; i++) {
+        const float distance = readings[i].distance_m;
+        if (!is_positive(distance)) {
+            // nothing seen in this direction
+            continue;
+        }
+        OA_DbItem item = {loc, timestamp_ms, 0, 0, get_importance(distance, readings[i].angle_deg)};
+        item.loc.offset_bearing(wrap_180(bearing + readings[i].angle_deg), distance);
+        if (!_queue.items->push(item)) {
+            break;
+        }
+    }
+}
+
+// get importance of an object at the given distance and angle
+AP_OADatabase::OA_DbItemImportance AP_OADatabase::get_importance(const float distance, const float angle) const
+{
     AP_OADatabase::OA_DbItemImportance importance = AP_OADatabase::OA_DbItemImportance::Normal;
 
     if (distance <= 0 || angle < 0 || angle > 360) {
@@ -139,11 +171,7 @@ void AP_OADatabase::queue_push(const Location &loc, const uint32_t timestamp_ms,
         importance = AP_OADatabase::OA_DbItemImportance::Low;
     }
 
-    const OA_DbItem item = {loc, timestamp_ms, 0, 0, importance};
-    {
-        WITH_SEMAPHORE(_queue.sem);
-        _queue.items->push(item);
-    }
+    return importance;
 }
 
 void AP_OADatabase::init_queue()
@@ -3,6 +3,7 @@
 #include <AP_HAL/AP_HAL.h>
 #include <AP_Common/Location.h>
 #include <GCS_MAVLink/GCS_MAVLink.h>
+#include <AP_Proximity/AP_Proximity_Map.h>
 
 #if !HAL_MINIMIZE_FEATURES
 #include <AP_Param/AP_Param.h>
@@ -39,6 +40,10 @@ public:
     // push a location into the database
     void queue_push(const Location &loc, const uint32_t timestamp_ms, const float distance, const float angle);
 
+    // push a batch of readings taken from loc with the vehicle at the
+    // given bearing, holding the queue lock once for the whole batch
+    void queue_push(const Location &loc, const float bearing, const uint32_t timestamp_ms, const AP_Proximity_Map::reading *readings, uint16_t count);
+
     // returns true if database is healthy
     bool healthy() const { return (_queue.items != nullptr) && (_database.items != nullptr); }
 
@@ -74,6 +79,9 @@ private:
     void database_item_remove(const uint16_t index);
     void database_items_remove_all_expired();
 
+    // get importance of an object at the given distance and body-frame angle
+    OA_DbItemImportance get_importance(const float distance, const float angle) const;
+
     // get bitmask of gcs channels item should be sent to based on its importance
     // returns 0xFF (send to all channels) if should be sent or 0 if it should not be sent
     uint8_t get_send_to_gcs_flags(const OA_DbItemImportance importance);
@@ -132,6 +140,7 @@ public:
     static AP_OADatabase *get_singleton() { return nullptr; }
     void init() {};
     void queue_push(const Location &loc, const uint32_t timestamp_ms, const float distance, const float angle) {};
+    void queue_push(const Location &loc, const float bearing, const uint32_t timestamp_ms, const AP_Proximity_Map::reading *readings, uint16_t count) {};
     bool healthy() const { return false; }
     void send_adsb_vehicle(mavlink_channel_t chan, uint16_t interval_ms) {};
 };
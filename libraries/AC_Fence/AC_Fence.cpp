@@ -555,7 +555,8 @@ bool AC_Fence::load_polygon_from_eeprom()
         // move into location structure and convert to offset from ekf origin
         temp_loc.lat = temp_latlon.x;
         temp_loc.lng = temp_latlon.y;
-        _boundary[index] = ekf_origin.get_distance_NE(temp_loc) * 100.0f;
+        const Vector2p ofs_ne = ekf_origin.get_distance_NE_postype(temp_loc);
+        _boundary[index] = Vector2f(ofs_ne.x * 100, ofs_ne.y * 100);
     }
     _boundary_num_points = _total;
     _boundary_update_ms = AP_HAL::millis();
@@ -179,7 +179,7 @@ bool AC_WPNav::get_wp_destination(Location& destination) const
     if (!AP::ahrs().get_origin(destination)) {
         return false;
     }
-    destination.offset(dest.x*0.01f, dest.y*0.01f);
+    destination.offset_postype(postype_t(dest.x) / 100, postype_t(dest.y) / 100);
     destination.alt += dest.z;
     return true;
 }
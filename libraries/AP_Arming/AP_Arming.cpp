@@ -31,6 +31,7 @@
 #include <AP_AHRS/AP_AHRS.h>
 #include <AP_Baro/AP_Baro.h>
 #include <AP_RangeFinder/AP_RangeFinder.h>
+#include <StorageManager/StorageManager.h>
 
 #if HAL_WITH_UAVCAN
   #include <AP_BoardConfig/AP_BoardConfig_CAN.h>
@@ -875,6 +876,9 @@ bool AP_Arming::disarm()
     //TODO: Log motor disarming to the logger
     //Can't do this from this class until there is a unified logging library.
 
+    // don't leave changes made in flight waiting to be written
+    StorageManager::flush();
+
     return true;
 }
 
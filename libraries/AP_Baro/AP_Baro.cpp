@@ -769,6 +769,8 @@ void AP_Baro::update(void)
         }
         if (_hil.have_last_update) {
             sensors[0].last_update_ms = _hil.last_update_ms;
+            sensors[0].sample_aligned = _hil.last_sample_ms != 0;
+            sensors[0].last_sample_ms = sensors[0].sample_aligned ? _hil.last_sample_ms : _hil.last_update_ms;
         }
     }
 
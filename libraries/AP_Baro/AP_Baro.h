@@ -2,6 +2,7 @@
 
 #include <AP_HAL/AP_HAL.h>
 #include <AP_Param/AP_Param.h>
+#include <AP_Common/SampleTiming.h>
 #include <Filter/Filter.h>
 #include <Filter/DerivativeFilter.h>
 
@@ -116,6 +117,17 @@ public:
     uint32_t get_last_update(void) const { return get_last_update(_primary); }
     uint32_t get_last_update(uint8_t instance) const { return sensors[instance].last_update_ms; }
 
+    // time that the last reading was measured, allowing for the time
+    // samples spend in the backend accumulator
+    uint32_t get_last_sample_ms(void) const { return get_last_sample_ms(_primary); }
+    uint32_t get_last_sample_ms(uint8_t instance) const { return sensors[instance].last_sample_ms; }
+    bool sample_time_aligned(void) const { return sensors[_primary].sample_aligned; }
+    bool sample_time_aligned(uint8_t instance) const { return sensors[instance].sample_aligned; }
+
+    // estimated latency and jitter from measurement to publication
+    uint32_t get_sample_latency_usec(uint8_t instance) const { return sensors[instance].timing.latency_usec(); }
+    uint32_t get_sample_jitter_usec(uint8_t instance) const { return sensors[instance].timing.jitter_usec(); }
+
     // settable parameters
     static const struct AP_Param::GroupInfo var_info[];
 
@@ -127,7 +139,8 @@ public:
 
     // HIL (and SITL) interface, setting pressure, temperature, altitude and climb_rate
     // used by Replay
-    void setHIL(uint8_t instance, float pressure, float temperature, float altitude, float climb_rate, uint32_t last_update_ms);
+    // used by Replay. A non-zero last_sample_ms is the logged aligned sample time
+    void setHIL(uint8_t instance, float pressure, float temperature, float altitude, float climb_rate, uint32_t last_update_ms, uint32_t last_sample_ms=0);
 
     // Set the primary baro
     void set_primary_baro(uint8_t primary) { _primary_baro.set_and_save(primary); };
@@ -145,6 +158,7 @@ public:
         float altitude;
         float climb_rate;
         uint32_t last_update_ms;
+        uint32_t last_sample_ms;
         bool updated:1;
         bool have_alt:1;
         bool have_last_update:1;
@@ -219,6 +233,9 @@ private:
     
     struct sensor {
         uint32_t last_update_ms;        // last update time in ms
+        uint32_t last_sample_ms;        // time the last reading was measured in ms
+        SampleTiming timing;            // bus transfer times of accumulated samples
+        bool sample_aligned;            // true if last_sample_ms came from bus transfer times
         uint32_t last_change_ms;        // last update time in ms that included a change in reading from previous readings
         float pressure;                 // pressure in Pascal
         float temperature;              // temperature in degrees C
@@ -200,4 +200,5 @@ void AP_Baro_BMP280::_update_pressure(int32_t press_raw)
     
     _pressure = press;
     _has_sample = true;
+    _sample_taken(_instance, true);
 }
@@ -49,6 +49,8 @@ void AP_Baro_Backend::_copy_to_frontend(uint8_t instance, float pressure, float
     if (instance >= _frontend._num_sensors) {
         return;
     }
+    WITH_SEMAPHORE(_sem);
+
     uint32_t now = AP_HAL::millis();
 
     // check for changes in data values
@@ -60,6 +62,31 @@ void AP_Baro_Backend::_copy_to_frontend(uint8_t instance, float pressure, float
     _frontend.sensors[instance].pressure = pressure;
     _frontend.sensors[instance].temperature = temperature;
     _frontend.sensors[instance].last_update_ms = now;
+
+    // the sample time is kept in microseconds, so convert via its age
+    const uint32_t now_us = AP_HAL::micros();
+    const uint32_t sample_us = _frontend.sensors[instance].timing.publish(now_us);
+    _frontend.sensors[instance].last_sample_ms = now - (now_us - sample_us) / 1000U;
+    _frontend.sensors[instance].sample_aligned = _frontend.sensors[instance].timing.have_sample_time();
+}
+
+void AP_Baro_Backend::_sample_taken(uint8_t instance, bool replace)
+{
+    if (instance >= _frontend._num_sensors) {
+        return;
+    }
+    if (replace) {
+        _frontend.sensors[instance].timing.replace(AP_HAL::micros());
+    } else {
+        _frontend.sensors[instance].timing.sample(AP_HAL::micros());
+    }
+}
+
+void AP_Baro_Backend::_samples_halved(uint8_t instance)
+{
+    if (instance < _frontend._num_sensors) {
+        _frontend.sensors[instance].timing.halve();
+    }
 }
 
 static constexpr float FILTER_KOEF = 0.1f;
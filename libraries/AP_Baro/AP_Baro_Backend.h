@@ -29,6 +29,12 @@ protected:
 
     void _copy_to_frontend(uint8_t instance, float pressure, float temperature);
 
+    // record the bus transfer time of a sample going into the
+    // accumulator, called with _sem held. Backends that only keep the
+    // latest reading set replace
+    void _sample_taken(uint8_t instance, bool replace=false);
+    void _samples_halved(uint8_t instance);
+
     // semaphore for access to shared frontend data
     HAL_Semaphore_Recursive _sem;
 
@@ -216,6 +216,7 @@ void AP_Baro_DPS280::timer(void)
     pressure_sum += pressure;
     temperature_sum += temperature;
     count++;
+    _sample_taken(instance);
 }
 
 // transfer data to the frontend
@@ -96,7 +96,7 @@ void AP_Baro::setHIL(float altitude_msl)
 /*
   set HIL pressure and temperature for an instance
  */
-void AP_Baro::setHIL(uint8_t instance, float pressure, float temperature, float altitude, float climb_rate, uint32_t last_update_ms)
+void AP_Baro::setHIL(uint8_t instance, float pressure, float temperature, float altitude, float climb_rate, uint32_t last_update_ms, uint32_t last_sample_ms)
 {
     if (instance >= _num_sensors) {
         // invalid
@@ -111,6 +111,7 @@ void AP_Baro::setHIL(uint8_t instance, float pressure, float temperature, float
 
     if (last_update_ms != 0) {
         _hil.last_update_ms = last_update_ms;
+        _hil.last_sample_ms = last_sample_ms;
         _hil.have_last_update = true;
     }
 }
@@ -284,8 +284,13 @@ void AP_Baro_MS56XX::_timer(void)
         _update_and_wrap_accumulator(&_accum.s_D2, adc_val,
                                      &_accum.d2_count, 32);
     } else if (pressure_ok(adc_val)) {
+        const uint8_t d1_count = _accum.d1_count;
+        _sample_taken(_instance);
         _update_and_wrap_accumulator(&_accum.s_D1, adc_val,
                                      &_accum.d1_count, 128);
+        if (_accum.d1_count <= d1_count) {
+            _samples_halved(_instance);
+        }
     }
     
     _state = next_state;
@@ -113,9 +113,12 @@ void AP_Baro_SITL::_timer()
     float T = 303.16f * theta - C_TO_KELVIN;  // Assume 30 degrees at sea level - converted to degrees Kelvin
 #endif
 
+    WITH_SEMAPHORE(_sem);
+
     _recent_press = p;
     _recent_temp = T;
     _has_sample = true;
+    _sample_taken(_instance, true);
 }
 
 // Read the sensor
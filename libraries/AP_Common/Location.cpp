@@ -2,13 +2,26 @@
  * Location.cpp
  */
 
+// for the postype_t conversions on boards with HAL_WITH_POSTYPE_DOUBLE
+#define ALLOW_DOUBLE_MATH_FUNCTIONS
+
 #include "Location.h"
 
 #include <AP_AHRS/AP_AHRS.h>
 #include <AP_Terrain/AP_Terrain.h>
 
+extern const AP_HAL::HAL& hal;
+
 AP_Terrain *Location::_terrain = nullptr;
 
+#if HAL_WITH_POSTYPE_DOUBLE
+// scaling factor from 1e-7 degrees to meters at equator. These are
+// calculated rather than written as literals so they keep their
+// precision on builds with -fsingle-precision-constant
+static const double LOCATION_SCALING_FACTOR_POSTYPE = RADIUS_OF_EARTH * DEG_TO_RAD_DOUBLE / 10000000;
+static const double LOCATION_SCALING_FACTOR_INV_POSTYPE = 1 / LOCATION_SCALING_FACTOR_POSTYPE;
+#endif
+
 /// constructors
 Location::Location()
 {
@@ -44,7 +57,7 @@ Location::Location(const Vector3f &ekf_offset_neu)
     if (AP::ahrs().get_origin(ekf_origin)) {
         lat = ekf_origin.lat;
         lng = ekf_origin.lng;
-        offset(ekf_offset_neu.x / 100.0f, ekf_offset_neu.y / 100.0f);
+        offset_postype(postype_t(ekf_offset_neu.x) / 100, postype_t(ekf_offset_neu.y) / 100);
     }
 }
 
@@ -190,8 +203,10 @@ bool Location::get_vector_xy_from_origin_NE(Vector2f &vec_ne) const
     if (!AP::ahrs().get_origin(ekf_origin)) {
         return false;
     }
-    vec_ne.x = (lat-ekf_origin.lat) * LATLON_TO_CM;
-    vec_ne.y = (lng-ekf_origin.lng) * LATLON_TO_CM * ekf_origin.longitude_scale();
+    // use the EKF's projection so the result matches its position
+    const Vector2p ofs_ne = ekf_origin.get_distance_NE_postype(*this);
+    vec_ne.x = ofs_ne.x * 100;
+    vec_ne.y = ofs_ne.y * 100;
     return true;
 }
 
@@ -242,6 +257,20 @@ Vector3f Location::get_distance_NED(const Location &loc2) const
                     (alt - loc2.alt) * 0.01f);
 }
 
+/*
+  return the distance in meters in North/East plane as a N/E vector
+  from this location to loc2, at postype_t precision
+ */
+Vector2p Location::get_distance_NE_postype(const Location &loc2) const
+{
+#if HAL_WITH_POSTYPE_DOUBLE
+    return Vector2p((loc2.lat - lat) * LOCATION_SCALING_FACTOR_POSTYPE,
+                    (loc2.lng - lng) * LOCATION_SCALING_FACTOR_POSTYPE * longitude_scale_postype());
+#else
+    return get_distance_NE(loc2);
+#endif
+}
+
 // extrapolate latitude/longitude given distances (in meters) north and east
 void Location::offset(float ofs_north, float ofs_east)
 {
@@ -254,6 +283,22 @@ void Location::offset(float ofs_north, float ofs_east)
     }
 }
 
+// extrapolate latitude/longitude given distances (in meters) north
+// and east, at postype_t precision and rounding to the nearest 1e-7
+// degree
+void Location::offset_postype(postype_t ofs_north, postype_t ofs_east)
+{
+#if HAL_WITH_POSTYPE_DOUBLE
+    const postype_t dlat = ofs_north * LOCATION_SCALING_FACTOR_INV_POSTYPE;
+    const postype_t dlng = (ofs_east * LOCATION_SCALING_FACTOR_INV_POSTYPE) / longitude_scale_postype();
+#else
+    const postype_t dlat = ofs_north * LOCATION_SCALING_FACTOR_INV;
+    const postype_t dlng = (ofs_east * LOCATION_SCALING_FACTOR_INV) / longitude_scale_postype();
+#endif
+    lat += (int32_t)(dlat + (dlat < 0 ? postype_t(-0.5) : postype_t(0.5)));
+    lng += (int32_t)(dlng + (dlng < 0 ? postype_t(-0.5) : postype_t(0.5)));
+}
+
 /*
  *  extrapolate latitude/longitude given bearing and distance
  * Note that this function is accurate to about 1mm at a distance of
@@ -263,15 +308,37 @@ void Location::offset(float ofs_north, float ofs_east)
  */
 void Location::offset_bearing(float bearing, float distance)
 {
-    const float ofs_north = cosf(radians(bearing)) * distance;
-    const float ofs_east  = sinf(radians(bearing)) * distance;
-    offset(ofs_north, ofs_east);
+    float sin_bearing, cos_bearing;
+    fast_sincosf(radians(bearing), sin_bearing, cos_bearing);
+    offset(cos_bearing * distance, sin_bearing * distance);
 }
 
 float Location::longitude_scale() const
 {
-    float scale = cosf(lat * (1.0e-7f * DEG_TO_RAD));
-    return MAX(scale, 0.01f);
+    return float(longitude_scale_postype());
+}
+
+postype_t Location::longitude_scale_postype() const
+{
+    // the main thread asks for the scale at the same latitude many
+    // times per loop, so keep the last result. Other threads don't
+    // share the cache
+    static int32_t last_lat;
+    static postype_t last_scale = 1;
+    const bool main_thread = hal.scheduler->in_main_thread();
+    if (main_thread && lat == last_lat) {
+        return last_scale;
+    }
+#if HAL_WITH_POSTYPE_DOUBLE
+    const postype_t scale = MAX(cos(lat * DEG_TO_RAD_DOUBLE / 10000000), 0.01);
+#else
+    const postype_t scale = MAX(fast_cosf(lat * (1.0e-7f * DEG_TO_RAD)), 0.01f);
+#endif
+    if (main_thread) {
+        last_lat = lat;
+        last_scale = scale;
+    }
+    return scale;
 }
 
 /*
@@ -313,7 +380,7 @@ int32_t Location::get_bearing_to(const struct Location &loc2) const
 {
     const int32_t off_x = loc2.lng - lng;
     const int32_t off_y = (loc2.lat - lat) / loc2.longitude_scale();
-    int32_t bearing = 9000 + atan2f(-off_y, off_x) * DEGX100;
+    int32_t bearing = 9000 + fast_atan2f(-off_y, off_x) * DEGX100;
     if (bearing < 0) {
         bearing += 36000;
     }
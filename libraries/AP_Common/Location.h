@@ -74,6 +74,14 @@ public:
     // extrapolate latitude/longitude given bearing and distance
     void offset_bearing(float bearing, float distance);
 
+    // versions of get_distance_NE() and offset() for use far from the
+    // EKF origin, in double precision on boards with
+    // HAL_WITH_POSTYPE_DOUBLE. They use the same flat earth projection
+    // as the EKF, and offset_postype() rounds to the nearest 1e-7
+    // degree instead of truncating
+    Vector2p get_distance_NE_postype(const Location &loc2) const;
+    void offset_postype(postype_t ofs_north, postype_t ofs_east);
+
     // longitude_scale - returns the scaler to compensate for
     // shrinking longitude as you move north or south from the equator
     // Note: this does not include the scaling to convert
@@ -122,4 +130,7 @@ private:
     static constexpr float LOCATION_SCALING_FACTOR = 0.011131884502145034f;
     // inverse of LOCATION_SCALING_FACTOR
     static constexpr float LOCATION_SCALING_FACTOR_INV = 89.83204953368922f;
+
+    // longitude_scale() at postype_t precision
+    postype_t longitude_scale_postype() const;
 };
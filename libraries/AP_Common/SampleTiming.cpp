@@ -0,0 +1,98 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  class to give sensor samples a measurement time.
+
+  Backends read samples in a bus callback and accumulate them until
+  the main loop publishes the average to the frontend. Stamping the
+  published value with the time of publication adds a lag of up to a
+  full publish interval, and that lag varies from one update to the
+  next.
+
+  Instead each bus transfer is recorded with sample(), and publish()
+  returns the mean transfer time of the samples that went into the
+  average, which is the time the averaged value actually applies
+  to. The age of the batch when it is published is tracked with a
+  low pass filter to give an online estimate of the latency and
+  jitter of each sensor.
+
+  All times are 32 bit microsecond times, so differences are safe
+  across wrap. The caller must serialise calls, normally with the
+  backend semaphore protecting the accumulator.
+ */
+
+#include <AP_Math/AP_Math.h>
+#include "SampleTiming.h"
+
+// time constant of the latency estimate in batches
+#define SAMPLE_TIMING_ALPHA 0.05f
+
+void SampleTiming::sample(uint32_t transfer_us)
+{
+    if (count == 0) {
+        first_us = transfer_us;
+        sum_us = 0;
+    }
+    sum_us += uint32_t(transfer_us - first_us);
+    count++;
+}
+
+void SampleTiming::halve(void)
+{
+    count /= 2;
+    sum_us /= 2;
+}
+
+/*
+  close the current batch of samples, returning the mean time of the
+  bus transfers in the batch. If no transfers were recorded then the
+  backend does not support sample timing and now_us is returned
+ */
+uint32_t SampleTiming::publish(uint32_t now_us)
+{
+    if (count == 0) {
+        aligned = false;
+        sample_us = now_us;
+        return sample_us;
+    }
+
+    sample_us = first_us + uint32_t(sum_us / count);
+    count = 0;
+    aligned = true;
+
+    // a batch can't be from the future
+    int32_t age_us = int32_t(now_us - sample_us);
+    if (age_us < 0) {
+        sample_us = now_us;
+        age_us = 0;
+    }
+
+    if (!initialised) {
+        latency_us = age_us;
+        latency_var = 0;
+        initialised = true;
+    } else {
+        const float err = age_us - latency_us;
+        latency_us += SAMPLE_TIMING_ALPHA * err;
+        latency_var = (1 - SAMPLE_TIMING_ALPHA) * (latency_var + SAMPLE_TIMING_ALPHA * sq(err));
+    }
+
+    return sample_us;
+}
+
+uint32_t SampleTiming::jitter_usec(void) const
+{
+    return uint32_t(sqrtf(latency_var));
+}
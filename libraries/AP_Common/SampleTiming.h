@@ -0,0 +1,64 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  sensor sample timing class
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+class SampleTiming {
+public:
+    // record a sample read over the bus at transfer_us
+    void sample(uint32_t transfer_us);
+
+    // record a sample that replaces any unpublished samples, for
+    // backends that only keep the latest reading
+    void replace(uint32_t transfer_us) {
+        count = 0;
+        sample(transfer_us);
+    }
+
+    // halve the accumulated samples, for backends that halve their
+    // own accumulator when it gets full
+    void halve(void);
+
+    // close the current batch of samples when they are published at
+    // now_us. See SampleTiming.cpp for details
+    uint32_t publish(uint32_t now_us);
+
+    // aligned time of the last published batch in microseconds
+    uint32_t sample_usec(void) const { return sample_us; }
+
+    // true if the last published batch had bus transfer times
+    bool have_sample_time(void) const { return aligned; }
+
+    // estimated time from bus transfer to publication
+    uint32_t latency_usec(void) const { return uint32_t(latency_us); }
+
+    // estimated standard deviation of the latency
+    uint32_t jitter_usec(void) const;
+
+private:
+    uint32_t first_us = 0;
+    uint64_t sum_us = 0;
+    uint32_t count = 0;
+    uint32_t sample_us = 0;
+    float latency_us = 0;
+    float latency_var = 0;
+    bool aligned = false;
+    bool initialised = false;
+};
@@ -0,0 +1,39 @@
+#include <AP_gtest.h>
+
+#include <AP_Common/Location.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+static const Location origin(-353632640, 1491652352, 0, Location::AltFrame::ABSOLUTE);
+
+// the postype and float versions agree close to the origin
+TEST(LocationPostype, MatchesFloat)
+{
+    for (float ofs = -1000; ofs <= 1000; ofs += 37.3f) {
+        Location loc = origin;
+        loc.offset(ofs, -0.7f * ofs);
+        const Vector2f ne = origin.get_distance_NE(loc);
+        const Vector2p ne_postype = origin.get_distance_NE_postype(loc);
+        EXPECT_NEAR(ne.x, ne_postype.x, 1e-3);
+        EXPECT_NEAR(ne.y, ne_postype.y, 1e-3);
+    }
+}
+
+#if HAL_WITH_POSTYPE_DOUBLE
+// offsets far from the origin survive a round trip to within half of
+// the 1e-7 degree resolution of a location
+TEST(LocationPostype, RoundTrip)
+{
+    const double lat_res = origin.get_distance_NE_postype(Location(origin.lat+1, origin.lng, 0, Location::AltFrame::ABSOLUTE)).x;
+    const double lng_res = origin.get_distance_NE_postype(Location(origin.lat, origin.lng+1, 0, Location::AltFrame::ABSOLUTE)).y;
+    for (double ofs = -150000; ofs <= 150000; ofs += 1234.567) {
+        Location loc = origin;
+        loc.offset_postype(ofs, 0.6 * ofs);
+        const Vector2p ne = origin.get_distance_NE_postype(loc);
+        EXPECT_NEAR(ofs, ne.x, 0.5 * lat_res + 1e-6);
+        EXPECT_NEAR(0.6 * ofs, ne.y, 0.5 * lng_res + 1e-6);
+    }
+}
+#endif
+
+AP_GTEST_MAIN()
@@ -0,0 +1,73 @@
+#include <AP_gtest.h>
+
+#include <AP_Common/SampleTiming.h>
+
+TEST(SampleTiming, Unaligned)
+{
+    SampleTiming t;
+
+    // with no bus transfers the publication time is used
+    EXPECT_EQ(5000U, t.publish(5000));
+    EXPECT_FALSE(t.have_sample_time());
+}
+
+TEST(SampleTiming, MeanTransferTime)
+{
+    SampleTiming t;
+
+    t.sample(1000);
+    t.sample(2000);
+    t.sample(3000);
+    t.sample(4000);
+    EXPECT_EQ(2500U, t.publish(10000));
+    EXPECT_TRUE(t.have_sample_time());
+    EXPECT_EQ(7500U, t.latency_usec());
+    EXPECT_EQ(0U, t.jitter_usec());
+
+    // the batch is closed on publish
+    EXPECT_EQ(20000U, t.publish(20000));
+    EXPECT_FALSE(t.have_sample_time());
+
+    t.sample(30000);
+    t.replace(31000);
+    EXPECT_EQ(31000U, t.publish(32000));
+
+    // halving keeps the mean
+    t.sample(40000);
+    t.sample(41000);
+    t.halve();
+    t.sample(42000);
+    EXPECT_EQ(41250U, t.publish(43000));
+}
+
+TEST(SampleTiming, Wrap)
+{
+    SampleTiming t;
+
+    t.sample(0xFFFFFF00U);
+    t.sample(0x00000100U);
+    EXPECT_EQ(0U, t.publish(0x00000200U));
+    EXPECT_EQ(0x200U, t.latency_usec());
+}
+
+TEST(SampleTiming, LatencyEstimate)
+{
+    SampleTiming t;
+
+    // samples every 1ms published every 10ms with a varying delay
+    uint32_t now = 0;
+    for (uint16_t i=0; i<1000; i++) {
+        for (uint8_t s=0; s<10; s++) {
+            now += 1000;
+            t.sample(now);
+        }
+        const uint32_t delay = (i & 1) ? 2000 : 0;
+        EXPECT_EQ(now - 4500, t.publish(now + delay));
+    }
+
+    // mean age is 4.5ms plus 1ms of average delay, with 1ms of jitter
+    EXPECT_NEAR(5500, t.latency_usec(), 100);
+    EXPECT_NEAR(1000, t.jitter_usec(), 100);
+}
+
+AP_GTEST_MAIN()
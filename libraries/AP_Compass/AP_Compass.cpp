@@ -27,6 +27,7 @@
 #include "AP_Compass_RM3100.h"
 #include "AP_Compass.h"
 #include "Compass_learn.h"
+#include "Compass_OnlineCal.h"
 
 extern AP_HAL::HAL& hal;
 
@@ -487,6 +488,15 @@ const AP_Param::GroupInfo Compass::var_info[] = {
     // @Values: 0:Disabled,1:Enabled
     AP_GROUPINFO("ENABLE", 39, Compass, _enabled, 1),
 
+#if COMPASS_ONLINE_CAL_ENABLED
+    // @Param: OCAL
+    // @DisplayName: Online compass calibration
+    // @Description: Continuously refine the offsets, diagonals and off-diagonals of all compasses from live samples. With Estimate the result is only logged. With Estimate-and-save the result is also saved when the vehicle disarms, if it has seen enough attitudes and passes the same checks as a full calibration. It is paused while a full calibration or InFlight learning is running.
+    // @Values: 0:Disabled,1:Estimate,2:Estimate-and-save
+    // @User: Advanced
+    AP_GROUPINFO("OCAL", 40, Compass, _online_cal, 0),
+#endif
+
     AP_GROUPEND
 };
 
@@ -924,6 +934,15 @@ Compass::read(void)
     if (_learn == LEARN_INFLIGHT && learn != nullptr) {
         learn->update();
     }
+#if COMPASS_ONLINE_CAL_ENABLED
+    if (_online_cal != 0 && !online_cal_allocated) {
+        online_cal_allocated = true;
+        online_cal = new CompassOnlineCal(*this);
+    }
+    if (_online_cal != 0 && online_cal != nullptr) {
+        online_cal->update();
+    }
+#endif
     bool ret = healthy();
     if (ret && _log_bit != (uint32_t)-1 && AP::logger().should_log(_log_bit) && !AP::ahrs().have_ekf_logging()) {
         AP::logger().Write_Compass();
@@ -1202,6 +1221,12 @@ void Compass::setHIL(uint8_t instance, const Vector3f &mag, uint32_t update_usec
     _state[instance].last_update_usec = update_usec;
 }
 
+void Compass::setHIL_sample_usec(uint8_t instance, uint32_t sample_usec)
+{
+    _state[instance].sample_aligned = sample_usec != 0;
+    _state[instance].last_sample_usec = sample_usec != 0 ? sample_usec : _state[instance].last_update_usec;
+}
+
 const Vector3f& Compass::getHIL(uint8_t instance) const
 {
     return _hil.field[instance];
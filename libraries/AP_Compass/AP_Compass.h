@@ -3,6 +3,7 @@
 #include <inttypes.h>
 
 #include <AP_Common/AP_Common.h>
+#include <AP_Common/SampleTiming.h>
 #include <AP_Declination/AP_Declination.h>
 #include <AP_HAL/AP_HAL.h>
 #include <AP_Math/AP_Math.h>
@@ -34,6 +35,7 @@
 #define COMPASS_CAL_ENABLED !defined(HAL_BUILD_AP_PERIPH)
 #define COMPASS_MOT_ENABLED !defined(HAL_BUILD_AP_PERIPH)
 #define COMPASS_LEARN_ENABLED !defined(HAL_BUILD_AP_PERIPH)
+#define COMPASS_ONLINE_CAL_ENABLED !defined(HAL_BUILD_AP_PERIPH)
 
 // define default compass calibration fitness and consistency checks
 #define AP_COMPASS_CALIBRATION_FITNESS_DEFAULT 16.0f
@@ -49,6 +51,7 @@
 #define COMPASS_MAX_BACKEND   3
 
 class CompassLearn;
+class CompassOnlineCal;
 
 class Compass
 {
@@ -66,6 +69,7 @@ public:
     }
 
     friend class CompassLearn;
+    friend class CompassOnlineCal;
 
     /// Initialize the compass device.
     ///
@@ -270,6 +274,8 @@ public:
     // HIL methods
     void        setHIL(uint8_t instance, float roll, float pitch, float yaw);
     void        setHIL(uint8_t instance, const Vector3f &mag, uint32_t last_update_usec);
+    // set the logged aligned sample time for Replay, zero if not aligned
+    void        setHIL_sample_usec(uint8_t instance, uint32_t sample_usec);
     const Vector3f&   getHIL(uint8_t instance) const;
     void        _setup_earth_field();
 
@@ -280,6 +286,16 @@ public:
     uint32_t last_update_usec(void) const { return _state[get_primary()].last_update_usec; }
     uint32_t last_update_usec(uint8_t i) const { return _state[i].last_update_usec; }
 
+    // time the last published field was measured, and whether the
+    // backend recorded bus transfer times to measure it. When not
+    // aligned it is the time of publication
+    uint32_t last_sample_usec(uint8_t i) const { return _state[i].last_sample_usec; }
+    bool sample_time_aligned(uint8_t i) const { return _state[i].sample_aligned; }
+
+    // estimated latency and jitter from measurement to publication
+    uint32_t sample_latency_usec(uint8_t i) const { return _state[i].timing.latency_usec(); }
+    uint32_t sample_jitter_usec(uint8_t i) const { return _state[i].timing.jitter_usec(); }
+
     uint32_t last_update_ms(void) const { return _state[get_primary()].last_update_ms; }
     uint32_t last_update_ms(uint8_t i) const { return _state[i].last_update_ms; }
 
@@ -350,6 +366,11 @@ private:
     //keep track of which calibrators have been saved
     bool _cal_saved[COMPASS_MAX_INSTANCES];
     bool _cal_autosave;
+
+    // calibration fits run in their own thread, started on first use
+    void _calibration_thread(void);
+    bool _start_calibration_thread(void);
+    bool _cal_thread_started;
 #endif
 
     //autoreboot after compass calibration
@@ -457,6 +478,12 @@ private:
         uint32_t    last_update_ms;
         uint32_t    last_update_usec;
 
+        // time the published field was measured, from the bus
+        // transfer times of the accumulated samples
+        uint32_t    last_sample_usec;
+        bool        sample_aligned;
+        SampleTiming timing;
+
         // board specific orientation
         enum Rotation rotation;
 
@@ -489,6 +516,11 @@ private:
     CompassLearn *learn;
     bool learn_allocated;
 
+    // continuous online calibration
+    AP_Int8 _online_cal;
+    CompassOnlineCal *online_cal;
+    bool online_cal_allocated;
+
     /// Sets the initial location used to get declination
     ///
     /// @param  latitude             GPS Latitude.
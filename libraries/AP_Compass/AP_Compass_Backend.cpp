@@ -120,9 +120,11 @@ void AP_Compass_Backend::accumulate_sample(Vector3f &field, uint8_t instance,
     Compass::mag_state &state = _compass._state[instance];
     state.accum += field;
     state.accum_count++;
+    state.timing.sample(AP_HAL::micros());
     if (max_samples && state.accum_count >= max_samples) {
         state.accum_count /= 2;
         state.accum /= 2;
+        state.timing.halve();
     }
 }
 
@@ -159,12 +161,16 @@ void AP_Compass_Backend::publish_filtered_field(const Vector3f &mag, uint8_t ins
 
     state.last_update_ms = AP_HAL::millis();
     state.last_update_usec = AP_HAL::micros();
+    state.last_sample_usec = state.timing.publish(state.last_update_usec);
+    state.sample_aligned = state.timing.have_sample_time();
 }
 
-void AP_Compass_Backend::set_last_update_usec(uint32_t last_update, uint8_t instance)
+void AP_Compass_Backend::set_last_update_usec(uint32_t last_update, uint32_t last_sample, bool sample_aligned, uint8_t instance)
 {
     Compass::mag_state &state = _compass._state[instance];
     state.last_update_usec = last_update;
+    state.last_sample_usec = last_sample;
+    state.sample_aligned = sample_aligned;
 }
 
 /*
@@ -18,6 +18,10 @@ Compass::cal_update()
     bool running = false;
 
     for (uint8_t i=0; i<COMPASS_MAX_INSTANCES; i++) {
+        if (!_cal_thread_started) {
+            // no fit thread, so run the fit here
+            _calibrator[i].run_fit();
+        }
         bool failure;
         _calibrator[i].update(failure);
         if (failure) {
@@ -47,6 +51,46 @@ Compass::cal_update()
     }
 }
 
+/*
+  run the calibration fits, so the scheduler only has to pick up the
+  results. The fits for several compasses run one after another
+ */
+void
+Compass::_calibration_thread(void)
+{
+    while (true) {
+        bool fitted = false;
+        for (uint8_t i=0; i<COMPASS_MAX_INSTANCES; i++) {
+            if (_calibrator[i].run_fit()) {
+                fitted = true;
+            }
+        }
+        if (!fitted) {
+            hal.scheduler->delay(20);
+        }
+    }
+}
+
+bool
+Compass::_start_calibration_thread(void)
+{
+    if (_cal_thread_started) {
+        return true;
+    }
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+    // SITL snapshots fork() the vehicle, and only the main thread
+    // survives a fork, so the fits run from cal_update() instead
+    return false;
+#endif
+    if (!hal.scheduler->thread_create(FUNCTOR_BIND_MEMBER(&Compass::_calibration_thread, void),
+                                      "compass_cal",
+                                      4096, AP_HAL::Scheduler::PRIORITY_IO, -1)) {
+        return false;
+    }
+    _cal_thread_started = true;
+    return true;
+}
+
 bool
 Compass::_start_calibration(uint8_t i, bool retry, float delay)
 {
@@ -74,6 +118,7 @@ Compass::_start_calibration(uint8_t i, bool retry, float delay)
         }
     }
     _cal_saved[i] = false;
+    _start_calibration_thread();
     _calibrator[i].start(retry, delay, get_offsets_max(), i);
 
     // disable compass learning both for calibration and after completion
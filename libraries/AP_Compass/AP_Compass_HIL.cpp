@@ -65,8 +65,10 @@ void AP_Compass_HIL::read()
             publish_raw_field(field, compass_instance);
             correct_field(field, compass_instance);
             uint32_t saved_last_update = _compass.last_update_usec(compass_instance);
+            uint32_t saved_last_sample = _compass.last_sample_usec(compass_instance);
+            bool saved_aligned = _compass.sample_time_aligned(compass_instance);
             publish_filtered_field(field, compass_instance);
-            set_last_update_usec(saved_last_update, compass_instance);
+            set_last_update_usec(saved_last_update, saved_last_sample, saved_aligned, compass_instance);
         }
     }
 }
@@ -65,6 +65,8 @@
 
 extern const AP_HAL::HAL& hal;
 
+CompassCalibrator::fit_snapshot *CompassCalibrator::_snapshot;
+
 ////////////////////////////////////////////////////////////
 ///////////////////// PUBLIC INTERFACE /////////////////////
 ////////////////////////////////////////////////////////////
@@ -73,15 +75,17 @@ CompassCalibrator::CompassCalibrator():
 _tolerance(COMPASS_CAL_DEFAULT_TOLERANCE),
 _sample_buffer(nullptr)
 {
-    clear();
+    set_status(COMPASS_CAL_NOT_STARTED);
 }
 
 void CompassCalibrator::clear() {
+    WITH_SEMAPHORE(_sem);
     set_status(COMPASS_CAL_NOT_STARTED);
 }
 
 void CompassCalibrator::start(bool retry, float delay, uint16_t offset_max, uint8_t compass_idx)
 {
+    WITH_SEMAPHORE(_sem);
     if(running()) {
         return;
     }
@@ -153,6 +157,7 @@ CompassCalibrator::completion_mask_t& CompassCalibrator::get_completion_mask()
 }
 
 bool CompassCalibrator::check_for_timeout() {
+    WITH_SEMAPHORE(_sem);
     uint32_t tnow = AP_HAL::millis();
     if(running() && tnow - _last_sample_ms > 1000) {
         _retry = false;
@@ -163,6 +168,7 @@ bool CompassCalibrator::check_for_timeout() {
 }
 
 void CompassCalibrator::new_sample(const Vector3f& sample) {
+    WITH_SEMAPHORE(_sem);
     _last_sample_ms = AP_HAL::millis();
 
     if(_status == COMPASS_CAL_WAITING_TO_START) {
@@ -177,43 +183,98 @@ void CompassCalibrator::new_sample(const Vector3f& sample) {
     }
 }
 
+/*
+  apply the result of a fit step run by the fit thread
+ */
 void CompassCalibrator::update(bool &failure) {
     failure = false;
 
-    if(!fitting()) {
+    WITH_SEMAPHORE(_sem);
+
+    if(!fitting() || !_fit_done) {
         return;
     }
+    _fit_done = false;
+
+    const fit_job &job = _fit_result;
+    _params = job.params;
+    _fitness = job.fitness;
+    _sphere_lambda = job.sphere_lambda;
+    _ellipsoid_lambda = job.ellipsoid_lambda;
+    update_completion_mask();
 
     if(_status == COMPASS_CAL_RUNNING_STEP_ONE) {
-        if (_fit_step >= 10) {
-            if(is_equal(_fitness,_initial_fitness) || isnan(_fitness)) {           //if true, means that fitness is diverging instead of converging
-                set_status(COMPASS_CAL_FAILED);
-                failure = true;
-            }
-            set_status(COMPASS_CAL_RUNNING_STEP_TWO);
+        if(is_equal(_fitness,_initial_fitness) || isnan(_fitness)) {           //if true, means that fitness is diverging instead of converging
+            set_status(COMPASS_CAL_FAILED);
+            failure = true;
         } else {
-            if (_fit_step == 0) {
-                calc_initial_offset();
-            }
-            run_sphere_fit();
-            _fit_step++;
+            set_status(COMPASS_CAL_RUNNING_STEP_TWO);
         }
     } else if(_status == COMPASS_CAL_RUNNING_STEP_TWO) {
-        if (_fit_step >= 35) {
-            if(fit_acceptable() && calculate_orientation()) {
-                set_status(COMPASS_CAL_SUCCESS);
-            } else {
-                set_status(COMPASS_CAL_FAILED);
-                failure = true;
-            }
-        } else if (_fit_step < 15) {
-            run_sphere_fit();
-            _fit_step++;
+        _orientation = job.orientation;
+        _orientation_confidence = job.orientation_confidence;
+        if (job.bad_orientation) {
+            set_status(COMPASS_CAL_BAD_ORIENTATION);
+            failure = true;
+        } else if (job.acceptable) {
+            set_status(COMPASS_CAL_SUCCESS);
         } else {
-            run_ellipsoid_fit();
-            _fit_step++;
+            set_status(COMPASS_CAL_FAILED);
+            failure = true;
+        }
+    }
+}
+
+/*
+  run the fit for the current step against a snapshot of the samples,
+  so that the main thread is only held up while the samples are
+  copied. The whole step runs at once, and the result is picked up by
+  update()
+ */
+bool CompassCalibrator::run_fit()
+{
+    fit_job job;
+    {
+        WITH_SEMAPHORE(_sem);
+        if(!fitting() || _fit_done) {
+            return false;
+        }
+        if (_snapshot == nullptr) {
+            _snapshot = new fit_snapshot;
+            if (_snapshot == nullptr) {
+                return false;
+            }
+        }
+        for (uint16_t i = 0; i < _samples_collected; i++) {
+            const Vector3f v = _sample_buffer[i].get();
+            _snapshot->x[i] = v.x;
+            _snapshot->y[i] = v.y;
+            _snapshot->z[i] = v.z;
+            _snapshot->att[i] = _sample_buffer[i].att;
         }
+        _snapshot->count = _samples_collected;
+
+        job.status = _status;
+        job.generation = _fit_generation;
+        job.params = _params;
+        job.fitness = _fitness;
+        job.initial_fitness = _initial_fitness;
+        job.sphere_lambda = _sphere_lambda;
+        job.ellipsoid_lambda = _ellipsoid_lambda;
+        job.orientation = _orientation;
+        job.orientation_confidence = _orientation_confidence;
+        job.acceptable = false;
+        job.bad_orientation = false;
     }
+
+    run_fit_step(*_snapshot, job);
+
+    WITH_SEMAPHORE(_sem);
+    if (job.generation == _fit_generation && job.status == _status) {
+        _fit_result = job;
+        _fit_done = true;
+    }
+    return true;
 }
 
 /////////////////////////////////////////////////////////////
@@ -237,7 +298,10 @@ void CompassCalibrator::initialize_fit() {
     _ellipsoid_lambda = 1.0f;
     _sphere_lambda = 1.0f;
     _initial_fitness = _fitness;
-    _fit_step = 0;
+
+    // any fit in progress is for the old samples
+    _fit_generation++;
+    _fit_done = false;
 }
 
 void CompassCalibrator::reset_state() {
@@ -349,20 +413,21 @@ bool CompassCalibrator::set_status(compass_cal_status_t status) {
     };
 }
 
-bool CompassCalibrator::fit_acceptable() {
-    if( !isnan(_fitness) &&
-        _params.radius > 150 && _params.radius < 950 && //Earth's magnetic field strength range: 250-850mG
-        fabsf(_params.offset.x) < _offset_max &&
-        fabsf(_params.offset.y) < _offset_max &&
-        fabsf(_params.offset.z) < _offset_max &&
-        _params.diag.x > 0.2f && _params.diag.x < 5.0f &&
-        _params.diag.y > 0.2f && _params.diag.y < 5.0f &&
-        _params.diag.z > 0.2f && _params.diag.z < 5.0f &&
-        fabsf(_params.offdiag.x) <  1.0f &&      //absolute of sine/cosine output cannot be greater than 1
-        fabsf(_params.offdiag.y) <  1.0f &&
-        fabsf(_params.offdiag.z) <  1.0f ){
-
-            return _fitness <= sq(_tolerance);
+bool CompassCalibrator::fit_acceptable(const fit_job &job) const {
+    const param_t &params = job.params;
+    if( !isnan(job.fitness) &&
+        params.radius > 150 && params.radius < 950 && //Earth's magnetic field strength range: 250-850mG
+        fabsf(params.offset.x) < _offset_max &&
+        fabsf(params.offset.y) < _offset_max &&
+        fabsf(params.offset.z) < _offset_max &&
+        params.diag.x > 0.2f && params.diag.x < 5.0f &&
+        params.diag.y > 0.2f && params.diag.y < 5.0f &&
+        params.diag.z > 0.2f && params.diag.z < 5.0f &&
+        fabsf(params.offdiag.x) <  1.0f &&      //absolute of sine/cosine output cannot be greater than 1
+        fabsf(params.offdiag.y) <  1.0f &&
+        fabsf(params.offdiag.z) <  1.0f ){
+
+            return job.fitness <= sq(_tolerance);
         }
     return false;
 }
@@ -463,81 +528,105 @@ float CompassCalibrator::calc_mean_squared_residuals(const param_t& params) cons
     return sum;
 }
 
-void CompassCalibrator::calc_sphere_jacob(const Vector3f& sample, const param_t& params, float* ret) const{
+/*
+  mean squared residuals over the snapshot. The soft iron matrix is
+  applied as scalar products so the loop runs straight over the axis
+  arrays
+ */
+float CompassCalibrator::calc_snapshot_residuals(const fit_snapshot &s, const param_t& params)
+{
+    if(s.count == 0) {
+        return 1.0e30f;
+    }
     const Vector3f &offset = params.offset;
     const Vector3f &diag = params.diag;
     const Vector3f &offdiag = params.offdiag;
-    Matrix3f softiron(
-        diag.x    , offdiag.x , offdiag.y,
-        offdiag.x , diag.y    , offdiag.z,
-        offdiag.y , offdiag.z , diag.z
-    );
-
-    float A =  (diag.x    * (sample.x + offset.x)) + (offdiag.x * (sample.y + offset.y)) + (offdiag.y * (sample.z + offset.z));
-    float B =  (offdiag.x * (sample.x + offset.x)) + (diag.y    * (sample.y + offset.y)) + (offdiag.z * (sample.z + offset.z));
-    float C =  (offdiag.y * (sample.x + offset.x)) + (offdiag.z * (sample.y + offset.y)) + (diag.z    * (sample.z + offset.z));
-    float length = (softiron*(sample+offset)).length();
-
-    // 0: partial derivative (radius wrt fitness fn) fn operated on sample
-    ret[0] = 1.0f;
-    // 1-3: partial derivative (offsets wrt fitness fn) fn operated on sample
-    ret[1] = -1.0f * (((diag.x    * A) + (offdiag.x * B) + (offdiag.y * C))/length);
-    ret[2] = -1.0f * (((offdiag.x * A) + (diag.y    * B) + (offdiag.z * C))/length);
-    ret[3] = -1.0f * (((offdiag.y * A) + (offdiag.z * B) + (diag.z    * C))/length);
+    float sum = 0.0f;
+    for(uint16_t k = 0; k < s.count; k++) {
+        const float dx = s.x[k] + offset.x;
+        const float dy = s.y[k] + offset.y;
+        const float dz = s.z[k] + offset.z;
+        const float A = (diag.x    * dx) + (offdiag.x * dy) + (offdiag.y * dz);
+        const float B = (offdiag.x * dx) + (diag.y    * dy) + (offdiag.z * dz);
+        const float C = (offdiag.y * dx) + (offdiag.z * dy) + (diag.z    * dz);
+        sum += sq(params.radius - norm(A, B, C));
+    }
+    return sum / s.count;
 }
 
-void CompassCalibrator::calc_initial_offset()
+void CompassCalibrator::calc_initial_offset(const fit_snapshot &s, fit_job &job)
 {
     // Set initial offset to the average value of the samples
-    _params.offset.zero();
-    for(uint16_t k = 0; k<_samples_collected; k++) {
-        _params.offset -= _sample_buffer[k].get();
+    Vector3f total;
+    for(uint16_t k = 0; k < s.count; k++) {
+        total.x += s.x[k];
+        total.y += s.y[k];
+        total.z += s.z[k];
     }
-    _params.offset /= _samples_collected;
+    job.params.offset = -total / s.count;
 }
 
-void CompassCalibrator::run_sphere_fit()
+void CompassCalibrator::run_sphere_fit(const fit_snapshot &s, fit_job &job)
 {
-    if(_sample_buffer == nullptr) {
-        return;
-    }
-
     const float lma_damping = 10.0f;
 
-    float fitness = _fitness;
+    float fitness = job.fitness;
     float fit1, fit2;
     param_t fit1_params, fit2_params;
-    fit1_params = fit2_params = _params;
+    fit1_params = fit2_params = job.params;
 
     float JTJ[COMPASS_CAL_NUM_SPHERE_PARAMS*COMPASS_CAL_NUM_SPHERE_PARAMS] = { };
-    float JTJ2[COMPASS_CAL_NUM_SPHERE_PARAMS*COMPASS_CAL_NUM_SPHERE_PARAMS] = { };
+    float JTJ2[COMPASS_CAL_NUM_SPHERE_PARAMS*COMPASS_CAL_NUM_SPHERE_PARAMS];
     float JTFI[COMPASS_CAL_NUM_SPHERE_PARAMS] = { };
 
-    // Gauss Newton Part common for all kind of extensions including LM
-    for(uint16_t k = 0; k<_samples_collected; k++) {
-        Vector3f sample = _sample_buffer[k].get();
-
-        float sphere_jacob[COMPASS_CAL_NUM_SPHERE_PARAMS];
-
-        calc_sphere_jacob(sample, fit1_params, sphere_jacob);
-
-        for(uint8_t i = 0;i < COMPASS_CAL_NUM_SPHERE_PARAMS; i++) {
-            // compute JTJ
-            for(uint8_t j = 0; j < COMPASS_CAL_NUM_SPHERE_PARAMS; j++) {
+    const Vector3f &offset = job.params.offset;
+    const Vector3f &diag = job.params.diag;
+    const Vector3f &offdiag = job.params.offdiag;
+
+    // Gauss Newton Part common for all kind of extensions including LM.
+    // The residual and jacobian share the soft iron product
+    for(uint16_t k = 0; k < s.count; k++) {
+        const float dx = s.x[k] + offset.x;
+        const float dy = s.y[k] + offset.y;
+        const float dz = s.z[k] + offset.z;
+        const float A = (diag.x    * dx) + (offdiag.x * dy) + (offdiag.y * dz);
+        const float B = (offdiag.x * dx) + (diag.y    * dy) + (offdiag.z * dz);
+        const float C = (offdiag.y * dx) + (offdiag.z * dy) + (diag.z    * dz);
+        const float length = norm(A, B, C);
+        const float resid = job.params.radius - length;
+        const float inv_length = 1.0f / length;
+
+        const float sphere_jacob[COMPASS_CAL_NUM_SPHERE_PARAMS] = {
+            // 0: partial derivative (radius wrt fitness fn) fn operated on sample
+            1.0f,
+            // 1-3: partial derivative (offsets wrt fitness fn) fn operated on sample
+            -((diag.x    * A) + (offdiag.x * B) + (offdiag.y * C)) * inv_length,
+            -((offdiag.x * A) + (diag.y    * B) + (offdiag.z * C)) * inv_length,
+            -((offdiag.y * A) + (offdiag.z * B) + (diag.z    * C)) * inv_length,
+        };
+
+        for(uint8_t i = 0; i < COMPASS_CAL_NUM_SPHERE_PARAMS; i++) {
+            // compute JTJ, which is symmetric so only the upper triangle
+            for(uint8_t j = i; j < COMPASS_CAL_NUM_SPHERE_PARAMS; j++) {
                 JTJ[i*COMPASS_CAL_NUM_SPHERE_PARAMS+j] += sphere_jacob[i] * sphere_jacob[j];
-                JTJ2[i*COMPASS_CAL_NUM_SPHERE_PARAMS+j] += sphere_jacob[i] * sphere_jacob[j];   //a backup JTJ for LM
             }
             // compute JTFI
-            JTFI[i] += sphere_jacob[i] * calc_residual(sample, fit1_params);
+            JTFI[i] += sphere_jacob[i] * resid;
         }
     }
-
+    for(uint8_t i = 1; i < COMPASS_CAL_NUM_SPHERE_PARAMS; i++) {
+        for(uint8_t j = 0; j < i; j++) {
+            JTJ[i*COMPASS_CAL_NUM_SPHERE_PARAMS+j] = JTJ[j*COMPASS_CAL_NUM_SPHERE_PARAMS+i];
+        }
+    }
+    // a backup JTJ for LM
+    memcpy(JTJ2, JTJ, sizeof(JTJ2));
 
     //------------------------Levenberg-Marquardt-part-starts-here---------------------------------//
     //refer: http://en.wikipedia.org/wiki/Levenberg%E2%80%93Marquardt_algorithm#Choice_of_damping_parameter
     for(uint8_t i = 0; i < COMPASS_CAL_NUM_SPHERE_PARAMS; i++) {
-        JTJ[i*COMPASS_CAL_NUM_SPHERE_PARAMS+i] += _sphere_lambda;
-        JTJ2[i*COMPASS_CAL_NUM_SPHERE_PARAMS+i] += _sphere_lambda/lma_damping;
+        JTJ[i*COMPASS_CAL_NUM_SPHERE_PARAMS+i] += job.sphere_lambda;
+        JTJ2[i*COMPASS_CAL_NUM_SPHERE_PARAMS+i] += job.sphere_lambda/lma_damping;
     }
 
     if(!inverse(JTJ, JTJ, 4)) {
@@ -555,103 +644,92 @@ void CompassCalibrator::run_sphere_fit()
         }
     }
 
-    fit1 = calc_mean_squared_residuals(fit1_params);
-    fit2 = calc_mean_squared_residuals(fit2_params);
+    fit1 = calc_snapshot_residuals(s, fit1_params);
+    fit2 = calc_snapshot_residuals(s, fit2_params);
 
-    if(fit1 > _fitness && fit2 > _fitness){
-        _sphere_lambda *= lma_damping;
-    } else if(fit2 < _fitness && fit2 < fit1) {
-        _sphere_lambda /= lma_damping;
+    if(fit1 > job.fitness && fit2 > job.fitness){
+        job.sphere_lambda *= lma_damping;
+    } else if(fit2 < job.fitness && fit2 < fit1) {
+        job.sphere_lambda /= lma_damping;
         fit1_params = fit2_params;
         fitness = fit2;
-    } else if(fit1 < _fitness){
+    } else if(fit1 < job.fitness){
         fitness = fit1;
     }
     //--------------------Levenberg-Marquardt-part-ends-here--------------------------------//
 
-    if(!isnan(fitness) && fitness < _fitness) {
-        _fitness = fitness;
-        _params = fit1_params;
-        update_completion_mask();
+    if(!isnan(fitness) && fitness < job.fitness) {
+        job.fitness = fitness;
+        job.params = fit1_params;
     }
 }
 
-
-
-void CompassCalibrator::calc_ellipsoid_jacob(const Vector3f& sample, const param_t& params, float* ret) const{
-    const Vector3f &offset = params.offset;
-    const Vector3f &diag = params.diag;
-    const Vector3f &offdiag = params.offdiag;
-    Matrix3f softiron(
-        diag.x    , offdiag.x , offdiag.y,
-        offdiag.x , diag.y    , offdiag.z,
-        offdiag.y , offdiag.z , diag.z
-    );
-
-    float A =  (diag.x    * (sample.x + offset.x)) + (offdiag.x * (sample.y + offset.y)) + (offdiag.y * (sample.z + offset.z));
-    float B =  (offdiag.x * (sample.x + offset.x)) + (diag.y    * (sample.y + offset.y)) + (offdiag.z * (sample.z + offset.z));
-    float C =  (offdiag.y * (sample.x + offset.x)) + (offdiag.z * (sample.y + offset.y)) + (diag.z    * (sample.z + offset.z));
-    float length = (softiron*(sample+offset)).length();
-
-    // 0-2: partial derivative (offset wrt fitness fn) fn operated on sample
-    ret[0] = -1.0f * (((diag.x    * A) + (offdiag.x * B) + (offdiag.y * C))/length);
-    ret[1] = -1.0f * (((offdiag.x * A) + (diag.y    * B) + (offdiag.z * C))/length);
-    ret[2] = -1.0f * (((offdiag.y * A) + (offdiag.z * B) + (diag.z    * C))/length);
-    // 3-5: partial derivative (diag offset wrt fitness fn) fn operated on sample
-    ret[3] = -1.0f * ((sample.x + offset.x) * A)/length;
-    ret[4] = -1.0f * ((sample.y + offset.y) * B)/length;
-    ret[5] = -1.0f * ((sample.z + offset.z) * C)/length;
-    // 6-8: partial derivative (off-diag offset wrt fitness fn) fn operated on sample
-    ret[6] = -1.0f * (((sample.y + offset.y) * A) + ((sample.x + offset.x) * B))/length;
-    ret[7] = -1.0f * (((sample.z + offset.z) * A) + ((sample.x + offset.x) * C))/length;
-    ret[8] = -1.0f * (((sample.z + offset.z) * B) + ((sample.y + offset.y) * C))/length;
-}
-
-void CompassCalibrator::run_ellipsoid_fit()
+void CompassCalibrator::run_ellipsoid_fit(const fit_snapshot &s, fit_job &job)
 {
-    if(_sample_buffer == nullptr) {
-        return;
-    }
-
     const float lma_damping = 10.0f;
 
-
-    float fitness = _fitness;
+    float fitness = job.fitness;
     float fit1, fit2;
     param_t fit1_params, fit2_params;
-    fit1_params = fit2_params = _params;
-
+    fit1_params = fit2_params = job.params;
 
     float JTJ[COMPASS_CAL_NUM_ELLIPSOID_PARAMS*COMPASS_CAL_NUM_ELLIPSOID_PARAMS] = { };
-    float JTJ2[COMPASS_CAL_NUM_ELLIPSOID_PARAMS*COMPASS_CAL_NUM_ELLIPSOID_PARAMS] = { };
+    float JTJ2[COMPASS_CAL_NUM_ELLIPSOID_PARAMS*COMPASS_CAL_NUM_ELLIPSOID_PARAMS];
     float JTFI[COMPASS_CAL_NUM_ELLIPSOID_PARAMS] = { };
 
-    // Gauss Newton Part common for all kind of extensions including LM
-    for(uint16_t k = 0; k<_samples_collected; k++) {
-        Vector3f sample = _sample_buffer[k].get();
-
-        float ellipsoid_jacob[COMPASS_CAL_NUM_ELLIPSOID_PARAMS];
-
-        calc_ellipsoid_jacob(sample, fit1_params, ellipsoid_jacob);
-
-        for(uint8_t i = 0;i < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; i++) {
-            // compute JTJ
-            for(uint8_t j = 0; j < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; j++) {
-                JTJ [i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+j] += ellipsoid_jacob[i] * ellipsoid_jacob[j];
-                JTJ2[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+j] += ellipsoid_jacob[i] * ellipsoid_jacob[j];
+    const Vector3f &offset = job.params.offset;
+    const Vector3f &diag = job.params.diag;
+    const Vector3f &offdiag = job.params.offdiag;
+
+    // Gauss Newton Part common for all kind of extensions including LM.
+    // The residual and jacobian share the soft iron product
+    for(uint16_t k = 0; k < s.count; k++) {
+        const float dx = s.x[k] + offset.x;
+        const float dy = s.y[k] + offset.y;
+        const float dz = s.z[k] + offset.z;
+        const float A = (diag.x    * dx) + (offdiag.x * dy) + (offdiag.y * dz);
+        const float B = (offdiag.x * dx) + (diag.y    * dy) + (offdiag.z * dz);
+        const float C = (offdiag.y * dx) + (offdiag.z * dy) + (diag.z    * dz);
+        const float length = norm(A, B, C);
+        const float resid = job.params.radius - length;
+        const float inv_length = 1.0f / length;
+
+        const float ellipsoid_jacob[COMPASS_CAL_NUM_ELLIPSOID_PARAMS] = {
+            // 0-2: partial derivative (offset wrt fitness fn) fn operated on sample
+            -((diag.x    * A) + (offdiag.x * B) + (offdiag.y * C)) * inv_length,
+            -((offdiag.x * A) + (diag.y    * B) + (offdiag.z * C)) * inv_length,
+            -((offdiag.y * A) + (offdiag.z * B) + (diag.z    * C)) * inv_length,
+            // 3-5: partial derivative (diag offset wrt fitness fn) fn operated on sample
+            -(dx * A) * inv_length,
+            -(dy * B) * inv_length,
+            -(dz * C) * inv_length,
+            // 6-8: partial derivative (off-diag offset wrt fitness fn) fn operated on sample
+            -((dy * A) + (dx * B)) * inv_length,
+            -((dz * A) + (dx * C)) * inv_length,
+            -((dz * B) + (dy * C)) * inv_length,
+        };
+
+        for(uint8_t i = 0; i < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; i++) {
+            // compute JTJ, which is symmetric so only the upper triangle
+            for(uint8_t j = i; j < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; j++) {
+                JTJ[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+j] += ellipsoid_jacob[i] * ellipsoid_jacob[j];
             }
             // compute JTFI
-            JTFI[i] += ellipsoid_jacob[i] * calc_residual(sample, fit1_params);
+            JTFI[i] += ellipsoid_jacob[i] * resid;
         }
     }
-
-
+    for(uint8_t i = 1; i < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; i++) {
+        for(uint8_t j = 0; j < i; j++) {
+            JTJ[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+j] = JTJ[j*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+i];
+        }
+    }
+    memcpy(JTJ2, JTJ, sizeof(JTJ2));
 
     //------------------------Levenberg-Marquardt-part-starts-here---------------------------------//
     //refer: http://en.wikipedia.org/wiki/Levenberg%E2%80%93Marquardt_algorithm#Choice_of_damping_parameter
     for(uint8_t i = 0; i < COMPASS_CAL_NUM_ELLIPSOID_PARAMS; i++) {
-        JTJ[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+i] += _ellipsoid_lambda;
-        JTJ2[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+i] += _ellipsoid_lambda/lma_damping;
+        JTJ[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+i] += job.ellipsoid_lambda;
+        JTJ2[i*COMPASS_CAL_NUM_ELLIPSOID_PARAMS+i] += job.ellipsoid_lambda/lma_damping;
     }
 
     if(!inverse(JTJ, JTJ, 9)) {
@@ -669,27 +747,49 @@ void CompassCalibrator::run_ellipsoid_fit()
         }
     }
 
-    fit1 = calc_mean_squared_residuals(fit1_params);
-    fit2 = calc_mean_squared_residuals(fit2_params);
+    fit1 = calc_snapshot_residuals(s, fit1_params);
+    fit2 = calc_snapshot_residuals(s, fit2_params);
 
-    if(fit1 > _fitness && fit2 > _fitness){
-        _ellipsoid_lambda *= lma_damping;
-    } else if(fit2 < _fitness && fit2 < fit1) {
-        _ellipsoid_lambda /= lma_damping;
+    if(fit1 > job.fitness && fit2 > job.fitness){
+        job.ellipsoid_lambda *= lma_damping;
+    } else if(fit2 < job.fitness && fit2 < fit1) {
+        job.ellipsoid_lambda /= lma_damping;
         fit1_params = fit2_params;
         fitness = fit2;
-    } else if(fit1 < _fitness){
+    } else if(fit1 < job.fitness){
         fitness = fit1;
     }
     //--------------------Levenberg-part-ends-here--------------------------------//
 
-    if(fitness < _fitness) {
-        _fitness = fitness;
-        _params = fit1_params;
-        update_completion_mask();
+    if(fitness < job.fitness) {
+        job.fitness = fitness;
+        job.params = fit1_params;
     }
 }
 
+/*
+  run all the iterations for the current step. Step one is a sphere
+  fit from the mean offset, step two refines the sphere then fits the
+  full ellipsoid and checks the orientation
+ */
+void CompassCalibrator::run_fit_step(fit_snapshot &s, fit_job &job) const
+{
+    if (job.status == COMPASS_CAL_RUNNING_STEP_ONE) {
+        calc_initial_offset(s, job);
+        for (uint8_t i = 0; i < 10; i++) {
+            run_sphere_fit(s, job);
+        }
+        return;
+    }
+    for (uint8_t i = 0; i < 15; i++) {
+        run_sphere_fit(s, job);
+    }
+    for (uint8_t i = 0; i < 20; i++) {
+        run_ellipsoid_fit(s, job);
+    }
+    job.acceptable = fit_acceptable(job) && calculate_orientation(s, job);
+}
+
 
 //////////////////////////////////////////////////////////
 //////////// CompassSample public interface //////////////
@@ -720,7 +820,7 @@ void CompassCalibrator::AttitudeSample::set_from_ahrs(void) {
     yaw = constrain_int16(127 * (yaw_rad / M_PI), -127, 127);
 }
 
-Matrix3f CompassCalibrator::AttitudeSample::get_rotmat(void) {
+Matrix3f CompassCalibrator::AttitudeSample::get_rotmat(void) const {
     float roll_rad, pitch_rad, yaw_rad;
     roll_rad = roll * (M_PI / 127);
     pitch_rad = pitch * (M_PI_2 / 127);
@@ -741,26 +841,26 @@ Matrix3f CompassCalibrator::AttitudeSample::get_rotmat(void) {
   Note that this earth field uses an arbitrary north reference, so it
   may not match the true earth field.
  */
-Vector3f CompassCalibrator::calculate_earth_field(CompassSample &sample, enum Rotation r)
+Vector3f CompassCalibrator::calculate_earth_field(const fit_snapshot &s, uint16_t i, const fit_job &job, enum Rotation r) const
 {
-    Vector3f v = sample.get();
+    Vector3f v(s.x[i], s.y[i], s.z[i]);
 
     // convert the sample back to sensor frame
-    v.rotate_inverse(_orientation);
+    v.rotate_inverse(job.orientation);
 
     // rotate to body frame for this rotation
     v.rotate(r);
 
     // apply offsets, rotating them for the orientation we are testing
-    Vector3f rot_offsets = _params.offset;
-    rot_offsets.rotate_inverse(_orientation);
+    Vector3f rot_offsets = job.params.offset;
+    rot_offsets.rotate_inverse(job.orientation);
 
     rot_offsets.rotate(r);
     
     v += rot_offsets;
 
     // rotate the sample from body frame back to earth frame
-    Matrix3f rot = sample.att.get_rotmat();
+    Matrix3f rot = s.att[i].get_rotmat();
 
     Vector3f efield = rot * v;
 
@@ -773,7 +873,7 @@ Vector3f CompassCalibrator::calculate_earth_field(CompassSample &sample, enum Ro
   with each sample, and fix orientation on external compasses if
   the feature is enabled
  */
-bool CompassCalibrator::calculate_orientation(void)
+bool CompassCalibrator::calculate_orientation(fit_snapshot &s, fit_job &job) const
 {
     if (!_check_orientation) {
         // we are not checking orientation
@@ -788,18 +888,18 @@ bool CompassCalibrator::calculate_orientation(void)
     for (enum Rotation r = ROTATION_NONE; r<ROTATION_MAX; r = (enum Rotation)(r+1)) {
         // calculate the average implied earth field across all samples
         Vector3f total_ef {};
-        for (uint32_t i=0; i<_samples_collected; i++) {
-            Vector3f efield = calculate_earth_field(_sample_buffer[i], r);
+        for (uint16_t i=0; i<s.count; i++) {
+            Vector3f efield = calculate_earth_field(s, i, job, r);
             total_ef += efield;
         }
-        Vector3f avg_efield = total_ef / _samples_collected;
+        Vector3f avg_efield = total_ef / s.count;
 
         // now calculate the square error for this rotation against the average earth field
-        for (uint32_t i=0; i<_samples_collected; i++) {
-            Vector3f efield = calculate_earth_field(_sample_buffer[i], r);
+        for (uint16_t i=0; i<s.count; i++) {
+            Vector3f efield = calculate_earth_field(s, i, job, r);
             float err = (efield - avg_efield).length_squared();
             // divide by number of samples collected to get the variance
-            variance[r] += err / _samples_collected;
+            variance[r] += err / s.count;
         }
     }
 
@@ -828,66 +928,70 @@ bool CompassCalibrator::calculate_orientation(void)
         }
     }
 
-    _orientation_confidence = second_best/bestv;
+    job.orientation_confidence = second_best/bestv;
     
     bool pass;
-    if (besti == _orientation) {
+    if (besti == job.orientation) {
         // if the orientation matched then allow for a low threshold
         pass = true;
     } else {
-        pass = _orientation_confidence > variance_threshold;
+        pass = job.orientation_confidence > variance_threshold;
     }
     if (!pass) {
         gcs().send_text(MAV_SEVERITY_CRITICAL, "Mag(%u) bad orientation: %u/%u %.1f", _compass_idx,
-                        besti, besti2, (double)_orientation_confidence);
-    } else if (besti == _orientation) {
+                        besti, besti2, (double)job.orientation_confidence);
+    } else if (besti == job.orientation) {
         // no orientation change
-        gcs().send_text(MAV_SEVERITY_INFO, "Mag(%u) good orientation: %u %.1f", _compass_idx, besti, (double)_orientation_confidence);
+        gcs().send_text(MAV_SEVERITY_INFO, "Mag(%u) good orientation: %u %.1f", _compass_idx, besti, (double)job.orientation_confidence);
     } else if (!_is_external || !_fix_orientation) {
-        gcs().send_text(MAV_SEVERITY_CRITICAL, "Mag(%u) internal bad orientation: %u %.1f", _compass_idx, besti, (double)_orientation_confidence);
+        gcs().send_text(MAV_SEVERITY_CRITICAL, "Mag(%u) internal bad orientation: %u %.1f", _compass_idx, besti, (double)job.orientation_confidence);
     } else {
-        gcs().send_text(MAV_SEVERITY_INFO, "Mag(%u) new orientation: %u was %u %.1f", _compass_idx, besti, _orientation, (double)_orientation_confidence);
+        gcs().send_text(MAV_SEVERITY_INFO, "Mag(%u) new orientation: %u was %u %.1f", _compass_idx, besti, job.orientation, (double)job.orientation_confidence);
     }
 
     if (!pass) {
-        set_status(COMPASS_CAL_BAD_ORIENTATION);
+        job.bad_orientation = true;
         return false;
     }
 
-    if (_orientation == besti) {
+    if (job.orientation == besti) {
         // no orientation change
         return true;
     }
 
     if (!_is_external || !_fix_orientation) {
-        // we won't change the orientation, but we set _orientation
+        // we won't change the orientation, but we set the orientation
         // for reporting purposes
-        _orientation = besti;
-        set_status(COMPASS_CAL_BAD_ORIENTATION);
+        job.orientation = besti;
+        job.bad_orientation = true;
         return false;
     }
     
     // correct the offsets for the new orientation
-    Vector3f rot_offsets = _params.offset;
-    rot_offsets.rotate_inverse(_orientation);
+    Vector3f rot_offsets = job.params.offset;
+    rot_offsets.rotate_inverse(job.orientation);
     rot_offsets.rotate(besti);
-    _params.offset = rot_offsets;
+    job.params.offset = rot_offsets;
 
     // rotate the samples for the new orientation
-    for (uint32_t i=0; i<_samples_collected; i++) {
-        Vector3f s = _sample_buffer[i].get();
-        s.rotate_inverse(_orientation);
-        s.rotate(besti);
-        _sample_buffer[i].set(s);
+    for (uint16_t i=0; i<s.count; i++) {
+        Vector3f v(s.x[i], s.y[i], s.z[i]);
+        v.rotate_inverse(job.orientation);
+        v.rotate(besti);
+        s.x[i] = v.x;
+        s.y[i] = v.y;
+        s.z[i] = v.z;
     }
 
-    _orientation = besti;
+    job.orientation = besti;
 
     // re-run the fit to get the diagonals and off-diagonals for the
     // new orientation
-    initialize_fit();
-    run_sphere_fit();
-    run_ellipsoid_fit();
+    job.fitness = calc_snapshot_residuals(s, job.params);
+    job.sphere_lambda = 1.0f;
+    job.ellipsoid_lambda = 1.0f;
+    run_sphere_fit(s, job);
+    run_ellipsoid_fit(s, job);
     
-    return fit_acceptable();
+    return fit_acceptable(job);
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <AP_HAL/AP_HAL.h>
 #include <AP_Math/AP_Math.h>
 
 #define COMPASS_CAL_NUM_SPHERE_PARAMS 4
@@ -20,6 +21,7 @@ enum compass_cal_status_t {
 };
 
 class CompassCalibrator {
+    friend class CompassCalibratorTest;
 public:
     typedef uint8_t completion_mask_t[10];
 
@@ -31,6 +33,10 @@ public:
     void update(bool &failure);
     void new_sample(const Vector3f &sample);
 
+    // run the pending fit step if there is one, returning true if a
+    // fit was run. Called from the compass calibration thread
+    bool run_fit();
+
     bool check_for_timeout();
 
     bool running() const;
@@ -75,8 +81,9 @@ private:
 
     // compact class for approximate attitude, to save memory
     class AttitudeSample {
+        friend class CompassCalibratorTest;
     public:
-        Matrix3f get_rotmat();
+        Matrix3f get_rotmat() const;
         void set_from_ahrs();
     private:
         int8_t roll;
@@ -95,6 +102,37 @@ private:
         int16_t z;
     };
 
+    // state for one fit step. The fit thread copies it from the
+    // calibrator, runs the step against a snapshot of the samples and
+    // hands the result back to update() on the main thread
+    struct fit_job {
+        compass_cal_status_t status;
+        uint16_t generation;
+        param_t params;
+        float fitness;
+        float initial_fitness;
+        float sphere_lambda;
+        float ellipsoid_lambda;
+        enum Rotation orientation;
+        float orientation_confidence;
+        bool acceptable;
+        bool bad_orientation;
+    };
+
+    // samples as seen by the fit thread, one array per axis so the
+    // residual and jacobian loops run over contiguous floats. Only
+    // one fit runs at a time so this is shared by all calibrators
+    struct fit_snapshot {
+        float x[COMPASS_CAL_NUM_SAMPLES];
+        float y[COMPASS_CAL_NUM_SAMPLES];
+        float z[COMPASS_CAL_NUM_SAMPLES];
+        AttitudeSample att[COMPASS_CAL_NUM_SAMPLES];
+        uint16_t count;
+    };
+    static fit_snapshot *_snapshot;
+
+    HAL_Semaphore _sem;
+
     enum Rotation _orientation;
     enum Rotation _orig_orientation;
     bool _is_external;
@@ -119,7 +157,6 @@ private:
 
     //fit state
     class param_t _params;
-    uint16_t _fit_step;
     CompassSample *_sample_buffer;
     float _fitness; // mean squared residuals
     float _initial_fitness;
@@ -129,6 +166,13 @@ private:
     uint16_t _samples_thinned;
     float _orientation_confidence;
 
+    // result of the last fit step, valid when _fit_done is set.
+    // _fit_generation changes whenever the samples are replaced so a
+    // stale result is discarded
+    fit_job _fit_result;
+    bool _fit_done;
+    uint16_t _fit_generation;
+
     bool set_status(compass_cal_status_t status);
 
     // returns true if sample should be added to buffer
@@ -136,7 +180,7 @@ private:
     bool accept_sample(const CompassSample &sample);
 
     // returns true if fit is acceptable
-    bool fit_acceptable();
+    bool fit_acceptable(const fit_job &job) const;
 
     void reset_state();
     void initialize_fit();
@@ -150,12 +194,12 @@ private:
     float calc_mean_squared_residuals(const param_t& params) const;
     float calc_mean_squared_residuals() const;
 
-    void calc_initial_offset();
-    void calc_sphere_jacob(const Vector3f& sample, const param_t& params, float* ret) const;
-    void run_sphere_fit();
-
-    void calc_ellipsoid_jacob(const Vector3f& sample, const param_t& params, float* ret) const;
-    void run_ellipsoid_fit();
+    // fit steps, run by the fit thread against _snapshot
+    static float calc_snapshot_residuals(const fit_snapshot &s, const param_t& params);
+    static void calc_initial_offset(const fit_snapshot &s, fit_job &job);
+    static void run_sphere_fit(const fit_snapshot &s, fit_job &job);
+    static void run_ellipsoid_fit(const fit_snapshot &s, fit_job &job);
+    void run_fit_step(fit_snapshot &s, fit_job &job) const;
 
     /**
      * Update #_completion_mask for the geodesic section of \p v. Corrections
@@ -169,6 +213,6 @@ private:
      */
     void update_completion_mask();
 
-    Vector3f calculate_earth_field(CompassSample &sample, enum Rotation r);
-    bool calculate_orientation();
+    Vector3f calculate_earth_field(const fit_snapshot &s, uint16_t i, const fit_job &job, enum Rotation r) const;
+    bool calculate_orientation(fit_snapshot &s, fit_job &job) const;
 };
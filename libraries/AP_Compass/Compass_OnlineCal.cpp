@@ -0,0 +1,363 @@
+#include <AP_Math/AP_Math.h>
+#include <AP_Math/AP_GeodesicGrid.h>
+#include <AP_Logger/AP_Logger.h>
+#include <GCS_MAVLink/GCS.h>
+
+#include "AP_Compass.h"
+#include "Compass_OnlineCal.h"
+
+#if COMPASS_ONLINE_CAL_ENABLED
+
+extern const AP_HAL::HAL &hal;
+
+// forgetting factor, giving a memory of roughly 500 accepted samples
+#define OCAL_FORGET 0.998f
+// initial parameter covariance, a prior worth roughly 100 samples
+// that holds unexcited parameters at the current calibration
+#define OCAL_P_INIT 0.01f
+// stop forgetting once the covariance grows past this, so directions
+// the vehicle doesn't rotate through can't wind up
+#define OCAL_P_TRACE_MAX (2 * num_params * OCAL_P_INIT)
+// minimum angle between accepted samples
+#define OCAL_MIN_ANGLE_COS 0.985f
+// requirements before an estimate may be saved
+#define OCAL_MIN_SAMPLES 150
+#define OCAL_MIN_COVERAGE 20
+#define OCAL_MAX_RESIDUAL 0.04f
+
+// constructor
+CompassOnlineCal::CompassOnlineCal(Compass &_compass) :
+    compass(_compass)
+{
+    for (uint8_t i=0; i<COMPASS_MAX_INSTANCES; i++) {
+        reset(i);
+    }
+}
+
+/*
+  start a new fit for an instance, relative to its current calibration
+ */
+void CompassOnlineCal::reset(uint8_t i)
+{
+    estimator &e = est[i];
+    const uint32_t last_update_usec = e.last_update_usec;
+    e = estimator {};
+    e.last_update_usec = last_update_usec;
+
+    // unit sphere
+    e.theta[0] = e.theta[1] = e.theta[2] = 1;
+    for (uint8_t j=0; j<num_params; j++) {
+        e.P[j*num_params+j] = OCAL_P_INIT;
+    }
+    e.ref_offsets = compass.get_offsets(i);
+    e.ref_diagonals = compass.get_diagonals(i);
+    e.ref_offdiagonals = compass.get_offdiagonals(i);
+    if (e.ref_diagonals.is_zero()) {
+        e.ref_diagonals = Vector3f(1, 1, 1);
+    }
+}
+
+/*
+  called on each compass read
+ */
+void CompassOnlineCal::update(void)
+{
+    const bool armed = hal.util->get_soft_armed();
+    if (compass.is_calibrating() || compass.get_learn_type() == Compass::LEARN_INFLIGHT) {
+        // another calibration owns the parameters
+        was_armed = armed;
+        return;
+    }
+
+    const uint32_t now_ms = AP_HAL::millis();
+    for (uint8_t i=0; i<compass.get_count(); i++) {
+        estimator &e = est[i];
+        const uint32_t last_update_usec = compass.last_update_usec(i);
+        if (!compass.healthy(i) || last_update_usec == e.last_update_usec) {
+            continue;
+        }
+        e.last_update_usec = last_update_usec;
+
+        if (compass.get_offsets(i) != e.ref_offsets ||
+            compass.get_offdiagonals(i) != e.ref_offdiagonals ||
+            (compass.get_diagonals(i) != e.ref_diagonals && !compass.get_diagonals(i).is_zero())) {
+            // calibration changed underneath us, the samples so far
+            // are in the wrong frame
+            reset(i);
+        }
+
+        Vector3f field = compass.get_field(i);
+#if COMPASS_MOT_ENABLED
+        field -= compass._state[i].motor_offset;
+#endif
+        add_sample(i, field);
+
+        if (now_ms - e.last_log_ms >= 1000) {
+            e.last_log_ms = now_ms;
+            Log_Write(i, false);
+        }
+    }
+
+    // offer the estimate for saving once on each disarm
+    if (was_armed && !armed && compass._online_cal == 2) {
+        for (uint8_t i=0; i<compass.get_count(); i++) {
+            commit(i);
+        }
+    }
+    was_armed = armed;
+}
+
+/*
+  add a corrected field sample, gating on attitude diversity so a
+  vehicle holding one attitude doesn't swamp the fit
+ */
+void CompassOnlineCal::add_sample(uint8_t i, const Vector3f &field)
+{
+    estimator &e = est[i];
+    const float length = field.length();
+    if (e.scale <= 0) {
+        if (length < 100) {
+            // implausibly weak field
+            return;
+        }
+        e.scale = length;
+    }
+    const Vector3f u = field / e.scale;
+    const float ulength = length / e.scale;
+    if (ulength < 0.5f || ulength > 2.0f) {
+        // interference, not a useful sample
+        return;
+    }
+    if (e.num_samples > 0 && (u * e.last_u) > OCAL_MIN_ANGLE_COS * ulength * e.last_u.length()) {
+        // too close to the last accepted sample
+        return;
+    }
+    const int section = AP_GeodesicGrid::section(u, true);
+    if (section < 0) {
+        return;
+    }
+    uint8_t &count = e.section_count[section];
+    if (count != 0 && count > 2 * (e.num_samples / e.coverage) + 2) {
+        // this part of the sphere is already well represented
+        return;
+    }
+    if (count == 0) {
+        e.coverage++;
+    }
+    if (count == UINT8_MAX) {
+        // keep the counts bounded, preserving their ratios
+        for (uint8_t s=0; s<num_sections; s++) {
+            e.section_count[s] = (e.section_count[s] + 1) / 2;
+        }
+    }
+    count++;
+
+    e.last_u = u;
+    e.num_samples++;
+    rls_update(e, u);
+}
+
+/*
+  recursive least squares update with forgetting. The cost is fixed
+  at a few hundred multiplies per sample
+ */
+void CompassOnlineCal::rls_update(estimator &e, const Vector3f &u)
+{
+    const float phi[num_params] = { u.x*u.x, u.y*u.y, u.z*u.z,
+                                    u.x*u.y, u.x*u.z, u.y*u.z,
+                                    u.x, u.y, u.z };
+    float Pphi[num_params];
+    float err = 1.0f;
+    float phiPphi = 0;
+    float trace = 0;
+    for (uint8_t r=0; r<num_params; r++) {
+        float sum = 0;
+        for (uint8_t c=0; c<num_params; c++) {
+            sum += e.P[r*num_params+c] * phi[c];
+        }
+        Pphi[r] = sum;
+        phiPphi += phi[r] * sum;
+        err -= phi[r] * e.theta[r];
+        trace += e.P[r*num_params+r];
+    }
+
+    const float lambda = trace < OCAL_P_TRACE_MAX ? OCAL_FORGET : 1.0f;
+    const float inv_denom = 1.0f / (lambda + phiPphi);
+
+    for (uint8_t r=0; r<num_params; r++) {
+        e.theta[r] += Pphi[r] * inv_denom * err;
+        for (uint8_t c=r; c<num_params; c++) {
+            const float v = (e.P[r*num_params+c] - Pphi[r] * Pphi[c] * inv_denom) / lambda;
+            e.P[r*num_params+c] = v;
+            e.P[c*num_params+r] = v;
+        }
+    }
+
+    e.resid_sq = 0.99f * e.resid_sq + 0.01f * sq(err);
+}
+
+/*
+  square root of a symmetric positive definite matrix, using the
+  Denman-Beavers iteration
+ */
+static bool sqrt_spd(const Matrix3f &A, Matrix3f &ret)
+{
+    if (A.a.x <= 0 || A.a.x * A.b.y - A.a.y * A.b.x <= 0 || A.det() <= 0) {
+        // not positive definite
+        return false;
+    }
+    Matrix3f Y = A;
+    Matrix3f Z;
+    Z.identity();
+    for (uint8_t n=0; n<12; n++) {
+        Matrix3f Yinv, Zinv;
+        if (!Y.inverse(Yinv) || !Z.inverse(Zinv)) {
+            return false;
+        }
+        Y = (Y + Zinv) * 0.5f;
+        Z = (Z + Yinv) * 0.5f;
+    }
+    if (Y.is_nan()) {
+        return false;
+    }
+    ret = Y;
+    return true;
+}
+
+/*
+  turn the current estimate into compass parameters
+ */
+bool CompassOnlineCal::get_proposal(uint8_t i, proposal &p) const
+{
+    const estimator &e = est[i];
+    const float *t = e.theta;
+    const Matrix3f Q(t[0],      0.5f*t[3], 0.5f*t[4],
+                     0.5f*t[3], t[1],      0.5f*t[5],
+                     0.5f*t[4], 0.5f*t[5], t[2]);
+    Matrix3f Qinv;
+    if (e.scale <= 0 || !Q.inverse(Qinv)) {
+        return false;
+    }
+
+    // centre and shape of the ellipsoid in scaled corrected units
+    const Vector3f centre = Qinv * Vector3f(t[6], t[7], t[8]) * -0.5f;
+    const float k = 1.0f + centre * (Q * centre);
+    if (k <= 0) {
+        return false;
+    }
+    Matrix3f Md;
+    if (!sqrt_spd(Q / k, Md)) {
+        return false;
+    }
+    // keep the overall field strength
+    Md /= cbrtf(Md.det());
+
+    // compose with the calibration the samples were taken with. The
+    // corrected field becomes Md * M * (raw + offsets - M^-1 * centre)
+    // and the symmetric equivalent of Md * M is sqrt(M * Md^2 * M)
+    const Vector3f &d = e.ref_diagonals;
+    const Vector3f &od = e.ref_offdiagonals;
+    const Matrix3f M(d.x,  od.x, od.y,
+                     od.x, d.y,  od.z,
+                     od.y, od.z, d.z);
+    Matrix3f Minv;
+    if (!M.inverse(Minv)) {
+        return false;
+    }
+    Matrix3f Mnew;
+    if (!sqrt_spd(M * Md * Md * M, Mnew)) {
+        return false;
+    }
+    p.offsets = e.ref_offsets - Minv * (centre * e.scale);
+    p.diagonals = Vector3f(Mnew.a.x, Mnew.b.y, Mnew.c.z);
+    p.offdiagonals = Vector3f(Mnew.a.y, Mnew.a.z, Mnew.b.z);
+    return true;
+}
+
+/*
+  check an estimate is good enough to save, using the same limits as
+  a full calibration
+ */
+bool CompassOnlineCal::proposal_ok(uint8_t i, const proposal &p) const
+{
+    const estimator &e = est[i];
+    if (e.num_samples < OCAL_MIN_SAMPLES ||
+        e.coverage < OCAL_MIN_COVERAGE ||
+        sqrtf(e.resid_sq) > OCAL_MAX_RESIDUAL) {
+        return false;
+    }
+    const float offset_max = compass.get_offsets_max();
+    if (p.offsets.is_nan() ||
+        fabsf(p.offsets.x) >= offset_max ||
+        fabsf(p.offsets.y) >= offset_max ||
+        fabsf(p.offsets.z) >= offset_max ||
+        p.diagonals.x <= 0.2f || p.diagonals.x >= 5.0f ||
+        p.diagonals.y <= 0.2f || p.diagonals.y >= 5.0f ||
+        p.diagonals.z <= 0.2f || p.diagonals.z >= 5.0f ||
+        fabsf(p.offdiagonals.x) >= 1.0f ||
+        fabsf(p.offdiagonals.y) >= 1.0f ||
+        fabsf(p.offdiagonals.z) >= 1.0f) {
+        return false;
+    }
+    return true;
+}
+
+/*
+  save the estimate if it passes the checks and differs from the
+  current calibration, then start a new fit in the new frame
+ */
+void CompassOnlineCal::commit(uint8_t i)
+{
+    proposal p;
+    if (!get_proposal(i, p) || !proposal_ok(i, p)) {
+        return;
+    }
+    const estimator &e = est[i];
+    if ((p.offsets - e.ref_offsets).length() < 2.0f &&
+        (p.diagonals - e.ref_diagonals).length() < 0.005f &&
+        (p.offdiagonals - e.ref_offdiagonals).length() < 0.005f) {
+        // no meaningful change
+        return;
+    }
+
+    compass.set_and_save_offsets(i, p.offsets);
+    compass.set_and_save_diagonals(i, p.diagonals);
+    compass.set_and_save_offdiagonals(i, p.offdiagonals);
+    gcs().send_text(MAV_SEVERITY_INFO, "Mag(%u) online cal saved ofs %.0f %.0f %.0f", i,
+                    (double)p.offsets.x, (double)p.offsets.y, (double)p.offsets.z);
+    Log_Write(i, true);
+
+    reset(i);
+}
+
+/*
+  log the current estimate, with C set when it was saved
+ */
+void CompassOnlineCal::Log_Write(uint8_t i, bool committed)
+{
+    const estimator &e = est[i];
+    proposal p;
+    if (!get_proposal(i, p)) {
+        p.offsets = e.ref_offsets;
+        p.diagonals = e.ref_diagonals;
+        p.offdiagonals = e.ref_offdiagonals;
+    }
+    AP::logger().Write("OCAL", "TimeUS,I,OX,OY,OZ,DX,DY,DZ,ODX,ODY,ODZ,Res,Cov,N,C", "QBffffffffffBIB",
+                       AP_HAL::micros64(),
+                       i,
+                       (double)p.offsets.x,
+                       (double)p.offsets.y,
+                       (double)p.offsets.z,
+                       (double)p.diagonals.x,
+                       (double)p.diagonals.y,
+                       (double)p.diagonals.z,
+                       (double)p.offdiagonals.x,
+                       (double)p.offdiagonals.y,
+                       (double)p.offdiagonals.z,
+                       (double)sqrtf(e.resid_sq),
+                       e.coverage,
+                       e.num_samples,
+                       committed);
+}
+
+#endif // COMPASS_ONLINE_CAL_ENABLED
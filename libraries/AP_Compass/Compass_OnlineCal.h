@@ -0,0 +1,65 @@
+#pragma once
+
+#include "AP_Compass.h"
+
+/*
+  continuous online compass calibration. A recursive least squares
+  fit of an ellipsoid to the corrected field refines the offsets,
+  diagonals and off-diagonals from live samples, with fixed memory
+  and a fixed cost per sample
+ */
+
+class CompassOnlineCal {
+public:
+    CompassOnlineCal(Compass &compass);
+
+    // called on each compass read
+    void update(void);
+
+private:
+    Compass &compass;
+
+    /*
+      the fit is of the corrected field u scaled by the field strength
+      seen at the start, so a good calibration is close to the unit
+      sphere u^T Q u + p^T u = 1 with
+      theta = [Qxx Qyy Qzz 2Qxy 2Qxz 2Qyz px py pz]
+     */
+    static const uint8_t num_params = 9;
+    static const uint8_t num_sections = 80;
+
+    struct estimator {
+        // calibration in use when the samples were taken
+        Vector3f ref_offsets;
+        Vector3f ref_diagonals;
+        Vector3f ref_offdiagonals;
+        float theta[num_params];
+        float P[num_params*num_params];
+        float scale;
+        float resid_sq;
+        Vector3f last_u;
+        uint32_t last_update_usec;
+        uint32_t num_samples;
+        uint8_t section_count[num_sections];
+        uint8_t coverage;
+        uint32_t last_log_ms;
+        bool started;
+    } est[COMPASS_MAX_INSTANCES];
+
+    // proposed calibration from the current estimate
+    struct proposal {
+        Vector3f offsets;
+        Vector3f diagonals;
+        Vector3f offdiagonals;
+    };
+
+    bool was_armed;
+
+    void reset(uint8_t i);
+    void add_sample(uint8_t i, const Vector3f &field);
+    void rls_update(estimator &e, const Vector3f &u);
+    bool get_proposal(uint8_t i, proposal &p) const;
+    bool proposal_ok(uint8_t i, const proposal &p) const;
+    void commit(uint8_t i);
+    void Log_Write(uint8_t i, bool committed);
+};
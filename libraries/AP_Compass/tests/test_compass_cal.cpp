@@ -0,0 +1,135 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <AP_gtest.h>
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_Compass/CompassCalibrator.h>
+#include <GCS_MAVLink/GCS_Dummy.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+// the calibrator reports orientation results as text
+GCS_Dummy _gcs;
+
+class CompassCalibratorTest : public ::testing::Test {
+protected:
+    CompassCalibrator cal;
+
+    // earth field and hard iron offset of the simulated compass, mGauss
+    const Vector3f earth_field{220, 40, 430};
+    const Vector3f sensor_bias{60, -35, 25};
+
+    // start a calibration for a compass configured with orientation
+    void start(enum Rotation orientation, bool is_external, bool fix_orientation) {
+        cal.set_orientation(orientation, is_external, fix_orientation);
+        cal.start(false, 0, 1000, 0);
+        ASSERT_EQ(COMPASS_CAL_RUNNING_STEP_ONE, cal.get_status());
+    }
+
+    /*
+      fill the sample buffer with what a compass mounted with rotation
+      actual reports over a spread of vehicle attitudes, once the
+      driver has applied the configured orientation
+     */
+    void fill_samples(enum Rotation actual) {
+        const enum Rotation configured = cal._orientation;
+        for (uint16_t i=0; i<COMPASS_CAL_NUM_SAMPLES; i++) {
+            CompassCalibrator::AttitudeSample att;
+            att.roll = int8_t((i * 97) % 255 - 127);
+            att.pitch = int8_t((i * 61) % 255 - 127);
+            att.yaw = int8_t((i * 31) % 255 - 127);
+
+            // earth field in body frame, then sensor frame
+            Vector3f field = att.get_rotmat().transposed() * earth_field;
+            field.rotate_inverse(actual);
+            field += sensor_bias;
+
+            // the driver rotates by the configured orientation
+            field.rotate(configured);
+
+            cal._sample_buffer[i].set(field);
+            cal._sample_buffer[i].att = att;
+        }
+        cal._samples_collected = COMPASS_CAL_NUM_SAMPLES;
+    }
+
+    // run both fit steps, as the compass calibration thread would
+    void run_fit(enum Rotation actual) {
+        bool failure;
+        fill_samples(actual);
+        ASSERT_TRUE(cal.run_fit());
+        cal.update(failure);
+        ASSERT_FALSE(failure);
+        ASSERT_EQ(COMPASS_CAL_RUNNING_STEP_TWO, cal.get_status());
+
+        fill_samples(actual);
+        ASSERT_TRUE(cal.run_fit());
+        cal.update(failure);
+    }
+};
+
+/*
+  a correctly configured compass passes
+ */
+TEST_F(CompassCalibratorTest, GoodOrientation)
+{
+    start(ROTATION_YAW_90, true, true);
+    run_fit(ROTATION_YAW_90);
+
+    EXPECT_EQ(COMPASS_CAL_SUCCESS, cal.get_status());
+    EXPECT_EQ(ROTATION_YAW_90, cal.get_orientation());
+}
+
+/*
+  an external compass with the wrong orientation is rotated to the
+  right one, and the fit passes on the first calibration
+ */
+TEST_F(CompassCalibratorTest, FixExternalOrientation)
+{
+    start(ROTATION_NONE, true, true);
+    run_fit(ROTATION_ROLL_180_YAW_90);
+
+    EXPECT_EQ(COMPASS_CAL_SUCCESS, cal.get_status());
+    EXPECT_EQ(ROTATION_ROLL_180_YAW_90, cal.get_orientation());
+    EXPECT_EQ(ROTATION_NONE, cal.get_original_orientation());
+    EXPECT_GT(cal.get_orientation_confidence(), 2.0f);
+
+    // offsets are for the corrected orientation
+    Vector3f offsets, diag, offdiag;
+    cal.get_calibration(offsets, diag, offdiag);
+    Vector3f expected = -sensor_bias;
+    expected.rotate(ROTATION_ROLL_180_YAW_90);
+    EXPECT_NEAR(expected.x, offsets.x, 5);
+    EXPECT_NEAR(expected.y, offsets.y, 5);
+    EXPECT_NEAR(expected.z, offsets.z, 5);
+    EXPECT_NEAR(1, diag.x, 0.05);
+    EXPECT_NEAR(1, diag.y, 0.05);
+    EXPECT_NEAR(1, diag.z, 0.05);
+}
+
+/*
+  an internal compass is not rotated, so the calibration reports the
+  bad orientation
+ */
+TEST_F(CompassCalibratorTest, InternalBadOrientation)
+{
+    start(ROTATION_NONE, false, true);
+    run_fit(ROTATION_ROLL_180_YAW_90);
+
+    EXPECT_EQ(COMPASS_CAL_BAD_ORIENTATION, cal.get_status());
+    EXPECT_EQ(ROTATION_ROLL_180_YAW_90, cal.get_orientation());
+}
+
+AP_GTEST_MAIN()
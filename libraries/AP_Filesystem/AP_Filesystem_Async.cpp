@@ -0,0 +1,562 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  asynchronous request queue on top of AP_Filesystem
+ */
+#include "AP_Filesystem_Async.h"
+
+#if HAVE_FILESYSTEM_SUPPORT
+
+#include <AP_Logger/AP_Logger.h>
+
+extern const AP_HAL::HAL& hal;
+
+static AP_Filesystem_Async fs_async;
+
+/*
+  start the IO thread on first use
+ */
+bool AP_Filesystem_Async::start_thread(void)
+{
+    if (thread_started || !use_thread) {
+        return true;
+    }
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+    // SITL snapshots fork() the vehicle, and only the main thread
+    // survives a fork. The IO processes run on the main thread in
+    // SITL, so service the requests from there instead
+    hal.scheduler->register_io_process(FUNCTOR_BIND_MEMBER(&AP_Filesystem_Async::io_timer, void));
+#else
+    if (!hal.scheduler->thread_create(FUNCTOR_BIND_MEMBER(&AP_Filesystem_Async::io_thread, void),
+                                      "FSIO",
+                                      4096, AP_HAL::Scheduler::PRIORITY_IO, 0)) {
+        return false;
+    }
+#endif
+    thread_started = true;
+    return true;
+}
+
+/*
+  place a request in a free slot
+ */
+bool AP_Filesystem_Async::queue(request &r)
+{
+    WITH_SEMAPHORE(sem);
+    if (!start_thread()) {
+        return false;
+    }
+    for (uint8_t i=0; i<FS_ASYNC_MAX_REQUESTS; i++) {
+        if (!requests[i].in_use) {
+            r.queued_us = AP_HAL::micros();
+            r.seq = next_seq++;
+            r.in_use = true;
+            requests[i] = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AP_Filesystem_Async::open(const char *fname, int flags, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    if (strlen(fname) >= sizeof(r.fname)) {
+        return false;
+    }
+    strncpy(r.fname, fname, sizeof(r.fname));
+    r.op = Op::OPEN;
+    r.flags = flags;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+bool AP_Filesystem_Async::read(int fd, uint32_t offset, void *buf, uint16_t count, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    r.op = Op::READ;
+    r.fd = fd;
+    r.offset = offset;
+    r.buf = (uint8_t *)buf;
+    r.count = count;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+bool AP_Filesystem_Async::write(int fd, uint32_t offset, const void *buf, uint16_t count, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    r.op = Op::WRITE;
+    r.fd = fd;
+    r.offset = offset;
+    r.buf = (uint8_t *)buf;
+    r.count = count;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+bool AP_Filesystem_Async::fsync(int fd, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    r.op = Op::FSYNC;
+    r.fd = fd;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+bool AP_Filesystem_Async::close(int fd, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    r.op = Op::CLOSE;
+    r.fd = fd;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+bool AP_Filesystem_Async::call(call_fn_t fn, Priority prio, completion_fn_t cb)
+{
+    request r {};
+    r.op = Op::CALL;
+    r.fn = fn;
+    r.prio = prio;
+    r.cb = cb;
+    return queue(r);
+}
+
+uint8_t AP_Filesystem_Async::pending(void) const
+{
+    uint8_t count = 0;
+    for (uint8_t i=0; i<FS_ASYNC_MAX_REQUESTS; i++) {
+        if (requests[i].in_use) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+  take the oldest request of the highest priority off the queue
+ */
+bool AP_Filesystem_Async::next_request(request &r)
+{
+    WITH_SEMAPHORE(sem);
+    int8_t best = -1;
+    for (uint8_t i=0; i<FS_ASYNC_MAX_REQUESTS; i++) {
+        const request &c = requests[i];
+        if (!c.in_use) {
+            continue;
+        }
+        if (best == -1 ||
+            c.prio < requests[best].prio ||
+            (c.prio == requests[best].prio && int32_t(c.seq - requests[best].seq) < 0)) {
+            best = i;
+        }
+    }
+    if (best == -1) {
+        return false;
+    }
+    r = requests[best];
+    requests[best].in_use = false;
+    return true;
+}
+
+bool AP_Filesystem_Async::update(void)
+{
+    request r;
+    if (next_request(r)) {
+        const int32_t ret = service(r);
+        record_latency(r.op, AP_HAL::micros() - r.queued_us);
+        if (r.cb) {
+            r.cb(ret);
+        }
+        return true;
+    }
+    return background_io();
+}
+
+void AP_Filesystem_Async::io_thread(void)
+{
+    while (true) {
+        if (!update()) {
+            hal.scheduler->delay(1);
+        }
+    }
+}
+
+/*
+  service the queue from the IO processes, doing at most one pass
+  over a full queue per call
+ */
+void AP_Filesystem_Async::io_timer(void)
+{
+    for (uint8_t i=0; i<FS_ASYNC_MAX_REQUESTS; i++) {
+        if (!update()) {
+            break;
+        }
+    }
+}
+
+int32_t AP_Filesystem_Async::service(request &r)
+{
+    file_state *f = nullptr;
+    if (r.op != Op::OPEN && r.op != Op::CALL) {
+        f = find_file(r.fd);
+    }
+
+    switch (r.op) {
+    case Op::OPEN: {
+        const int fd = AP::FS().open(r.fname, r.flags);
+        if (fd != -1) {
+            attach_file(fd);
+        }
+        return fd;
+    }
+
+    case Op::READ:
+        if (f == nullptr) {
+            return do_read(r.fd, r.offset, r.buf, r.count);
+        }
+        return buffered_read(*f, r.offset, r.buf, r.count);
+
+    case Op::WRITE:
+        if (f == nullptr) {
+            return do_write(r.fd, r.offset, r.buf, r.count);
+        }
+        return buffered_write(*f, r.offset, r.buf, r.count);
+
+    case Op::FSYNC:
+        if (f != nullptr && !flush_file(*f)) {
+            return -1;
+        }
+        return AP::FS().fsync(r.fd);
+
+    case Op::CLOSE: {
+        bool ok = true;
+        if (f != nullptr) {
+            ok = flush_file(*f);
+            detach_file(*f);
+        }
+        const int ret = AP::FS().close(r.fd);
+        return ok ? ret : -1;
+    }
+
+    case Op::CALL:
+        return r.fn();
+
+    case Op::NUM_OPS:
+        break;
+    }
+    return -1;
+}
+
+/*
+  work done when there are no requests: write out stale write-behind
+  data and read ahead of sequential readers. Returns true if any IO
+  was done
+ */
+bool AP_Filesystem_Async::background_io(void)
+{
+    const uint32_t now_ms = AP_HAL::millis();
+    for (uint8_t i=0; i<FS_ASYNC_MAX_FILES; i++) {
+        file_state &f = files[i];
+        if (f.fd == -1 || f.buf == nullptr) {
+            continue;
+        }
+        if (f.dirty) {
+            if (now_ms - f.dirty_ms >= FS_ASYNC_WRITE_BEHIND_MS) {
+                // any error is kept for the next request on the file
+                write_behind(f);
+                return true;
+            }
+            continue;
+        }
+        if (read_ahead(f)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AP_Filesystem_Async::record_latency(Op op, uint32_t latency_us)
+{
+    latency_stats &s = stats[uint8_t(op)];
+    uint8_t b = 0;
+    uint32_t v = latency_us >> 7;
+    while (v != 0 && b < FS_ASYNC_HIST_BUCKETS-1) {
+        v >>= 1;
+        b++;
+    }
+    s.hist[b]++;
+    s.count++;
+    s.max_us = MAX(s.max_us, latency_us);
+}
+
+void AP_Filesystem_Async::get_histogram(Op op, uint32_t hist[FS_ASYNC_HIST_BUCKETS]) const
+{
+    memcpy(hist, stats[uint8_t(op)].hist, sizeof(stats[0].hist));
+}
+
+/*
+  return an upper bound on the given latency percentile, from the
+  histogram buckets
+ */
+uint32_t AP_Filesystem_Async::latency_percentile_us(Op op, uint8_t percent) const
+{
+    const latency_stats &s = stats[uint8_t(op)];
+    if (s.count == 0) {
+        return 0;
+    }
+    const uint64_t target = (uint64_t(s.count) * percent + 99) / 100;
+    uint64_t total = 0;
+    for (uint8_t b=0; b<FS_ASYNC_HIST_BUCKETS-1; b++) {
+        total += s.hist[b];
+        if (total >= target) {
+            return MIN(uint32_t(128U << b), s.max_us);
+        }
+    }
+    return s.max_us;
+}
+
+void AP_Filesystem_Async::Log_Write(void) const
+{
+    for (uint8_t i=0; i<uint8_t(Op::NUM_OPS); i++) {
+        if (stats[i].count == 0) {
+            continue;
+        }
+        AP::logger().Write("FSIO",
+                           "TimeUS,Op,Count,P50,P95,Max",
+                           "s--sss",
+                           "F--FFF",
+                           "QBIIII",
+                           AP_HAL::micros64(),
+                           i,
+                           stats[i].count,
+                           latency_percentile_us(Op(i), 50),
+                           latency_percentile_us(Op(i), 95),
+                           stats[i].max_us);
+    }
+}
+
+AP_Filesystem_Async::file_state *AP_Filesystem_Async::find_file(int fd)
+{
+    for (uint8_t i=0; i<FS_ASYNC_MAX_FILES; i++) {
+        if (files[i].fd == fd) {
+            return &files[i];
+        }
+    }
+    return nullptr;
+}
+
+/*
+  give a newly opened file a buffer slot if one is free. Files
+  without a slot are accessed unbuffered
+ */
+void AP_Filesystem_Async::attach_file(int fd)
+{
+    file_state *f = find_file(-1);
+    if (f == nullptr) {
+        return;
+    }
+    uint8_t *buf = f->buf;
+    *f = file_state {};
+    f->fd = fd;
+    f->buf = buf;
+}
+
+/*
+  release a file slot, keeping its buffer for the next file
+ */
+void AP_Filesystem_Async::detach_file(file_state &f)
+{
+    f.fd = -1;
+    f.buf_len = 0;
+    f.dirty = false;
+}
+
+/*
+  write out write-behind data, recording any failure in write_error
+ */
+void AP_Filesystem_Async::write_behind(file_state &f)
+{
+    if (!f.dirty) {
+        return;
+    }
+    if (do_write(f.fd, f.buf_offset, f.buf, f.buf_len) != f.buf_len) {
+        f.write_error = true;
+    }
+    f.dirty = false;
+    f.buf_len = 0;
+}
+
+/*
+  write out write-behind data for a request. A failure, including one
+  from an earlier background write, is reported to this request only
+ */
+bool AP_Filesystem_Async::flush_file(file_state &f)
+{
+    write_behind(f);
+    const bool ok = !f.write_error;
+    f.write_error = false;
+    return ok;
+}
+
+/*
+  fill the buffer with read-ahead data from the given offset
+ */
+bool AP_Filesystem_Async::fill_buffer(file_state &f, uint32_t offset)
+{
+    if (f.buf == nullptr) {
+        f.buf = (uint8_t *)malloc(FS_ASYNC_BUFFER_SIZE);
+        if (f.buf == nullptr) {
+            return false;
+        }
+    }
+    f.buf_offset = offset;
+    f.buf_len = 0;
+    const int32_t n = do_read(f.fd, offset, f.buf, FS_ASYNC_BUFFER_SIZE);
+    if (n < 0) {
+        return false;
+    }
+    f.buf_len = n;
+    f.eof = (n < FS_ASYNC_BUFFER_SIZE);
+    return true;
+}
+
+/*
+  once a sequential reader is into the last quarter of the buffer,
+  keep what it has not read yet and fetch the data after it. Returns
+  true if any IO was done
+ */
+bool AP_Filesystem_Async::read_ahead(file_state &f)
+{
+    if (f.eof || f.buf_len == 0 ||
+        f.next_read <= f.buf_offset ||
+        f.next_read > f.buf_offset + f.buf_len ||
+        f.next_read - f.buf_offset < uint32_t(f.buf_len - f.buf_len / 4)) {
+        return false;
+    }
+    const uint16_t consumed = f.next_read - f.buf_offset;
+    const uint16_t keep = f.buf_len - consumed;
+    memmove(f.buf, &f.buf[consumed], keep);
+    f.buf_offset = f.next_read;
+    f.buf_len = keep;
+    const int32_t n = do_read(f.fd, f.buf_offset + keep, &f.buf[keep], FS_ASYNC_BUFFER_SIZE - keep);
+    if (n < 0) {
+        // stop reading ahead, a miss will retry
+        f.eof = true;
+        return true;
+    }
+    f.buf_len += n;
+    f.eof = (f.buf_len < FS_ASYNC_BUFFER_SIZE);
+    return true;
+}
+
+int32_t AP_Filesystem_Async::do_read(int fd, uint32_t offset, uint8_t *buf, uint16_t count)
+{
+    if (AP::FS().lseek(fd, offset, SEEK_SET) != (off_t)offset) {
+        return -1;
+    }
+    return AP::FS().read(fd, buf, count);
+}
+
+int32_t AP_Filesystem_Async::do_write(int fd, uint32_t offset, const uint8_t *buf, uint16_t count)
+{
+    if (AP::FS().lseek(fd, offset, SEEK_SET) != (off_t)offset) {
+        return -1;
+    }
+    return AP::FS().write(fd, buf, count);
+}
+
+int32_t AP_Filesystem_Async::buffered_read(file_state &f, uint32_t offset, uint8_t *buf, uint16_t count)
+{
+    if (f.dirty && !flush_file(f)) {
+        return -1;
+    }
+    const bool hit = f.buf_len > 0 &&
+        offset >= f.buf_offset &&
+        offset + count <= f.buf_offset + f.buf_len;
+    if (!hit) {
+        if (count >= FS_ASYNC_BUFFER_SIZE) {
+            // too large to be worth buffering
+            const int32_t n = do_read(f.fd, offset, buf, count);
+            if (n > 0) {
+                f.next_read = offset + n;
+            }
+            return n;
+        }
+        if (!fill_buffer(f, offset)) {
+            return f.buf == nullptr ? do_read(f.fd, offset, buf, count) : -1;
+        }
+    }
+    const uint16_t n = MIN(uint32_t(count), f.buf_offset + f.buf_len - offset);
+    memcpy(buf, &f.buf[offset - f.buf_offset], n);
+    f.next_read = offset + n;
+    return n;
+}
+
+int32_t AP_Filesystem_Async::buffered_write(file_state &f, uint32_t offset, const uint8_t *buf, uint16_t count)
+{
+    if (f.write_error) {
+        // report a failed write-behind once
+        f.write_error = false;
+        return -1;
+    }
+    if (!f.dirty) {
+        // drop any read-ahead data, it may be overwritten
+        f.buf_len = 0;
+    } else if (offset != f.buf_offset + f.buf_len ||
+               f.buf_len + count > FS_ASYNC_BUFFER_SIZE) {
+        // not a continuation of the buffered data
+        if (!flush_file(f)) {
+            return -1;
+        }
+    }
+    if (count >= FS_ASYNC_BUFFER_SIZE) {
+        return do_write(f.fd, offset, buf, count);
+    }
+    if (f.buf == nullptr) {
+        f.buf = (uint8_t *)malloc(FS_ASYNC_BUFFER_SIZE);
+        if (f.buf == nullptr) {
+            return do_write(f.fd, offset, buf, count);
+        }
+    }
+    if (!f.dirty) {
+        f.dirty = true;
+        f.dirty_ms = AP_HAL::millis();
+        f.buf_offset = offset;
+        f.buf_len = 0;
+    }
+    memcpy(&f.buf[f.buf_len], buf, count);
+    f.buf_len += count;
+    if (f.buf_len == FS_ASYNC_BUFFER_SIZE && !flush_file(f)) {
+        return -1;
+    }
+    return count;
+}
+
+namespace AP
+{
+AP_Filesystem_Async &FS_async()
+{
+    return fs_async;
+}
+}
+
+#endif // HAVE_FILESYSTEM_SUPPORT
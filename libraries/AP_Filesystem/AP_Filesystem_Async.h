@@ -0,0 +1,197 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  asynchronous request queue on top of AP_Filesystem. Requests are
+  serviced in priority order by a dedicated IO thread, which does
+  per-file read-ahead and write-behind so that callers are not
+  blocked on SD card latency. On SITL they are serviced from the IO
+  processes instead, so the vehicle can be snapshotted with fork()
+ */
+#pragma once
+
+#include "AP_Filesystem.h"
+
+#if HAVE_FILESYSTEM_SUPPORT
+
+#include <AP_HAL/AP_HAL.h>
+
+// maximum number of requests waiting to be serviced
+#ifndef FS_ASYNC_MAX_REQUESTS
+#define FS_ASYNC_MAX_REQUESTS 16
+#endif
+
+// number of open files given read-ahead and write-behind buffers
+#ifndef FS_ASYNC_MAX_FILES
+#define FS_ASYNC_MAX_FILES 4
+#endif
+
+// size of the per-file buffer, allocated on first use
+#ifndef FS_ASYNC_BUFFER_SIZE
+#define FS_ASYNC_BUFFER_SIZE 1024
+#endif
+
+// write-behind data is written out after this long even if the
+// buffer is not full
+#define FS_ASYNC_WRITE_BEHIND_MS 1000
+
+#define FS_ASYNC_MAX_NAME 64
+
+// latency histogram buckets. Bucket 0 counts requests completing in
+// under 128us, bucket n counts [2^(n+6), 2^(n+7)) us and the last
+// bucket everything slower
+#define FS_ASYNC_HIST_BUCKETS 16
+
+class AP_Filesystem_Async {
+public:
+    // without a thread requests are only serviced by calls to update()
+    AP_Filesystem_Async(bool _use_thread = true) :
+        use_thread(_use_thread) {}
+
+    /* Do not allow copies */
+    AP_Filesystem_Async(const AP_Filesystem_Async &other) = delete;
+    AP_Filesystem_Async &operator=(const AP_Filesystem_Async&) = delete;
+
+    // requests of a higher priority are always serviced first, so
+    // terrain lookups are not held up behind a log download
+    enum class Priority : uint8_t {
+        HIGH = 0,
+        NORMAL = 1,
+        LOW = 2,
+        NUM_PRIORITIES
+    };
+
+    enum class Op : uint8_t {
+        OPEN = 0,
+        READ,
+        WRITE,
+        FSYNC,
+        CLOSE,
+        CALL,
+        NUM_OPS
+    };
+
+    // called from the IO thread when a request completes, with the
+    // return value of the equivalent AP_Filesystem call
+    FUNCTOR_TYPEDEF(completion_fn_t, void, int32_t);
+
+    // an operation with no request of its own, run on the IO thread
+    FUNCTOR_TYPEDEF(call_fn_t, int32_t);
+
+    /*
+      queue a request. These return false if the request could not be
+      queued, in which case the callback will not be called. Read and
+      write buffers must stay valid until the callback is called. A
+      file opened here should only be accessed through this interface
+      until it is closed. Files opened with AP::FS() may also be read
+      and written here, without buffering
+     */
+    bool open(const char *fname, int flags, Priority prio, completion_fn_t cb);
+    bool read(int fd, uint32_t offset, void *buf, uint16_t count, Priority prio, completion_fn_t cb);
+    bool write(int fd, uint32_t offset, const void *buf, uint16_t count, Priority prio, completion_fn_t cb);
+    bool fsync(int fd, Priority prio, completion_fn_t cb);
+    bool close(int fd, Priority prio, completion_fn_t cb);
+
+    // run fn on the IO thread, for filesystem calls such as stat(),
+    // unlink() and directory listing. cb is given the return value
+    bool call(call_fn_t fn, Priority prio, completion_fn_t cb);
+
+    // number of requests waiting to be serviced
+    uint8_t pending(void) const;
+
+    // service the next request, or do background IO if there are
+    // none. Returns true if any work was done. Called in a loop by
+    // the IO thread
+    bool update(void);
+
+    // request latency, from being queued to completion
+    void get_histogram(Op op, uint32_t hist[FS_ASYNC_HIST_BUCKETS]) const;
+    uint32_t latency_percentile_us(Op op, uint8_t percent) const;
+
+    // log latency statistics for each operation
+    void Log_Write(void) const;
+
+private:
+    struct request {
+        completion_fn_t cb;
+        call_fn_t fn;
+        uint8_t *buf;
+        uint32_t offset;
+        uint32_t queued_us;
+        uint32_t seq;
+        int fd;
+        int flags;
+        uint16_t count;
+        Op op;
+        Priority prio;
+        bool in_use;
+        char fname[FS_ASYNC_MAX_NAME];
+    } requests[FS_ASYNC_MAX_REQUESTS];
+
+    /*
+      buffer state for an open file. A file buffer holds either
+      read-ahead data or write-behind data, never both. Only accessed
+      from the IO thread
+     */
+    struct file_state {
+        int fd = -1;
+        uint8_t *buf;
+        uint32_t buf_offset;
+        uint16_t buf_len;
+        bool dirty;
+        bool eof;
+        bool write_error; // a write-behind failed and is not yet reported
+        uint32_t dirty_ms;
+        uint32_t next_read;
+    } files[FS_ASYNC_MAX_FILES];
+
+    struct latency_stats {
+        uint32_t hist[FS_ASYNC_HIST_BUCKETS];
+        uint32_t count;
+        uint32_t max_us;
+    } stats[uint8_t(Op::NUM_OPS)];
+
+    HAL_Semaphore sem;
+    uint32_t next_seq;
+    const bool use_thread;
+    bool thread_started;
+
+    bool queue(request &r);
+    bool start_thread(void);
+    bool next_request(request &r);
+    void io_thread(void);
+    void io_timer(void);
+    int32_t service(request &r);
+    bool background_io(void);
+    void record_latency(Op op, uint32_t latency_us);
+
+    file_state *find_file(int fd);
+    void attach_file(int fd);
+    void detach_file(file_state &f);
+    void write_behind(file_state &f);
+    bool flush_file(file_state &f);
+    bool fill_buffer(file_state &f, uint32_t offset);
+    bool read_ahead(file_state &f);
+
+    int32_t do_read(int fd, uint32_t offset, uint8_t *buf, uint16_t count);
+    int32_t do_write(int fd, uint32_t offset, const uint8_t *buf, uint16_t count);
+    int32_t buffered_read(file_state &f, uint32_t offset, uint8_t *buf, uint16_t count);
+    int32_t buffered_write(file_state &f, uint32_t offset, const uint8_t *buf, uint16_t count);
+};
+
+namespace AP {
+    AP_Filesystem_Async &FS_async();
+};
+
+#endif // HAVE_FILESYSTEM_SUPPORT
@@ -0,0 +1,274 @@
+/*
+  tests for the AP_Filesystem_Async request queue, serviced without
+  the IO thread by calling update()
+ */
+#include <AP_gtest.h>
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_Math/AP_Math.h>
+#include <AP_Filesystem/AP_Filesystem_Async.h>
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#include <AP_HAL_SITL/Scheduler.h>
+#endif
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+#if HAVE_FILESYSTEM_SUPPORT
+
+#define TEST_FILE "fs_async_test.dat"
+
+class FSAsyncTest : public ::testing::Test {
+protected:
+    AP_Filesystem_Async fs{false};
+
+    // results in order of completion
+    int32_t results[16];
+    uint8_t order[16];
+    uint8_t num_done;
+
+    void done0(int32_t ret) { record(0, ret); }
+    void done1(int32_t ret) { record(1, ret); }
+    void done2(int32_t ret) { record(2, ret); }
+    void done3(int32_t ret) { record(3, ret); }
+
+    void record(uint8_t id, int32_t ret) {
+        order[num_done] = id;
+        results[num_done] = ret;
+        num_done++;
+    }
+
+    AP_Filesystem_Async::completion_fn_t cb(uint8_t id) {
+        switch (id) {
+        case 0: return FUNCTOR_BIND_MEMBER(&FSAsyncTest::done0, void, int32_t);
+        case 1: return FUNCTOR_BIND_MEMBER(&FSAsyncTest::done1, void, int32_t);
+        case 2: return FUNCTOR_BIND_MEMBER(&FSAsyncTest::done2, void, int32_t);
+        default: return FUNCTOR_BIND_MEMBER(&FSAsyncTest::done3, void, int32_t);
+        }
+    }
+
+    // service requests until the queue is empty
+    void run_queue(void) {
+        while (fs.pending() > 0) {
+            fs.update();
+        }
+    }
+
+    // open TEST_FILE and return the fd
+    int open_file(int flags) {
+        num_done = 0;
+        EXPECT_TRUE(fs.open(TEST_FILE, flags, AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+        run_queue();
+        EXPECT_EQ(1U, num_done);
+        num_done = 0;
+        return results[0];
+    }
+
+    void close_file(int fd) {
+        num_done = 0;
+        EXPECT_TRUE(fs.close(fd, AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+        run_queue();
+        EXPECT_EQ(0, results[0]);
+        num_done = 0;
+    }
+
+    // a call() that removes TEST_FILE
+    int32_t unlink_file(void) {
+        return AP::FS().unlink(TEST_FILE);
+    }
+
+    AP_Filesystem_Async::call_fn_t unlink_fn(void) {
+        return FUNCTOR_BIND_MEMBER(&FSAsyncTest::unlink_file, int32_t);
+    }
+
+    void SetUp() override {
+        num_done = 0;
+        AP::FS().unlink(TEST_FILE);
+    }
+
+    void TearDown() override {
+        AP::FS().unlink(TEST_FILE);
+    }
+};
+
+/*
+  higher priority requests are serviced first, and requests of the
+  same priority in the order they were queued
+ */
+TEST_F(FSAsyncTest, PriorityOrder)
+{
+    const int fd = open_file(O_RDWR|O_CREAT|O_TRUNC);
+    ASSERT_GE(fd, 0);
+
+    uint8_t buf[4][16] {};
+    ASSERT_TRUE(fs.write(fd, 0, buf[0], sizeof(buf[0]), AP_Filesystem_Async::Priority::LOW, cb(0)));
+    ASSERT_TRUE(fs.write(fd, 16, buf[1], sizeof(buf[1]), AP_Filesystem_Async::Priority::NORMAL, cb(1)));
+    ASSERT_TRUE(fs.write(fd, 32, buf[2], sizeof(buf[2]), AP_Filesystem_Async::Priority::HIGH, cb(2)));
+    ASSERT_TRUE(fs.write(fd, 48, buf[3], sizeof(buf[3]), AP_Filesystem_Async::Priority::NORMAL, cb(3)));
+    EXPECT_EQ(4U, fs.pending());
+    run_queue();
+
+    ASSERT_EQ(4U, num_done);
+    EXPECT_EQ(2U, order[0]);
+    EXPECT_EQ(1U, order[1]);
+    EXPECT_EQ(3U, order[2]);
+    EXPECT_EQ(0U, order[3]);
+    for (uint8_t i=0; i<4; i++) {
+        EXPECT_EQ(16, results[i]);
+    }
+    close_file(fd);
+}
+
+/*
+  small writes are gathered and reach the file by close
+ */
+TEST_F(FSAsyncTest, WriteBehind)
+{
+    int fd = open_file(O_RDWR|O_CREAT|O_TRUNC);
+    ASSERT_GE(fd, 0);
+
+    uint8_t data[3000];
+    for (uint16_t i=0; i<sizeof(data); i++) {
+        data[i] = i * 7;
+    }
+    for (uint16_t ofs=0; ofs<sizeof(data); ofs += 100) {
+        ASSERT_TRUE(fs.write(fd, ofs, &data[ofs], 100, AP_Filesystem_Async::Priority::NORMAL, nullptr));
+        run_queue();
+    }
+    close_file(fd);
+
+    fd = AP::FS().open(TEST_FILE, O_RDONLY);
+    ASSERT_GE(fd, 0);
+    uint8_t check[sizeof(data)+1];
+    EXPECT_EQ((ssize_t)sizeof(data), AP::FS().read(fd, check, sizeof(check)));
+    EXPECT_EQ(0, memcmp(data, check, sizeof(data)));
+    AP::FS().close(fd);
+}
+
+/*
+  a sequential reader in the last quarter of the buffer gets the next
+  data read ahead while the queue is idle, and reads stay correct
+ */
+TEST_F(FSAsyncTest, ReadAhead)
+{
+    uint8_t data[4000];
+    for (uint16_t i=0; i<sizeof(data); i++) {
+        data[i] = i * 13;
+    }
+    int fd = AP::FS().open(TEST_FILE, O_WRONLY|O_CREAT|O_TRUNC);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ((ssize_t)sizeof(data), AP::FS().write(fd, data, sizeof(data)));
+    AP::FS().close(fd);
+
+    fd = open_file(O_RDONLY);
+    ASSERT_GE(fd, 0);
+
+    // nothing to read ahead until a read has been done
+    EXPECT_FALSE(fs.update());
+
+    uint8_t buf[4000] {};
+    uint32_t ofs = 0;
+    bool read_ahead = false;
+    while (ofs < sizeof(data)) {
+        const uint16_t n = MIN(uint32_t(100), sizeof(data) - ofs);
+        num_done = 0;
+        ASSERT_TRUE(fs.read(fd, ofs, &buf[ofs], n, AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+        run_queue();
+        ASSERT_EQ(1U, num_done);
+        ASSERT_EQ(n, results[0]);
+        ofs += n;
+        if (ofs % FS_ASYNC_BUFFER_SIZE == 800) {
+            // 800 of a 1024 byte buffer have been read, which does not
+            // end on the buffer boundary but is in its last quarter
+            read_ahead = fs.update();
+            EXPECT_TRUE(read_ahead) << "no read-ahead at " << ofs;
+        }
+    }
+    EXPECT_TRUE(read_ahead);
+    EXPECT_EQ(0, memcmp(data, buf, sizeof(data)));
+
+    // reading past the end returns nothing
+    num_done = 0;
+    ASSERT_TRUE(fs.read(fd, sizeof(data), buf, 100, AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+    run_queue();
+    EXPECT_EQ(0, results[0]);
+    close_file(fd);
+}
+
+/*
+  a failed write-behind is reported once, then the file is usable again
+ */
+TEST_F(FSAsyncTest, WriteErrorReportedOnce)
+{
+    int fd = AP::FS().open(TEST_FILE, O_WRONLY|O_CREAT|O_TRUNC);
+    ASSERT_GE(fd, 0);
+    AP::FS().close(fd);
+
+    // writes to a read only file fail when they are written out
+    fd = open_file(O_RDONLY);
+    ASSERT_GE(fd, 0);
+    uint8_t data[16] {};
+    ASSERT_TRUE(fs.write(fd, 0, data, sizeof(data), AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+    ASSERT_TRUE(fs.fsync(fd, AP_Filesystem_Async::Priority::NORMAL, cb(1)));
+    ASSERT_TRUE(fs.fsync(fd, AP_Filesystem_Async::Priority::NORMAL, cb(2)));
+    run_queue();
+
+    ASSERT_EQ(3U, num_done);
+    // the write is buffered, so it succeeds
+    EXPECT_EQ(16, results[0]);
+    // the flush fails
+    EXPECT_EQ(-1, results[1]);
+    // and the error is not reported again
+    EXPECT_EQ(0, results[2]);
+    close_file(fd);
+}
+
+/*
+  a call() is run in order with the other requests of its priority,
+  and its return value is passed to the callback
+ */
+TEST_F(FSAsyncTest, Call)
+{
+    const int fd = open_file(O_RDWR|O_CREAT|O_TRUNC);
+    ASSERT_GE(fd, 0);
+
+    uint8_t data[16] {};
+    ASSERT_TRUE(fs.write(fd, 0, data, sizeof(data), AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+    ASSERT_TRUE(fs.close(fd, AP_Filesystem_Async::Priority::NORMAL, cb(1)));
+    ASSERT_TRUE(fs.call(unlink_fn(), AP_Filesystem_Async::Priority::NORMAL, cb(2)));
+    ASSERT_TRUE(fs.call(unlink_fn(), AP_Filesystem_Async::Priority::NORMAL, cb(3)));
+    run_queue();
+
+    ASSERT_EQ(4U, num_done);
+    for (uint8_t i=0; i<4; i++) {
+        EXPECT_EQ(i, order[i]);
+    }
+    EXPECT_EQ(16, results[0]);
+    EXPECT_EQ(0, results[1]);
+    // the file is removed by the first call only
+    EXPECT_EQ(0, results[2]);
+    EXPECT_EQ(-1, results[3]);
+}
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+/*
+  on SITL the shared queue is serviced by the IO processes, which run
+  on the main thread as the clock moves on, so no thread is started
+  that would stop the vehicle being snapshotted
+ */
+TEST_F(FSAsyncTest, SITLServicedWithoutThread)
+{
+    ASSERT_TRUE(AP::FS_async().call(unlink_fn(), AP_Filesystem_Async::Priority::NORMAL, cb(0)));
+    EXPECT_FALSE(HALSITL::Scheduler::have_threads());
+    EXPECT_EQ(0U, num_done);
+
+    hal.scheduler->stop_clock(1000000);
+    hal.scheduler->stop_clock(1020000);
+    EXPECT_EQ(1U, num_done);
+    EXPECT_EQ(0U, AP::FS_async().pending());
+    hal.scheduler->stop_clock(0);
+}
+#endif
+
+#endif // HAVE_FILESYSTEM_SUPPORT
+
+AP_GTEST_MAIN()
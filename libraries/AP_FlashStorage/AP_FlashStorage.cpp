@@ -108,10 +108,22 @@ bool AP_FlashStorage::init(void)
     // clear any write error
     write_error = false;
     reserved_space = 0;
-    
+    compacting = false;
+
     // if the first sector is full then write out all data so we can erase it
     if (states[first_sector] == SECTOR_STATE_FULL) {
         current_sector = first_sector ^ 1;
+        if (states[current_sector] == SECTOR_STATE_AVAILABLE) {
+            // we lost power between marking the first sector full and
+            // the second in use, so nothing has been written to it yet
+            struct sector_header hdr;
+            hdr.signature = signature;
+            hdr.state = SECTOR_STATE_IN_USE;
+            if (!flash_write(current_sector, 0, (const uint8_t *)&hdr, sizeof(hdr))) {
+                return false;
+            }
+            write_offset = sizeof(hdr);
+        }
         if (!write_all()) {
             return erase_all();
         }
@@ -139,11 +151,26 @@ bool AP_FlashStorage::init(void)
 bool AP_FlashStorage::switch_full_sector(void)
 {
     debug("running switch_full_sector()\n");
-    
+
+    if (in_switch_full_sector) {
+        // write_all() ran out of space in the sector we are switching
+        // away from, so the data can't fit. Don't recurse
+        write_error = true;
+        return false;
+    }
+    in_switch_full_sector = true;
+    const bool ret = protected_switch_full_sector();
+    in_switch_full_sector = false;
+    return ret;
+}
+
+bool AP_FlashStorage::protected_switch_full_sector(void)
+{
     // clear any write error
     write_error = false;
     reserved_space = 0;
-    
+    compacting = false;
+
     if (!write_all()) {
         return false;
     }
@@ -216,11 +243,58 @@ bool AP_FlashStorage::write(uint16_t offset, uint16_t length)
     return true;
 }
 
+/*
+  incrementally copy live data out of the full sector, then erase it
+ */
+bool AP_FlashStorage::compact(void)
+{
+    if (!compacting || write_error) {
+        return false;
+    }
+
+    // skip over zero data, it is the default after an erase
+    while (compact_offset < storage_size) {
+        // local variable needed to overcome problem with MIN() macro and -O0
+        const uint8_t max_write_local = max_write;
+        const uint8_t n = MIN(max_write_local, storage_size-compact_offset);
+        const uint16_t ofs = compact_offset;
+        if (all_zero(ofs, n)) {
+            compact_offset += n;
+            continue;
+        }
+        // a sector switch during the write restarts compaction, so
+        // only advance if we are still copying the same range
+        if (!write(ofs, n)) {
+            return true;
+        }
+        if (compacting && compact_offset == ofs) {
+            compact_offset += n;
+        }
+        return true;
+    }
+
+    // everything in the full sector is now also in the current
+    // sector, so it can be erased when that is allowed
+    if (!flash_erase_ok()) {
+        return true;
+    }
+    debug("compacted, erasing sector %u\n", current_sector ^ 1);
+    if (!erase_sector(current_sector ^ 1)) {
+        return true;
+    }
+    compacting = false;
+    reserved_space = 0;
+    return false;
+}
+
 /*
   load all data from a flash sector into mem_buffer
  */
 bool AP_FlashStorage::load_sector(uint8_t sector)
 {
+    // the last sector loaded is the one we carry on writing to
+    current_sector = sector;
+
     uint32_t ofs = sizeof(sector_header);
     while (ofs < flash_sector_size - sizeof(struct block_header)) {
         struct block_header header;
@@ -392,6 +466,10 @@ bool AP_FlashStorage::switch_sectors(void)
     reserved_space = reserve_size;
     
     write_offset = sizeof(header);
+
+    // start copying live data across so the full sector can be erased early
+    compacting = true;
+    compact_offset = 0;
     return true;    
 }
 
@@ -403,6 +481,7 @@ bool AP_FlashStorage::re_initialise(void)
     if (!flash_erase_ok()) {
         return false;
     }
+    compacting = false;
     if (!erase_all()) {
         return false;        
     }
@@ -34,6 +34,12 @@
     128k flash sectors with 16k storage size.
 
   - assumes two flash sectors are available
+
+  - after switching sectors the live data is copied into the new
+    sector in the background, one block at a time, by compact(). Once
+    that is complete the full sector holds nothing that is needed and
+    is erased as soon as erasing is allowed, so the next sector switch
+    doesn't need a blocking re-write of all of storage
  */
 #pragma once
 
@@ -92,6 +98,12 @@ public:
     // write some data to storage from mem_buffer
     bool write(uint16_t offset, uint16_t length);
 
+    // copy at most one block of live data into the current sector, or
+    // erase the full sector once it is no longer needed. Should be
+    // called when there is nothing else to write. Returns true if
+    // there is more compaction to do
+    bool compact(void);
+
     // fixed storage size
     static const uint16_t storage_size = block_size * num_blocks;
     
@@ -108,6 +120,13 @@ private:
     uint32_t reserved_space;
     bool write_error;
 
+    // guard against write_all() needing another sector switch
+    bool in_switch_full_sector;
+
+    // progress of copying live data out of the full sector
+    uint16_t compact_offset;
+    bool compacting;
+
     // 24 bit signature
 #if AP_FLASHSTORAGE_MULTI_WRITE
     static const uint32_t signature = 0x51685B;
@@ -173,4 +192,7 @@ private:
 
     // switch to next sector for writing
     bool switch_sectors(void);
+
+    // body of switch_full_sector(), run with the recursion guard held
+    bool protected_switch_full_sector(void);
 };
@@ -0,0 +1,219 @@
+/*
+  flash wear and write latency simulation for AP_FlashStorage
+ */
+#include <AP_gtest.h>
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_Math/AP_Math.h>
+#include <AP_FlashStorage/AP_FlashStorage.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+class FlashSim {
+public:
+    static const uint32_t sector_size = 128U * 1024U;
+
+    FlashSim() {
+        memset(flash, 0xFF, sizeof(flash));
+    }
+
+    bool write(uint8_t sector, uint32_t offset, const uint8_t *data, uint16_t length) {
+        if (sector > 1 || offset + length > sector_size) {
+            ADD_FAILURE() << "write out of range " << unsigned(sector) << ":" << offset;
+            return false;
+        }
+        for (uint16_t i=0; i<length; i++) {
+            // flash can only clear bits
+            if (data[i] & ~flash[sector][offset+i]) {
+                ADD_FAILURE() << "write sets bits at " << unsigned(sector) << ":" << (offset+i);
+                return false;
+            }
+            flash[sector][offset+i] &= data[i];
+        }
+        bytes_written += length;
+        op_bytes_written += length;
+        return true;
+    }
+
+    bool read(uint8_t sector, uint32_t offset, uint8_t *data, uint16_t length) {
+        if (sector > 1 || offset + length > sector_size) {
+            ADD_FAILURE() << "read out of range " << unsigned(sector) << ":" << offset;
+            return false;
+        }
+        memcpy(data, &flash[sector][offset], length);
+        return true;
+    }
+
+    bool erase(uint8_t sector) {
+        if (sector > 1) {
+            ADD_FAILURE() << "erase out of range " << unsigned(sector);
+            return false;
+        }
+        memset(flash[sector], 0xFF, sector_size);
+        erases[sector]++;
+        op_erases++;
+        return true;
+    }
+
+    bool erase_ok(void) {
+        return erase_allowed;
+    }
+
+    // start measuring a single storage operation
+    void begin_op(void) {
+        op_bytes_written = 0;
+        op_erases = 0;
+    }
+
+    uint8_t flash[2][sector_size];
+    uint32_t erases[2];
+    uint64_t bytes_written;
+    uint32_t op_bytes_written;
+    uint32_t op_erases;
+    bool erase_allowed;
+};
+
+class FlashWearTest : public ::testing::Test {
+protected:
+    FlashSim sim;
+    uint8_t mem_buffer[AP_FlashStorage::storage_size];
+    uint8_t mem_mirror[AP_FlashStorage::storage_size];
+
+    AP_FlashStorage *new_storage() {
+        return new AP_FlashStorage(mem_buffer,
+                                   FlashSim::sector_size,
+                                   FUNCTOR_BIND(&sim, &FlashSim::write, bool, uint8_t, uint32_t, const uint8_t *, uint16_t),
+                                   FUNCTOR_BIND(&sim, &FlashSim::read, bool, uint8_t, uint32_t, uint8_t *, uint16_t),
+                                   FUNCTOR_BIND(&sim, &FlashSim::erase, bool, uint8_t),
+                                   FUNCTOR_BIND(&sim, &FlashSim::erase_ok, bool));
+    }
+
+    void SetUp() override {
+        memset(mem_mirror, 0, sizeof(mem_mirror));
+    }
+
+    // a parameter sized write to the start of storage, as a tuning script would do
+    void random_update(uint16_t &ofs, uint16_t &length) {
+        ofs = get_random16() % 4096;
+        length = 1 + (get_random16() % 16);
+        for (uint16_t i=0; i<length; i++) {
+            mem_mirror[ofs+i] = mem_buffer[ofs+i] = get_random16() & 0xFF;
+        }
+    }
+};
+
+/*
+  writes made while erasing is not allowed (armed) never stall on a
+  sector switch as long as compaction runs in the idle time
+ */
+TEST_F(FlashWearTest, BoundedWriteLatency)
+{
+    AP_FlashStorage *storage = new_storage();
+    sim.erase_allowed = true;
+    ASSERT_TRUE(storage->init());
+
+    uint32_t max_op_bytes = 0;
+    for (uint32_t i=0; i<200000; i++) {
+        uint16_t ofs, length;
+        random_update(ofs, length);
+
+        sim.erase_allowed = false;
+        sim.begin_op();
+        ASSERT_TRUE(storage->write(ofs, length)) << "write " << i << " failed";
+        EXPECT_EQ(0U, sim.op_erases);
+        max_op_bytes = MAX(max_op_bytes, sim.op_bytes_written);
+
+        // idle time between saves, erasing is allowed while disarmed
+        sim.erase_allowed = (i % 10) == 0;
+        for (uint8_t j=0; j<4; j++) {
+            sim.begin_op();
+            storage->compact();
+            max_op_bytes = MAX(max_op_bytes, sim.op_bytes_written);
+        }
+    }
+
+    // a write is at most two block writes plus the sector headers on a switch
+    EXPECT_LE(max_op_bytes, 2U * (2 + 64) + 2 * 4);
+
+    printf("erases: %u %u, bytes written: %llu, max bytes per operation: %u\n",
+           (unsigned)sim.erases[0], (unsigned)sim.erases[1],
+           (unsigned long long)sim.bytes_written, (unsigned)max_op_bytes);
+
+    // wear is spread evenly over both sectors
+    EXPECT_LE(abs(int32_t(sim.erases[0]) - int32_t(sim.erases[1])), 1);
+
+    delete storage;
+}
+
+/*
+  data survives reboots at any point during compaction
+ */
+TEST_F(FlashWearTest, ReinitDuringCompaction)
+{
+    AP_FlashStorage *storage = new_storage();
+    sim.erase_allowed = true;
+    ASSERT_TRUE(storage->init());
+
+    for (uint32_t i=0; i<100000; i++) {
+        uint16_t ofs, length;
+        random_update(ofs, length);
+        ASSERT_TRUE(storage->write(ofs, length));
+        storage->compact();
+
+        if (i % 7919 == 0) {
+            // reboot, reloading everything from flash
+            delete storage;
+            memset(mem_buffer, 0, sizeof(mem_buffer));
+            storage = new_storage();
+            ASSERT_TRUE(storage->init());
+            ASSERT_EQ(0, memcmp(mem_buffer, mem_mirror, sizeof(mem_buffer))) << "mismatch after reboot at " << i;
+        }
+    }
+
+    delete storage;
+    memset(mem_buffer, 0, sizeof(mem_buffer));
+    storage = new_storage();
+    ASSERT_TRUE(storage->init());
+    EXPECT_EQ(0, memcmp(mem_buffer, mem_mirror, sizeof(mem_buffer)));
+    delete storage;
+}
+
+/*
+  reboot as soon as compaction has erased the old sector, leaving the
+  live data only in the second sector, and keep writing
+ */
+TEST_F(FlashWearTest, ReinitAfterCompaction)
+{
+    AP_FlashStorage *storage = new_storage();
+    sim.erase_allowed = true;
+    ASSERT_TRUE(storage->init());
+
+    uint32_t reboots = 0;
+    for (uint32_t i=0; i<100000; i++) {
+        uint16_t ofs, length;
+        random_update(ofs, length);
+        ASSERT_TRUE(storage->write(ofs, length)) << "write " << i << " failed";
+
+        const uint32_t erases = sim.erases[0] + sim.erases[1];
+        storage->compact();
+        if (sim.erases[0] + sim.erases[1] != erases) {
+            delete storage;
+            memset(mem_buffer, 0, sizeof(mem_buffer));
+            storage = new_storage();
+            ASSERT_TRUE(storage->init());
+            ASSERT_EQ(0, memcmp(mem_buffer, mem_mirror, sizeof(mem_buffer))) << "mismatch after reboot at " << i;
+            reboots++;
+        }
+    }
+    // both sectors have been left as the only live one
+    EXPECT_GE(reboots, 4U);
+
+    delete storage;
+    memset(mem_buffer, 0, sizeof(mem_buffer));
+    storage = new_storage();
+    ASSERT_TRUE(storage->init());
+    EXPECT_EQ(0, memcmp(mem_buffer, mem_mirror, sizeof(mem_buffer)));
+    delete storage;
+}
+
+AP_GTEST_MAIN()
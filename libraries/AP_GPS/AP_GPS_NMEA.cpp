@@ -52,24 +52,31 @@ extern const AP_HAL::HAL& hal;
 
 bool AP_GPS_NMEA::read(void)
 {
-    int16_t numc;
     bool parsed = false;
 
-    numc = port->available();
-    while (numc--) {
-        char c = port->read();
+    // read in blocks, bounded by what was available on entry
+    uint32_t numc = port->available();
+    uint8_t buf[NMEA_READ_BLOCK];
+    while (numc > 0) {
+        const ssize_t n = port->read(buf, MIN(numc, sizeof(buf)));
+        if (n <= 0) {
+            break;
+        }
 #ifdef NMEA_LOG_PATH
         static FILE *logf = nullptr;
         if (logf == nullptr) {
             logf = fopen(NMEA_LOG_PATH, "wb");
         }
         if (logf != nullptr) {
-            ::fwrite(&c, 1, 1, logf);
+            ::fwrite(buf, 1, n, logf);
         }
 #endif
-        if (_decode(c)) {
-            parsed = true;
+        for (ssize_t i = 0; i < n; i++) {
+            if (_decode(buf[i])) {
+                parsed = true;
+            }
         }
+        numc -= MIN(uint32_t(n), numc);
     }
     return parsed;
 }
@@ -46,11 +46,15 @@
 #include "AP_GPS.h"
 #include "GPS_Backend.h"
 
+// bytes taken from the UART at a time
+#define NMEA_READ_BLOCK 64
+
 /// NMEA parser
 ///
 class AP_GPS_NMEA : public AP_GPS_Backend
 {
     friend class AP_GPS_NMEA_Test;
+    friend class GPS_ParseBench;
 
 public:
 
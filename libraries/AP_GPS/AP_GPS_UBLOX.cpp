@@ -369,8 +369,6 @@ AP_GPS_UBLOX::_request_port(void)
 bool
 AP_GPS_UBLOX::read(void)
 {
-    uint8_t data;
-    int16_t numc;
     bool parsed = false;
     uint32_t millis_now = AP_HAL::millis();
 
@@ -399,113 +397,161 @@ AP_GPS_UBLOX::read(void)
         }
     }
 
-    numc = port->available();
-    for (int16_t i = 0; i < numc; i++) {        // Process bytes received
-
-        // read the next byte
-        data = port->read();
+    // read in blocks, bounded by what was available on entry so a
+    // fast stream can't keep us here
+    uint32_t numc = port->available();
+    uint8_t buf[UBLOX_READ_BLOCK];
+    while (numc > 0) {
+        const ssize_t n = port->read(buf, MIN(numc, sizeof(buf)));
+        if (n <= 0) {
+            break;
+        }
+        if (_parse_buffer(buf, n)) {
+            parsed = true;
+        }
+        numc -= MIN(uint32_t(n), numc);
+    }
+    return parsed;
+}
 
-	reset:
-        switch(_step) {
-
-        // Message preamble detection
-        //
-        // If we fail to match any of the expected bytes, we reset
-        // the state machine and re-consider the failed byte as
-        // the first byte of the preamble.  This improves our
-        // chances of recovering from a mismatch and makes it less
-        // likely that we will be fooled by the preamble appearing
-        // as data in some other message.
-        //
-        case 1:
-            if (PREAMBLE2 == data) {
-                _step++;
-                break;
+/*
+  run a block of received bytes through the message state machine,
+  returning true if a message was parsed
+ */
+bool AP_GPS_UBLOX::_parse_buffer(const uint8_t *buf, uint16_t len)
+{
+    bool parsed = false;
+    for (uint16_t i = 0; i < len; i++) {
+        // payload bytes are most of the stream, so take as many as
+        // this block holds without going through _parse_byte()
+        if (_step == 6) {
+            const uint16_t n = MIN(uint16_t(len - i), uint16_t(_payload_length - _payload_counter));
+            memcpy(&_buffer[_payload_counter], &buf[i], n);
+            for (uint16_t j = 0; j < n; j++) {
+                _ck_b += (_ck_a += buf[i+j]);           // checksum byte
             }
-            _step = 0;
-            Debug("reset %u", __LINE__);
-            FALLTHROUGH;
-        case 0:
-            if(PREAMBLE1 == data)
+            _payload_counter += n;
+            if (_payload_counter == _payload_length) {
                 _step++;
-            break;
+            }
+            i += n - 1;
+            continue;
+        }
+        if (_parse_byte(buf[i])) {
+            parsed = true;
+        }
+    }
+    return parsed;
+}
 
-        // Message header processing
-        //
-        // We sniff the class and message ID to decide whether we
-        // are going to gather the message bytes or just discard
-        // them.
-        //
-        // We always collect the length so that we can avoid being
-        // fooled by preamble bytes in messages.
-        //
-        case 2:
-            _step++;
-            _class = data;
-            _ck_b = _ck_a = data;                       // reset the checksum accumulators
-            break;
-        case 3:
-            _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-            _msg_id = data;
-            break;
-        case 4:
+/*
+  run one received byte through the message state machine, returning
+  true if a message was parsed
+ */
+bool AP_GPS_UBLOX::_parse_byte(uint8_t data)
+{
+    bool parsed = false;
+
+	reset:
+    switch(_step) {
+
+    // Message preamble detection
+    //
+    // If we fail to match any of the expected bytes, we reset
+    // the state machine and re-consider the failed byte as
+    // the first byte of the preamble.  This improves our
+    // chances of recovering from a mismatch and makes it less
+    // likely that we will be fooled by the preamble appearing
+    // as data in some other message.
+    //
+    case 1:
+        if (PREAMBLE2 == data) {
             _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-            _payload_length = data;                     // payload length low byte
             break;
-        case 5:
+        }
+        _step = 0;
+        Debug("reset %u", __LINE__);
+        FALLTHROUGH;
+    case 0:
+        if(PREAMBLE1 == data)
             _step++;
-            _ck_b += (_ck_a += data);                   // checksum byte
-
-            _payload_length += (uint16_t)(data<<8);
-            if (_payload_length > sizeof(_buffer)) {
-                Debug("large payload %u", (unsigned)_payload_length);
-                // assume any payload bigger then what we know about is noise
-                _payload_length = 0;
-                _step = 0;
-				goto reset;
-            }
-            _payload_counter = 0;                       // prepare to receive payload
-            if (_payload_length == 0) {
-                // bypass payload and go straight to checksum
-                _step++;
-            }
-            break;
+        break;
 
-        // Receive message data
-        //
-        case 6:
-            _ck_b += (_ck_a += data);                   // checksum byte
-            if (_payload_counter < sizeof(_buffer)) {
-                _buffer[_payload_counter] = data;
-            }
-            if (++_payload_counter == _payload_length)
-                _step++;
-            break;
+    // Message header processing
+    //
+    // We sniff the class and message ID to decide whether we
+    // are going to gather the message bytes or just discard
+    // them.
+    //
+    // We always collect the length so that we can avoid being
+    // fooled by preamble bytes in messages.
+    //
+    case 2:
+        _step++;
+        _class = data;
+        _ck_b = _ck_a = data;                       // reset the checksum accumulators
+        break;
+    case 3:
+        _step++;
+        _ck_b += (_ck_a += data);                   // checksum byte
+        _msg_id = data;
+        break;
+    case 4:
+        _step++;
+        _ck_b += (_ck_a += data);                   // checksum byte
+        _payload_length = data;                     // payload length low byte
+        break;
+    case 5:
+        _step++;
+        _ck_b += (_ck_a += data);                   // checksum byte
+
+        _payload_length += (uint16_t)(data<<8);
+        if (_payload_length > sizeof(_buffer)) {
+            Debug("large payload %u", (unsigned)_payload_length);
+            // assume any payload bigger then what we know about is noise
+            _payload_length = 0;
+            _step = 0;
+            goto reset;
+        }
+        _payload_counter = 0;                       // prepare to receive payload
+        if (_payload_length == 0) {
+            // bypass payload and go straight to checksum
+            _step++;
+        }
+        break;
 
-        // Checksum and message processing
-        //
-        case 7:
+    // Receive message data
+    //
+    case 6:
+        _ck_b += (_ck_a += data);                   // checksum byte
+        if (_payload_counter < sizeof(_buffer)) {
+            _buffer[_payload_counter] = data;
+        }
+        if (++_payload_counter == _payload_length)
             _step++;
-            if (_ck_a != data) {
-                Debug("bad cka %x should be %x", data, _ck_a);
-                _step = 0;
-				goto reset;
-            }
-            break;
-        case 8:
+        break;
+
+    // Checksum and message processing
+    //
+    case 7:
+        _step++;
+        if (_ck_a != data) {
+            Debug("bad cka %x should be %x", data, _ck_a);
             _step = 0;
-            if (_ck_b != data) {
-                Debug("bad ckb %x should be %x", data, _ck_b);
-                break;                                                  // bad checksum
-            }
+            goto reset;
+        }
+        break;
+    case 8:
+        _step = 0;
+        if (_ck_b != data) {
+            Debug("bad ckb %x should be %x", data, _ck_b);
+            break;                                                  // bad checksum
+        }
 
-            if (_parse_gps()) {
-                parsed = true;
-            }
-            break;
+        if (_parse_gps()) {
+            parsed = true;
         }
+        break;
     }
     return parsed;
 }
@@ -51,6 +51,9 @@
 
 #define UBLOX_MAX_PORTS 6
 
+// bytes taken from the UART at a time
+#define UBLOX_READ_BLOCK 64
+
 #define RATE_POSLLH 1
 #define RATE_STATUS 1
 #define RATE_SOL 1
@@ -97,6 +100,8 @@
 
 class AP_GPS_UBLOX : public AP_GPS_Backend
 {
+    friend class GPS_ParseBench;
+
 public:
 	AP_GPS_UBLOX(AP_GPS &_gps, AP_GPS::GPS_State &_state, AP_HAL::UARTDriver *_port);
 
@@ -574,6 +579,8 @@ private:
 
     // Buffer parse & GPS state update
     bool        _parse_gps();
+    bool        _parse_buffer(const uint8_t *buf, uint16_t len);
+    bool        _parse_byte(uint8_t data);
 
     // used to update fix between status and position packets
     AP_GPS::GPS_Status next_fix;
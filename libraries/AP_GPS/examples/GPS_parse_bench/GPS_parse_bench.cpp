@@ -0,0 +1,283 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  benchmark of the UBX and NMEA parsers, feeding a capture through a
+  memory UART. "byte" is the per-byte read() and parse loop the
+  drivers used before block reads, "block" is the driver's read(). On
+  SITL a capture is loaded from gps_capture.ubx and gps_capture.nmea
+  if present, otherwise a synthetic stream is used
+ */
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_GPS/AP_GPS.h>
+#include <AP_GPS/AP_GPS_UBLOX.h>
+#include <AP_GPS/AP_GPS_NMEA.h>
+#include <GCS_MAVLink/GCS_Dummy.h>
+#include <AP_BoardConfig/AP_BoardConfig.h>
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#include <stdio.h>
+#endif
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+#include <time.h>
+#endif
+
+void setup();
+void loop();
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+static AP_BoardConfig board_config;
+
+// create fake gcs object
+GCS_Dummy _gcs;
+
+const AP_Param::GroupInfo GCS_MAVLINK_Parameters::var_info[] = {
+        AP_GROUPEND
+};
+
+static AP_GPS gps;
+
+#define CAPTURE_MAX 16384
+
+/*
+  a UART that replays a capture in a loop, presenting at most
+  rx_space bytes at a time like a driver ring buffer
+ */
+class CaptureUART : public AP_HAL::UARTDriver {
+public:
+    void begin(uint32_t baud) override {}
+    void begin(uint32_t baud, uint16_t rxSpace, uint16_t txSpace) override {}
+    void end() override {}
+    void flush() override {}
+    bool is_initialized() override { return true; }
+    void set_blocking_writes(bool blocking) override {}
+    bool tx_pending() override { return false; }
+    uint32_t txspace() override { return 1024; }
+    size_t write(uint8_t c) override { return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { return size; }
+
+    uint32_t available() override { return rx_space; }
+
+    int16_t read() override {
+        if (rx_space == 0) {
+            return -1;
+        }
+        rx_space--;
+        total++;
+        const uint8_t c = data[ofs];
+        ofs = (ofs + 1) % len;
+        return c;
+    }
+
+    ssize_t read(uint8_t *buffer, uint16_t count) override {
+        count = MIN(uint32_t(count), rx_space);
+        for (uint16_t n = 0; n < count; ) {
+            const uint16_t chunk = MIN(uint32_t(count - n), len - ofs);
+            memcpy(&buffer[n], &data[ofs], chunk);
+            n += chunk;
+            ofs = (ofs + chunk) % len;
+        }
+        rx_space -= count;
+        total += count;
+        return count;
+    }
+
+    void refill(void) { rx_space = 512; }
+
+    uint8_t data[CAPTURE_MAX];
+    uint32_t len;
+    uint32_t ofs;
+    uint32_t rx_space;
+    uint32_t total;
+};
+
+static CaptureUART ubx_uart;
+static CaptureUART nmea_uart;
+
+static AP_GPS::GPS_State ubx_state;
+static AP_GPS::GPS_State nmea_state;
+
+static void ubx_append(CaptureUART &u, uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t plen)
+{
+    if (u.len + plen + 8 > sizeof(u.data)) {
+        return;
+    }
+    uint8_t *p = &u.data[u.len];
+    p[0] = 0xB5;
+    p[1] = 0x62;
+    p[2] = cls;
+    p[3] = id;
+    p[4] = plen & 0xFF;
+    p[5] = plen >> 8;
+    memcpy(&p[6], payload, plen);
+    uint8_t ck_a = 0, ck_b = 0;
+    for (uint16_t i = 2; i < plen + 6; i++) {
+        ck_b += (ck_a += p[i]);
+    }
+    p[plen+6] = ck_a;
+    p[plen+7] = ck_b;
+    u.len += plen + 8;
+}
+
+static void nmea_append(CaptureUART &u, const char *body)
+{
+    uint8_t cs = 0;
+    for (const char *c = body; *c; c++) {
+        cs ^= *c;
+    }
+    char s[100];
+    const int n = hal.util->snprintf(s, sizeof(s), "$%s*%02X\r\n", body, cs);
+    if (n > 0 && u.len + n <= sizeof(u.data)) {
+        memcpy(&u.data[u.len], s, n);
+        u.len += n;
+    }
+}
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+static bool load_capture(CaptureUART &u, const char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    if (f == nullptr) {
+        return false;
+    }
+    u.len = fread(u.data, 1, sizeof(u.data), f);
+    fclose(f);
+    return u.len > 0;
+}
+#endif
+
+static void make_captures(void)
+{
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+    const bool have_ubx = load_capture(ubx_uart, "gps_capture.ubx");
+    const bool have_nmea = load_capture(nmea_uart, "gps_capture.nmea");
+#else
+    const bool have_ubx = false;
+    const bool have_nmea = false;
+#endif
+    if (!have_ubx) {
+        // 10Hz NAV-PVT with a large RAWX-sized message the driver
+        // doesn't decode, as an RTK receiver would send
+        uint8_t pvt[92] {};
+        uint8_t raw[16 + 32*32];
+        for (uint16_t i = 0; i < sizeof(raw); i++) {
+            raw[i] = i * 7;
+        }
+        while (ubx_uart.len + sizeof(pvt) + sizeof(raw) + 16 < sizeof(ubx_uart.data)) {
+            ubx_append(ubx_uart, 0x01, 0x07, pvt, sizeof(pvt));
+            ubx_append(ubx_uart, 0x02, 0x13, raw, sizeof(raw));
+        }
+    }
+    if (!have_nmea) {
+        while (nmea_uart.len + 200 < sizeof(nmea_uart.data)) {
+            nmea_append(nmea_uart, "GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+            nmea_append(nmea_uart, "GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W");
+            nmea_append(nmea_uart, "GPVTG,054.7,T,034.4,M,005.5,N,010.2,K");
+        }
+    }
+    hal.console->printf("UBX capture %u bytes, NMEA capture %u bytes\n",
+                        (unsigned)ubx_uart.len, (unsigned)nmea_uart.len);
+}
+
+/*
+  wall clock time. AP_HAL::micros() is simulated time on SITL and
+  doesn't advance while the benchmark runs
+ */
+static uint64_t bench_time_ns(void)
+{
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return AP_HAL::micros64() * 1000ULL;
+#endif
+}
+
+#define BENCH_BYTES 2000000U
+
+/*
+  run the parsers over the capture, returning ns per byte
+ */
+class GPS_ParseBench {
+public:
+    // the UBX read() loop before block reads
+    static float ubx_byte(AP_GPS_UBLOX &ubx, CaptureUART &u) {
+        return run(u, [&]() {
+            const uint32_t numc = ubx.port->available();
+            for (uint32_t i = 0; i < numc; i++) {
+                ubx._parse_byte(ubx.port->read());
+            }
+        });
+    }
+
+    // the NMEA read() loop before block reads
+    static float nmea_byte(AP_GPS_NMEA &nmea, CaptureUART &u) {
+        return run(u, [&]() {
+            const uint32_t numc = nmea.port->available();
+            for (uint32_t i = 0; i < numc; i++) {
+                nmea._decode(nmea.port->read());
+            }
+        });
+    }
+
+    static float block(AP_GPS_Backend &backend, CaptureUART &u) {
+        return run(u, [&]() {
+            backend.read();
+        });
+    }
+
+private:
+    template <typename F>
+    static float run(CaptureUART &u, F read_fn) {
+        u.total = 0;
+        const uint64_t start_ns = bench_time_ns();
+        while (u.total < BENCH_BYTES) {
+            u.refill();
+            read_fn();
+        }
+        const uint64_t dt_ns = bench_time_ns() - start_ns;
+        return float(dt_ns) / u.total;
+    }
+};
+
+void setup()
+{
+    hal.console->printf("GPS parser benchmark\n");
+    board_config.init();
+
+    make_captures();
+
+    AP_GPS_UBLOX ubx(gps, ubx_state, &ubx_uart);
+    AP_GPS_NMEA nmea(gps, nmea_state, &nmea_uart);
+
+    for (uint8_t i = 0; i < 3; i++) {
+        const float ubx_byte = GPS_ParseBench::ubx_byte(ubx, ubx_uart);
+        const float ubx_block = GPS_ParseBench::block(ubx, ubx_uart);
+        const float nmea_byte = GPS_ParseBench::nmea_byte(nmea, nmea_uart);
+        const float nmea_block = GPS_ParseBench::block(nmea, nmea_uart);
+        hal.console->printf("UBX  byte %.1f ns/B block %.1f ns/B\n", (double)ubx_byte, (double)ubx_block);
+        hal.console->printf("NMEA byte %.1f ns/B block %.1f ns/B\n", (double)nmea_byte, (double)nmea_block);
+    }
+}
+
+void loop()
+{
+    hal.scheduler->delay(1000);
+}
+
+// Register above functions in HAL board level
+AP_HAL_MAIN();
@@ -178,6 +178,17 @@
 #define HAL_HAVE_GETTIME_SETTIME 0
 #endif
 
+// use double precision for positions relative to the EKF origin. Only
+// enabled where double is done in hardware; ChibiOS boards are built
+// for single precision FPUs where it would be emulated in software
+#ifndef HAL_WITH_POSTYPE_DOUBLE
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+#define HAL_WITH_POSTYPE_DOUBLE 1
+#else
+#define HAL_WITH_POSTYPE_DOUBLE 0
+#endif
+#endif
+
 // this is used as a general mechanism to make a 'small' build by
 // dropping little used features. We use this to allow us to keep
 // FMUv2 going for as long as possible
@@ -3,6 +3,18 @@
 #include <stdint.h>
 #include "AP_HAL_Namespace.h"
 
+/*
+  writes are held back until no writes have been made for
+  HAL_STORAGE_SETTLE_MS so that neighbouring writes can be coalesced,
+  but for no longer than HAL_STORAGE_MAX_STALE_MS
+ */
+#ifndef HAL_STORAGE_SETTLE_MS
+#define HAL_STORAGE_SETTLE_MS 20
+#endif
+#ifndef HAL_STORAGE_MAX_STALE_MS
+#define HAL_STORAGE_MAX_STALE_MS 500
+#endif
+
 class AP_HAL::Storage {
 public:
     virtual void init() = 0;
@@ -10,4 +22,11 @@ public:
     virtual void write_block(uint16_t dst, const void* src, size_t n) = 0;
     virtual void _timer_tick(void) {};
     virtual bool healthy(void) { return true; }
+
+    // request that held back writes are written out without waiting
+    // for them to settle. Returns true if there is nothing left to write
+    virtual bool flush(void) { return true; }
+
+    // number of writes made to the backing store
+    virtual uint32_t backend_writes(void) const { return 0; }
 };
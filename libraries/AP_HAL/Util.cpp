@@ -36,6 +36,7 @@ public:
     const size_t _size;
 
     uint32_t available() override { return 0; }
+    using AP_HAL::BetterStream::read;
     int16_t read() override { return -1; }
     uint32_t txspace() override { return 0; }
 };
@@ -43,6 +43,11 @@ public:
      * -1 if nothing available, uint8_t value otherwise. */
     virtual int16_t read() = 0;
 
+    /* read up to count bytes into buffer, returning the number of
+     * bytes read or -1 on error. The default reads a byte at a time;
+     * drivers with a receive buffer override it to copy in one go */
+    virtual ssize_t read(uint8_t *buffer, uint16_t count);
+
     /* NB txspace was traditionally a member of BetterStream in the
      * FastSerial library. As far as concerns go, it belongs with available() */
     virtual uint32_t txspace() = 0;
@@ -0,0 +1,199 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Periodic callback schedule for a shared bus.
+ *
+ * Every callback has a deadline on a common timeline: deadlines are
+ * multiples of the callback period from the time the first callback
+ * was added. A 1kHz baro and a 100Hz compass therefore come due on the
+ * same tick every 10ms rather than at unrelated phases, and the bus
+ * thread wakes once for both.
+ *
+ * When the thread wakes, every callback that is due runs in deadline
+ * order with the bus semaphore taken once for the whole burst, so the
+ * bus is not released and re-arbitrated between back to back
+ * transactions. Each callback runs at most once per burst so a slow
+ * callback can't keep the bus forever. A callback that could not be
+ * run before its next deadline skips the missed slots, which is
+ * counted as late. adjust() restarts a callback one period from now,
+ * off the common timeline.
+ *
+ * Perf counters per bus give the time the bus is held per burst
+ * (utilisation is this over the burst interval) and the number of
+ * missed deadlines. A per callback interval counter gives the jitter
+ * of each device.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <AP_HAL/AP_HAL.h>
+
+#include "BusSchedule.h"
+
+extern const AP_HAL::HAL &hal;
+
+// don't delay for less than 100usec, so one bus thread doesn't
+// completely dominate the CPU
+#define BUS_SCHEDULE_MIN_DELAY_US 100
+
+// delay for at most 50ms, to handle newly added callbacks
+#define BUS_SCHEDULE_MAX_DELAY_US 50000
+
+void BusSchedule::set_name(const char *_name)
+{
+    name = _name;
+    perf_busy = alloc_perf(AP_HAL::Util::PC_ELAPSED, "busy");
+    perf_late = alloc_perf(AP_HAL::Util::PC_COUNT, "late");
+}
+
+/*
+  allocate a perf counter named after the bus. The name is only kept
+  if the HAL supports perf counters
+ */
+AP_HAL::Util::perf_counter_t BusSchedule::alloc_perf(AP_HAL::Util::perf_counter_type t, const char *suffix)
+{
+    if (name == nullptr) {
+        return nullptr;
+    }
+    const size_t len = strlen(name) + strlen(suffix) + 2;
+    char *perf_name = (char *)malloc(len);
+    if (perf_name == nullptr) {
+        return nullptr;
+    }
+    snprintf(perf_name, len, "%s %s", name, suffix);
+    AP_HAL::Util::perf_counter_t ret = hal.util->perf_alloc(t, perf_name);
+    if (ret == nullptr) {
+        free(perf_name);
+    }
+    return ret;
+}
+
+/*
+  first deadline after now on the common timeline
+ */
+uint64_t BusSchedule::next_deadline(uint64_t now, uint32_t period_usec) const
+{
+    if (period_usec == 0) {
+        return now;
+    }
+    return epoch_usec + ((now - epoch_usec) / period_usec + 1) * period_usec;
+}
+
+AP_HAL::Device::PeriodicHandle BusSchedule::add(AP_HAL::Device::PeriodicCb cb, uint32_t period_usec, uint8_t address)
+{
+    callback_info *callback = new callback_info;
+    if (callback == nullptr) {
+        return nullptr;
+    }
+
+    const uint64_t now = AP_HAL::micros64();
+    if (callbacks == nullptr) {
+        epoch_usec = now;
+    }
+
+    callback->cb = cb;
+    callback->period_usec = period_usec;
+    callback->next_usec = next_deadline(now, period_usec);
+    callback->burst = burst;
+
+    // name the interval counter after the device, numbered in case
+    // a device has more than one callback
+    char suffix[12];
+    snprintf(suffix, sizeof(suffix), "0x%02x cb%u", (unsigned)address, (unsigned)num_callbacks++);
+    callback->perf_interval = alloc_perf(AP_HAL::Util::PC_INTERVAL, suffix);
+
+    // add to linked list of callbacks. The callback is complete
+    // before it is visible to the bus thread
+    callback->next = callbacks;
+    callbacks = callback;
+
+    return callback;
+}
+
+void BusSchedule::adjust(AP_HAL::Device::PeriodicHandle h, uint32_t period_usec)
+{
+    callback_info *callback = static_cast<callback_info *>(h);
+
+    callback->period_usec = period_usec;
+    callback->next_usec = AP_HAL::micros64() + period_usec;
+}
+
+uint32_t BusSchedule::run(AP_HAL::Semaphore &sem)
+{
+    uint64_t now = AP_HAL::micros64();
+    bool taken = false;
+
+    burst++;
+
+    while (true) {
+        // find the due callback with the earliest deadline
+        callback_info *due = nullptr;
+        for (callback_info *callback = callbacks; callback; callback = callback->next) {
+            if (callback->next_usec <= now &&
+                callback->burst != burst &&
+                (due == nullptr || callback->next_usec < due->next_usec)) {
+                due = callback;
+            }
+        }
+        if (due == nullptr) {
+            break;
+        }
+
+        if (!taken) {
+            if (!sem.take(HAL_SEMAPHORE_BLOCK_FOREVER)) {
+                break;
+            }
+            taken = true;
+            hal.util->perf_begin(perf_busy);
+        }
+
+        due->burst = burst;
+        due->next_usec += due->period_usec;
+        if (due->next_usec <= now) {
+            // we missed at least one deadline, skip to the next one
+            hal.util->perf_count(perf_late);
+            due->next_usec = next_deadline(now, due->period_usec);
+        }
+
+        hal.util->perf_count(due->perf_interval);
+        due->cb();
+
+        now = AP_HAL::micros64();
+    }
+
+    if (taken) {
+        hal.util->perf_end(perf_busy);
+        sem.give();
+    }
+
+    // work out when next run is needed
+    uint32_t delay = BUS_SCHEDULE_MAX_DELAY_US;
+    for (callback_info *callback = callbacks; callback; callback = callback->next) {
+        if (callback->next_usec <= now) {
+            delay = 0;
+            break;
+        }
+        if (callback->next_usec - now < delay) {
+            delay = callback->next_usec - now;
+        }
+    }
+
+    if (delay < BUS_SCHEDULE_MIN_DELAY_US) {
+        delay = BUS_SCHEDULE_MIN_DELAY_US;
+    }
+
+    return delay;
+}
@@ -0,0 +1,77 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include <AP_HAL/Device.h>
+#include <AP_HAL/Semaphores.h>
+#include <AP_HAL/Util.h>
+
+/*
+ * Schedule of the periodic callbacks of all devices on one bus, run
+ * from the bus thread.
+ */
+class BusSchedule {
+public:
+    /*
+     * Set the bus name used for perf counters, e.g. "I2C:1". The
+     * string must remain valid
+     */
+    void set_name(const char *name);
+
+    /*
+     * Add a callback for the device at address on this bus. Its
+     * deadlines are aligned to the schedule so that callbacks with
+     * related periods fall due together
+     */
+    AP_HAL::Device::PeriodicHandle add(AP_HAL::Device::PeriodicCb cb, uint32_t period_usec, uint8_t address);
+
+    /*
+     * Change the period of a callback. The next call is one period
+     * from now rather than on the common timeline, as drivers use
+     * this to wait for a conversion to complete. Must be called from
+     * the bus thread
+     */
+    void adjust(AP_HAL::Device::PeriodicHandle h, uint32_t period_usec);
+
+    /*
+     * Run all callbacks that are due in deadline order, taking the
+     * bus semaphore once for the whole burst. Returns the time in
+     * microseconds the bus thread should sleep for
+     */
+    uint32_t run(AP_HAL::Semaphore &sem);
+
+private:
+    struct callback_info {
+        struct callback_info *next;
+        AP_HAL::Device::PeriodicCb cb;
+        uint32_t period_usec;
+        uint64_t next_usec;
+        uint32_t burst;
+        AP_HAL::Util::perf_counter_t perf_interval;
+    } *callbacks;
+
+    const char *name;
+    uint64_t epoch_usec;
+    uint32_t burst;
+    uint8_t num_callbacks;
+
+    AP_HAL::Util::perf_counter_t perf_busy;
+    AP_HAL::Util::perf_counter_t perf_late;
+
+    uint64_t next_deadline(uint64_t now, uint32_t period_usec) const;
+    AP_HAL::Util::perf_counter_t alloc_perf(AP_HAL::Util::perf_counter_type t, const char *suffix);
+};
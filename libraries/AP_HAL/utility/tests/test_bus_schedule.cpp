@@ -0,0 +1,218 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <AP_gtest.h>
+
+#include <algorithm>
+#include <string>
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_HAL/utility/BusSchedule.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+// semaphore that counts how often the bus is taken
+class CountingSemaphore : public AP_HAL::Semaphore {
+public:
+    bool take(uint32_t timeout_ms) override {
+        takes++;
+        return true;
+    }
+    bool take_nonblocking() override {
+        takes++;
+        return true;
+    }
+    bool give() override {
+        return true;
+    }
+    uint32_t takes;
+};
+
+class BusScheduleTest : public ::testing::Test {
+protected:
+    static const uint64_t start_usec = 1000000;
+
+    BusSchedule schedule;
+    CountingSemaphore sem;
+    char order[8];
+    uint8_t calls;
+    uint32_t sleep_usec;
+
+    void SetUp() override {
+        set_time(0);
+    }
+
+    void TearDown() override {
+        // let the clock run again for other tests
+        hal.scheduler->stop_clock(0);
+    }
+
+    // time in microseconds since the start of the test
+    void set_time(uint64_t t) {
+        hal.scheduler->stop_clock(start_usec + t);
+    }
+
+    void record(char c) {
+        if (calls < sizeof(order)) {
+            order[calls] = c;
+        }
+        calls++;
+    }
+    void cb_a() { record('a'); }
+    void cb_b() { record('b'); }
+    void cb_c() { record('c'); }
+
+    // a callback that takes 1.5ms of bus time
+    void cb_slow() {
+        record('s');
+        hal.scheduler->stop_clock(AP_HAL::micros64() + 1500);
+    }
+
+    // add one of the callbacks above by name
+    AP_HAL::Device::PeriodicHandle add(char name, uint32_t period_usec) {
+        AP_HAL::Device::PeriodicCb cb;
+        switch (name) {
+        case 'a':
+            cb = FUNCTOR_BIND_MEMBER(&BusScheduleTest::cb_a, void);
+            break;
+        case 'b':
+            cb = FUNCTOR_BIND_MEMBER(&BusScheduleTest::cb_b, void);
+            break;
+        case 'c':
+            cb = FUNCTOR_BIND_MEMBER(&BusScheduleTest::cb_c, void);
+            break;
+        default:
+            cb = FUNCTOR_BIND_MEMBER(&BusScheduleTest::cb_slow, void);
+            break;
+        }
+        return schedule.add(cb, period_usec, 0x10);
+    }
+
+    // run a burst, returning the callbacks that ran in order
+    std::string run() {
+        calls = 0;
+        sleep_usec = schedule.run(sem);
+        return std::string(order, std::min(calls, uint8_t(sizeof(order))));
+    }
+
+    // run a burst, returning the callbacks that ran in any order
+    std::string run_sorted() {
+        std::string ran = run();
+        std::sort(ran.begin(), ran.end());
+        return ran;
+    }
+};
+
+/*
+  due callbacks run in deadline order with the bus taken once
+ */
+TEST_F(BusScheduleTest, DeadlineOrder)
+{
+    add('b', 2000);
+    add('a', 1000);
+    add('c', 500);
+
+    set_time(400);
+    EXPECT_EQ("", run());
+    EXPECT_EQ(0U, sem.takes);
+    EXPECT_EQ(100U, sleep_usec);
+
+    // deadlines are 500 for c, 1000 for a and 2000 for b
+    set_time(2000);
+    EXPECT_EQ("cab", run());
+    EXPECT_EQ(1U, sem.takes);
+}
+
+/*
+  callbacks with related periods come due on the same tick
+ */
+TEST_F(BusScheduleTest, AlignedDeadlines)
+{
+    add('a', 1000);
+    set_time(300);
+    add('b', 10000);
+
+    for (uint32_t t=1000; t<10000; t+=1000) {
+        set_time(t);
+        EXPECT_EQ("a", run()) << t;
+    }
+    set_time(10000);
+    EXPECT_EQ("ab", run_sorted());
+    EXPECT_EQ(10U, sem.takes);
+}
+
+/*
+  a callback that missed deadlines runs once and skips to the next
+  slot on the timeline
+ */
+TEST_F(BusScheduleTest, LateSkip)
+{
+    add('a', 1000);
+
+    set_time(4500);
+    EXPECT_EQ("a", run());
+    EXPECT_EQ(500U, sleep_usec);
+
+    // nothing more until the next slot
+    EXPECT_EQ("", run());
+    set_time(5000);
+    EXPECT_EQ("a", run());
+    EXPECT_EQ(1000U, sleep_usec);
+}
+
+/*
+  a callback still due after it ran waits for the next burst, so a
+  slow device can't hold the bus
+ */
+TEST_F(BusScheduleTest, OncePerBurst)
+{
+    add('a', 1000);
+    add('s', 1000);
+
+    // the slow callback is due again at 2000 by the time the burst
+    // ends at 2500, but doesn't run twice
+    set_time(1000);
+    EXPECT_EQ("as", run_sorted());
+    EXPECT_EQ(1U, sem.takes);
+
+    // so the bus thread comes straight back for it, after the
+    // minimum sleep. It runs before a, which is due at 3000
+    EXPECT_EQ(100U, sleep_usec);
+    EXPECT_EQ("sa", run());
+    EXPECT_EQ(2U, sem.takes);
+}
+
+/*
+  adjust() runs the callback one period from now, not on the timeline
+ */
+TEST_F(BusScheduleTest, AdjustFromNow)
+{
+    AP_HAL::Device::PeriodicHandle h = add('a', 1000);
+
+    set_time(1234);
+    schedule.adjust(h, 5000);
+    EXPECT_EQ("", run());
+    EXPECT_EQ(5000U, sleep_usec);
+
+    set_time(6233);
+    EXPECT_EQ("", run());
+    set_time(6234);
+    EXPECT_EQ("a", run());
+
+    // and keeps that phase
+    set_time(11234);
+    EXPECT_EQ("a", run());
+}
+
+AP_GTEST_MAIN()
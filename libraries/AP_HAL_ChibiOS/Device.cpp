@@ -48,47 +48,9 @@ void DeviceBus::bus_thread(void *arg)
     struct DeviceBus *binfo = (struct DeviceBus *)arg;
 
     while (true) {
-        uint64_t now = AP_HAL::micros64();
-        DeviceBus::callback_info *callback;
-
-        // find a callback to run
-        for (callback = binfo->callbacks; callback; callback = callback->next) {
-            if (now >= callback->next_usec) {
-                while (now >= callback->next_usec) {
-                    callback->next_usec += callback->period_usec;
-                }
-                // call it with semaphore held
-                if (binfo->semaphore.take(HAL_SEMAPHORE_BLOCK_FOREVER)) {
-                    callback->cb();
-                    binfo->semaphore.give();
-                }
-            }
-        }
-
-        // work out when next loop is needed
-        uint64_t next_needed = 0;
-        now = AP_HAL::micros64();
-
-        for (callback = binfo->callbacks; callback; callback = callback->next) {
-            if (next_needed == 0 ||
-                callback->next_usec < next_needed) {
-                next_needed = callback->next_usec;
-                if (next_needed < now) {
-                    next_needed = now;
-                }
-            }
-        }
-
-        // delay for at most 50ms, to handle newly added callbacks
-        uint32_t delay = 50000;
-        if (next_needed >= now && next_needed - now < delay) {
-            delay = next_needed - now;
-        }
-        // don't delay for less than 100usec, so one thread doesn't
-        // completely dominate the CPU
-        if (delay < 100) {
-            delay = 100;
-        }
+        // run the callbacks that are due, and sleep until the next
+        // deadline
+        const uint32_t delay = binfo->schedule.run(binfo->semaphore);
         hal.scheduler->delay_microseconds(delay);
     }
     return;
@@ -126,20 +88,10 @@ AP_HAL::Device::PeriodicHandle DeviceBus::register_periodic_callback(uint32_t pe
         if (thread_ctx == nullptr) {
             AP_HAL::panic("Failed to create bus thread %s", name);
         }
+        schedule.set_name(name);
     }
-    DeviceBus::callback_info *callback = new DeviceBus::callback_info;
-    if (callback == nullptr) {
-        return nullptr;
-    }
-    callback->cb = cb;
-    callback->period_usec = period_usec;
-    callback->next_usec = AP_HAL::micros64() + period_usec;
 
-    // add to linked list of callbacks on thread
-    callback->next = callbacks;
-    callbacks = callback;
-
-    return callback;
+    return schedule.add(cb, period_usec, _hal_device->get_bus_address());
 }
 #endif // CH_CFG_USE_HEAP
 
@@ -153,10 +105,7 @@ bool DeviceBus::adjust_timer(AP_HAL::Device::PeriodicHandle h, uint32_t period_u
         return false;
     }
 
-    DeviceBus::callback_info *callback = static_cast<DeviceBus::callback_info *>(h);
-
-    callback->period_usec = period_usec;
-    callback->next_usec = AP_HAL::micros64() + period_usec;
+    schedule.adjust(h, period_usec);
 
     return true;
 }
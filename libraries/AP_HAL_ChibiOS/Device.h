@@ -16,6 +16,7 @@
 
 #include <inttypes.h>
 #include <AP_HAL/HAL.h>
+#include <AP_HAL/utility/BusSchedule.h>
 #include "Semaphores.h"
 #include "AP_HAL_ChibiOS.h"
 
@@ -44,12 +45,7 @@ public:
     void bouncebuffer_finish(const uint8_t *buf_tx, uint8_t *buf_rx, uint16_t rx_len);
     
 private:
-    struct callback_info {
-        struct callback_info *next;
-        AP_HAL::Device::PeriodicCb cb;
-        uint32_t period_usec;
-        uint64_t next_usec;
-    } *callbacks;
+    BusSchedule schedule;
     uint8_t thread_priority;
     thread_t* thread_ctx;
     bool thread_started;
@@ -156,21 +156,41 @@ void Storage::write_block(uint16_t loc, const void *src, size_t n)
         _storage_open();
         memcpy(&_buffer[loc], src, n);
         _mark_dirty(loc, n);
+        _last_write_ms = AP_HAL::millis();
     }
 }
 
+bool Storage::flush(void)
+{
+    _flush_requested = true;
+    return _dirty_mask.empty() && !_write_in_flight;
+}
+
 void Storage::_timer_tick(void)
 {
     if (!_initialised) {
         return;
     }
+    const uint32_t now_ms = AP_HAL::millis();
     if (_dirty_mask.empty()) {
-        _last_empty_ms = AP_HAL::millis();
+        _last_empty_ms = now_ms;
+        _flush_requested = false;
+#ifdef STORAGE_FLASH_PAGE
+        // use idle ticks to copy live data out of a full flash sector
+        _flash.compact();
+#endif
+        return;
+    }
+
+    // hold back while writes are still arriving so they can be coalesced
+    if (!_flush_requested &&
+        now_ms - _last_write_ms < HAL_STORAGE_SETTLE_MS &&
+        now_ms - _last_empty_ms < HAL_STORAGE_MAX_STALE_MS) {
         return;
     }
 
-    // write out the first dirty line. We don't write more
-    // than one to keep the latency of this call to a minimum
+    // write out the first run of dirty lines. We don't write more
+    // than one run to keep the latency of this call to a minimum
     uint16_t i;
     for (i=0; i<CH_STORAGE_NUM_LINES; i++) {
         if (_dirty_mask.get(i)) {
@@ -181,36 +201,58 @@ void Storage::_timer_tick(void)
         // this shouldn't be possible
         return;
     }
+    uint16_t nlines = 1;
+    while (nlines < CH_STORAGE_MAX_WRITE_LINES && i+nlines < CH_STORAGE_NUM_LINES && _dirty_mask.get(i+nlines)) {
+        nlines++;
+    }
+
+    // mark the lines clean before writing, so a write_block() racing
+    // with us marks them dirty again rather than being lost. Until
+    // the write completes flush() must not report the data as saved
+    _write_in_flight = true;
+    for (uint16_t j=0; j<nlines; j++) {
+        _dirty_mask.clear(i+j);
+    }
+
+    const bool ok = _write_lines(CH_STORAGE_LINE_SIZE*i, CH_STORAGE_LINE_SIZE*nlines);
+    if (ok) {
+        _backend_writes++;
+    } else {
+        for (uint16_t j=0; j<nlines; j++) {
+            _dirty_mask.set(i+j);
+        }
+    }
+    _write_in_flight = false;
+}
 
+/*
+  write a range of the buffer to the storage backend
+ */
+bool Storage::_write_lines(uint32_t offset, uint32_t length)
+{
 #if HAL_WITH_RAMTRON
     if (using_fram) {
-        if (fram.write(CH_STORAGE_LINE_SIZE*i, &_buffer[CH_STORAGE_LINE_SIZE*i], CH_STORAGE_LINE_SIZE)) {
-            _dirty_mask.clear(i);
-        }
-        return;
+        return fram.write(offset, &_buffer[offset], length);
     } 
 #endif
 
 #ifdef USE_POSIX
     if (using_filesystem && log_fd != -1) {
-        uint32_t offset = CH_STORAGE_LINE_SIZE*i;
-        if (AP::FS().lseek(log_fd, offset, SEEK_SET) != offset) {
-            return;
+        if (AP::FS().lseek(log_fd, offset, SEEK_SET) != (off_t)offset) {
+            return false;
         }
-        if (AP::FS().write(log_fd, &_buffer[offset], CH_STORAGE_LINE_SIZE) != CH_STORAGE_LINE_SIZE) {
-            return;
+        if (AP::FS().write(log_fd, &_buffer[offset], length) != (ssize_t)length) {
+            return false;
         }
-        if (AP::FS().fsync(log_fd) != 0) {
-            return;
-        }
-        _dirty_mask.clear(i);
-        return;
+        return AP::FS().fsync(log_fd) == 0;
     } 
 #endif
     
 #ifdef STORAGE_FLASH_PAGE
     // save to storage backend
-    _flash_write(i);
+    return _flash_write(offset >> CH_STORAGE_LINE_SHIFT, length >> CH_STORAGE_LINE_SHIFT);
+#else
+    return false;
 #endif
 }
 
@@ -233,15 +275,14 @@ void Storage::_flash_load(void)
 }
 
 /*
-  write one storage line. This also updates _dirty_mask. 
+  write a run of storage lines
 */
-void Storage::_flash_write(uint16_t line)
+bool Storage::_flash_write(uint16_t line, uint16_t nlines)
 {
 #ifdef STORAGE_FLASH_PAGE
-    if (_flash.write(line*CH_STORAGE_LINE_SIZE, CH_STORAGE_LINE_SIZE)) {
-        // mark the line clean
-        _dirty_mask.clear(line);
-    }
+    return _flash.write(line*CH_STORAGE_LINE_SIZE, nlines*CH_STORAGE_LINE_SIZE);
+#else
+    return false;
 #endif
 }
 
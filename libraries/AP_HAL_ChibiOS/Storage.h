@@ -34,6 +34,10 @@
 #define CH_STORAGE_LINE_SIZE (1<<CH_STORAGE_LINE_SHIFT)
 #define CH_STORAGE_NUM_LINES (CH_STORAGE_SIZE/CH_STORAGE_LINE_SIZE)
 
+// maximum number of adjacent dirty lines written out together. 64
+// bytes matches the largest single write AP_FlashStorage makes
+#define CH_STORAGE_MAX_WRITE_LINES 8
+
 class ChibiOS::Storage : public AP_HAL::Storage {
 public:
     void init() override {}
@@ -42,6 +46,8 @@ public:
 
     void _timer_tick(void) override;
     bool healthy(void) override;
+    bool flush(void) override;
+    uint32_t backend_writes(void) const override { return _backend_writes; }
 
 private:
     volatile bool _initialised;
@@ -49,6 +55,7 @@ private:
     void _storage_open(void);
     void _save_backup(void);
     void _mark_dirty(uint16_t loc, uint16_t length);
+    bool _write_lines(uint32_t offset, uint32_t length);
     uint8_t _buffer[CH_STORAGE_SIZE] __attribute__((aligned(4)));
     Bitmask<CH_STORAGE_NUM_LINES> _dirty_mask;
 
@@ -60,6 +67,11 @@ private:
     bool _flash_failed;
     uint32_t _last_re_init_ms;
     uint32_t _last_empty_ms;
+    volatile uint32_t _last_write_ms;
+    volatile bool _flush_requested;
+    // lines have been marked clean but are still being written out
+    volatile bool _write_in_flight;
+    uint32_t _backend_writes;
 
 #ifdef STORAGE_FLASH_PAGE
     AP_FlashStorage _flash{_buffer,
@@ -71,7 +83,7 @@ private:
 #endif
     
     void _flash_load(void);
-    void _flash_write(uint16_t line);
+    bool _flash_write(uint16_t line, uint16_t nlines);
 
 #if HAL_WITH_RAMTRON
     AP_RAMTRON fram;
@@ -43,9 +43,9 @@
 #include <vector>
 
 #include <AP_HAL/AP_HAL.h>
+#include <AP_HAL/utility/BusSchedule.h>
 #include <AP_Math/AP_Math.h>
 
-#include "PollerThread.h"
 #include "Scheduler.h"
 #include "Semaphores.h"
 #include "Thread.h"
@@ -75,25 +75,39 @@ static inline char *startswith(const char *s, const char *prefix)
     return nullptr;
 }
 
+class I2CBus;
+
+/* Thread running the periodic callbacks of all devices on a bus */
+class I2CBusThread : public Thread {
+public:
+    I2CBusThread(I2CBus &bus)
+        : Thread{FUNCTOR_BIND_MEMBER(&I2CBusThread::mainloop, void)}
+        , _bus(bus)
+    {
+    }
+
+    bool stop() override;
+
+protected:
+    void mainloop();
+
+    I2CBus &_bus;
+};
+
 /* Private struct to maintain for each bus */
-class I2CBus : public TimerPollable::WrapperCb {
+class I2CBus {
 public:
     ~I2CBus();
 
-    /*
-     * TimerPollable::WrapperCb methods to take
-     * and release semaphore while calling the callback
-     */
-    void start_cb() override;
-    void end_cb() override;
-
     int open(uint8_t n);
 
-    PollerThread thread;
+    I2CBusThread thread{*this};
+    BusSchedule schedule;
     Semaphore sem;
     int fd = -1;
     uint8_t bus;
     uint8_t ref;
+    char name[16];
 };
 
 I2CBus::~I2CBus()
@@ -103,14 +117,26 @@ I2CBus::~I2CBus()
     }
 }
 
-void I2CBus::start_cb()
+void I2CBusThread::mainloop()
 {
-    sem.take(HAL_SEMAPHORE_BLOCK_FOREVER);
+    while (!_should_exit) {
+        uint32_t delay = _bus.schedule.run(_bus.sem);
+        hal.scheduler->delay_microseconds(delay);
+    }
+
+    _started = false;
+    _should_exit = false;
 }
 
-void I2CBus::end_cb()
+bool I2CBusThread::stop()
 {
-    sem.give();
+    if (!is_started()) {
+        return false;
+    }
+
+    _should_exit = true;
+
+    return true;
 }
 
 int I2CBus::open(uint8_t n)
@@ -253,27 +279,39 @@ AP_HAL::Semaphore *I2CDevice::get_semaphore()
 AP_HAL::Device::PeriodicHandle I2CDevice::register_periodic_callback(
     uint32_t period_usec, AP_HAL::Device::PeriodicCb cb)
 {
-    TimerPollable *p = _bus.thread.add_timer(cb, &_bus, period_usec);
-    if (!p) {
+    if (!_bus.thread.is_started()) {
+        snprintf(_bus.name, sizeof(_bus.name), "ap-i2c-%u", _bus.bus);
+        _bus.schedule.set_name(_bus.name);
+    }
+
+    AP_HAL::Device::PeriodicHandle h = _bus.schedule.add(cb, period_usec, _address);
+    if (!h) {
         AP_HAL::panic("Could not create periodic callback");
     }
 
     if (!_bus.thread.is_started()) {
-        char name[16];
-        snprintf(name, sizeof(name), "ap-i2c-%u", _bus.bus);
-
         _bus.thread.set_stack_size(AP_LINUX_SENSORS_STACK_SIZE);
-        _bus.thread.start(name, AP_LINUX_SENSORS_SCHED_POLICY,
+        _bus.thread.start(_bus.name, AP_LINUX_SENSORS_SCHED_POLICY,
                           AP_LINUX_SENSORS_SCHED_PRIO);
     }
 
-    return static_cast<AP_HAL::Device::PeriodicHandle>(p);
+    return h;
 }
 
+/*
+ * Adjust the timer for the next call: it needs to be called from the bus
+ * thread, otherwise it will race with it
+ */
 bool I2CDevice::adjust_periodic_callback(
     AP_HAL::Device::PeriodicHandle h, uint32_t period_usec)
 {
-    return _bus.thread.adjust_timer(static_cast<TimerPollable*>(h), period_usec);
+    if (!_bus.thread.is_current_thread()) {
+        return false;
+    }
+
+    _bus.schedule.adjust(h, period_usec);
+
+    return true;
 }
 
 I2CDeviceManager::I2CDeviceManager()
@@ -6,6 +6,9 @@
 #include <errno.h>
 #include <signal.h>
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "AP_HAL_SITL.h"
 #include "AP_HAL_SITL_Namespace.h"
@@ -122,6 +125,129 @@ static void sig_alrm(int signum)
     execv(new_argv[0], new_argv);
 }
 
+/*
+  snapshot and restore of the whole simulation.
+
+  SIGUSR1 forks the running vehicle. The child is parked holding the
+  complete state of the simulation - the autopilot RAM, storage,
+  simulator model and HAL clock - and its pid is written to
+  snapshot-PORT.pid, where PORT is the instance's base port.
+
+  Sending SIGUSR2 to the parked process forks a copy which resumes
+  from the snapshot, while the snapshot stays parked so it can be
+  restored any number of times. The copy shares the sockets and files
+  of the original vehicle, so the running vehicle should be stopped
+  first:
+
+    kill -USR1 $SITL_PID                      # take snapshot
+    kill $SITL_PID; kill -USR2 $(cat snapshot-5760.pid)   # restore
+
+  Only the calling thread survives fork(), so a snapshot is refused
+  while any thread_create() thread is running. The filesystem queue,
+  compass calibration fits and MAVLink proximity ingest run on the
+  main thread in SITL for this reason, leaving only optional features
+  such as scripting and object avoidance to block a snapshot.
+ */
+static volatile sig_atomic_t snapshot_requested;
+static volatile sig_atomic_t restore_requested;
+
+// the snapshot this process owns: either a parked child it forked, or
+// the parked parent it was restored from
+static pid_t snapshot_pid;
+
+static void sig_usr1(int signum)
+{
+    snapshot_requested = 1;
+}
+
+static void sig_usr2(int signum)
+{
+    restore_requested = 1;
+}
+
+/*
+  return true if pid is still the snapshot this process owns, so it
+  is safe to signal
+ */
+static bool snapshot_owned(pid_t pid)
+{
+    if (pid <= 0) {
+        return false;
+    }
+    if (pid == getppid()) {
+        // we were restored from it and it is still parked
+        return true;
+    }
+    // a parked child which has not exited. This fails with ECHILD for
+    // any process which is not our child
+    return waitpid(pid, nullptr, WNOHANG) == 0;
+}
+
+static void snapshot_take(uint16_t base_port)
+{
+    snapshot_requested = 0;
+
+    if (Scheduler::have_threads()) {
+        // only the calling thread survives fork()
+        printf("SITL snapshot: not supported with threads running\n");
+        return;
+    }
+
+    // only one snapshot is kept
+    if (snapshot_owned(snapshot_pid)) {
+        kill(snapshot_pid, SIGTERM);
+        if (snapshot_pid != getppid()) {
+            waitpid(snapshot_pid, nullptr, 0);
+        }
+    }
+    snapshot_pid = 0;
+
+    char pid_file[32];
+    snprintf(pid_file, sizeof(pid_file), "snapshot-%u.pid", (unsigned)base_port);
+
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid == -1) {
+        printf("SITL snapshot: fork failed: %s\n", strerror(errno));
+        return;
+    }
+    if (pid != 0) {
+        snapshot_pid = pid;
+        printf("SITL snapshot: taken as pid %d at %.3fs\n", (int)pid, AP_HAL::micros64()*1.0e-6);
+        return;
+    }
+
+    // this is the snapshot. Write our pid and park until asked to
+    // restore, leaving the vehicle to carry on
+    alarm(0);
+    signal(SIGCHLD, SIG_IGN);
+    FILE *f = fopen(pid_file, "w");
+    if (f != nullptr) {
+        fprintf(f, "%d\n", (int)getpid());
+        fclose(f);
+    }
+    while (true) {
+        while (!restore_requested) {
+            pause();
+        }
+        restore_requested = 0;
+        fflush(stdout);
+        const pid_t restored = fork();
+        if (restored == 0) {
+            break;
+        }
+        if (restored == -1) {
+            printf("SITL snapshot: restore failed: %s\n", strerror(errno));
+        }
+    }
+
+    // resume the vehicle from the snapshot
+    signal(SIGCHLD, SIG_DFL);
+    snapshot_pid = getppid();
+    sitlStorage.mark_all_dirty();
+    printf("SITL snapshot: restored as pid %d at %.3fs\n", (int)getpid(), AP_HAL::micros64()*1.0e-6);
+}
+
 void HAL_SITL::run(int argc, char * const argv[], Callbacks* callbacks) const
 {
     assert(callbacks);
@@ -176,10 +302,17 @@ void HAL_SITL::run(int argc, char * const argv[], Callbacks* callbacks) const
 
     uint32_t last_watchdog_save = AP_HAL::millis();
 
+    signal(SIGUSR1, sig_usr1);
+    signal(SIGUSR2, sig_usr2);
+
     while (!HALSITL::Scheduler::_should_reboot) {
         callbacks->loop();
         HALSITL::Scheduler::_run_io_procs();
 
+        if (snapshot_requested) {
+            snapshot_take(_sitl_state->base_port());
+        }
+
         uint32_t now = AP_HAL::millis();
         if (now - last_watchdog_save >= 100 && using_watchdog) {
             // save persistent data every 100ms
@@ -51,6 +51,9 @@ public:
     static void _run_io_procs();
     static bool _should_reboot;
 
+    // true if any threads have been created with thread_create()
+    static bool have_threads() { return threads != nullptr; }
+
     /*
       create a new thread
      */
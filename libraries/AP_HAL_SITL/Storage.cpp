@@ -60,6 +60,20 @@ void Storage::_storage_open(void)
     _initialised = true;
 }
 
+/*
+  mark every line dirty, so the backing file is brought back in line
+  with the RAM copy of storage
+ */
+void Storage::mark_all_dirty(void)
+{
+    if (!_initialised) {
+        return;
+    }
+    for (uint16_t line=0; line<STORAGE_NUM_LINES; line++) {
+        _dirty_mask.set(line);
+    }
+}
+
 /*
   mark some lines as dirty. Note that there is no attempt to avoid
   the race condition between this code and the _timer_tick() code
@@ -95,21 +109,41 @@ void Storage::write_block(uint16_t loc, const void *src, size_t n)
         _storage_open();
         memcpy(&_buffer[loc], src, n);
         _mark_dirty(loc, n);
+        _last_write_ms = AP_HAL::millis();
     }
 }
 
+bool Storage::flush(void)
+{
+    _flush_requested = true;
+    return _dirty_mask.empty() && !_write_in_flight;
+}
+
 void Storage::_timer_tick(void)
 {
     if (!_initialised) {
         return;
     }
+    const uint32_t now_ms = AP_HAL::millis();
     if (_dirty_mask.empty()) {
-        _last_empty_ms = AP_HAL::millis();
+        _last_empty_ms = now_ms;
+        _flush_requested = false;
+#if STORAGE_USE_FLASH
+        // use idle ticks to copy live data out of a full flash sector
+        _flash.compact();
+#endif
         return;
     }
 
-    // write out the first dirty line. We don't write more
-    // than one to keep the latency of this call to a minimum
+    // hold back while writes are still arriving so they can be coalesced
+    if (!_flush_requested &&
+        now_ms - _last_write_ms < HAL_STORAGE_SETTLE_MS &&
+        now_ms - _last_empty_ms < HAL_STORAGE_MAX_STALE_MS) {
+        return;
+    }
+
+    // write out the first run of dirty lines. We don't write more
+    // than one run to keep the latency of this call to a minimum
     uint16_t i;
     for (i=0; i<STORAGE_NUM_LINES; i++) {
         if (_dirty_mask.get(i)) {
@@ -120,25 +154,42 @@ void Storage::_timer_tick(void)
         // this shouldn't be possible
         return;
     }
+    uint16_t nlines = 1;
+    while (nlines < STORAGE_MAX_WRITE_LINES && i+nlines < STORAGE_NUM_LINES && _dirty_mask.get(i+nlines)) {
+        nlines++;
+    }
 
+    // mark the lines clean before writing, so a write_block() racing
+    // with us marks them dirty again rather than being lost. Until
+    // the write completes flush() must not report the data as saved
+    _write_in_flight = true;
+    for (uint16_t j=0; j<nlines; j++) {
+        _dirty_mask.clear(i+j);
+    }
+
+    bool ok = false;
 #if STORAGE_USE_POSIX
     if (using_filesystem && log_fd != -1) {
         const off_t offset = STORAGE_LINE_SIZE*i;
-        if (lseek(log_fd, offset, SEEK_SET) != offset) {
-            return;
-        }
-        if (write(log_fd, &_buffer[offset], STORAGE_LINE_SIZE) != STORAGE_LINE_SIZE) {
-            return;
-        }
-        _dirty_mask.clear(i);
-        return;
-    } 
+        const ssize_t length = STORAGE_LINE_SIZE*nlines;
+        ok = (lseek(log_fd, offset, SEEK_SET) == offset) &&
+             (write(log_fd, &_buffer[offset], length) == length);
+    }
 #endif
     
 #if STORAGE_USE_FLASH
     // save to storage backend
-    _flash_write(i);
+    ok = _flash_write(i, nlines);
 #endif
+
+    if (ok) {
+        _backend_writes++;
+    } else {
+        for (uint16_t j=0; j<nlines; j++) {
+            _dirty_mask.set(i+j);
+        }
+    }
+    _write_in_flight = false;
 }
 
 /*
@@ -156,15 +207,14 @@ void Storage::_flash_load(void)
 }
 
 /*
-  write one storage line. This also updates _dirty_mask. 
+  write a run of storage lines
 */
-void Storage::_flash_write(uint16_t line)
+bool Storage::_flash_write(uint16_t line, uint16_t nlines)
 {
 #if STORAGE_USE_FLASH
-    if (_flash.write(line*STORAGE_LINE_SIZE, STORAGE_LINE_SIZE)) {
-        // mark the line clean
-        _dirty_mask.clear(line);
-    }
+    return _flash.write(line*STORAGE_LINE_SIZE, nlines*STORAGE_LINE_SIZE);
+#else
+    return false;
 #endif
 }
 
@@ -22,6 +22,9 @@
 #define STORAGE_LINE_SIZE (1<<STORAGE_LINE_SHIFT)
 #define STORAGE_NUM_LINES (HAL_STORAGE_SIZE/STORAGE_LINE_SIZE)
 
+// maximum number of adjacent dirty lines written out together
+#define STORAGE_MAX_WRITE_LINES 8
+
 class HALSITL::Storage : public AP_HAL::Storage {
 public:
     void init() override {}
@@ -30,6 +33,12 @@ public:
 
     void _timer_tick(void) override;
     bool healthy(void) override;
+    bool flush(void) override;
+    uint32_t backend_writes(void) const override { return _backend_writes; }
+
+    // mark all of storage dirty so the backing file is rewritten
+    // from RAM, used when resuming from a snapshot
+    void mark_all_dirty(void);
 
 private:
     volatile bool _initialised;
@@ -50,6 +59,11 @@ private:
     bool _flash_failed;
     uint32_t _last_re_init_ms;
     uint32_t _last_empty_ms;
+    volatile uint32_t _last_write_ms;
+    volatile bool _flush_requested;
+    // lines have been marked clean but are still being written out
+    volatile bool _write_in_flight;
+    uint32_t _backend_writes;
 
 #if STORAGE_USE_FLASH
     AP_FlashStorage _flash{_buffer,
@@ -61,7 +75,7 @@ private:
 #endif
     
     void _flash_load(void);
-    void _flash_write(uint16_t line);
+    bool _flash_write(uint16_t line, uint16_t nlines);
 
 #if STORAGE_USE_POSIX
     bool using_filesystem;
@@ -93,9 +93,7 @@ void AP_IOMCU_FW::rcin_serial_update(void)
     if ((n = chnReadTimeout(&SD1, b, sizeof(b), TIME_IMMEDIATE)) > 0) {
         n = MIN(n, sizeof(b));
         rc_stats.num_dsm_bytes += n;
-        for (uint8_t i=0; i<n; i++) {
-            AP::RC().process_byte(b[i], 115200);
-        }
+        AP::RC().process_bytes(b, n, 115200);
         //BLUE_TOGGLE();
     }
 
@@ -108,9 +106,7 @@ void AP_IOMCU_FW::rcin_serial_update(void)
         } else {
             n = MIN(n, sizeof(b));
             rc_stats.num_sbus_bytes += n;
-            for (uint8_t i=0; i<n; i++) {
-                AP::RC().process_byte(b[i], 100000);
-            }
+            AP::RC().process_bytes(b, n, 100000);
         }
     }
 }
@@ -263,7 +263,10 @@ void AP_Logger::Write_Baro_instance(uint64_t time_us, uint8_t baro_instance, enu
         sample_time_ms: baro.get_last_update(baro_instance),
         drift_offset  : drift_offset,
         ground_temp   : ground_temp,
-        healthy       : (uint8_t)baro.healthy(baro_instance)
+        healthy       : (uint8_t)baro.healthy(baro_instance),
+        aligned_sample_ms : baro.sample_time_aligned(baro_instance) ? baro.get_last_sample_ms(baro_instance) : 0,
+        latency_us    : baro.get_sample_latency_usec(baro_instance),
+        jitter_us     : baro.get_sample_jitter_usec(baro_instance)
     };
     WriteBlock(&pkt, sizeof(pkt));
 }
@@ -731,6 +734,16 @@ void AP_Logger::Write_Compass_instance(const uint64_t time_us, const uint8_t mag
         SUS             : compass.last_update_usec(mag_instance)
     };
     WriteBlock(&pkt, sizeof(pkt));
+
+    const struct log_MagTiming pkt2{
+        LOG_PACKET_HEADER_INIT(LOG_MAG_TIMING_MSG),
+        time_us           : time_us,
+        instance          : mag_instance,
+        aligned_sample_us : compass.sample_time_aligned(mag_instance) ? compass.last_sample_usec(mag_instance) : 0,
+        latency_us        : compass.sample_latency_usec(mag_instance),
+        jitter_us         : compass.sample_jitter_usec(mag_instance)
+    };
+    WriteBlock(&pkt2, sizeof(pkt2));
 }
 
 // Write a Compass packet
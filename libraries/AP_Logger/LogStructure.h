@@ -386,6 +386,9 @@ struct PACKED log_BARO {
     float   drift_offset;
     float   ground_temp;
     uint8_t healthy;
+    uint32_t aligned_sample_ms;
+    uint32_t latency_us;
+    uint32_t jitter_us;
 };
 
 struct PACKED log_Optflow {
@@ -811,6 +814,16 @@ struct PACKED log_Compass {
     uint32_t SUS;
 };
 
+// the MAG labels are full, so sample timing goes in its own message
+struct PACKED log_MagTiming {
+    LOG_PACKET_HEADER;
+    uint64_t time_us;
+    uint8_t  instance;
+    uint32_t aligned_sample_us;
+    uint32_t latency_us;
+    uint32_t jitter_us;
+};
+
 struct PACKED log_Mode {
     LOG_PACKET_HEADER;
     uint64_t time_us;
@@ -1212,10 +1225,10 @@ struct PACKED log_Arm_Disarm {
 #define ACC_MULTS "FF000"
 
 // see "struct sensor" in AP_Baro.h and "Write_Baro":
-#define BARO_LABELS "TimeUS,Alt,Press,Temp,CRt,SMS,Offset,GndTemp,Health"
-#define BARO_FMT   "QffcfIffB"
-#define BARO_UNITS "smPOnsmO-"
-#define BARO_MULTS "F00B0C?0-"
+#define BARO_LABELS "TimeUS,Alt,Press,Temp,CRt,SMS,Offset,GndTemp,Health,SS,Dly,Jit"
+#define BARO_FMT   "QffcfIffBIII"
+#define BARO_UNITS "smPOnsmO-sss"
+#define BARO_MULTS "F00B0C?0-CFF"
 
 #define ESC_LABELS "TimeUS,RPM,Volt,Curr,Temp,CTot"
 #define ESC_FMT   "QeCCcH"
@@ -1515,6 +1528,8 @@ struct PACKED log_Arm_Disarm {
       "MAG2",MAG_FMT,    MAG_LABELS, MAG_UNITS, MAG_MULTS }, \
     { LOG_COMPASS3_MSG, sizeof(log_Compass), \
       "MAG3",MAG_FMT,    MAG_LABELS, MAG_UNITS, MAG_MULTS }, \
+    { LOG_MAG_TIMING_MSG, sizeof(log_MagTiming), \
+      "MAGT", "QBIII", "TimeUS,I,SS,Dly,Jit", "s#sss", "F-FFF" }, \
     { LOG_ACC1_MSG, sizeof(log_ACCEL), \
       "ACC1", ACC_FMT,        ACC_LABELS, ACC_UNITS, ACC_MULTS }, \
     { LOG_ACC2_MSG, sizeof(log_ACCEL), \
@@ -1770,6 +1785,7 @@ enum LogMessages : uint8_t {
     LOG_ARM_DISARM_MSG,
     LOG_OA_BENDYRULER_MSG,
     LOG_OA_DIJKSTRA_MSG,
+    LOG_MAG_TIMING_MSG,
 
     _LOG_LAST_MSG_
 };
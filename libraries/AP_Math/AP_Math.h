@@ -10,6 +10,7 @@
 
 #include "definitions.h"
 #include "crc.h"
+#include "fast_math.h"
 #include "matrix3.h"
 #include "polygon.h"
 #include "quaternion.h"
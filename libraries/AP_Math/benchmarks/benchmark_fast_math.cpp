@@ -0,0 +1,81 @@
+#include <AP_gbenchmark.h>
+
+#include <AP_Math/AP_Math.h>
+
+/*
+  compare the fast trig approximations against libm. The argument is
+  changed on each iteration so the result can't be hoisted
+ */
+
+static void BM_Sinf(benchmark::State& state)
+{
+    float x = 0.1f;
+    while (state.KeepRunning()) {
+        float s = sinf(x);
+        gbenchmark_escape(&s);
+        x += 0.37f;
+    }
+}
+
+static void BM_FastSinf(benchmark::State& state)
+{
+    float x = 0.1f;
+    while (state.KeepRunning()) {
+        float s = fast_sinf(x);
+        gbenchmark_escape(&s);
+        x += 0.37f;
+    }
+}
+
+static void BM_SinCosf(benchmark::State& state)
+{
+    float x = 0.1f;
+    while (state.KeepRunning()) {
+        float s = sinf(x);
+        float c = cosf(x);
+        gbenchmark_escape(&s);
+        gbenchmark_escape(&c);
+        x += 0.37f;
+    }
+}
+
+static void BM_FastSinCosf(benchmark::State& state)
+{
+    float x = 0.1f;
+    while (state.KeepRunning()) {
+        float s, c;
+        fast_sincosf(x, s, c);
+        gbenchmark_escape(&s);
+        gbenchmark_escape(&c);
+        x += 0.37f;
+    }
+}
+
+static void BM_Atan2f(benchmark::State& state)
+{
+    float y = -3.0f;
+    while (state.KeepRunning()) {
+        float a = atan2f(y, 1.3f);
+        gbenchmark_escape(&a);
+        y += 0.013f;
+    }
+}
+
+static void BM_FastAtan2f(benchmark::State& state)
+{
+    float y = -3.0f;
+    while (state.KeepRunning()) {
+        float a = fast_atan2f(y, 1.3f);
+        gbenchmark_escape(&a);
+        y += 0.013f;
+    }
+}
+
+BENCHMARK(BM_Sinf);
+BENCHMARK(BM_FastSinf);
+BENCHMARK(BM_SinCosf);
+BENCHMARK(BM_FastSinCosf);
+BENCHMARK(BM_Atan2f);
+BENCHMARK(BM_FastAtan2f);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,63 @@
+#include <AP_gbenchmark.h>
+
+#include <AP_Common/Location.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+/*
+  compare the float and postype_t conversions between locations and
+  offsets from an origin
+ */
+
+static const Location origin(-353632640, 1491652352, 0, Location::AltFrame::ABSOLUTE);
+
+static void BM_GetDistanceNE(benchmark::State& state)
+{
+    Location loc = origin;
+    while (state.KeepRunning()) {
+        Vector2f ne = origin.get_distance_NE(loc);
+        gbenchmark_escape(&ne);
+        loc.lat += 13;
+        loc.lng -= 7;
+    }
+}
+
+static void BM_GetDistanceNEPostype(benchmark::State& state)
+{
+    Location loc = origin;
+    while (state.KeepRunning()) {
+        Vector2p ne = origin.get_distance_NE_postype(loc);
+        gbenchmark_escape(&ne);
+        loc.lat += 13;
+        loc.lng -= 7;
+    }
+}
+
+static void BM_Offset(benchmark::State& state)
+{
+    float ofs = 0;
+    while (state.KeepRunning()) {
+        Location loc = origin;
+        loc.offset(ofs, -ofs);
+        gbenchmark_escape(&loc);
+        ofs += 0.37f;
+    }
+}
+
+static void BM_OffsetPostype(benchmark::State& state)
+{
+    postype_t ofs = 0;
+    while (state.KeepRunning()) {
+        Location loc = origin;
+        loc.offset_postype(ofs, -ofs);
+        gbenchmark_escape(&loc);
+        ofs += postype_t(0.37);
+    }
+}
+
+BENCHMARK(BM_GetDistanceNE);
+BENCHMARK(BM_GetDistanceNEPostype);
+BENCHMARK(BM_Offset);
+BENCHMARK(BM_OffsetPostype);
+
+BENCHMARK_MAIN()
@@ -41,6 +41,13 @@ static const double DEG_TO_RAD_DOUBLE = asin(1) / 90;
 static const double RAD_TO_DEG_DOUBLE = 1 / DEG_TO_RAD_DOUBLE;
 #endif
 
+// type for positions relative to the EKF origin, see HAL_WITH_POSTYPE_DOUBLE
+#if HAL_WITH_POSTYPE_DOUBLE
+typedef double postype_t;
+#else
+typedef float postype_t;
+#endif
+
 #define RadiansToCentiDegrees(x) (static_cast<float>(x) * RAD_TO_DEG * static_cast<float>(100))
 
 // acceleration due to gravity in m/s/s
@@ -0,0 +1,119 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AP_Math.h"
+
+#if AP_MATH_FAST_TRIG_ENABLED
+
+/*
+  reduce x to r in [-pi/4, pi/4] with x = r + q*pi/2, returning the
+  quadrant q in 0..3. pi/2 is split in three parts with the first two
+  having enough trailing zero bits that q*part is exact for the
+  arguments we support
+ */
+static uint8_t reduce_quadrant(float x, float &r)
+{
+    const float PIO2_1 = 1.5703125f;
+    const float PIO2_2 = 4.837512969970703125e-4f;
+    const float PIO2_3 = 7.54978995489188216e-8f;
+
+    const float q = rintf(x * (float)M_2_PI);
+    r = ((x - q * PIO2_1) - q * PIO2_2) - q * PIO2_3;
+    return (uint8_t)((int32_t)q & 3);
+}
+
+// minimax polynomials for sin and cos on [-pi/4, pi/4]
+static inline float sin_poly(float r, float r2)
+{
+    return r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+}
+
+static inline float cos_poly(float r2)
+{
+    return 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+}
+
+void fast_sincosf(float x, float &s, float &c)
+{
+    float r;
+    const uint8_t quadrant = reduce_quadrant(x, r);
+    const float r2 = r * r;
+    const float sr = sin_poly(r, r2);
+    const float cr = cos_poly(r2);
+
+    switch (quadrant) {
+    case 0:
+        s = sr;
+        c = cr;
+        break;
+    case 1:
+        s = cr;
+        c = -sr;
+        break;
+    case 2:
+        s = -sr;
+        c = -cr;
+        break;
+    default:
+        s = -cr;
+        c = sr;
+        break;
+    }
+}
+
+float fast_sinf(float x)
+{
+    float r;
+    const uint8_t quadrant = reduce_quadrant(x, r);
+    const float r2 = r * r;
+    const float v = (quadrant & 1) ? cos_poly(r2) : sin_poly(r, r2);
+    return (quadrant & 2) ? -v : v;
+}
+
+float fast_cosf(float x)
+{
+    float r;
+    const uint8_t quadrant = reduce_quadrant(x, r);
+    const float r2 = r * r;
+    const float v = (quadrant & 1) ? sin_poly(r, r2) : cos_poly(r2);
+    return ((quadrant + 1) & 2) ? -v : v;
+}
+
+/*
+  atan2 using the Abramowitz and Stegun 4.4.49 polynomial for atan on
+  [0, 1] and octant symmetry for the rest of the circle
+ */
+float fast_atan2f(float y, float x)
+{
+    const float ax = fabsf(x);
+    const float ay = fabsf(y);
+    const float mx = MAX(ax, ay);
+    if (mx <= 0.0f) {
+        return 0.0f;
+    }
+    const float t = MIN(ax, ay) / mx;
+    const float t2 = t * t;
+    float a = t * (1.0f + t2 * (-0.3333314528f + t2 * (0.1999355085f + t2 * (-0.1420889944f + t2 * (0.1065626393f +
+                   t2 * (-0.0752896400f + t2 * (0.0429096138f + t2 * (-0.0161657367f + t2 * 0.0028662257f))))))));
+    if (ay > ax) {
+        a = M_PI_2 - a;
+    }
+    if (x < 0.0f) {
+        a = M_PI - a;
+    }
+    return (y < 0.0f) ? -a : a;
+}
+
+#endif // AP_MATH_FAST_TRIG_ENABLED
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cmath>
+
+/*
+  polynomial approximations of the trig functions used in navigation
+  and geodesy calculations. They are several times faster than the
+  libm versions on microcontrollers and accurate to a few float ulps
+  for the arguments seen in flight. Define AP_MATH_FAST_TRIG_ENABLED
+  to 0 to use the exact libm functions instead
+ */
+#ifndef AP_MATH_FAST_TRIG_ENABLED
+#define AP_MATH_FAST_TRIG_ENABLED 1
+#endif
+
+#if AP_MATH_FAST_TRIG_ENABLED
+
+// sine and cosine with an absolute error of less than 5e-7 for
+// |x| < 1e4 radians
+float fast_sinf(float x);
+float fast_cosf(float x);
+void fast_sincosf(float x, float &s, float &c);
+
+// atan2 with an absolute error of less than 5e-7 radians for finite
+// arguments. Returns zero when both arguments are zero
+float fast_atan2f(float y, float x);
+
+#else
+
+static inline float fast_sinf(float x) { return sinf(x); }
+static inline float fast_cosf(float x) { return cosf(x); }
+static inline void fast_sincosf(float x, float &s, float &c)
+{
+    s = sinf(x);
+    c = cosf(x);
+}
+static inline float fast_atan2f(float y, float x) { return atan2f(y, x); }
+
+#endif // AP_MATH_FAST_TRIG_ENABLED
@@ -32,7 +32,7 @@ float get_horizontal_distance_cm(const Vector3f &origin, const Vector3f &destina
 // return bearing in centi-degrees between two positions
 float get_bearing_cd(const Vector3f &origin, const Vector3f &destination)
 {
-    float bearing = atan2f(destination.y-origin.y, destination.x-origin.x) * DEGX100;
+    float bearing = fast_atan2f(destination.y-origin.y, destination.x-origin.x) * DEGX100;
     if (bearing < 0) {
         bearing += 36000.0f;
     }
@@ -0,0 +1,82 @@
+#include <AP_gtest.h>
+
+#include <AP_Math/AP_Math.h>
+#include <AP_Common/Location.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+#if AP_MATH_FAST_TRIG_ENABLED
+
+// largest error of the fast functions against the double precision
+// versions over the range used for navigation
+TEST(FastMathTest, SinCos)
+{
+    double max_err = 0;
+    for (float x = -100.0f; x <= 100.0f; x += 0.000731f) {
+        float s, c;
+        fast_sincosf(x, s, c);
+        max_err = MAX(max_err, fabs(s - sin((double)x)));
+        max_err = MAX(max_err, fabs(c - cos((double)x)));
+        EXPECT_FLOAT_EQ(s, fast_sinf(x));
+        EXPECT_FLOAT_EQ(c, fast_cosf(x));
+    }
+    EXPECT_LT(max_err, 5e-7);
+
+    // large arguments
+    for (float x = -1e4f; x <= 1e4f; x += 0.731f) {
+        EXPECT_NEAR(fast_sinf(x), sin((double)x), 5e-7);
+        EXPECT_NEAR(fast_cosf(x), cos((double)x), 5e-7);
+    }
+
+    // exact values at the quadrant boundaries
+    EXPECT_FLOAT_EQ(0.0f, fast_sinf(0));
+    EXPECT_FLOAT_EQ(1.0f, fast_cosf(0));
+    EXPECT_NEAR(1.0f, fast_sinf(M_PI_2), 1e-7);
+    EXPECT_NEAR(-1.0f, fast_cosf(M_PI), 1e-7);
+}
+
+TEST(FastMathTest, Atan2)
+{
+    double max_err = 0;
+    for (float a = -M_PI; a <= M_PI; a += 0.000913f) {
+        for (float r : {1e-3f, 1.0f, 1e5f}) {
+            const float y = r * sinf(a);
+            const float x = r * cosf(a);
+            max_err = MAX(max_err, fabs(fast_atan2f(y, x) - atan2((double)y, (double)x)));
+        }
+    }
+    EXPECT_LT(max_err, 5e-7);
+
+    EXPECT_FLOAT_EQ(0.0f, fast_atan2f(0, 0));
+    EXPECT_FLOAT_EQ(0.0f, fast_atan2f(0, 1));
+    EXPECT_NEAR(M_PI_2, fast_atan2f(1, 0), 1e-7);
+    EXPECT_NEAR(-M_PI_2, fast_atan2f(-1, 0), 1e-7);
+    EXPECT_NEAR(M_PI, fast_atan2f(0, -1), 1e-7);
+}
+
+#endif // AP_MATH_FAST_TRIG_ENABLED
+
+TEST(FastMathTest, LongitudeScale)
+{
+    Location loc;
+    for (int32_t lat = -900000000; lat <= 900000000; lat += 12345678) {
+        loc.lat = lat;
+        const double expected = MAX(cos(lat * 1.0e-7 * DEG_TO_RAD), 0.01);
+        // twice to check the cached value
+        EXPECT_NEAR(expected, loc.longitude_scale(), 5e-7);
+        EXPECT_NEAR(expected, loc.longitude_scale(), 5e-7);
+    }
+}
+
+TEST(FastMathTest, Bearing)
+{
+    const Location loc1(-353632640, 1491652352, 0, Location::AltFrame::ABSOLUTE);
+    for (float bearing = 0; bearing < 360; bearing += 7.3f) {
+        Location loc2 = loc1;
+        loc2.offset_bearing(bearing, 500);
+        EXPECT_NEAR(500, loc1.get_distance(loc2), 0.05);
+        EXPECT_NEAR(bearing * 100, loc1.get_bearing_to(loc2), 2);
+    }
+}
+
+AP_GTEST_MAIN()
@@ -27,10 +27,17 @@ const AP_Param::GroupInfo AP_Mission::var_info[] = {
     // @Param: OPTIONS
     // @DisplayName: Mission options bitmask
     // @Description: Bitmask of what options to use in missions.
-    // @Bitmask: 0:Clear Mission on reboot
+    // @Bitmask: 0:Clear Mission on reboot, 1:Keep mission in RAM (takes effect on reboot)
     // @User: Advanced
     AP_GROUPINFO("OPTIONS",  2, AP_Mission, _options, AP_MISSION_OPTIONS_DEFAULT),
 
+    // @Param: UPL_WINDOW
+    // @DisplayName: Mission upload window
+    // @Description: Number of mission item requests kept in flight while a GCS uploads a mission. 1 is the standard one item per round trip protocol. Larger values speed up uploads over high latency links; items may then arrive out of order and missing items are re-requested individually.
+    // @Range: 1 16
+    // @User: Advanced
+    AP_GROUPINFO("UPL_WINDOW",  3, AP_Mission, _upload_window, 1),
+
     AP_GROUPEND
 };
 
@@ -58,6 +65,8 @@ void AP_Mission::init()
     	clear();	
     }
 
+    cache_init();
+
     _last_change_time_ms = AP_HAL::millis();
 }
 
@@ -195,6 +204,7 @@ bool AP_Mission::clear()
 
     // remove all commands
     _cmd_total.set_and_save(0);
+    _cache_next_nav_valid = false;
 
     // clear index to commands
     _nav_cmd.index = AP_MISSION_CMD_INDEX_NONE;
@@ -212,6 +222,7 @@ void AP_Mission::truncate(uint16_t index)
 {
     if ((unsigned)_cmd_total > index) {        
         _cmd_total.set_and_save(index);
+        _cache_next_nav_valid = false;
     }
 }
 
@@ -318,8 +329,13 @@ bool AP_Mission::add_cmd(Mission_Command& cmd)
     if (ret) {
         // update command's index
         cmd.index = _cmd_total;
-        // increment total number of commands
-        _cmd_total.set_and_save(_cmd_total + 1);
+        // increment total number of commands, saved by flush() when batching
+        if (_write_batch) {
+            _cmd_total.set(_cmd_total + 1);
+        } else {
+            _cmd_total.set_and_save(_cmd_total + 1);
+        }
+        _cache_next_nav_valid = false;
     }
 
     return ret;
@@ -353,6 +369,14 @@ bool AP_Mission::get_next_nav_cmd(uint16_t start_index, Mission_Command& cmd)
 {
     // search until the end of the mission command list
     for (uint16_t cmd_index = start_index; cmd_index < (unsigned)_cmd_total; cmd_index++) {
+        if (_cache != nullptr) {
+            // skip straight past do commands
+            WITH_SEMAPHORE(_rsem);
+            cmd_index = cache_next_nav(cmd_index);
+            if (cmd_index == AP_MISSION_CMD_INDEX_NONE) {
+                return false;
+            }
+        }
         // get next command
         if (!get_next_cmd(cmd_index, cmd, false)) {
             // no more commands so return failure
@@ -519,22 +543,46 @@ bool AP_Mission::read_cmd_from_storage(uint16_t index, Mission_Command& cmd) con
         return false;
     }
 
+    if (_cache != nullptr) {
+        cmd = _cache[index];
+        return true;
+    }
+
+    read_cmd_from_storage_raw(index, cmd);
+
+    // return success
+    return true;
+}
+
+/// read_cmd_from_storage_raw - read and decode a command from storage, bypassing the cache
+void AP_Mission::read_cmd_from_storage_raw(uint16_t index, Mission_Command& cmd) const
+{
     // Find out proper location in memory by using the start_byte position + the index
     // we can load a command, we don't process it yet
     // read WP position
     const uint16_t pos_in_storage = 4 + (index * AP_MISSION_EEPROM_COMMAND_SIZE);
 
+    uint8_t buf[AP_MISSION_EEPROM_COMMAND_SIZE];
+    _storage.read_block(buf, pos_in_storage, sizeof(buf));
+    unpack_cmd(buf, cmd);
+
+    // set command's index to it's position in eeprom
+    cmd.index = index;
+}
+
+/// unpack_cmd - convert a command from its storage format
+void AP_Mission::unpack_cmd(const uint8_t *buf, Mission_Command& cmd)
+{
     PackedContent packed_content {};
 
-    const uint8_t b1 = _storage.read_byte(pos_in_storage);
-    if (b1 == 0) {
-        cmd.id = _storage.read_uint16(pos_in_storage+1);
-        cmd.p1 = _storage.read_uint16(pos_in_storage+3);
-        _storage.read_block(packed_content.bytes, pos_in_storage+5, 10);
+    if (buf[0] == 0) {
+        cmd.id = UINT16_VALUE(buf[2], buf[1]);
+        cmd.p1 = UINT16_VALUE(buf[4], buf[3]);
+        memcpy(packed_content.bytes, &buf[5], 10);
     } else {
-        cmd.id = b1;
-        cmd.p1 = _storage.read_uint16(pos_in_storage+1);
-        _storage.read_block(packed_content.bytes, pos_in_storage+3, 12);
+        cmd.id = buf[0];
+        cmd.p1 = UINT16_VALUE(buf[2], buf[1]);
+        memcpy(packed_content.bytes, &buf[3], 12);
     }
 
     if (stored_in_location(cmd.id)) {
@@ -554,12 +602,6 @@ bool AP_Mission::read_cmd_from_storage(uint16_t index, Mission_Command& cmd) con
         // (void *) cast to specify gcc that we know that we are copy byte into a non trivial type and leaving 4 bytes untouched
         memcpy((void *)&cmd.content, packed_content.bytes, 12);
     }
-
-    // set command's index to it's position in eeprom
-    cmd.index = index;
-
-    // return success
-    return true;
 }
 
 bool AP_Mission::stored_in_location(uint16_t id)
@@ -600,6 +642,44 @@ bool AP_Mission::write_cmd_to_storage(uint16_t index, const Mission_Command& cmd
         return false;
     }
 
+    // remember when the mission last changed
+    _last_change_time_ms = AP_HAL::millis();
+
+    if (_cache != nullptr) {
+        _cache[index] = cmd;
+        _cache[index].index = index;
+        _cache_next_nav_valid = false;
+        if (_cache_dirty_first == AP_MISSION_CMD_INDEX_NONE) {
+            _cache_dirty_first = index;
+            _cache_dirty_last = index;
+        } else {
+            _cache_dirty_first = MIN(_cache_dirty_first, index);
+            _cache_dirty_last = MAX(_cache_dirty_last, index);
+        }
+        // outside of a batch the cache is write-through, during a
+        // batch the number of commands that can be lost on power
+        // failure is bounded
+        if (!_write_batch ||
+            _cache_dirty_last - _cache_dirty_first >= AP_MISSION_CACHE_FLUSH_BATCH-1) {
+            flush();
+        }
+        return true;
+    }
+
+    // calculate where in storage the command should be placed
+    const uint16_t pos_in_storage = 4 + (index * AP_MISSION_EEPROM_COMMAND_SIZE);
+
+    uint8_t buf[AP_MISSION_EEPROM_COMMAND_SIZE];
+    pack_cmd(cmd, buf);
+    _storage.write_block(pos_in_storage, buf, sizeof(buf));
+
+    // return success
+    return true;
+}
+
+/// pack_cmd - convert a command to its AP_MISSION_EEPROM_COMMAND_SIZE byte storage format
+void AP_Mission::pack_cmd(const Mission_Command& cmd, uint8_t *buf)
+{
     PackedContent packed {};
     if (stored_in_location(cmd.id)) {
         // Location is not PACKED; field-wise copy it:
@@ -618,26 +698,101 @@ bool AP_Mission::write_cmd_to_storage(uint16_t index, const Mission_Command& cmd
         memcpy(packed.bytes, &cmd.content, 12);
     }
 
-    // calculate where in storage the command should be placed
-    uint16_t pos_in_storage = 4 + (index * AP_MISSION_EEPROM_COMMAND_SIZE);
-
     if (cmd.id < 256) {
-        _storage.write_byte(pos_in_storage, cmd.id);
-        _storage.write_uint16(pos_in_storage+1, cmd.p1);
-        _storage.write_block(pos_in_storage+3, packed.bytes, 12);
+        buf[0] = cmd.id;
+        buf[1] = LOWBYTE(cmd.p1);
+        buf[2] = HIGHBYTE(cmd.p1);
+        memcpy(&buf[3], packed.bytes, 12);
     } else {
         // if the command ID is above 256 we store a 0 followed by the 16 bit command ID
-        _storage.write_byte(pos_in_storage, 0);
-        _storage.write_uint16(pos_in_storage+1, cmd.id);
-        _storage.write_uint16(pos_in_storage+3, cmd.p1);
-        _storage.write_block(pos_in_storage+5, packed.bytes, 10);
+        buf[0] = 0;
+        buf[1] = LOWBYTE(cmd.id);
+        buf[2] = HIGHBYTE(cmd.id);
+        buf[3] = LOWBYTE(cmd.p1);
+        buf[4] = HIGHBYTE(cmd.p1);
+        memcpy(&buf[5], packed.bytes, 10);
     }
+}
 
-    // remember when the mission last changed
-    _last_change_time_ms = AP_HAL::millis();
+/// begin_write_batch - defer storage writes until flush() is called
+void AP_Mission::begin_write_batch()
+{
+    WITH_SEMAPHORE(_rsem);
+    _write_batch = true;
+}
 
-    // return success
-    return true;
+/// flush - write any commands held in the cache to storage and end a write batch
+void AP_Mission::flush()
+{
+    WITH_SEMAPHORE(_rsem);
+
+    if (_cache_dirty_first != AP_MISSION_CMD_INDEX_NONE && _cache != nullptr) {
+        // write in chunks of consecutive commands so storage sees
+        // a few large writes rather than one per field
+        const uint8_t chunk = 8;
+        uint8_t buf[chunk * AP_MISSION_EEPROM_COMMAND_SIZE];
+        uint16_t i = _cache_dirty_first;
+        while (i <= _cache_dirty_last) {
+            const uint16_t n = MIN(chunk, _cache_dirty_last + 1 - i);
+            for (uint16_t j=0; j<n; j++) {
+                pack_cmd(_cache[i+j], &buf[j*AP_MISSION_EEPROM_COMMAND_SIZE]);
+            }
+            _storage.write_block(4 + i * AP_MISSION_EEPROM_COMMAND_SIZE, buf, n * AP_MISSION_EEPROM_COMMAND_SIZE);
+            i += n;
+        }
+    }
+    _cache_dirty_first = AP_MISSION_CMD_INDEX_NONE;
+
+    if (_write_batch) {
+        _write_batch = false;
+        _cmd_total.save();
+    }
+}
+
+/// cache_init - allocate the command cache and fill it from storage
+void AP_Mission::cache_init()
+{
+    if (_cache != nullptr || !(_options & AP_MISSION_MASK_CACHE)) {
+        return;
+    }
+    const uint16_t size = num_commands_max();
+    _cache = new Mission_Command[size];
+    _cache_next_nav = new uint16_t[size];
+    if (_cache == nullptr || _cache_next_nav == nullptr) {
+        delete[] _cache;
+        delete[] _cache_next_nav;
+        _cache = nullptr;
+        _cache_next_nav = nullptr;
+        gcs().send_text(MAV_SEVERITY_WARNING, "Mission: cache allocation failed");
+        return;
+    }
+    _cache_size = size;
+
+    // fill the whole cache so commands appended later are already loaded
+    for (uint16_t i=0; i<size; i++) {
+        read_cmd_from_storage_raw(i, _cache[i]);
+    }
+    _cache_next_nav_valid = false;
+}
+
+/// cache_next_nav - returns the index of the first nav or do-jump command at or after index
+///     returns AP_MISSION_CMD_INDEX_NONE if there are none
+uint16_t AP_Mission::cache_next_nav(uint16_t index)
+{
+    if (!_cache_next_nav_valid) {
+        uint16_t next = AP_MISSION_CMD_INDEX_NONE;
+        for (int32_t i=(int32_t)_cmd_total-1; i>=0; i--) {
+            if (is_nav_cmd(_cache[i]) || _cache[i].id == MAV_CMD_DO_JUMP) {
+                next = i;
+            }
+            _cache_next_nav[i] = next;
+        }
+        _cache_next_nav_valid = true;
+    }
+    if (index >= (unsigned)_cmd_total) {
+        return AP_MISSION_CMD_INDEX_NONE;
+    }
+    return _cache_next_nav[index];
 }
 
 /// write_home_to_storage - writes the special purpose cmd 0 (home) to storage
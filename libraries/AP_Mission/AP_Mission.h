@@ -39,6 +39,9 @@
 
 #define AP_MISSION_OPTIONS_DEFAULT          0       // Do not clear the mission when rebooting
 #define AP_MISSION_MASK_MISSION_CLEAR       (1<<0)  // If set then Clear the mission on boot
+#define AP_MISSION_MASK_CACHE               (1<<1)  // If set then keep a decoded copy of the mission in RAM
+
+#define AP_MISSION_CACHE_FLUSH_BATCH        32      // maximum number of commands held dirty in the cache before they are written to storage
 
 /// @class    AP_Mission
 /// @brief    Object managing Mission
@@ -439,6 +442,17 @@ public:
     ///     home is taken directly from ahrs
     void write_home_to_storage();
 
+    /// upload_window - number of item requests the GCS protocol may keep in flight
+    uint8_t upload_window() const { return _upload_window; }
+
+    /// begin_write_batch - defer storage writes until flush() is called or
+    ///     AP_MISSION_CACHE_FLUSH_BATCH commands are pending.  Used while a
+    ///     mission is being uploaded
+    void begin_write_batch();
+
+    /// flush - write any commands held in the cache to storage and end a write batch
+    void flush();
+
     static MAV_MISSION_RESULT convert_MISSION_ITEM_to_MISSION_ITEM_INT(const mavlink_mission_item_t &mission_item,
                                                                        mavlink_mission_item_int_t &mission_item_int) WARN_IF_UNUSED;
     static MAV_MISSION_RESULT convert_MISSION_ITEM_INT_to_MISSION_ITEM(const mavlink_mission_item_int_t &mission_item_int,
@@ -552,10 +566,26 @@ private:
     /// sanity checks that the masked fields are not NaN's or infinite
     static MAV_MISSION_RESULT sanity_check_params(const mavlink_mission_item_int_t& packet);
 
+    /// pack_cmd - convert a command to its AP_MISSION_EEPROM_COMMAND_SIZE byte storage format
+    static void pack_cmd(const Mission_Command& cmd, uint8_t *buf);
+
+    /// unpack_cmd - convert a command from its storage format
+    static void unpack_cmd(const uint8_t *buf, Mission_Command& cmd);
+
+    /// read_cmd_from_storage_raw - read and decode a command from storage, bypassing the cache
+    void read_cmd_from_storage_raw(uint16_t index, Mission_Command& cmd) const;
+
+    /// cache_init - allocate the command cache and fill it from storage
+    void cache_init();
+
+    /// cache_next_nav - returns the index of the first nav or do-jump command at or after index
+    uint16_t cache_next_nav(uint16_t index);
+
     // parameters
     AP_Int16                _cmd_total;  // total number of commands in the mission
     AP_Int8                 _restart;   // controls mission starting point when entering Auto mode (either restart from beginning of mission or resume from last command run)
     AP_Int16                _options;    // bitmask options for missions, currently for mission clearing on reboot but can be expanded as required
+    AP_Int8                 _upload_window; // number of item requests kept in flight during a mission upload
 
     // pointer to main program functions
     mission_cmd_fn_t        _cmd_start_fn;  // pointer to function which will be called when a new command is started
@@ -578,6 +608,22 @@ private:
     // last time that mission changed
     uint32_t _last_change_time_ms;
 
+    // RAM copy of the mission, only allocated if AP_MISSION_MASK_CACHE is set
+    Mission_Command *_cache;
+    uint16_t _cache_size;
+
+    // index of the next nav or do-jump command at or after each
+    // command, rebuilt when the mission changes
+    uint16_t *_cache_next_nav;
+    bool _cache_next_nav_valid;
+
+    // range of cached commands not yet written to storage
+    uint16_t _cache_dirty_first = AP_MISSION_CMD_INDEX_NONE;
+    uint16_t _cache_dirty_last;
+
+    // true while writes are being batched, _cmd_total is saved on flush()
+    bool _write_batch;
+
     // multi-thread support. This is static so it can be used from
     // const functions
     static HAL_Semaphore_Recursive _rsem;
@@ -269,10 +269,17 @@ void NavEKF2_core::readMagData()
         lastMagUpdate_us = _ahrs->get_compass()->last_update_usec(magSelectIndex);
 
         // estimate of time magnetometer measurement was taken, allowing for delays
-        magDataNew.time_ms = imuSampleTime_ms - frontend->magDelay_ms;
+        if (_ahrs->get_compass()->sample_time_aligned(magSelectIndex)) {
+            // the compass reports when the published field was
+            // measured, so use its age rather than assuming it is new
+            const int32_t age_us = int32_t(uint32_t(frontend->imuSampleTime_us) - _ahrs->get_compass()->last_sample_usec(magSelectIndex));
+            magDataNew.time_ms = imuSampleTime_ms - MAX(age_us, 0) / 1000 - frontend->magDelay_ms;
+        } else {
+            magDataNew.time_ms = imuSampleTime_ms - frontend->magDelay_ms;
 
-        // Correct for the average intersampling delay due to the filter updaterate
-        magDataNew.time_ms -= localFilterTimeStep_ms/2;
+            // Correct for the average intersampling delay due to the filter updaterate
+            magDataNew.time_ms -= localFilterTimeStep_ms/2;
+        }
 
         // read compass data and scale to improve numerical conditioning
         magDataNew.mag = _ahrs->get_compass()->get_field(magSelectIndex) * 0.001f;
@@ -649,10 +656,15 @@ void NavEKF2_core::readBaroData()
         lastBaroReceived_ms = baro.get_last_update();
 
         // estimate of time height measurement was taken, allowing for delays
-        baroDataNew.time_ms = lastBaroReceived_ms - frontend->_hgtDelay_ms;
+        if (baro.sample_time_aligned()) {
+            // the baro reports when the published reading was measured
+            baroDataNew.time_ms = baro.get_last_sample_ms() - frontend->_hgtDelay_ms;
+        } else {
+            baroDataNew.time_ms = lastBaroReceived_ms - frontend->_hgtDelay_ms;
 
-        // Correct for the average intersampling delay due to the filter updaterate
-        baroDataNew.time_ms -= localFilterTimeStep_ms/2;
+            // Correct for the average intersampling delay due to the filter updaterate
+            baroDataNew.time_ms -= localFilterTimeStep_ms/2;
+        }
 
         // Prevent time delay exceeding age of oldest IMU data in the buffer
         baroDataNew.time_ms = MAX(baroDataNew.time_ms,imuDataDelayed.time_ms);
@@ -175,6 +175,25 @@ const AP_Param::GroupInfo AP_Proximity::var_info[] = {
     AP_GROUPINFO("2_YAW_CORR", 18, AP_Proximity, _yaw_correction[1], 0),
 #endif
 
+    // @Param: _MAP_RES
+    // @DisplayName: Proximity map resolution
+    // @Description: Width of each direction in the high resolution map kept for scanning sensors. Must divide 360 evenly. 0 disables the map and readings are only kept per sector
+    // @Units: deg
+    // @Values: 0:Disabled,1:1,2:2,3:3,5:5,10:10
+    // @Range: 0 45
+    // @User: Advanced
+    // @RebootRequired: True
+    AP_GROUPINFO("_MAP_RES", 19, AP_Proximity, _map_res_deg, 2),
+
+    // @Param: _MAP_DECAY
+    // @DisplayName: Proximity map decay time
+    // @Description: Readings in the high resolution map older than this are ignored
+    // @Units: ms
+    // @Range: 100 5000
+    // @User: Advanced
+    // @RebootRequired: True
+    AP_GROUPINFO("_MAP_DECAY", 20, AP_Proximity, _map_decay_ms, 500),
+
     AP_GROUPEND
 };
 
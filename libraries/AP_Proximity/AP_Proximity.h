@@ -157,6 +157,8 @@ private:
     AP_Int16 _yaw_correction[PROXIMITY_MAX_INSTANCES];
     AP_Int16 _ignore_angle_deg[PROXIMITY_MAX_IGNORE];   // angle (in degrees) of area that should be ignored by sensor (i.e. leg shows up)
     AP_Int8 _ignore_width_deg[PROXIMITY_MAX_IGNORE];    // width of beam (in degrees) that should be ignored
+    AP_Int8 _map_res_deg;                               // bin width (in degrees) of high resolution map, 0 to disable
+    AP_Int16 _map_decay_ms;                             // time (in milliseconds) after which map readings are ignored
 
     void detect_instance(uint8_t instance);
 };
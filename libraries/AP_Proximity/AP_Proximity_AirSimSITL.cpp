@@ -31,6 +31,7 @@ AP_Proximity_AirSimSITL::AP_Proximity_AirSimSITL(AP_Proximity &_frontend,
     AP_Proximity_Backend(_frontend, _state),
     sitl(AP::sitl())
 {
+    init_map();
 }
 
 // update the state of the sensor
@@ -44,34 +45,29 @@ void AP_Proximity_AirSimSITL::update(void)
 
     set_status(AP_Proximity::Proximity_Good);
 
-    memset(_distance_valid, 0, sizeof(_distance_valid));
-    memset(_angle, 0, sizeof(_angle));
-    memset(_distance, 0, sizeof(_distance));
-
-    // only use 8 sectors to match RPLidar
-    const uint8_t nsectors = MIN(8, PROXIMITY_SECTORS_MAX);
-    const uint16_t degrees_per_sector = 360 / nsectors;
+    // add the point cloud to the map in batches
+    const uint32_t now_ms = AP_HAL::millis();
+    AP_Proximity_Map::reading readings[32];
+    uint8_t num_readings = 0;
 
     for (uint16_t i=0; i<points.length; i++) {
         Vector3f &point = points.data[i];
         if (point.is_zero()) {
             continue;
         }
-        float angle_deg = wrap_360(degrees(atan2f(-point.y, point.x)));
-        uint16_t angle_rounded = uint16_t(angle_deg+0.5);
-        uint8_t sector = wrap_360(angle_rounded + 22.5f) / degrees_per_sector;
-        if (!_distance_valid[sector] || PROXIMITY_MAX_RANGE < _distance[sector]) {
-            _distance_valid[sector] = true;
-            const Vector2f v = Vector2f(point.x, point.y);
-            _distance[sector] = v.length();
-            _angle[sector] = angle_deg;
-            update_boundary_for_sector(sector, true);
+        readings[num_readings].angle_deg = wrap_360(degrees(atan2f(-point.y, point.x)));
+        readings[num_readings].distance_m = Vector2f(point.x, point.y).length();
+        num_readings++;
+        if (num_readings >= ARRAY_SIZE(readings)) {
+            update_readings(readings, num_readings, now_ms);
+            num_readings = 0;
         }
     }
+    update_readings(readings, num_readings, now_ms);
 
 #if 0
     printf("npoints=%u\n", points.length);
-    for (uint16_t i=0; i<nsectors; i++) {
+    for (uint16_t i=0; i<_num_sectors; i++) {
         printf("sector[%u] ang=%.1f dist=%.1f\n", i, _angle[i], _distance[i]);
     }
 #endif
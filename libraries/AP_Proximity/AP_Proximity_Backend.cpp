@@ -36,6 +36,10 @@ AP_Proximity_Backend::AP_Proximity_Backend(AP_Proximity &_frontend, AP_Proximity
 // get distance in meters in a particular direction in degrees (0 is forward, angles increase in the clockwise direction)
 bool AP_Proximity_Backend::get_horizontal_distance(float angle_deg, float &distance) const
 {
+    if (_map_bin_sector != nullptr) {
+        return _map.get_distance(angle_deg, AP_HAL::millis(), distance);
+    }
+
     uint8_t sector;
     if (convert_angle_to_sector(angle_deg, sector)) {
         if (_distance_valid[sector]) {
@@ -235,6 +239,92 @@ void AP_Proximity_Backend::update_boundary_for_sector(const uint8_t sector, cons
     }
 }
 
+// allocate the high resolution map and work out which bins fall in each sector
+void AP_Proximity_Backend::init_map()
+{
+    if (frontend._map_res_deg <= 0 ||
+        !_map.init(frontend._map_res_deg, frontend._map_decay_ms)) {
+        return;
+    }
+
+    const uint16_t num_bins = _map.num_bins();
+    uint8_t *bin_sector = new uint8_t[num_bins];
+    if (bin_sector == nullptr) {
+        return;
+    }
+    memset(_map_sector_num_bins, 0, sizeof(_map_sector_num_bins));
+    for (uint16_t bin=0; bin<num_bins; bin++) {
+        uint8_t sector = 0;
+        convert_angle_to_sector(_map.bin_to_angle(bin), sector);
+        bin_sector[bin] = sector;
+    }
+
+    // sectors are contiguous, so the first bin of a sector is the
+    // one whose counter-clockwise neighbour is in a different sector
+    for (uint16_t bin=0; bin<num_bins; bin++) {
+        const uint8_t sector = bin_sector[bin];
+        const uint8_t prev_sector = bin_sector[(bin == 0) ? num_bins-1 : bin-1];
+        if (_map_sector_num_bins[sector] == 0 || sector != prev_sector) {
+            _map_sector_first_bin[sector] = bin;
+        }
+        _map_sector_num_bins[sector]++;
+    }
+
+    _map_bin_sector = bin_sector;
+}
+
+// add a batch of readings and update the sectors and boundary they fall in
+void AP_Proximity_Backend::update_readings(const AP_Proximity_Map::reading *readings, uint16_t count, uint32_t timestamp_ms, bool push_to_OA_DB)
+{
+    static_assert(PROXIMITY_SECTORS_MAX <= 16, "sector mask too small");
+    uint16_t sector_mask = 0;
+
+    if (_map_bin_sector != nullptr) {
+        for (uint16_t i=0; i<count; i++) {
+            sector_mask |= 1U << _map_bin_sector[_map.add(readings[i], timestamp_ms)];
+        }
+        for (uint8_t sector=0; sector<_num_sectors; sector++) {
+            if (sector_mask & (1U << sector)) {
+                _distance_valid[sector] = _map.get_closest(_map_sector_first_bin[sector], _map_sector_num_bins[sector],
+                                                           timestamp_ms, _angle[sector], _distance[sector]);
+                _sector_update_ms[sector] = timestamp_ms;
+            } else if (_distance_valid[sector] && (timestamp_ms - _sector_update_ms[sector] > _map.decay_ms())) {
+                // nothing has been seen in this sector for longer
+                // than the decay time so all its bins have decayed
+                _distance_valid[sector] = false;
+                sector_mask |= 1U << sector;
+            }
+        }
+    } else {
+        // keep the closest reading in each sector from batches with
+        // the same timestamp
+        for (uint16_t i=0; i<count; i++) {
+            uint8_t sector;
+            if (!convert_angle_to_sector(readings[i].angle_deg, sector)) {
+                continue;
+            }
+            sector_mask |= 1U << sector;
+            if (_sector_update_ms[sector] != timestamp_ms) {
+                _sector_update_ms[sector] = timestamp_ms;
+                _distance_valid[sector] = false;
+            }
+            if (is_positive(readings[i].distance_m) &&
+                (!_distance_valid[sector] || readings[i].distance_m < _distance[sector])) {
+                _angle[sector] = readings[i].angle_deg;
+                _distance[sector] = readings[i].distance_m;
+                _distance_valid[sector] = true;
+            }
+        }
+    }
+
+    // update the boundary once for each sector that changed
+    for (uint8_t sector=0; sector<_num_sectors; sector++) {
+        if (sector_mask & (1U << sector)) {
+            update_boundary_for_sector(sector, push_to_OA_DB && _distance_valid[sector]);
+        }
+    }
+}
+
 // set status and update valid count
 void AP_Proximity_Backend::set_status(AP_Proximity::Proximity_Status status)
 {
@@ -372,3 +462,13 @@ void AP_Proximity_Backend::database_push(const float angle, const float distance
     temp_loc.offset_bearing(wrap_180(current_vehicle_bearing + angle), distance);
     oaDb->queue_push(temp_loc, timestamp_ms, distance, angle);
 }
+
+// update Object Avoidance database with a batch of body-frame readings
+void AP_Proximity_Backend::database_push(const AP_Proximity_Map::reading *readings, uint16_t count, const uint32_t timestamp_ms)
+{
+    Location current_loc;
+    float current_vehicle_bearing;
+    if (database_prepare_for_push(current_loc, current_vehicle_bearing)) {
+        AP::oadatabase()->queue_push(current_loc, current_vehicle_bearing, timestamp_ms, readings, count);
+    }
+}
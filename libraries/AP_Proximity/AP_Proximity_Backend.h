@@ -17,6 +17,7 @@
 #include <AP_Common/AP_Common.h>
 #include <AP_HAL/AP_HAL.h>
 #include "AP_Proximity.h"
+#include "AP_Proximity_Map.h"
 #include <AP_Common/Location.h>
 
 #define PROXIMITY_SECTORS_MAX   12  // maximum number of sectors
@@ -82,6 +83,18 @@ protected:
     //   the boundary point is set to the shortest distance found in the two adjacent sectors, this is a conservative boundary around the vehicle
     void update_boundary_for_sector(const uint8_t sector, const bool push_to_OA_DB);
 
+    // allocate the high resolution map using the PRX_MAP_RES bin
+    // width. Should be called by backends that produce many readings
+    // per sector once their sectors are set up
+    void init_map();
+
+    // add a batch of readings taken at timestamp_ms, then update the
+    // sectors and boundary points they fall in once for the batch.
+    // Without a map the closest reading in each sector is used. The
+    // closest object in each updated sector is pushed to the object
+    // avoidance database if push_to_OA_DB is true
+    void update_readings(const AP_Proximity_Map::reading *readings, uint16_t count, uint32_t timestamp_ms, bool push_to_OA_DB = true);
+
     // get ignore area info
     uint8_t get_ignore_area_count() const;
     bool get_ignore_area(uint8_t index, uint16_t &angle_deg, uint8_t &width_deg) const;
@@ -91,6 +104,7 @@ protected:
     bool database_prepare_for_push(Location &current_loc, float &current_vehicle_bearing);
     void database_push(const float angle, const float distance);
     void database_push(const float angle, const float distance, const uint32_t timestamp_ms, const Location &current_loc, const float current_vehicle_bearing);
+    void database_push(const AP_Proximity_Map::reading *readings, uint16_t count, const uint32_t timestamp_ms);
 
     AP_Proximity &frontend;
     AP_Proximity::Proximity_State &state;   // reference to this instances state
@@ -104,8 +118,15 @@ protected:
     float _angle[PROXIMITY_SECTORS_MAX];            // angle to closest object within each sector
     float _distance[PROXIMITY_SECTORS_MAX];         // distance to closest object within each sector
     bool _distance_valid[PROXIMITY_SECTORS_MAX];    // true if a valid distance received for each sector
+    uint32_t _sector_update_ms[PROXIMITY_SECTORS_MAX];  // time of the last batch of readings in each sector
 
     // fence boundary
     Vector2f _sector_edge_vector[PROXIMITY_SECTORS_MAX];    // vector for right-edge of each sector, used to speed up calculation of boundary
     Vector2f _boundary_point[PROXIMITY_SECTORS_MAX];        // bounding polygon around the vehicle calculated conservatively for object avoidance
+
+    // high resolution map
+    AP_Proximity_Map _map;
+    uint8_t *_map_bin_sector;                               // sector each map bin falls in
+    uint16_t _map_sector_first_bin[PROXIMITY_SECTORS_MAX];  // first map bin in each sector
+    uint16_t _map_sector_num_bins[PROXIMITY_SECTORS_MAX];   // number of map bins in each sector
 };
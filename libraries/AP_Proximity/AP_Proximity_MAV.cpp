@@ -16,12 +16,15 @@
 #include <AP_HAL/AP_HAL.h>
 #include "AP_Proximity_MAV.h"
 #include <AP_SerialManager/AP_SerialManager.h>
+#include <AP_Logger/AP_Logger.h>
 #include <ctype.h>
 #include <stdio.h>
 
 extern const AP_HAL::HAL& hal;
 
 #define PROXIMITY_MAV_TIMEOUT_MS    500 // distance messages must arrive within this many milliseconds
+#define PROXIMITY_MAV_CELL_WIDTH_DEG    5   // width of decimation cells when there is no map
+#define PROXIMITY_MAV_INGEST_IDLE_MS    10  // ingest thread sleep while no messages are queued, one 100Hz update() period
 
 /* 
    The constructor also initialises the proximity sensor. Note that this
@@ -32,11 +35,35 @@ AP_Proximity_MAV::AP_Proximity_MAV(AP_Proximity &_frontend,
                                    AP_Proximity::Proximity_State &_state) :
     AP_Proximity_Backend(_frontend, _state)
 {
+    // OBSTACLE_DISTANCE readings are decimated to the map bins, or to
+    // fixed width cells if the map is disabled
+    init_map();
+    const uint16_t num_cells = _map.enabled() ? _map.num_bins() : 360 / PROXIMITY_MAV_CELL_WIDTH_DEG;
+
+    _cell_index = new uint16_t[num_cells];
+    if (_cell_index == nullptr) {
+        return;
+    }
+    for (ingest_batch &batch : _batch) {
+        batch.readings = new AP_Proximity_Map::reading[num_cells];
+        batch.cells = new uint16_t[num_cells];
+        if (batch.readings == nullptr || batch.cells == nullptr) {
+            return;
+        }
+    }
+    _num_cells = num_cells;
 }
 
 // update the state of the sensor
 void AP_Proximity_MAV::update(void)
 {
+    // decimate queued messages here if there is no ingest thread
+    if (!_ingest_thread_started) {
+        ingest_packets();
+    }
+    apply_batch();
+    Log_Write_Ingest();
+
     // check for timeout and set health status
     if ((_last_update_ms == 0 || (AP_HAL::millis() - _last_update_ms > PROXIMITY_MAV_TIMEOUT_MS)) &&
         (_last_upward_update_ms == 0 || (AP_HAL::millis() - _last_upward_update_ms > PROXIMITY_MAV_TIMEOUT_MS))) {
@@ -65,14 +92,15 @@ void AP_Proximity_MAV::handle_msg(const mavlink_message_t &msg)
 
         // store distance to appropriate sector based on orientation field
         if (packet.orientation <= MAV_SENSOR_ROTATION_YAW_315) {
-            uint8_t sector = packet.orientation;
-            _angle[sector] = sector * 45;
-            _distance[sector] = packet.current_distance * 0.01f;
             _distance_min = packet.min_distance * 0.01f;
             _distance_max = packet.max_distance * 0.01f;
-            _distance_valid[sector] = (_distance[sector] >= _distance_min) && (_distance[sector] <= _distance_max);
+            const float distance_m = packet.current_distance * 0.01f;
+            const bool valid = (distance_m >= _distance_min) && (distance_m <= _distance_max);
+            const AP_Proximity_Map::reading reading {packet.orientation * 45.0f, valid ? distance_m : 0.0f};
             _last_update_ms = AP_HAL::millis();
-            update_boundary_for_sector(sector, true);
+            update_readings(&reading, 1, _last_update_ms);
+            _ingest_points++;
+            _ingest_readings++;
         }
 
         // store upward distance
@@ -84,89 +112,177 @@ void AP_Proximity_MAV::handle_msg(const mavlink_message_t &msg)
     }
 
     if (msg.msgid == MAVLINK_MSG_ID_OBSTACLE_DISTANCE) {
-        mavlink_obstacle_distance_t packet;
-        mavlink_msg_obstacle_distance_decode(&msg, &packet);
-
-        // check increment (message's sector width)
-        float increment;
-        if (!is_zero(packet.increment_f)) {
-            // use increment float
-            increment = packet.increment_f;
-        } else if (packet.increment != 0) {
-            // use increment uint8_t
-            increment = packet.increment;
-        } else {
-            // invalid increment
+        if (_num_cells == 0) {
             return;
         }
-
-        const float MAX_DISTANCE = 9999.0f;
-        const uint8_t total_distances = MIN(((360.0f / fabsf(increment)) + 0.5f), MAVLINK_MSG_OBSTACLE_DISTANCE_FIELD_DISTANCES_LEN); // usually 72
+        mavlink_obstacle_distance_t packet;
+        mavlink_msg_obstacle_distance_decode(&msg, &packet);
 
         // set distance min and max
         _distance_min = packet.min_distance * 0.01f;
         _distance_max = packet.max_distance * 0.01f;
         _last_update_ms = AP_HAL::millis();
 
-        // get user configured yaw correction from front end
-        const float param_yaw_offset = constrain_float(frontend.get_yaw_correction(state.instance), -360.0f, +360.0f);
-        const float yaw_correction = wrap_360(param_yaw_offset + packet.angle_offset);
-        if (frontend.get_orientation(state.instance) != 0) {
-            increment *= -1;
+        // leave the per point work to the ingest thread
+        start_ingest_thread();
+        if (!_packets.push(packet)) {
+            _ingest_dropped++;
         }
+    }
+}
 
-        Location current_loc;
-        float current_vehicle_bearing;
-        const bool database_ready = database_prepare_for_push(current_loc, current_vehicle_bearing);
-
-        // initialise updated array and proximity sector angles (to closest object) and distances
-        bool sector_updated[_num_sectors];
-        float sector_width_half[_num_sectors];
-        for (uint8_t i = 0; i < _num_sectors; i++) {
-            sector_updated[i] = false;
-            sector_width_half[i] = _sector_width_deg[i] * 0.5f;
-            _angle[i] = _sector_middle_deg[i];
-            _distance[i] = MAX_DISTANCE;
+void AP_Proximity_MAV::start_ingest_thread()
+{
+    if (_ingest_thread_tried) {
+        return;
+    }
+    _ingest_thread_tried = true;
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+    // SITL snapshots fork() the vehicle, and only the main thread
+    // survives a fork, so messages are decimated from update() instead
+    return;
+#endif
+    _ingest_thread_started = hal.scheduler->thread_create(FUNCTOR_BIND_MEMBER(&AP_Proximity_MAV::ingest_thread, void),
+                                                          "prx_mav",
+                                                          2048, AP_HAL::Scheduler::PRIORITY_IO, -1);
+}
+
+void AP_Proximity_MAV::ingest_thread()
+{
+    while (true) {
+        if (!ingest_packets()) {
+            hal.scheduler->delay(PROXIMITY_MAV_INGEST_IDLE_MS);
         }
+    }
+}
 
-        // iterate over message's sectors
-        for (uint8_t j = 0; j < total_distances; j++) {
-            const uint16_t distance_cm = packet.distances[j];
-            if (distance_cm == 0 ||
-                distance_cm == 65535 ||
-                distance_cm < packet.min_distance ||
-                distance_cm > packet.max_distance)
-            {
-                // sanity check failed, ignore this distance value
-                continue;
-            }
+// decimate all queued OBSTACLE_DISTANCE messages into the back
+// batch. Returns true if any messages were processed
+bool AP_Proximity_MAV::ingest_packets()
+{
+    bool processed = false;
+    mavlink_obstacle_distance_t packet;
+    while (_packets.pop(packet)) {
+        ingest_packet(packet);
+        processed = true;
+    }
+    return processed;
+}
 
-            const float packet_distance_m = distance_cm * 0.01f;
-            const float mid_angle = wrap_360((float)j * increment + yaw_correction);
-
-            // iterate over proximity sectors
-            for (uint8_t i = 0; i < _num_sectors; i++) {
-                float angle_diff = fabsf(wrap_180(_sector_middle_deg[i] - mid_angle));
-                // update distance array sector with shortest distance from message
-                if ((angle_diff <= sector_width_half[i]) && (packet_distance_m < _distance[i])) {
-                    _distance[i] = packet_distance_m;
-                    _angle[i] = mid_angle;
-                    sector_updated[i] = true;
-                }
-            }
+// get the decimation cell an angle falls in
+uint16_t AP_Proximity_MAV::get_cell(float angle_deg) const
+{
+    if (_map.enabled()) {
+        return _map.angle_to_bin(angle_deg);
+    }
+    return uint16_t((angle_deg + PROXIMITY_MAV_CELL_WIDTH_DEG * 0.5f) / PROXIMITY_MAV_CELL_WIDTH_DEG) % _num_cells;
+}
 
-            // update Object Avoidance database with Earth-frame point
-            if (database_ready) {
-                database_push(mid_angle, packet_distance_m, _last_update_ms, current_loc, current_vehicle_bearing);
-            }
+void AP_Proximity_MAV::ingest_packet(const mavlink_obstacle_distance_t &packet)
+{
+    // check increment (message's sector width)
+    float increment;
+    if (!is_zero(packet.increment_f)) {
+        // use increment float
+        increment = packet.increment_f;
+    } else if (packet.increment != 0) {
+        // use increment uint8_t
+        increment = packet.increment;
+    } else {
+        // invalid increment
+        return;
+    }
+
+    const uint8_t total_distances = MIN(((360.0f / fabsf(increment)) + 0.5f), MAVLINK_MSG_OBSTACLE_DISTANCE_FIELD_DISTANCES_LEN); // usually 72
+
+    // get user configured yaw correction from front end
+    const float param_yaw_offset = constrain_float(frontend.get_yaw_correction(state.instance), -360.0f, +360.0f);
+    const float yaw_correction = wrap_360(param_yaw_offset + packet.angle_offset);
+    if (frontend.get_orientation(state.instance) != 0) {
+        increment *= -1;
+    }
+
+    WITH_SEMAPHORE(_sem);
+    ingest_batch &batch = _batch[_back];
+
+    // iterate over message's sectors keeping the closest reading in each cell
+    for (uint8_t j = 0; j < total_distances; j++) {
+        const uint16_t distance_cm = packet.distances[j];
+        if (distance_cm == 0 ||
+            distance_cm == 65535 ||
+            distance_cm < packet.min_distance)
+        {
+            // sanity check failed, ignore this distance value
+            continue;
         }
 
-        // update proximity sectors validity and boundary point
-        for (uint8_t i = 0; i < _num_sectors; i++) {
-            _distance_valid[i] = (_distance[i] >= _distance_min) && (_distance[i] <= _distance_max);
-            if (sector_updated[i]) {
-                update_boundary_for_sector(i, false);
+        // beyond max distance means nothing was seen in this direction
+        const float distance_m = (distance_cm > packet.max_distance) ? 0.0f : distance_cm * 0.01f;
+        const float angle_deg = wrap_360((float)j * increment + yaw_correction);
+        const uint16_t cell = get_cell(angle_deg);
+        batch.points++;
+
+        uint16_t index = _cell_index[cell];
+        if (index < batch.count && batch.cells[index] == cell) {
+            AP_Proximity_Map::reading &closest = batch.readings[index];
+            if (is_positive(distance_m) && (!is_positive(closest.distance_m) || distance_m < closest.distance_m)) {
+                closest.angle_deg = angle_deg;
+                closest.distance_m = distance_m;
             }
+        } else if (batch.count < _num_cells) {
+            index = batch.count++;
+            batch.cells[index] = cell;
+            batch.readings[index].angle_deg = angle_deg;
+            batch.readings[index].distance_m = distance_m;
+            _cell_index[cell] = index;
         }
     }
 }
+
+// swap out the batch decimated by the ingest thread and apply it to
+// the sectors and object avoidance database
+void AP_Proximity_MAV::apply_batch()
+{
+    ingest_batch *front;
+    {
+        WITH_SEMAPHORE(_sem);
+        if (_batch[_back].count == 0) {
+            return;
+        }
+        front = &_batch[_back];
+        _back ^= 1;
+    }
+
+    // the ingest thread only touches the back batch so the front
+    // batch can be used without holding the semaphore
+    const uint32_t now_ms = AP_HAL::millis();
+    update_readings(front->readings, front->count, now_ms, false);
+    database_push(front->readings, front->count, now_ms);
+
+    _ingest_points += front->points;
+    _ingest_readings += front->count;
+    front->count = 0;
+    front->points = 0;
+}
+
+// log the number of points ingested per second
+void AP_Proximity_MAV::Log_Write_Ingest()
+{
+    const uint32_t now_ms = AP_HAL::millis();
+    const uint32_t dt_ms = now_ms - _ingest_log_ms;
+    if (dt_ms < 1000) {
+        return;
+    }
+    if (_ingest_log_ms != 0 && (_ingest_points != 0 || _ingest_dropped != 0)) {
+        const float scale = 1000.0f / dt_ms;
+        AP::logger().Write("PRXI", "TimeUS,Pts,Rdg,Drop", "Qfff",
+                           AP_HAL::micros64(),
+                           _ingest_points * scale,
+                           _ingest_readings * scale,
+                           _ingest_dropped * scale);
+    }
+    _ingest_points = 0;
+    _ingest_readings = 0;
+    _ingest_dropped = 0;
+    _ingest_log_ms = now_ms;
+}
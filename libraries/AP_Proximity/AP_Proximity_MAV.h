@@ -2,6 +2,9 @@
 
 #include "AP_Proximity.h"
 #include "AP_Proximity_Backend.h"
+#include <AP_HAL/utility/RingBuffer.h>
+
+#define PROXIMITY_MAV_QUEUE_LEN     4   // number of OBSTACLE_DISTANCE messages queued for the ingest thread
 
 class AP_Proximity_MAV : public AP_Proximity_Backend
 {
@@ -28,6 +31,40 @@ private:
     // initialise sensor (returns true if sensor is succesfully initialised)
     bool initialise();
 
+    // OBSTACLE_DISTANCE ingest. Messages are queued by handle_msg and
+    // decimated to the closest reading in each cell (map bin) by the
+    // ingest thread. The main thread swaps out the decimated batch and
+    // applies it to the sectors and object avoidance database at once
+    struct ingest_batch {
+        AP_Proximity_Map::reading *readings;
+        uint16_t *cells;                    // decimation cell of each reading
+        uint16_t count;                     // number of readings
+        uint16_t points;                    // number of points the readings were decimated from
+    };
+
+    void start_ingest_thread();
+    void ingest_thread();
+    bool ingest_packets();
+    void ingest_packet(const mavlink_obstacle_distance_t &packet);
+    uint16_t get_cell(float angle_deg) const;
+    void apply_batch();
+    void Log_Write_Ingest();
+
+    ObjectBuffer<mavlink_obstacle_distance_t> _packets{PROXIMITY_MAV_QUEUE_LEN};
+    ingest_batch _batch[2];
+    uint8_t _back;              // batch being filled by the ingest thread
+    uint16_t *_cell_index;      // index of each cell's reading in the back batch
+    uint16_t _num_cells;
+    HAL_Semaphore _sem;         // protects _back and the back batch
+    bool _ingest_thread_tried;
+    bool _ingest_thread_started;
+
+    // ingest rate reporting
+    uint32_t _ingest_points;
+    uint32_t _ingest_readings;
+    uint32_t _ingest_dropped;
+    uint32_t _ingest_log_ms;
+
     // horizontal distance support
     uint32_t _last_update_ms;   // system time of last DISTANCE_SENSOR message received
     float _distance_max;        // max range of sensor in meters
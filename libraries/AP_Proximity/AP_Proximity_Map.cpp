@@ -0,0 +1,99 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AP_Proximity_Map.h"
+
+/*
+  allocate the map. This is the only allocation, adding readings and
+  queries never allocate
+ */
+bool AP_Proximity_Map::init(uint8_t bin_width_deg, uint16_t decay_ms)
+{
+    if (enabled() || bin_width_deg == 0 || bin_width_deg > 45 ||
+        (360 % bin_width_deg) != 0) {
+        return false;
+    }
+
+    const uint16_t num_bins = 360 / bin_width_deg;
+    _distance_cm = new uint16_t[num_bins];
+    _timestamp_ms = new uint32_t[num_bins];
+    if (_distance_cm == nullptr || _timestamp_ms == nullptr) {
+        delete[] _distance_cm;
+        delete[] _timestamp_ms;
+        _distance_cm = nullptr;
+        _timestamp_ms = nullptr;
+        return false;
+    }
+    memset(_distance_cm, 0, num_bins * sizeof(_distance_cm[0]));
+    memset(_timestamp_ms, 0, num_bins * sizeof(_timestamp_ms[0]));
+
+    _num_bins = num_bins;
+    _bin_width_deg = bin_width_deg;
+    _bins_per_deg = 1.0f / bin_width_deg;
+    _decay_ms = decay_ms;
+    return true;
+}
+
+uint16_t AP_Proximity_Map::angle_to_bin(float angle_deg) const
+{
+    // bins are centred on multiples of the bin width
+    const uint16_t bin = uint16_t(wrap_360(angle_deg + _bin_width_deg * 0.5f) * _bins_per_deg);
+    return (bin < _num_bins) ? bin : 0;
+}
+
+uint16_t AP_Proximity_Map::add(const reading &r, uint32_t timestamp_ms)
+{
+    const uint16_t bin = angle_to_bin(r.angle_deg);
+    const uint16_t distance_cm = uint16_t(constrain_float(r.distance_m * 100.0f, 0, UINT16_MAX));
+
+    if (_timestamp_ms[bin] != timestamp_ms ||
+        _distance_cm[bin] == 0 ||
+        (distance_cm != 0 && distance_cm < _distance_cm[bin])) {
+        _distance_cm[bin] = distance_cm;
+    }
+    _timestamp_ms[bin] = timestamp_ms;
+
+    return bin;
+}
+
+bool AP_Proximity_Map::get_bin_distance(uint16_t bin, uint32_t now_ms, float &distance) const
+{
+    if (bin >= _num_bins ||
+        _distance_cm[bin] == 0 ||
+        now_ms - _timestamp_ms[bin] > _decay_ms) {
+        return false;
+    }
+    distance = _distance_cm[bin] * 0.01f;
+    return true;
+}
+
+bool AP_Proximity_Map::get_closest(uint16_t first_bin, uint16_t count, uint32_t now_ms, float &angle_deg, float &distance) const
+{
+    bool found = false;
+    uint16_t bin = first_bin;
+    for (uint16_t i=0; i<count; i++) {
+        float bin_distance;
+        if (get_bin_distance(bin, now_ms, bin_distance) && (!found || bin_distance < distance)) {
+            distance = bin_distance;
+            angle_deg = bin_to_angle(bin);
+            found = true;
+        }
+        bin++;
+        if (bin >= _num_bins) {
+            bin = 0;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,76 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <AP_Common/AP_Common.h>
+#include <AP_Math/AP_Math.h>
+
+#define PROXIMITY_MAP_BINS_MAX  360 // one degree resolution
+
+/*
+  polar map of the closest object around the vehicle, in bins of equal
+  width centred on multiples of the bin width (bin 0 is centred on
+  forward). Each bin keeps the time it was last updated and is ignored
+  once it is older than the decay time
+ */
+class AP_Proximity_Map
+{
+public:
+    // a single distance reading. A distance of zero means the sensor
+    // saw nothing in that direction
+    struct reading {
+        float angle_deg;
+        float distance_m;
+    };
+
+    // allocate the map with the given bin width. Returns false if the
+    // width is out of range or memory could not be allocated
+    bool init(uint8_t bin_width_deg, uint16_t decay_ms);
+
+    // true if the map has been allocated
+    bool enabled() const { return _distance_cm != nullptr; }
+
+    uint16_t num_bins() const { return _num_bins; }
+    uint16_t decay_ms() const { return _decay_ms; }
+
+    // bin that an angle in degrees (0 is forward, clockwise) falls into
+    uint16_t angle_to_bin(float angle_deg) const;
+
+    // angle in degrees of the centre of a bin
+    float bin_to_angle(uint16_t bin) const { return bin * _bin_width_deg; }
+
+    // add a reading taken at timestamp_ms, returning the bin it was
+    // added to. Readings with the same timestamp keep the closest
+    uint16_t add(const reading &r, uint32_t timestamp_ms);
+
+    // distance in meters of the object in a bin or direction.
+    // Returns false if the bin is empty or has decayed
+    bool get_bin_distance(uint16_t bin, uint32_t now_ms, float &distance) const;
+    bool get_distance(float angle_deg, uint32_t now_ms, float &distance) const {
+        return get_bin_distance(angle_to_bin(angle_deg), now_ms, distance);
+    }
+
+    // closest object within count bins starting at first_bin, wrapping
+    // around. Returns false if all the bins are empty or have decayed
+    bool get_closest(uint16_t first_bin, uint16_t count, uint32_t now_ms, float &angle_deg, float &distance) const;
+
+private:
+    uint16_t *_distance_cm;
+    uint32_t *_timestamp_ms;
+    uint16_t _num_bins;
+    float _bin_width_deg;
+    float _bins_per_deg;
+    uint16_t _decay_ms;
+};
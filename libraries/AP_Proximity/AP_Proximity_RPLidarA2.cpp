@@ -132,6 +132,7 @@ bool AP_Proximity_RPLidarA2::initialise()
     // initialise sectors
     if (!_sector_initialised) {
         init_sectors();
+        init_map();
         return false;
     }
     if (!_initialised) {
@@ -357,6 +358,17 @@ void AP_Proximity_RPLidarA2::get_readings()
                 break;
         }
     }
+
+    flush_readings();
+}
+
+// add batched readings to the map
+void AP_Proximity_RPLidarA2::flush_readings()
+{
+    if (_num_readings > 0) {
+        update_readings(_readings, _num_readings, AP_HAL::millis());
+        _num_readings = 0;
+    }
 }
 
 void AP_Proximity_RPLidarA2::parse_response_descriptor()
@@ -402,6 +414,17 @@ void AP_Proximity_RPLidarA2::parse_response_data()
                 Debug(2, "                                       D%02.2f A%03.1f Q%02d", distance_m, angle_deg, quality);
 #endif
                 _last_distance_received_ms = AP_HAL::millis();
+                if (_map.enabled()) {
+                    // batch readings into the map, readings too close
+                    // clear the direction
+                    _readings[_num_readings].angle_deg = angle_deg;
+                    _readings[_num_readings].distance_m = (distance_m > distance_min()) ? distance_m : 0.0f;
+                    _num_readings++;
+                    if (_num_readings >= ARRAY_SIZE(_readings)) {
+                        flush_readings();
+                    }
+                    break;
+                }
                 uint8_t sector;
                 if (convert_angle_to_sector(angle_deg, sector)) {
                     if (distance_m > distance_min()) {
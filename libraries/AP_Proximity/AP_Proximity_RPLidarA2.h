@@ -77,6 +77,7 @@ private:
     void parse_response_data();
     void parse_response_descriptor();
     void get_readings();
+    void flush_readings();
     void reset_rplidar();
 
     // reply related variables
@@ -106,6 +107,10 @@ private:
     float _angle_deg_last;
     float _distance_m_last;
 
+    // readings waiting to be added to the map
+    AP_Proximity_Map::reading _readings[32];
+    uint8_t _num_readings;
+
     struct PACKED _sensor_scan {
         uint8_t startbit      : 1;            ///< on the first revolution 1 else 0
         uint8_t not_startbit  : 1;            ///< complementary to startbit
@@ -47,6 +47,30 @@ AP_RCProtocol::~AP_RCProtocol()
     }
 }
 
+/*
+  check if a backend decoded new frames while searching, locking onto
+  it once it has enough good frames. Returns true if it is now the
+  detected protocol
+ */
+bool AP_RCProtocol::check_new_frames(uint8_t i, uint32_t frame_count, uint32_t input_count, uint32_t now, bool bytes)
+{
+    const uint32_t new_frames = backend[i]->get_rc_frame_count() - frame_count;
+    if (new_frames == 0) {
+        return false;
+    }
+    // a block may carry more than one frame
+    _good_frames[i] = MIN(_good_frames[i] + new_frames, 255U);
+    if (requires_3_frames((rcprotocol_t)i) && _good_frames[i] < 3) {
+        return false;
+    }
+    _new_input = (input_count != backend[i]->get_rc_input_count());
+    _detected_protocol = (enum AP_RCProtocol::rcprotocol_t)i;
+    memset(_good_frames, 0, sizeof(_good_frames));
+    _last_input_ms = now;
+    _detected_with_bytes = bytes;
+    return true;
+}
+
 void AP_RCProtocol::process_pulse(uint32_t width_s0, uint32_t width_s1)
 {
     uint32_t now = AP_HAL::millis();
@@ -75,16 +99,7 @@ void AP_RCProtocol::process_pulse(uint32_t width_s0, uint32_t width_s1)
             uint32_t frame_count = backend[i]->get_rc_frame_count();
             uint32_t input_count = backend[i]->get_rc_input_count();
             backend[i]->process_pulse(width_s0, width_s1);
-            if (frame_count != backend[i]->get_rc_frame_count()) {
-                _good_frames[i]++;
-                if (requires_3_frames((rcprotocol_t)i) && _good_frames[i] < 3) {
-                    continue;
-                }
-                _new_input = (input_count != backend[i]->get_rc_input_count());
-                _detected_protocol = (enum AP_RCProtocol::rcprotocol_t)i;
-                memset(_good_frames, 0, sizeof(_good_frames));
-                _last_input_ms = now;
-                _detected_with_bytes = false;
+            if (check_new_frames(i, frame_count, input_count, now, false)) {
                 break;
             }
         }
@@ -99,6 +114,34 @@ void AP_RCProtocol::process_pulse_list(const uint32_t *widths, uint16_t n, bool
     if (n & 1) {
         return;
     }
+    uint32_t now = AP_HAL::millis();
+    bool searching = (now - _last_input_ms >= 200);
+    if (_detected_protocol != AP_RCProtocol::NONE && !searching) {
+        if (_detected_with_bytes) {
+            // we're using byte inputs, discard pulses
+            return;
+        }
+        // locked, so give the whole list to the current protocol
+        AP_RCProtocol_Backend *b = backend[_detected_protocol];
+        while (n) {
+            uint32_t widths0 = widths[0];
+            uint32_t widths1 = widths[1];
+            if (need_swap) {
+                uint32_t tmp = widths1;
+                widths1 = widths0;
+                widths0 = tmp;
+            }
+            widths1 -= widths0;
+            b->process_pulse(widths0, widths1);
+            widths += 2;
+            n -= 2;
+        }
+        if (b->new_input()) {
+            _new_input = true;
+            _last_input_ms = now;
+        }
+        return;
+    }
     while (n) {
         uint32_t widths0 = widths[0];
         uint32_t widths1 = widths[1];
@@ -138,22 +181,56 @@ void AP_RCProtocol::process_byte(uint8_t byte, uint32_t baudrate)
             uint32_t frame_count = backend[i]->get_rc_frame_count();
             uint32_t input_count = backend[i]->get_rc_input_count();
             backend[i]->process_byte(byte, baudrate);
-            if (frame_count != backend[i]->get_rc_frame_count()) {
-                _good_frames[i]++;
-                if (requires_3_frames((rcprotocol_t)i) && _good_frames[i] < 3) {
-                    continue;
-                }
-                _new_input = (input_count != backend[i]->get_rc_input_count());
-                _detected_protocol = (enum AP_RCProtocol::rcprotocol_t)i;
-                memset(_good_frames, 0, sizeof(_good_frames));
-                _last_input_ms = now;
-                _detected_with_bytes = true;
+            if (check_new_frames(i, frame_count, input_count, now, true)) {
                 break;
             }
         }
     }
 }
 
+/*
+  process a block of bytes received together. Once locked the whole
+  block goes to the detected protocol in one call. While searching
+  protocols that can't run at this baudrate are skipped and the rest
+  each see the whole block. Checking the frame header is left to the
+  backends, SBUS and IBUS drop a block that can't start a frame
+  without parsing it
+ */
+void AP_RCProtocol::process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate)
+{
+    if (n == 0) {
+        return;
+    }
+    uint32_t now = AP_HAL::millis();
+    bool searching = (now - _last_input_ms >= 200);
+    if (_detected_protocol != AP_RCProtocol::NONE && !_detected_with_bytes && !searching) {
+        // we're using pulse inputs, discard bytes
+        return;
+    }
+    // first try current protocol
+    if (_detected_protocol != AP_RCProtocol::NONE && !searching) {
+        backend[_detected_protocol]->process_bytes(bytes, n, baudrate);
+        if (backend[_detected_protocol]->new_input()) {
+            _new_input = true;
+            _last_input_ms = now;
+        }
+        return;
+    }
+
+    // otherwise scan all protocols
+    for (uint8_t i = 0; i < AP_RCProtocol::NONE; i++) {
+        if (backend[i] == nullptr || protocol_baudrate((rcprotocol_t)i) != baudrate) {
+            continue;
+        }
+        uint32_t frame_count = backend[i]->get_rc_frame_count();
+        uint32_t input_count = backend[i]->get_rc_input_count();
+        backend[i]->process_bytes(bytes, n, baudrate);
+        if (check_new_frames(i, frame_count, input_count, now, true)) {
+            break;
+        }
+    }
+}
+
 /*
   check for bytes from an additional uart. This is used to support RC
   protocols from SERIALn_PROTOCOL
@@ -185,13 +262,16 @@ void AP_RCProtocol::check_added_uart(void)
         }
         added.last_baud_change_ms = AP_HAL::millis();
     }
+    uint8_t b[64];
     uint32_t n = added.uart->available();
     n = MIN(n, 255U);
-    for (uint8_t i=0; i<n; i++) {
-        int16_t b = added.uart->read();
-        if (b >= 0) {
-            process_byte(uint8_t(b), added.baudrate);
+    while (n > 0) {
+        ssize_t nread = added.uart->read(b, MIN(n, sizeof(b)));
+        if (nread <= 0) {
+            break;
         }
+        process_bytes(b, nread, added.baudrate);
+        n -= nread;
     }
     if (!_detected_with_bytes) {
         if (now - added.last_baud_change_ms > 1000) {
@@ -252,6 +332,28 @@ void AP_RCProtocol::start_bind(void)
     }
 }
 
+/*
+  return the baudrate a protocol uses for byte input
+ */
+uint32_t AP_RCProtocol::protocol_baudrate(rcprotocol_t protocol)
+{
+    switch (protocol) {
+    case SBUS:
+    case SBUS_NI:
+        return 100000;
+    case IBUS:
+    case DSM:
+    case SUMD:
+    case SRXL:
+    case ST24:
+        return 115200;
+    case PPM:
+    case NONE:
+        break;
+    }
+    return 0;
+}
+
 /*
   return protocol name
  */
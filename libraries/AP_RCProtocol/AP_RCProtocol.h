@@ -47,6 +47,7 @@ public:
     void process_pulse(uint32_t width_s0, uint32_t width_s1);
     void process_pulse_list(const uint32_t *widths, uint16_t n, bool need_swap);
     void process_byte(uint8_t byte, uint32_t baudrate);
+    void process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate);
     void update(void);
 
     void disable_for_pulses(enum rcprotocol_t protocol) {
@@ -67,6 +68,9 @@ public:
     bool new_input();
     void start_bind(void);
 
+    // serial baudrate a protocol uses for byte input, 0 for pulse only
+    static uint32_t protocol_baudrate(rcprotocol_t protocol);
+
     // return protocol name as a string
     static const char *protocol_name_from_protocol(rcprotocol_t protocol);
 
@@ -83,6 +87,7 @@ public:
 
 private:
     void check_added_uart(void);
+    bool check_new_frames(uint8_t i, uint32_t frame_count, uint32_t input_count, uint32_t now, bool bytes);
 
     enum rcprotocol_t _detected_protocol = NONE;
     uint16_t _disabled_for_pulses;
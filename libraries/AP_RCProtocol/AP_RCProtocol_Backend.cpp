@@ -36,6 +36,16 @@ bool AP_RCProtocol_Backend::new_input()
     return ret;
 }
 
+/*
+  default block input, one byte at a time
+ */
+void AP_RCProtocol_Backend::process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate)
+{
+    while (n--) {
+        process_byte(*bytes++, baudrate);
+    }
+}
+
 uint8_t AP_RCProtocol_Backend::num_channels()
 {
     return _num_channels;
@@ -27,6 +27,10 @@ public:
     virtual ~AP_RCProtocol_Backend() {}
     virtual void process_pulse(uint32_t width_s0, uint32_t width_s1) {}
     virtual void process_byte(uint8_t byte, uint32_t baudrate) {}
+
+    // process a block of bytes received together. Backends with
+    // fixed size frames override this to decode whole frames at once
+    virtual void process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate);
     uint16_t read(uint8_t chan);
     bool new_input();
     uint8_t num_channels();
@@ -15,6 +15,7 @@
  */
 
 #include "AP_RCProtocol_IBUS.h"
+#include <AP_Math/AP_Math.h>
 
 // constructor
 AP_RCProtocol_IBUS::AP_RCProtocol_IBUS(AP_RCProtocol &_frontend) :
@@ -87,13 +88,19 @@ void AP_RCProtocol_IBUS::_process_byte(uint32_t timestamp_us, uint8_t b)
     byte_input.buf[byte_input.ofs++] = b;
 
     if (byte_input.ofs == sizeof(byte_input.buf)) {
-        uint16_t values[IBUS_INPUT_CHANNELS];
-        bool ibus_failsafe = false;
-        if (ibus_decode(byte_input.buf, values, &ibus_failsafe)) {
-            add_input(IBUS_INPUT_CHANNELS, values, ibus_failsafe);
-        }
-        byte_input.ofs = 0;
+        _process_frame();
+    }
+}
+
+// decode a complete frame in byte_input.buf
+void AP_RCProtocol_IBUS::_process_frame(void)
+{
+    uint16_t values[IBUS_INPUT_CHANNELS];
+    bool ibus_failsafe = false;
+    if (ibus_decode(byte_input.buf, values, &ibus_failsafe)) {
+        add_input(IBUS_INPUT_CHANNELS, values, ibus_failsafe);
     }
+    byte_input.ofs = 0;
 }
 
 // support byte input
@@ -104,3 +111,39 @@ void AP_RCProtocol_IBUS::process_byte(uint8_t b, uint32_t baudrate)
     }
     _process_byte(AP_HAL::micros(), b);
 }
+
+/*
+  support block input, copying whole frames at once. Only the first
+  byte of a block can follow a frame gap, but a block may hold several
+  frames back to back
+ */
+void AP_RCProtocol_IBUS::process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate)
+{
+    if (baudrate != 115200 || n == 0) {
+        return;
+    }
+    const uint32_t now = AP_HAL::micros();
+    // a frame can start after a frame gap, or straight after
+    // another frame when the reader has fallen behind
+    bool frame_boundary = (now - byte_input.last_byte_us >= 2000U);
+    byte_input.last_byte_us = now;
+
+    if (frame_boundary) {
+        byte_input.ofs = 0;
+    }
+    while (n > 0) {
+        if (byte_input.ofs == 0 && (!frame_boundary || bytes[0] != 0x20)) {
+            // can't start a frame in the rest of this block
+            return;
+        }
+        const uint16_t len = MIN(n, sizeof(byte_input.buf) - byte_input.ofs);
+        memcpy(&byte_input.buf[byte_input.ofs], bytes, len);
+        byte_input.ofs += len;
+        bytes += len;
+        n -= len;
+        if (byte_input.ofs == sizeof(byte_input.buf)) {
+            _process_frame();
+            frame_boundary = true;
+        }
+    }
+}
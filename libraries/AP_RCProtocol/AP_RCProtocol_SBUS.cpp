@@ -52,6 +52,7 @@
  */
 
 #include "AP_RCProtocol_SBUS.h"
+#include <AP_Math/AP_Math.h>
 
 #define SBUS_FRAME_SIZE		25
 #define SBUS_INPUT_CHANNELS	16
@@ -246,17 +247,23 @@ void AP_RCProtocol_SBUS::_process_byte(uint32_t timestamp_us, uint8_t b)
     byte_input.buf[byte_input.ofs++] = b;
 
     if (byte_input.ofs == sizeof(byte_input.buf)) {
-        uint16_t values[SBUS_INPUT_CHANNELS];
-        uint16_t num_values=0;
-        bool sbus_failsafe = false;
-        bool sbus_frame_drop = false;
-        if (sbus_decode(byte_input.buf, values, &num_values,
-                        &sbus_failsafe, &sbus_frame_drop, SBUS_INPUT_CHANNELS) &&
-            num_values >= MIN_RCIN_CHANNELS) {
-            add_input(num_values, values, sbus_failsafe);
-        }
-        byte_input.ofs = 0;
+        _process_frame();
+    }
+}
+
+// decode a complete frame in byte_input.buf
+void AP_RCProtocol_SBUS::_process_frame(void)
+{
+    uint16_t values[SBUS_INPUT_CHANNELS];
+    uint16_t num_values=0;
+    bool sbus_failsafe = false;
+    bool sbus_frame_drop = false;
+    if (sbus_decode(byte_input.buf, values, &num_values,
+                    &sbus_failsafe, &sbus_frame_drop, SBUS_INPUT_CHANNELS) &&
+        num_values >= MIN_RCIN_CHANNELS) {
+        add_input(num_values, values, sbus_failsafe);
     }
+    byte_input.ofs = 0;
 }
 
 // support byte input
@@ -267,3 +274,39 @@ void AP_RCProtocol_SBUS::process_byte(uint8_t b, uint32_t baudrate)
     }
     _process_byte(AP_HAL::micros(), b);
 }
+
+/*
+  support block input. The bytes arrived together so only the first
+  can follow a frame gap, which lets us copy whole frames at once. A
+  block may hold several frames back to back
+ */
+void AP_RCProtocol_SBUS::process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate)
+{
+    if (baudrate != 100000 || n == 0) {
+        return;
+    }
+    const uint32_t now = AP_HAL::micros();
+    // a frame can start after a frame gap, or straight after
+    // another frame when the reader has fallen behind
+    bool frame_boundary = (now - byte_input.last_byte_us >= 2000U);
+    byte_input.last_byte_us = now;
+
+    if (frame_boundary) {
+        byte_input.ofs = 0;
+    }
+    while (n > 0) {
+        if (byte_input.ofs == 0 && (!frame_boundary || bytes[0] != 0x0F)) {
+            // can't start a frame in the rest of this block
+            return;
+        }
+        const uint16_t len = MIN(n, sizeof(byte_input.buf) - byte_input.ofs);
+        memcpy(&byte_input.buf[byte_input.ofs], bytes, len);
+        byte_input.ofs += len;
+        bytes += len;
+        n -= len;
+        if (byte_input.ofs == sizeof(byte_input.buf)) {
+            _process_frame();
+            frame_boundary = true;
+        }
+    }
+}
@@ -25,8 +25,10 @@ public:
     AP_RCProtocol_SBUS(AP_RCProtocol &_frontend, bool inverted);
     void process_pulse(uint32_t width_s0, uint32_t width_s1) override;
     void process_byte(uint8_t byte, uint32_t baudrate) override;
+    void process_bytes(const uint8_t *bytes, uint16_t n, uint32_t baudrate) override;
 private:
     void _process_byte(uint32_t timestamp_us, uint8_t byte);
+    void _process_frame(void);
     bool sbus_decode(const uint8_t frame[25], uint16_t *values, uint16_t *num_values,
                      bool *sbus_failsafe, bool *sbus_frame_drop, uint16_t max_values);
 
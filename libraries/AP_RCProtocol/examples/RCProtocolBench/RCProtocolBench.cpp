@@ -0,0 +1,163 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  RC input latency benchmark. Replays frame streams through
+  process_byte() and process_bytes(), reporting the frames needed to
+  lock on and the time from a frame arriving to new input being
+  available. Figures are only reported for streams that decode to the
+  expected protocol and values
+ */
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_RCProtocol/AP_RCProtocol.h>
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+#include <time.h>
+#endif
+
+void setup();
+void loop();
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+static const uint8_t sbus_bytes[] = {0x0F, 0x4C, 0x1C, 0x5F, 0x32, 0x34, 0x38, 0xDD, 0x89,
+                                     0x83, 0x0F, 0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+static const uint8_t dsm_bytes[] = {0x00, 0xab, 0x00, 0xae, 0x08, 0xbf, 0x10, 0xd0, 0x18,
+                                    0xe1, 0x20, 0xf2, 0x29, 0x03, 0x31, 0x14, 0x00, 0xab,
+                                    0x39, 0x25, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                    0xff, 0xff, 0xff, 0xff, 0xff};
+
+static const uint8_t sumd_bytes[] = {0xA8, 0x01, 0x08, 0x2F, 0x50, 0x31, 0xE8, 0x21, 0xA0,
+                                     0x2F, 0x50, 0x22, 0x60, 0x22, 0x60, 0x2E, 0xE0, 0x2E,
+                                     0xE0, 0x87, 0xC6};
+
+static const uint8_t ibus_bytes[] = {0x20, 0x40, 0xdc, 0x05, 0xdc, 0x05, 0xe8, 0x03, 0xdc, 0x05,
+                                     0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05,
+                                     0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05, 0xdc, 0x05,
+                                     0x47, 0xf3};
+
+// frames are sent at the usual rate for each protocol, which gives
+// the decoders the frame gaps they sync on
+static const struct {
+    const char *name;
+    uint32_t baudrate;
+    const uint8_t *bytes;
+    uint8_t nbytes;
+    uint16_t frame_us;
+    uint8_t nchannels;
+    uint16_t chan1;
+} streams[] = {
+    { "SBUS", 100000, sbus_bytes, sizeof(sbus_bytes), 14000, 16, 1562 },
+    { "DSM",  115200, dsm_bytes,  sizeof(dsm_bytes),  11000,  8, 1010 },
+    { "SUMD", 115200, sumd_bytes, sizeof(sumd_bytes), 10000,  8, 1597 },
+    { "IBUS", 115200, ibus_bytes, sizeof(ibus_bytes),  7000, 14, 1500 },
+};
+
+#define NUM_FRAMES 200
+
+/*
+  wall clock time. AP_HAL::micros64() is simulated time on SITL and
+  doesn't advance while the benchmark runs
+ */
+static uint64_t bench_time_ns(void)
+{
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return AP_HAL::micros64() * 1000ULL;
+#endif
+}
+
+/*
+  check the protocol decoded to the values in the test vector
+ */
+static bool check_decode(AP_RCProtocol &rcprot, uint8_t s)
+{
+    const char *pname = rcprot.protocol_name();
+    return rcprot.protocol_detected() != AP_RCProtocol::NONE &&
+        strncmp(pname, streams[s].name, strlen(pname)) == 0 &&
+        rcprot.num_channels() == streams[s].nchannels &&
+        rcprot.read(0) == streams[s].chan1;
+}
+
+/*
+  replay a stream, one frame every frame_us
+ */
+static void bench(uint8_t s, bool block)
+{
+    AP_RCProtocol *rcprot = new AP_RCProtocol();
+    rcprot->init();
+
+    uint16_t lock_frames = 0;
+    uint32_t decoded = 0;
+    uint64_t search_ns = 0;
+    uint64_t locked_ns = 0;
+
+    for (uint16_t f=0; f<NUM_FRAMES; f++) {
+        hal.scheduler->delay_microseconds(streams[s].frame_us);
+        const bool locked = rcprot->protocol_detected() != AP_RCProtocol::NONE;
+        const uint64_t t0 = bench_time_ns();
+        if (block) {
+            rcprot->process_bytes(streams[s].bytes, streams[s].nbytes, streams[s].baudrate);
+        } else {
+            for (uint8_t i=0; i<streams[s].nbytes; i++) {
+                rcprot->process_byte(streams[s].bytes[i], streams[s].baudrate);
+            }
+        }
+        const bool have_input = rcprot->new_input();
+        const uint64_t dt = bench_time_ns() - t0;
+        if (locked) {
+            locked_ns += dt;
+            decoded += (have_input && check_decode(*rcprot, s))?1:0;
+        } else {
+            search_ns += dt;
+            lock_frames++;
+        }
+    }
+
+    const uint16_t locked_frames = NUM_FRAMES - lock_frames;
+    if (locked_frames == 0 || decoded != locked_frames) {
+        hal.console->printf("%-4s %-5s FAILED: %u/%u frames decoded\n",
+                            streams[s].name, block?"block":"byte",
+                            (unsigned)decoded, locked_frames);
+    } else {
+        hal.console->printf("%-4s %-5s lock after %2u frames, search %.3fus/frame, locked %.3fus/frame\n",
+                            streams[s].name, block?"block":"byte",
+                            lock_frames,
+                            lock_frames?(double)(search_ns * 0.001f / lock_frames):0.0,
+                            (double)(locked_ns * 0.001f / locked_frames));
+    }
+    delete rcprot;
+}
+
+void setup()
+{
+    hal.console->printf("RC protocol latency benchmark\n");
+    hal.scheduler->delay(100);
+}
+
+void loop()
+{
+    for (uint8_t s=0; s<ARRAY_SIZE(streams); s++) {
+        bench(s, false);
+        bench(s, true);
+    }
+    hal.scheduler->delay(5000);
+}
+
+AP_HAL_MAIN();
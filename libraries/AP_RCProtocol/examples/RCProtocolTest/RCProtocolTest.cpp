@@ -85,6 +85,51 @@ static bool test_byte_protocol(const char *name, uint32_t baudrate,
     return ret;
 }
 
+/*
+  test a byte protocol handler with the frame given as one block
+ */
+static bool test_block_protocol(const char *name, uint32_t baudrate,
+                                const uint8_t *bytes, uint8_t nbytes,
+                                const uint16_t *values, uint8_t nvalues,
+                                uint8_t repeats)
+{
+    bool ret = true;
+    for (uint8_t repeat=0; repeat<repeats+4; repeat++) {
+        rcprot->process_bytes(bytes, nbytes, baudrate);
+        hal.scheduler->delay(10);
+        if (repeat > repeats) {
+            ret &= check_result(name, true, values, nvalues);
+        }
+    }
+    return ret;
+}
+
+/*
+  test a byte protocol handler with several frames in each block, as
+  a UART read returns when the reader falls behind
+ */
+static bool test_multi_block_protocol(const char *name, uint32_t baudrate,
+                                      const uint8_t *bytes, uint8_t nbytes,
+                                      const uint16_t *values, uint8_t nvalues,
+                                      uint8_t repeats)
+{
+    bool ret = true;
+    const uint8_t nframes = repeats + 1;
+    uint8_t *block = new uint8_t[nbytes * nframes];
+    for (uint8_t f=0; f<nframes; f++) {
+        memcpy(&block[f*nbytes], bytes, nbytes);
+    }
+    // the first block has enough frames to lock on, the rest are
+    // decoded by the detected protocol
+    for (uint8_t i=0; i<3; i++) {
+        rcprot->process_bytes(block, nbytes * nframes, baudrate);
+        hal.scheduler->delay(10);
+        ret &= check_result(name, true, values, nvalues);
+    }
+    delete[] block;
+    return ret;
+}
+
 static void send_bit(uint8_t bit, uint32_t baudrate)
 {
     static uint16_t bits_0, bits_1;
@@ -164,7 +209,7 @@ static bool test_pulse_protocol(const char *name, uint32_t baudrate,
 static bool test_protocol(const char *name, uint32_t baudrate,
                           const uint8_t *bytes, uint8_t nbytes,
                           const uint16_t *values, uint8_t nvalues,
-                          uint8_t repeats=1)
+                          uint8_t repeats=1, bool multi_block=true)
 {
     bool ret = true;
 
@@ -173,6 +218,18 @@ static bool test_protocol(const char *name, uint32_t baudrate,
     ret &= test_byte_protocol(name, baudrate, bytes, nbytes, values, nvalues, repeats);
     delete rcprot;
 
+    rcprot = new AP_RCProtocol();
+    rcprot->init();
+    ret &= test_block_protocol(name, baudrate, bytes, nbytes, values, nvalues, repeats);
+    delete rcprot;
+
+    if (multi_block) {
+        rcprot = new AP_RCProtocol();
+        rcprot->init();
+        ret &= test_multi_block_protocol(name, baudrate, bytes, nbytes, values, nvalues, repeats);
+        delete rcprot;
+    }
+
     rcprot = new AP_RCProtocol();
     rcprot->init();
     ret &= test_pulse_protocol(name, baudrate, bytes, nbytes, values, nvalues, repeats);
@@ -228,8 +285,10 @@ void loop()
     // SBUS needs 3 repeats to pass the RCProtocol 3 frames test
     test_protocol("SBUS", 100000, sbus_bytes, sizeof(sbus_bytes), sbus_output, ARRAY_SIZE(sbus_output), 3);
 
-    // DSM needs 8 repeats, 5 to guess the format, then 3 to pass the RCProtocol 3 frames test
-    test_protocol("DSM", 115200, dsm_bytes, sizeof(dsm_bytes), dsm_output, ARRAY_SIZE(dsm_output), 9);
+    // DSM needs 8 repeats, 5 to guess the format, then 3 to pass the RCProtocol 3 frames test.
+    // DSM has no header byte, it finds the start of a frame from the gap before it, so
+    // frames back to back in one block can't be decoded
+    test_protocol("DSM", 115200, dsm_bytes, sizeof(dsm_bytes), dsm_output, ARRAY_SIZE(dsm_output), 9, false);
 }
 
 AP_HAL_MAIN();
@@ -39,6 +39,21 @@ const uint8_t *AP_ROMFS::find_file(const char *name, uint32_t &size)
     return nullptr;
 }
 
+/*
+  list the files in a directory
+*/
+const char *AP_ROMFS::dir_list(const char *dirname, uint16_t &ofs)
+{
+    const size_t dlen = strlen(dirname);
+    for ( ; ofs < ARRAY_SIZE(files); ofs++) {
+        if (strncmp(dirname, files[ofs].filename, dlen) == 0 &&
+            files[ofs].filename[dlen] == '/') {
+            return files[ofs++].filename;
+        }
+    }
+    return nullptr;
+}
+
 /*
   find a compressed file and uncompress it. Space for decompressed
   data comes from malloc. Caller must be careful to free the resulting
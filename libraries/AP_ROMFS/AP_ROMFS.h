@@ -12,11 +12,19 @@ public:
     // call free on the return value after use. The next byte after
     // the file data is guaranteed to be null.
     static uint8_t *find_decompress(const char *name, uint32_t &size);
-    
-private:
-    // find an embedded file
+
+    // find an embedded file. Files that are embedded uncompressed
+    // (such as precompiled lua bytecode) can be used directly from
+    // flash without a copy
     static const uint8_t *find_file(const char *name, uint32_t &size);
 
+    // list the files in a directory. ofs should start at zero and is
+    // advanced on each call. Returns nullptr when there are no more
+    // files. The returned name includes the directory
+    static const char *dir_list(const char *dirname, uint16_t &ofs);
+
+private:
+
     struct embedded_file {
         const char *filename;
         uint32_t size;
@@ -26,6 +26,8 @@
 #include <AP_Logger/AP_Logger.h>
 #include <AP_InertialSensor/AP_InertialSensor.h>
 #include <AP_InternalError/AP_InternalError.h>
+#include <StorageManager/StorageManager.h>
+#include <AP_Filesystem/AP_Filesystem_Async.h>
 #if CONFIG_HAL_BOARD == HAL_BOARD_SITL
 #include <SITL/SITL.h>
 #endif
@@ -355,6 +357,21 @@ void AP_Scheduler::Log_Write_Performance()
         extra_loop_us    : extra_loop_us,
     };
     AP::logger().WriteCriticalBlock(&pkt, sizeof(pkt));
+
+    // storage writes requested vs writes made to the backend, to
+    // show how well writes are being coalesced
+    AP::logger().Write("STOR",
+                       "TimeUS,Writes,Backend",
+                       "s--",
+                       "F--",
+                       "QII",
+                       AP_HAL::micros64(),
+                       StorageManager::get_write_count(),
+                       hal.storage->backend_writes());
+
+#if HAVE_FILESYSTEM_SUPPORT
+    AP::FS_async().Log_Write();
+#endif
 }
 
 namespace AP {
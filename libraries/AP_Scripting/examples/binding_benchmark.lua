@@ -0,0 +1,44 @@
+-- reports the heap allocations and VM instructions used per call of some
+-- hot bindings, comparing a new result object against writing in place
+
+local calls = 50
+local gyro = Vector3f()
+local pos = Location()
+local now = uint32_t()
+
+local benchmarks = {
+  {"baseline",       function () end},
+  {"millis",         function () return millis() end},
+  {"millis(out)",    function () return millis(now) end},
+  {"get_gyro",       function () return ahrs:get_gyro() end},
+  {"get_gyro(out)",  function () return ahrs:get_gyro(gyro) end},
+  {"get_home",       function () return ahrs:get_home() end},
+  {"get_home(out)",  function () return ahrs:get_home(pos) end},
+  {"gyro:x()",       function () return gyro:x() end},
+}
+
+local baseline_steps = 0
+local index = 1
+
+function update ()
+  local name = benchmarks[index][1]
+  local fn = benchmarks[index][2]
+
+  local allocs = perf.alloc_count()
+  local steps = perf.vm_steps()
+  for i = 1, calls do
+    fn()
+  end
+  steps = (perf.vm_steps() - steps) / calls
+  allocs = (perf.alloc_count() - allocs) / calls
+
+  if index == 1 then
+    baseline_steps = steps
+  end
+  gcs:send_text(6, string.format("%s: %.1f allocs %.1f steps per call", name, allocs, steps - baseline_steps))
+
+  index = (index % #benchmarks) + 1
+  return update, 1000
+end
+
+return update, 1000
@@ -836,6 +836,16 @@ void emit_userdata_allocators(void) {
     fprintf(source, "    lua_setmetatable(L, -2);\n");
     fprintf(source, "    return 1;\n");
     fprintf(source, "}\n\n");
+
+    // push the caller provided output object, or a new one if none was provided
+    fprintf(source, "int output_%s(lua_State *L, int arg) {\n", node->name);
+    fprintf(source, "    if (arg == 0) {\n");
+    fprintf(source, "        return new_%s(L);\n", node->name);
+    fprintf(source, "    }\n");
+    fprintf(source, "    luaL_checkstack(L, 1, \"Out of stack\");\n");
+    fprintf(source, "    lua_pushvalue(L, arg);\n");
+    fprintf(source, "    return 1;\n");
+    fprintf(source, "}\n\n");
     node = node->next;
   }
 }
@@ -855,6 +865,7 @@ void emit_userdata_declarations(void) {
   struct userdata * node = parsed_userdata;
   while (node) {
     fprintf(header, "int new_%s(lua_State *L);\n", node->name);
+    fprintf(header, "int output_%s(lua_State *L, int arg);\n", node->name);
     fprintf(header, "%s * check_%s(lua_State *L, int arg);\n", node->name, node->name);
     node = node->next;
   }
@@ -1144,8 +1155,39 @@ void emit_userdata_fields() {
   }
 }
 
+// returns the type of the single boxed value a method returns, or NULL if it
+// doesn't return exactly one. The caller may pass an existing object of this
+// type as an extra trailing argument to have the result written in place
+const struct type * method_output_type(const struct method *method) {
+  const struct type *output = NULL;
+  if (method->return_type.type == TYPE_BOOLEAN && (method->flags & TYPE_FLAGS_NULLABLE)) {
+    struct argument *arg = method->arguments;
+    while (arg != NULL) {
+      if (arg->type.flags & TYPE_FLAGS_NULLABLE) {
+        if (output != NULL) {
+          return NULL;
+        }
+        output = &(arg->type);
+      }
+      arg = arg->next;
+    }
+  } else {
+    output = &(method->return_type);
+  }
+
+  if ((output != NULL) && ((output->type == TYPE_USERDATA) || (output->type == TYPE_UINT32_T))) {
+    return output;
+  }
+  return NULL;
+}
+
+const char * output_type_name(const struct type *t) {
+  return (t->type == TYPE_USERDATA) ? t->data.userdata_name : keyword_uint32_t;
+}
+
 void emit_userdata_method(const struct userdata *data, const struct method *method) {
   int arg_count = 1;
+  const struct type *output = method_output_type(method);
 
   const char *access_name = data->alias ? data->alias : data->name;
   // bind ud early if it's a singleton, so that we can use it in the range checks
@@ -1169,7 +1211,15 @@ void emit_userdata_method(const struct userdata *data, const struct method *meth
     }
     arg = arg->next;
   }
-  fprintf(source, "    binding_argcheck(L, %d);\n", arg_count);
+  if (output != NULL) {
+    fprintf(source, "    const int out_arg = binding_argcheck_output(L, %d);\n", arg_count);
+    // check the output early, so that we don't error while holding a semaphore
+    fprintf(source, "    if (out_arg != 0) {\n");
+    fprintf(source, "        check_%s(L, out_arg);\n", output_type_name(output));
+    fprintf(source, "    }\n");
+  } else {
+    fprintf(source, "    binding_argcheck(L, %d);\n", arg_count);
+  }
 
   switch (data->ud_type) {
     case UD_USERDATA:
@@ -1309,15 +1359,15 @@ void emit_userdata_method(const struct userdata *data, const struct method *meth
                 fprintf(source, "        lua_pushinteger(L, data_%d);\n", arg_index);
                 break;
               case TYPE_UINT32_T:
-                fprintf(source, "        new_uint32_t(L);\n");
+                fprintf(source, "        output_uint32_t(L, out_arg);\n");
                 fprintf(source, "        *static_cast<uint32_t *>(luaL_checkudata(L, -1, \"uint32_t\")) = data_%d;\n", arg_index);
                 break;
               case TYPE_STRING:
                 fprintf(source, "        lua_pushstring(L, data_%d);\n", arg_index);
                 break;
               case TYPE_USERDATA:
-                // userdatas must allocate a new container to return
-                fprintf(source, "        new_%s(L);\n", arg->type.data.userdata_name);
+                // userdatas must allocate a new container to return, unless the caller provided one
+                fprintf(source, "        output_%s(L, out_arg);\n", arg->type.data.userdata_name);
                 fprintf(source, "        *check_%s(L, -1) = data_%d;\n", arg->type.data.userdata_name, arg_index);
                 break;
               case TYPE_NONE:
@@ -1351,15 +1401,15 @@ void emit_userdata_method(const struct userdata *data, const struct method *meth
       fprintf(source, "    lua_pushinteger(L, data);\n");
       break;
     case TYPE_UINT32_T:
-      fprintf(source, "        new_uint32_t(L);\n");
+      fprintf(source, "        output_uint32_t(L, out_arg);\n");
       fprintf(source, "        *static_cast<uint32_t *>(luaL_checkudata(L, -1, \"uint32_t\")) = data;\n");
       break;
     case TYPE_STRING:
       fprintf(source, "    lua_pushstring(L, data);\n");
       break;
     case TYPE_USERDATA:
-      // userdatas must allocate a new container to return
-      fprintf(source, "    new_%s(L);\n", method->return_type.data.userdata_name);
+      // userdatas must allocate a new container to return, unless the caller provided one
+      fprintf(source, "    output_%s(L, out_arg);\n", method->return_type.data.userdata_name);
       fprintf(source, "    *check_%s(L, -1) = data;\n", method->return_type.data.userdata_name);
       break;
     case TYPE_NONE:
@@ -1648,6 +1698,16 @@ void emit_argcheck_helper(void) {
   fprintf(source, "    }\n");
   fprintf(source, "    return 0;\n");
   fprintf(source, "}\n\n");
+
+  // methods returning a boxed value take an optional trailing argument to write the result into
+  fprintf(source, "static int binding_argcheck_output(lua_State *L, int expected_arg_count) {\n");
+  fprintf(source, "    const int args = lua_gettop(L);\n");
+  fprintf(source, "    if (args == (expected_arg_count + 1)) {\n");
+  fprintf(source, "        return lua_isnil(L, args) ? 0 : args;\n");
+  fprintf(source, "    }\n");
+  fprintf(source, "    binding_argcheck(L, expected_arg_count);\n");
+  fprintf(source, "    return 0;\n");
+  fprintf(source, "}\n\n");
 }
 
 
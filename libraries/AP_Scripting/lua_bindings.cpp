@@ -6,6 +6,7 @@
 
 #include "lua_boxed_numerics.h"
 #include "lua_generated_bindings.h"
+#include "lua_scripts.h"
 
 extern const AP_HAL::HAL& hal;
 
@@ -42,26 +43,61 @@ static int lua_servo_set_output_pwm(lua_State *L) {
     return 0;
 }
 
-// millis
+// millis, optionally written into an existing uint32_t to avoid an allocation
 static int lua_millis(lua_State *L) {
-    check_arguments(L, 0, "millis");
+    const int args = lua_gettop(L);
+    if (args > 1) {
+        return luaL_error(L, "millis expected at most 1 argument got %d", args);
+    }
 
-    new_uint32_t(L);
+    const int out_arg = ((args == 1) && !lua_isnil(L, 1)) ? 1 : 0;
+    if (out_arg != 0) {
+        check_uint32_t(L, out_arg);
+    }
+
+    output_uint32_t(L, out_arg);
     *check_uint32_t(L, -1) = AP_HAL::millis();
 
     return 1;
 }
 
+// perf counters, used to measure the cost of bindings
+static int lua_perf_alloc_count(lua_State *L) {
+    check_arguments(L, 0, "alloc_count");
+
+    lua_pushinteger(L, lua_scripts::get_alloc_count());
+
+    return 1;
+}
+
+static int lua_perf_vm_steps(lua_State *L) {
+    check_arguments(L, 0, "vm_steps");
+
+    lua_pushinteger(L, lua_scripts::get_vm_steps(L));
+
+    return 1;
+}
+
 static const luaL_Reg servo_functions[] =
 {
     {"set_output_pwm", lua_servo_set_output_pwm},
     {NULL, NULL}
 };
 
+static const luaL_Reg perf_functions[] =
+{
+    {"alloc_count", lua_perf_alloc_count},
+    {"vm_steps", lua_perf_vm_steps},
+    {NULL, NULL}
+};
+
 void load_lua_bindings(lua_State *L) {
     luaL_newlib(L, servo_functions);
     lua_setglobal(L, "servo");
 
+    luaL_newlib(L, perf_functions);
+    lua_setglobal(L, "perf");
+
     load_generated_bindings(L);
 
     lua_pushcfunction(L, lua_millis);
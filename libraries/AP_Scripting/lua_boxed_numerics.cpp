@@ -12,6 +12,15 @@ int new_uint32_t(lua_State *L) {
     return 1;
 }
 
+int output_uint32_t(lua_State *L, int arg) {
+    if (arg == 0) {
+        return new_uint32_t(L);
+    }
+    luaL_checkstack(L, 1, "Out of stack");
+    lua_pushvalue(L, arg);
+    return 1;
+}
+
 uint32_t * check_uint32_t(lua_State *L, int arg) {
     void *data = luaL_checkudata(L, arg, "uint32_t");
     return static_cast<uint32_t *>(data);
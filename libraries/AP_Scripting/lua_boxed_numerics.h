@@ -3,6 +3,7 @@
 #include "lua/src/lua.hpp"
 
 int new_uint32_t(lua_State *L);
+int output_uint32_t(lua_State *L, int arg); // push the uint32_t at arg, or a new one if arg is 0
 uint32_t *check_uint32_t(lua_State *L, int arg);
 
 void load_boxed_numerics(lua_State *L);
@@ -30,6 +30,15 @@ static int binding_argcheck(lua_State *L, int expected_arg_count) {
     return 0;
 }
 
+static int binding_argcheck_output(lua_State *L, int expected_arg_count) {
+    const int args = lua_gettop(L);
+    if (args == (expected_arg_count + 1)) {
+        return lua_isnil(L, args) ? 0 : args;
+    }
+    binding_argcheck(L, expected_arg_count);
+    return 0;
+}
+
 int new_Vector2f(lua_State *L) {
     luaL_checkstack(L, 2, "Out of stack");
     void *ud = lua_newuserdata(L, sizeof(Vector2f));
@@ -40,6 +49,15 @@ int new_Vector2f(lua_State *L) {
     return 1;
 }
 
+int output_Vector2f(lua_State *L, int arg) {
+    if (arg == 0) {
+        return new_Vector2f(L);
+    }
+    luaL_checkstack(L, 1, "Out of stack");
+    lua_pushvalue(L, arg);
+    return 1;
+}
+
 int new_Vector3f(lua_State *L) {
     luaL_checkstack(L, 2, "Out of stack");
     void *ud = lua_newuserdata(L, sizeof(Vector3f));
@@ -50,6 +68,15 @@ int new_Vector3f(lua_State *L) {
     return 1;
 }
 
+int output_Vector3f(lua_State *L, int arg) {
+    if (arg == 0) {
+        return new_Vector3f(L);
+    }
+    luaL_checkstack(L, 1, "Out of stack");
+    lua_pushvalue(L, arg);
+    return 1;
+}
+
 int new_Location(lua_State *L) {
     luaL_checkstack(L, 2, "Out of stack");
     void *ud = lua_newuserdata(L, sizeof(Location));
@@ -60,6 +87,15 @@ int new_Location(lua_State *L) {
     return 1;
 }
 
+int output_Location(lua_State *L, int arg) {
+    if (arg == 0) {
+        return new_Location(L);
+    }
+    luaL_checkstack(L, 1, "Out of stack");
+    lua_pushvalue(L, arg);
+    return 1;
+}
+
 Vector2f * check_Vector2f(lua_State *L, int arg) {
     void *data = luaL_checkudata(L, arg, "Vector2f");
     return (Vector2f *)data;
@@ -390,14 +426,17 @@ static int Vector3f___sub(lua_State *L) {
 }
 
 static int Location_get_vector_from_origin_NEU(lua_State *L) {
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     Location * ud = check_Location(L, 1);
     Vector3f data_5002 = {};
     const bool data = ud->get_vector_from_origin_NEU(
             data_5002);
 
     if (data) {
-        new_Vector3f(L);
+        output_Vector3f(L, out_arg);
         *check_Vector3f(L, -1) = data_5002;
     } else {
         lua_pushnil(L);
@@ -699,14 +738,17 @@ static int AP_GPS_get_antenna_offset(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const Vector3f &data = ud->get_antenna_offset(
             data_2);
 
-    new_Vector3f(L);
+    output_Vector3f(L, out_arg);
     *check_Vector3f(L, -1) = data;
     return 1;
 }
@@ -734,14 +776,17 @@ static int AP_GPS_last_message_time_ms(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_uint32_t(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const uint32_t data = ud->last_message_time_ms(
             data_2);
 
-        new_uint32_t(L);
+        output_uint32_t(L, out_arg);
         *static_cast<uint32_t *>(luaL_checkudata(L, -1, "uint32_t")) = data;
     return 1;
 }
@@ -752,14 +797,17 @@ static int AP_GPS_last_fix_time_ms(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_uint32_t(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const uint32_t data = ud->last_fix_time_ms(
             data_2);
 
-        new_uint32_t(L);
+        output_uint32_t(L, out_arg);
         *static_cast<uint32_t *>(luaL_checkudata(L, -1, "uint32_t")) = data;
     return 1;
 }
@@ -804,14 +852,17 @@ static int AP_GPS_time_week_ms(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_uint32_t(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const uint32_t data = ud->time_week_ms(
             data_2);
 
-        new_uint32_t(L);
+        output_uint32_t(L, out_arg);
         *static_cast<uint32_t *>(luaL_checkudata(L, -1, "uint32_t")) = data;
     return 1;
 }
@@ -890,14 +941,17 @@ static int AP_GPS_velocity(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const Vector3f &data = ud->velocity(
             data_2);
 
-    new_Vector3f(L);
+    output_Vector3f(L, out_arg);
     *check_Vector3f(L, -1) = data;
     return 1;
 }
@@ -977,14 +1031,17 @@ static int AP_GPS_location(lua_State *L) {
         return luaL_argerror(L, 1, "gps not supported on this firmware");
     }
 
-    binding_argcheck(L, 2);
+    const int out_arg = binding_argcheck_output(L, 2);
+    if (out_arg != 0) {
+        check_Location(L, out_arg);
+    }
     const lua_Integer raw_data_2 = luaL_checkinteger(L, 2);
     luaL_argcheck(L, ((raw_data_2 >= MAX(0, 0)) && (raw_data_2 <= MIN(ud->num_sensors(), UINT8_MAX))), 2, "argument out of range");
     const uint8_t data_2 = static_cast<uint8_t>(raw_data_2);
     const Location &data = ud->location(
             data_2);
 
-    new_Location(L);
+    output_Location(L, out_arg);
     *check_Location(L, -1) = data;
     return 1;
 }
@@ -1327,7 +1384,10 @@ static int AP_AHRS_get_relative_position_NED_home(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     Vector3f data_5002 = {};
     ud->get_semaphore().take_blocking();
     const bool data = ud->get_relative_position_NED_home(
@@ -1335,7 +1395,7 @@ static int AP_AHRS_get_relative_position_NED_home(lua_State *L) {
 
     ud->get_semaphore().give();
     if (data) {
-        new_Vector3f(L);
+        output_Vector3f(L, out_arg);
         *check_Vector3f(L, -1) = data_5002;
     } else {
         lua_pushnil(L);
@@ -1349,7 +1409,10 @@ static int AP_AHRS_get_velocity_NED(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     Vector3f data_5002 = {};
     ud->get_semaphore().take_blocking();
     const bool data = ud->get_velocity_NED(
@@ -1357,7 +1420,7 @@ static int AP_AHRS_get_velocity_NED(lua_State *L) {
 
     ud->get_semaphore().give();
     if (data) {
-        new_Vector3f(L);
+        output_Vector3f(L, out_arg);
         *check_Vector3f(L, -1) = data_5002;
     } else {
         lua_pushnil(L);
@@ -1371,12 +1434,15 @@ static int AP_AHRS_groundspeed_vector(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector2f(L, out_arg);
+    }
     ud->get_semaphore().take_blocking();
     const Vector2f &data = ud->groundspeed_vector();
 
     ud->get_semaphore().give();
-    new_Vector2f(L);
+    output_Vector2f(L, out_arg);
     *check_Vector2f(L, -1) = data;
     return 1;
 }
@@ -1387,12 +1453,15 @@ static int AP_AHRS_wind_estimate(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     ud->get_semaphore().take_blocking();
     const Vector3f &data = ud->wind_estimate();
 
     ud->get_semaphore().give();
-    new_Vector3f(L);
+    output_Vector3f(L, out_arg);
     *check_Vector3f(L, -1) = data;
     return 1;
 }
@@ -1424,12 +1493,15 @@ static int AP_AHRS_get_gyro(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Vector3f(L, out_arg);
+    }
     ud->get_semaphore().take_blocking();
     const Vector3f &data = ud->get_gyro();
 
     ud->get_semaphore().give();
-    new_Vector3f(L);
+    output_Vector3f(L, out_arg);
     *check_Vector3f(L, -1) = data;
     return 1;
 }
@@ -1440,12 +1512,15 @@ static int AP_AHRS_get_home(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Location(L, out_arg);
+    }
     ud->get_semaphore().take_blocking();
     const Location &data = ud->get_home();
 
     ud->get_semaphore().give();
-    new_Location(L);
+    output_Location(L, out_arg);
     *check_Location(L, -1) = data;
     return 1;
 }
@@ -1456,7 +1531,10 @@ static int AP_AHRS_get_position(lua_State *L) {
         return luaL_argerror(L, 1, "ahrs not supported on this firmware");
     }
 
-    binding_argcheck(L, 1);
+    const int out_arg = binding_argcheck_output(L, 1);
+    if (out_arg != 0) {
+        check_Location(L, out_arg);
+    }
     Location data_5002 = {};
     ud->get_semaphore().take_blocking();
     const bool data = ud->get_position(
@@ -1464,7 +1542,7 @@ static int AP_AHRS_get_position(lua_State *L) {
 
     ud->get_semaphore().give();
     if (data) {
-        new_Location(L);
+        output_Location(L, out_arg);
         *check_Location(L, -1) = data_5002;
     } else {
         lua_pushnil(L);
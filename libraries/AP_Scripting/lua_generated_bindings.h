@@ -21,10 +21,13 @@
 
 
 int new_Vector2f(lua_State *L);
+int output_Vector2f(lua_State *L, int arg);
 Vector2f * check_Vector2f(lua_State *L, int arg);
 int new_Vector3f(lua_State *L);
+int output_Vector3f(lua_State *L, int arg);
 Vector3f * check_Vector3f(lua_State *L, int arg);
 int new_Location(lua_State *L);
+int output_Location(lua_State *L, int arg);
 Location * check_Location(lua_State *L, int arg);
 void load_generated_bindings(lua_State *L);
 void load_generated_sandbox(lua_State *L);
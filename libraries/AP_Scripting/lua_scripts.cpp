@@ -17,8 +17,11 @@
 #include <AP_HAL/AP_HAL.h>
 #include <GCS_MAVLink/GCS.h>
 #include <AP_ROMFS/AP_ROMFS.h>
+#include <AP_Logger/AP_Logger.h>
+#include <AP_Scheduler/AP_Scheduler.h>
 
 #include "lua_generated_bindings.h"
+#include "lua/src/lstate.h"
 
 #ifndef SCRIPTING_DIRECTORY
   #if HAL_OS_FATFS_IO
@@ -28,6 +31,17 @@
   #endif //HAL_OS_FATFS_IO
 #endif // SCRIPTING_DIRECTORY
 
+// scripts embedded in ROMFS are named with this prefix
+#define SCRIPTING_ROMFS_PREFIX "@ROMFS"
+#define SCRIPTING_ROMFS_DIRECTORY "scripts"
+
+// bounds on a single slice of garbage collection
+#define SCRIPTING_GC_SLICE_MIN_US 100
+#define SCRIPTING_GC_SLICE_MAX_US 2000
+
+// interval between per script stats reports
+#define SCRIPTING_STATS_INTERVAL_MS 10000
+
 extern const AP_HAL::HAL& hal;
 
 bool lua_scripts::overtime;
@@ -56,8 +70,39 @@ int lua_scripts::atpanic(lua_State *L) {
     return 0;
 }
 
+// returns true if the filename has the given extension
+static bool has_extension(const char *filename, const char *ext) {
+    const size_t length = strlen(filename);
+    const size_t ext_length = strlen(ext);
+    return (length > ext_length) && (strcmp(&filename[length - ext_length], ext) == 0);
+}
+
 lua_scripts::script_info *lua_scripts::load_script(lua_State *L, char *filename) {
-    if (int error = luaL_loadfile(L, filename)) {
+    int startMem = 0;
+    if (_debug_level > 0) {
+        // collect first so that the heap measurement only covers this script
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        startMem = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+    }
+    const uint32_t loadStart = AP_HAL::micros();
+
+    int error;
+    if (strncmp(filename, SCRIPTING_ROMFS_PREFIX "/", strlen(SCRIPTING_ROMFS_PREFIX "/")) == 0) {
+        // embedded bytecode is read straight out of flash, only the
+        // prototypes built by the undumper land on the scripting heap
+        uint32_t size;
+        const uint8_t *data = AP_ROMFS::find_file(&filename[strlen(SCRIPTING_ROMFS_PREFIX "/")], size);
+        if (data == nullptr) {
+            gcs().send_text(MAV_SEVERITY_CRITICAL, "Lua: Unable to load the file: %s", filename);
+            return nullptr;
+        }
+        error = luaL_loadbufferx(L, (const char *)data, size, filename, "b");
+    } else {
+        // precompiled scripts must be bytecode, plain scripts may be either
+        error = luaL_loadfilex(L, filename, has_extension(filename, ".luac") ? "b" : nullptr);
+    }
+
+    if (error) {
         switch (error) {
             case LUA_ERRSYNTAX:
                 gcs().send_text(MAV_SEVERITY_CRITICAL, "Lua: Syntax error in %s", filename);
@@ -88,6 +133,7 @@ lua_scripts::script_info *lua_scripts::load_script(lua_State *L, char *filename)
         return nullptr;
     }
 
+    memset(new_script, 0, sizeof(script_info));
     new_script->name = filename;
     new_script->next = nullptr;
 
@@ -105,6 +151,15 @@ lua_scripts::script_info *lua_scripts::load_script(lua_State *L, char *filename)
     new_script->lua_ref = luaL_ref(L, LUA_REGISTRYINDEX);   // cache the reference
     new_script->next_run_ms = AP_HAL::millis64() - 1; // force the script to be stale
 
+    if (_debug_level > 0) {
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        const int endMem = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+        gcs().send_text(MAV_SEVERITY_DEBUG, "Lua: Loaded %s Time: %u Mem: %d",
+                                            filename,
+                                            (unsigned int)(AP_HAL::micros() - loadStart),
+                                            (int)(endMem - startMem));
+    }
+
     return new_script;
 }
 
@@ -119,37 +174,44 @@ void lua_scripts::load_all_scripts_in_dir(lua_State *L, const char *dirname) {
         return;
     }
 
-    // load anything that ends in .lua
+    // load anything that ends in .lua or .luac
     for (struct dirent *de=AP::FS().readdir(d); de; de=AP::FS().readdir(d)) {
-        uint8_t length = strlen(de->d_name);
-        if (length < 5) {
-            // not long enough
-            continue;
-        }
-
-        if (strncmp(&de->d_name[length-4], ".lua", 4)) {
-            // doesn't end in .lua
+        if (!has_extension(de->d_name, ".lua") && !has_extension(de->d_name, ".luac")) {
             continue;
         }
+        load_and_schedule_script(L, dirname, de->d_name);
+    }
+    AP::FS().closedir(d);
+}
 
-        // FIXME: because chunk name fetching is not working we are allocating and storing an extra string we shouldn't need to
-        size_t size = strlen(dirname) + strlen(de->d_name) + 2;
-        char * filename = (char *) hal.util->heap_realloc(_heap, nullptr, size);
-        if (filename == nullptr) {
+void lua_scripts::load_all_scripts_in_romfs(lua_State *L) {
+    // only precompiled scripts are embedded, source would need decompressing onto the heap
+    uint16_t ofs = 0;
+    for (const char *name = AP_ROMFS::dir_list(SCRIPTING_ROMFS_DIRECTORY, ofs); name != nullptr;
+         name = AP_ROMFS::dir_list(SCRIPTING_ROMFS_DIRECTORY, ofs)) {
+        if (!has_extension(name, ".luac")) {
             continue;
         }
-        snprintf(filename, size, "%s/%s", dirname, de->d_name);
+        load_and_schedule_script(L, SCRIPTING_ROMFS_PREFIX, name);
+    }
+}
 
-        // we have something that looks like a lua file, attempt to load it
-        script_info * script = load_script(L, filename);
-        if (script == nullptr) {
-            hal.util->heap_realloc(_heap, filename, 0);
-            continue;
-        }
-        reschedule_script(script);
+void lua_scripts::load_and_schedule_script(lua_State *L, const char *dirname, const char *name) {
+    // FIXME: because chunk name fetching is not working we are allocating and storing an extra string we shouldn't need to
+    size_t size = strlen(dirname) + strlen(name) + 2;
+    char * filename = (char *) hal.util->heap_realloc(_heap, nullptr, size);
+    if (filename == nullptr) {
+        return;
+    }
+    snprintf(filename, size, "%s/%s", dirname, name);
 
+    // we have something that looks like a lua file, attempt to load it
+    script_info * script = load_script(L, filename);
+    if (script == nullptr) {
+        hal.util->heap_realloc(_heap, filename, 0);
+        return;
     }
-    AP::FS().closedir(d);
+    reschedule_script(script);
 }
 
 void lua_scripts::run_next_script(lua_State *L) {
@@ -177,7 +239,22 @@ void lua_scripts::run_next_script(lua_State *L) {
     // pop the function to the top of the stack
     lua_rawgeti(L, LUA_REGISTRYINDEX, script->lua_ref);
 
-    if(lua_pcall(L, 0, LUA_MULTRET, 0)) {
+    const uint32_t start_alloc_bytes = alloc_bytes;
+    const uint32_t start_us = AP_HAL::micros();
+
+    const int result = lua_pcall(L, 0, LUA_MULTRET, 0);
+
+    // account for the cost of this run, the hook is left at a single step if we ran overtime
+    const uint32_t run_time_us = AP_HAL::micros() - start_us;
+    const uint32_t run_vm_steps = overtime ? vm_steps : get_vm_steps(L);
+    const uint32_t run_alloc_bytes = alloc_bytes - start_alloc_bytes;
+    script->runs++;
+    script->run_time_us += run_time_us;
+    script->max_run_time_us = MAX(script->max_run_time_us, run_time_us);
+    script->vm_steps += run_vm_steps;
+    script->alloc_bytes += run_alloc_bytes;
+
+    if (result) {
         if (overtime) {
             // script has consumed an excessive amount of CPU time
             gcs().send_text(MAV_SEVERITY_CRITICAL, "Lua: %s exceeded time limit (%d)", script->name,  (int)vm_steps);
@@ -296,12 +373,116 @@ void lua_scripts::reschedule_script(script_info *script) {
 }
 
 void *lua_scripts::_heap;
+uint32_t lua_scripts::alloc_count;
+uint32_t lua_scripts::alloc_bytes;
 
 void *lua_scripts::alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
-    (void)ud; (void)osize;  /* not used */
+    (void)ud;  /* not used */
+    if (ptr == nullptr) {
+        // osize holds the type of object being created, not a size
+        if (nsize > 0) {
+            alloc_count++;
+            alloc_bytes += nsize;
+        }
+    } else if (nsize > osize) {
+        alloc_bytes += nsize - osize;
+    }
     return hal.util->heap_realloc(_heap, ptr, nsize);
 }
 
+uint32_t lua_scripts::get_vm_steps(lua_State *L) {
+    // the count hook is reloaded at the start of each run, and counts down
+    return L->basehookcount - L->hookcount;
+}
+
+bool lua_scripts::collect_garbage(lua_State *L) {
+    // size the slice to the time the main loop has left over each loop, so that it
+    // could fit in the idle part of a loop rather than stalling for a full collection
+    AP_Scheduler &scheduler = AP::scheduler();
+    const float spare = 1.0f - constrain_float(scheduler.load_average(), 0.0f, 1.0f);
+    const uint32_t budget_us = constrain_int32(scheduler.get_loop_period_us() * spare,
+                                               SCRIPTING_GC_SLICE_MIN_US, SCRIPTING_GC_SLICE_MAX_US);
+
+    const uint32_t start_us = AP_HAL::micros();
+    bool finished_cycle = false;
+    do {
+        finished_cycle = lua_gc(L, LUA_GCSTEP, 0);
+    } while (!finished_cycle && ((AP_HAL::micros() - start_us) < budget_us));
+    gc_time_us += AP_HAL::micros() - start_us;
+
+    return finished_cycle;
+}
+
+void lua_scripts::log_script_stats(const script_info *script, int heap_used) {
+    AP_Logger *logger = AP_Logger::get_singleton();
+    if (logger == nullptr) {
+        return;
+    }
+
+    // log the filename without the directory, the logger always copies 16 characters
+    const char *basename = strrchr(script->name, '/');
+    char name[16] {};
+    strncpy(name, (basename != nullptr) ? basename + 1 : script->name, sizeof(name) - 1);
+
+    logger->Write("SCR",
+                  "TimeUS,Name,Runs,Runtime,MaxRT,Steps,Alloc,Mem",
+                  "s--ss-bb",
+                  "F--FF---",
+                  "QNIIIIIi",
+                  AP_HAL::micros64(),
+                  name,
+                  script->runs,
+                  script->runs ? script->run_time_us / script->runs : 0,
+                  script->max_run_time_us,
+                  script->runs ? script->vm_steps / script->runs : 0,
+                  script->alloc_bytes,
+                  heap_used);
+}
+
+void lua_scripts::report_stats(lua_State *L) {
+    const uint32_t now_ms = AP_HAL::millis();
+    const uint32_t dt_ms = now_ms - last_stats_report_ms;
+    if (dt_ms < SCRIPTING_STATS_INTERVAL_MS) {
+        return;
+    }
+    last_stats_report_ms = now_ms;
+
+    const int heap_used = lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+    const bool send = _debug_level > 1;
+    uint32_t total_run_time_us = 0;
+    for (script_info *script = scripts; script != nullptr; script = script->next) {
+        log_script_stats(script, heap_used);
+        if (send) {
+            gcs().send_text(MAV_SEVERITY_DEBUG, "Lua: %s Runs: %u Steps: %u Time: %u Max: %u Alloc: %u",
+                                                script->name,
+                                                (unsigned int)script->runs,
+                                                (unsigned int)(script->runs ? script->vm_steps / script->runs : 0),
+                                                (unsigned int)(script->runs ? script->run_time_us / script->runs : 0),
+                                                (unsigned int)script->max_run_time_us,
+                                                (unsigned int)script->alloc_bytes);
+        }
+        total_run_time_us += script->run_time_us;
+        script->runs = 0;
+        script->vm_steps = 0;
+        script->run_time_us = 0;
+        script->max_run_time_us = 0;
+        script->alloc_bytes = 0;
+    }
+    if (_debug_level > 0) {
+        // machine readable totals for the GCS: percentage of time spent
+        // running scripts and collecting garbage, and the heap in use
+        gcs().send_named_float("LUA_CPU", total_run_time_us * 0.1f / dt_ms);
+        gcs().send_named_float("LUA_GC", gc_time_us * 0.1f / dt_ms);
+        gcs().send_named_float("LUA_MEM", heap_used);
+    }
+    if (send) {
+        gcs().send_text(MAV_SEVERITY_DEBUG, "Lua: GC Time: %u Mem: %d",
+                                            (unsigned int)(gc_time_us * 1000U / dt_ms),
+                                            heap_used);
+    }
+    gc_time_us = 0;
+}
+
 void lua_scripts::run(void) {
     if (_heap == nullptr) {
         gcs().send_text(MAV_SEVERITY_INFO, "Lua: Unable to allocate a heap");
@@ -346,6 +527,7 @@ void lua_scripts::run(void) {
     free(sandbox_data);
 
     // Scan the filesystem in an appropriate manner and autostart scripts
+    load_all_scripts_in_romfs(L);
     load_all_scripts_in_dir(L, SCRIPTING_DIRECTORY);
 
     while (true) {
@@ -367,6 +549,15 @@ void lua_scripts::run(void) {
               }
 #endif // defined(AP_SCRIPTING_CHECKS) && AP_SCRIPTING_CHECKS >= 1
 
+            // collect garbage while idle, one slice per millisecond so that we
+            // keep yielding, until the cycle is complete or the next script is due
+            while ((AP_HAL::millis64() + 1) < scripts->next_run_ms) {
+                if (collect_garbage(L)) {
+                    break;
+                }
+                hal.scheduler->delay(1);
+            }
+
             // compute delay time
             uint64_t now_ms = AP_HAL::millis64();
             if (now_ms < scripts->next_run_ms) {
@@ -391,8 +582,11 @@ void lua_scripts::run(void) {
                                                     (int)(endMem - startMem));
             }
 
-            // garbage collect after each script, this shouldn't matter, but seems to resolve a memory leak
-            lua_gc(L, LUA_GCCOLLECT, 0);
+            // step the collector after each script, rather than a full collection, so that
+            // garbage can't accumulate when scripts are always due
+            collect_garbage(L);
+
+            report_stats(L);
 
         } else {
             gcs().send_text(MAV_SEVERITY_DEBUG, "Lua: No scripts to run");
@@ -34,6 +34,12 @@ public:
     void run(void);
 
     static bool overtime; // script exceeded it's execution slot, and we are bailing out
+
+    // number of allocations made on the scripting heap since boot
+    static uint32_t get_alloc_count(void) { return alloc_count; }
+
+    // number of VM instructions the running script has used in its current slot
+    static uint32_t get_vm_steps(lua_State *L);
 private:
 
     typedef struct script_info {
@@ -41,12 +47,24 @@ private:
        uint64_t next_run_ms; // time (in milliseconds) the script should next be run at
        char *name;           // filename for the script // FIXME: This information should be available from Lua
        script_info *next;
+
+       // accumulated since the last stats report
+       uint32_t runs;        // number of times the script was run
+       uint32_t vm_steps;    // VM instructions used
+       uint32_t run_time_us; // wall time spent running the script
+       uint32_t max_run_time_us; // longest single run
+       uint32_t alloc_bytes; // bytes allocated on the heap by the script
     } script_info;
 
     script_info *load_script(lua_State *L, char *filename);
 
     void load_all_scripts_in_dir(lua_State *L, const char *dirname);
 
+    // load precompiled scripts embedded in ROMFS under scripts/
+    void load_all_scripts_in_romfs(lua_State *L);
+
+    void load_and_schedule_script(lua_State *L, const char *dirname, const char *name);
+
     void run_next_script(lua_State *L);
 
     void remove_script(lua_State *L, script_info *script);
@@ -54,6 +72,18 @@ private:
     // reschedule the script for execution. It is assumed the script is not in the list already
     void reschedule_script(script_info *script);
 
+    // run the incremental collector for a slice sized to the main loop's spare time,
+    // returns true if a collection cycle was completed
+    bool collect_garbage(lua_State *L);
+
+    // log the costs accumulated by a script since the last stats report
+    void log_script_stats(const script_info *script, int heap_used);
+
+    // log and report the accumulated per script costs
+    void report_stats(lua_State *L);
+    uint32_t last_stats_report_ms;
+    uint32_t gc_time_us; // time spent collecting garbage since the last stats report
+
     script_info *scripts; // linked list of scripts to be run, sorted by next run time (soonest first)
 
     // hook will be run when CPU time for a script is exceeded
@@ -72,4 +102,6 @@ private:
     static void *alloc(void *ud, void *ptr, size_t osize, size_t nsize);
 
     static void *_heap;
+    static uint32_t alloc_count;
+    static uint32_t alloc_bytes;
 };
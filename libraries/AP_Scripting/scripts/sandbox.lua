@@ -32,5 +32,6 @@ function get_sandbox_env ()
           -- ArduPilot specific
           millis = millis,
           servo = { set_output_pwm = servo.set_output_pwm},
+          perf = { alloc_count = perf.alloc_count, vm_steps = perf.vm_steps},
         }
 end
@@ -47,6 +47,13 @@ const AP_Param::GroupInfo AP_Terrain::var_info[] = {
     // @User: Advanced
     AP_GROUPINFO("SPACING",   1, AP_Terrain, grid_spacing, 100),
 
+    // @Param: PRELOAD
+    // @DisplayName: Terrain preload from local pack
+    // @Description: When set to 1 the terrain/PRELOAD.DEM elevation or bathymetry pack on the SD card is imported into the terrain database at TERRAIN_SPACING resolution. The import runs in the background and this parameter is reset to 0 once it completes. Any grid squares not covered by the pack are still requested from the ground station.
+    // @Values: 0:Disabled,1:Import on next update
+    // @User: Advanced
+    AP_GROUPINFO("PRELOAD",   2, AP_Terrain, preload, 0),
+
     AP_GROUPEND
 };
 
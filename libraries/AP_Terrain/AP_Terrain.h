@@ -57,6 +57,24 @@
 // format of grid on disk
 #define TERRAIN_GRID_FORMAT_VERSION 1
 
+// name of the local elevation/bathymetry pack imported when
+// TERRAIN_PRELOAD is set, relative to the terrain directory
+#define TERRAIN_PRELOAD_FILENAME "PRELOAD.DEM"
+
+// magic and version of the preload pack header
+#define TERRAIN_PRELOAD_MAGIC   0x4D454454 // "TDEM"
+#define TERRAIN_PRELOAD_VERSION 1
+
+// number of grid_blocks imported before handing back to the main
+// thread, so normal reads are never held off for long
+#define TERRAIN_PRELOAD_BATCH 32
+
+// widest run of samples read from one pack row in a single IO
+#define TERRAIN_PRELOAD_MAX_COLS 256
+
+// largest pack, so that any sample can be reached with a 32 bit off_t
+#define TERRAIN_PRELOAD_MAX_SIZE 0x7FFFFFFFUL
+
 #if TERRAIN_DEBUG
 #define ASSERT_RANGE(v,minv,maxv) assert((v)<=(maxv)&&(v)>=(minv))
 #else
@@ -74,6 +92,7 @@
  */
 
 class AP_Terrain {
+    friend class TerrainPreloadTest;
 public:
     AP_Terrain(const AP_Mission &_mission);
 
@@ -108,6 +127,9 @@ public:
     void handle_terrain_check(mavlink_channel_t chan, const mavlink_message_t &msg);
     void handle_terrain_data(const mavlink_message_t &msg);
 
+    // return true while a local preload pack is being imported
+    bool preload_active(void) const { return preload_state == PreloadRunning; }
+
     /*
       find the terrain height in meters above sea level for a location
 
@@ -320,9 +342,57 @@ private:
     void check_disk_write(void);
     void io_timer(void);
     void open_file(void);
+    uint32_t block_file_offset(void);
     void seek_offset(void);
     void write_block(void);
     void read_block(void);
+    void check_block_read(ssize_t ret, int32_t lat, int32_t lon);
+    void queue_block_io(bool write);
+    void read_block_done(int32_t ret);
+    void write_block_done(int32_t ret);
+
+    /*
+      bulk import of a local elevation pack, see TerrainPreload.cpp
+     */
+    enum PreloadState {
+        PreloadIdle     = 0,
+        PreloadRunning  = 1,
+        PreloadComplete = 2,
+        PreloadFailed   = 3
+    };
+
+    /*
+      header of a preload pack. The header is followed by rows*cols
+      little-endian int16_t heights in meters (negative below sea
+      level). Samples increase east first, then north, starting at the
+      south west corner, matching the grid_block conventions
+     */
+    struct PACKED preload_header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t flags;
+        // south west sample in degrees*10^7
+        int32_t lat;
+        int32_t lon;
+        // sample spacing in degrees*10^7
+        int32_t lat_step;
+        int32_t lon_step;
+        uint16_t rows;  // north
+        uint16_t cols;  // east
+        // height value marking a sample with no data
+        int16_t nodata;
+        uint16_t reserved;
+    };
+
+    void schedule_preload(void);
+    void preload_done(void);
+    void preload_timer(void);
+    bool preload_open(void);
+    void preload_close(void);
+    bool preload_setup_cell(void);
+    bool preload_next_block(struct grid_block &hdr);
+    bool preload_read_samples(uint16_t row, uint16_t col, uint16_t count, int16_t *buf);
+    bool preload_fill_block(struct grid_block &block);
 
     /*
       check for missing mission terrain data
@@ -338,6 +408,7 @@ private:
     // parameters
     AP_Int8  enable;
     AP_Int16 grid_spacing; // meters between grid points
+    AP_Int8  preload;
 
     // reference to AP_Mission, so we can ask preload terrain data for 
     // all waypoints
@@ -353,11 +424,19 @@ private:
         DiskIoWaitWrite = 1,
         DiskIoWaitRead  = 2,
         DiskIoDoneRead  = 3,
-        DiskIoDoneWrite = 4
+        DiskIoDoneWrite = 4,
+        DiskIoWaitPreload = 5,
+        DiskIoDonePreload = 6
     };
     volatile enum DiskIoState disk_io_state;
     union grid_io_block disk_block;
 
+    // a read or write of disk_block is queued on the filesystem IO
+    // thread, along with the position of the block being read
+    volatile bool disk_io_pending;
+    int32_t disk_read_lat;
+    int32_t disk_read_lon;
+
     // last time we asked for more grids
     uint32_t last_request_time_ms[MAVLINK_COMM_NUM_BUFFERS];
 
@@ -412,6 +491,34 @@ private:
 
     char *file_path = nullptr;
 
+    // state of local pack import. The pack file and cursor are owned
+    // by the IO thread while disk_io_state is DiskIoWaitPreload
+    volatile enum PreloadState preload_state = PreloadIdle;
+    struct {
+        int fd = -1;
+        struct preload_header header;
+        // extent of the pack in degrees*10^7
+        int32_t lat_max;
+        int32_t lon_max;
+        // degree cell and grid block being imported
+        int8_t lat_degrees;
+        int16_t lon_degrees;
+        uint16_t grid_idx_x;
+        uint16_t grid_idx_y;
+        uint16_t grid_idx_x_max;
+        uint16_t grid_idx_y_min;
+        uint16_t grid_idx_y_max;
+        // two pack rows worth of samples around a grid row
+        int16_t *rows = nullptr;
+        // grid blocks written in the last batch, so the main thread
+        // can drop stale cached copies
+        uint8_t num_written;
+        int32_t written_lat[TERRAIN_PRELOAD_BATCH];
+        int32_t written_lon[TERRAIN_PRELOAD_BATCH];
+        uint32_t blocks_written;
+        uint32_t start_ms;
+    } preload_io;
+
     // status
     enum TerrainStatus system_status = TerrainStatusDisabled;
 
@@ -27,6 +27,7 @@
 #if AP_TERRAIN_AVAILABLE
 
 #include <AP_Filesystem/AP_Filesystem.h>
+#include <AP_Filesystem/AP_Filesystem_Async.h>
 
 extern const AP_HAL::HAL& hal;
 
@@ -80,6 +81,10 @@ void AP_Terrain::schedule_disk_io(void)
             // still idle, check for writes
             check_disk_write();            
         }
+        if (disk_io_state == DiskIoIdle) {
+            // no cache IO pending, continue any local pack import
+            schedule_preload();
+        }
         break;
         
     case DiskIoDoneRead: {
@@ -110,8 +115,15 @@ void AP_Terrain::schedule_disk_io(void)
         break;
     }
         
+    case DiskIoDonePreload:
+        // a batch of preloaded blocks has been written
+        preload_done();
+        disk_io_state = DiskIoIdle;
+        break;
+
     case DiskIoWaitWrite:
     case DiskIoWaitRead:
+    case DiskIoWaitPreload:
         // waiting for io_timer()
         break;
     }
@@ -125,10 +137,13 @@ disk_io_state to manage who has access to the structures and to
 prevent race conditions.
 
 The IO timer context owns the data when disk_io_state is
-DiskIoWaitWrite or DiskIoWaitRead. The main thread owns the data when
-disk_io_state is DiskIoIdle, DiskIoDoneWrite or DiskIoDoneRead
+DiskIoWaitWrite, DiskIoWaitRead or DiskIoWaitPreload. The main thread
+owns the data when disk_io_state is DiskIoIdle, DiskIoDoneWrite,
+DiskIoDoneRead or DiskIoDonePreload
 
-All file operations are done by the IO thread.
+All file operations are done by the IO thread. Cache block reads and
+writes are queued at high priority on the filesystem IO thread, and
+disk_io_pending is set until the request completes.
 *********************************************************/
 
 
@@ -206,9 +221,9 @@ void AP_Terrain::open_file(void)
 }
 
 /*
-  seek to the right offset for disk_block
+  return the offset in the degree file of disk_block
  */
-void AP_Terrain::seek_offset(void)
+uint32_t AP_Terrain::block_file_offset(void)
 {
     struct grid_block &block = disk_block.block;
     // work out how many longitude blocks there are at this latitude
@@ -223,8 +238,16 @@ void AP_Terrain::seek_offset(void)
     const Vector2f offset = loc1.get_distance_NE(loc2);
     uint16_t east_blocks = offset.y / (grid_spacing*TERRAIN_GRID_BLOCK_SIZE_Y);
 
-    uint32_t file_offset = (east_blocks * block.grid_idx_x + 
-                            block.grid_idx_y) * sizeof(union grid_io_block);
+    return (east_blocks * block.grid_idx_x +
+            block.grid_idx_y) * sizeof(union grid_io_block);
+}
+
+/*
+  seek to the right offset for disk_block
+ */
+void AP_Terrain::seek_offset(void)
+{
+    const uint32_t file_offset = block_file_offset();
     if (AP::FS().lseek(fd, file_offset, SEEK_SET) != (off_t)file_offset) {
 #if TERRAIN_DEBUG
         hal.console->printf("Seek %lu failed - %s\n",
@@ -266,7 +289,6 @@ void AP_Terrain::write_block(void)
                (unsigned long long)disk_block.block.bitmap);
 #endif
     }
-    disk_io_state = DiskIoDoneWrite;
 }
 
 /*
@@ -282,6 +304,15 @@ void AP_Terrain::read_block(void)
     int32_t lon = disk_block.block.lon;
 
     ssize_t ret = AP::FS().read(fd, &disk_block, sizeof(disk_block));
+    check_block_read(ret, lat, lon);
+}
+
+/*
+  check a block just read into disk_block, replacing it with an empty
+  block if it is missing or bad
+ */
+void AP_Terrain::check_block_read(ssize_t ret, int32_t lat, int32_t lon)
+{
     if (ret != sizeof(disk_block) || 
         disk_block.block.lat != lat || 
         disk_block.block.lon != lon ||
@@ -310,7 +341,62 @@ void AP_Terrain::read_block(void)
                (unsigned long long)disk_block.block.bitmap);
 #endif
     }
+}
+
+/*
+  queue a read or write of disk_block on the filesystem request queue.
+  disk_io_state moves on when it completes
+ */
+void AP_Terrain::queue_block_io(bool write)
+{
+    const uint32_t file_offset = block_file_offset();
+    disk_io_pending = true;
+    bool queued;
+    if (write) {
+        disk_block.block.crc = get_block_crc(disk_block.block);
+        queued = AP::FS_async().write(fd, file_offset, &disk_block, sizeof(disk_block),
+                                      AP_Filesystem_Async::Priority::HIGH,
+                                      FUNCTOR_BIND_MEMBER(&AP_Terrain::write_block_done, void, int32_t));
+    } else {
+        disk_read_lat = disk_block.block.lat;
+        disk_read_lon = disk_block.block.lon;
+        queued = AP::FS_async().read(fd, file_offset, &disk_block, sizeof(disk_block),
+                                     AP_Filesystem_Async::Priority::HIGH,
+                                     FUNCTOR_BIND_MEMBER(&AP_Terrain::read_block_done, void, int32_t));
+    }
+    if (!queued) {
+        // the queue is full, try again on the next tick
+        disk_io_pending = false;
+    }
+}
+
+/*
+  called from the filesystem request queue when a block read completes
+ */
+void AP_Terrain::read_block_done(int32_t ret)
+{
+    check_block_read(ret, disk_read_lat, disk_read_lon);
     disk_io_state = DiskIoDoneRead;
+    disk_io_pending = false;
+}
+
+/*
+  called from the filesystem request queue when a block write completes
+ */
+void AP_Terrain::write_block_done(int32_t ret)
+{
+    if (ret != sizeof(disk_block)) {
+#if TERRAIN_DEBUG
+        hal.console->printf("write failed - %d\n", (int)ret);
+#endif
+        AP::FS().close(fd);
+        fd = -1;
+        io_failure = true;
+    } else {
+        AP::FS().fsync(fd);
+    }
+    disk_io_state = DiskIoDoneWrite;
+    disk_io_pending = false;
 }
 
 /*
@@ -323,11 +409,16 @@ void AP_Terrain::io_timer(void)
         // code while flying
         return;
     }
+    if (disk_io_pending) {
+        // waiting for a queued block read or write
+        return;
+    }
 
     switch (disk_io_state) {
     case DiskIoIdle:
     case DiskIoDoneRead:
     case DiskIoDoneWrite:
+    case DiskIoDonePreload:
         // nothing to do
         break;
         
@@ -337,7 +428,7 @@ void AP_Terrain::io_timer(void)
         if (fd == -1) {
             return;
         }
-        write_block();
+        queue_block_io(true);
         break;
 
     case DiskIoWaitRead:
@@ -346,7 +437,13 @@ void AP_Terrain::io_timer(void)
         if (fd == -1) {
             return;
         }
-        read_block();
+        queue_block_io(false);
+        break;
+
+    case DiskIoWaitPreload:
+        // import the next batch of blocks from the local pack
+        preload_timer();
+        disk_io_state = DiskIoDonePreload;
         break;
     }
 }
@@ -0,0 +1,444 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  bulk import of a local elevation or bathymetry pack into the terrain
+  database.
+
+  The pack is a regular lat/lon raster of int16_t heights (see
+  preload_header) that can be produced offline from a GeoTIFF DEM. It
+  is resampled onto the TERRAIN_SPACING grid and written straight into
+  the per-degree grid_block files, so that only cells it does not
+  cover need to be fetched from the GCS with TERRAIN_REQUEST.
+ */
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_Common/AP_Common.h>
+#include <AP_Math/AP_Math.h>
+#include <GCS_MAVLink/GCS_MAVLink.h>
+#include <GCS_MAVLink/GCS.h>
+#include <stdio.h>
+#include "AP_Terrain.h"
+
+#if AP_TERRAIN_AVAILABLE
+
+#include <AP_Filesystem/AP_Filesystem.h>
+
+extern const AP_HAL::HAL& hal;
+
+/*
+  called from the main thread when no cache IO is pending. Hands the
+  disk_block to the IO thread for another batch of the import
+ */
+void AP_Terrain::schedule_preload(void)
+{
+    if (preload == 0) {
+        if (preload_state != PreloadRunning) {
+            // allow a new import to be started by setting TERRAIN_PRELOAD
+            preload_state = PreloadIdle;
+        }
+        return;
+    }
+    if (preload_state == PreloadIdle) {
+        preload_state = PreloadRunning;
+        preload_io.blocks_written = 0;
+        preload_io.start_ms = AP_HAL::millis();
+    }
+    if (preload_state == PreloadRunning) {
+        disk_io_state = DiskIoWaitPreload;
+    }
+}
+
+/*
+  called from the main thread once a batch has been written. Any
+  cached copies of the written blocks are re-read from disk. Dirty
+  blocks are left alone, they hold newer data from the GCS and will
+  overwrite the preloaded block when flushed
+ */
+void AP_Terrain::preload_done(void)
+{
+    for (uint8_t i=0; i<preload_io.num_written; i++) {
+        for (uint16_t c=0; c<cache_size; c++) {
+            if (cache[c].grid.lat == preload_io.written_lat[i] &&
+                cache[c].grid.lon == preload_io.written_lon[i] &&
+                cache[c].grid.spacing == grid_spacing &&
+                cache[c].state == GRID_CACHE_VALID) {
+                cache[c].state = GRID_CACHE_DISKWAIT;
+            }
+        }
+    }
+    preload_io.num_written = 0;
+
+    switch (preload_state) {
+    case PreloadComplete:
+        gcs().send_text(MAV_SEVERITY_INFO, "Terrain: preloaded %u blocks in %ums",
+                        (unsigned)preload_io.blocks_written,
+                        (unsigned)(AP_HAL::millis() - preload_io.start_ms));
+        preload.set_and_save(0);
+        break;
+    case PreloadFailed:
+        gcs().send_text(MAV_SEVERITY_WARNING, "Terrain: preload of %s failed", TERRAIN_PRELOAD_FILENAME);
+        preload.set_and_save(0);
+        break;
+    case PreloadIdle:
+    case PreloadRunning:
+        break;
+    }
+}
+
+
+/********************************************************
+The functions below run in the IO timer context while disk_io_state
+is DiskIoWaitPreload
+*********************************************************/
+
+/*
+  import up to TERRAIN_PRELOAD_BATCH blocks
+ */
+void AP_Terrain::preload_timer(void)
+{
+    if (preload_io.fd == -1 && !preload_open()) {
+        preload_close();
+        preload_state = PreloadFailed;
+        return;
+    }
+
+    for (uint8_t n=0; n<TERRAIN_PRELOAD_BATCH; n++) {
+        struct grid_block hdr {};
+        if (!preload_next_block(hdr)) {
+            preload_close();
+            preload_state = PreloadComplete;
+            return;
+        }
+
+        // merge with any data already on disk for this block
+        disk_block.block = hdr;
+        open_file();
+        if (fd == -1) {
+            break;
+        }
+        read_block();
+        if (io_failure) {
+            break;
+        }
+        if (disk_block.block.bitmap == 0) {
+            disk_block.block = hdr;
+        }
+
+        if (!preload_fill_block(disk_block.block)) {
+            // nothing in this block is covered by the pack
+            continue;
+        }
+        write_block();
+        if (io_failure) {
+            break;
+        }
+        preload_io.written_lat[preload_io.num_written] = hdr.lat;
+        preload_io.written_lon[preload_io.num_written] = hdr.lon;
+        preload_io.num_written++;
+        preload_io.blocks_written++;
+    }
+
+    if (io_failure) {
+        preload_close();
+        preload_state = PreloadFailed;
+    }
+}
+
+/*
+  open the pack and check its header
+ */
+bool AP_Terrain::preload_open(void)
+{
+    const char* terrain_dir = hal.util->get_custom_terrain_directory();
+    if (terrain_dir == nullptr) {
+        terrain_dir = HAL_BOARD_TERRAIN_DIRECTORY;
+    }
+    char *pack_path = nullptr;
+    if (asprintf(&pack_path, "%s/%s", terrain_dir, TERRAIN_PRELOAD_FILENAME) <= 0) {
+        return false;
+    }
+
+    preload_io.fd = AP::FS().open(pack_path, O_RDONLY);
+    free(pack_path);
+    if (preload_io.fd == -1) {
+        return false;
+    }
+
+    struct preload_header &h = preload_io.header;
+    if (AP::FS().read(preload_io.fd, &h, sizeof(h)) != sizeof(h) ||
+        h.magic != TERRAIN_PRELOAD_MAGIC ||
+        h.version != TERRAIN_PRELOAD_VERSION ||
+        h.rows < 2 || h.cols < 2 ||
+        h.lat_step <= 0 || h.lon_step <= 0) {
+        return false;
+    }
+    const uint64_t pack_size = sizeof(h) + uint64_t(h.rows) * h.cols * sizeof(int16_t);
+    if (pack_size > TERRAIN_PRELOAD_MAX_SIZE) {
+        // the last rows are out of reach on boards with a 32 bit off_t
+        return false;
+    }
+    const int64_t lat_max = h.lat + int64_t(h.rows-1) * h.lat_step;
+    const int64_t lon_max = h.lon + int64_t(h.cols-1) * h.lon_step;
+    if (h.lat < -900000000L || lat_max > 900000000L ||
+        h.lon < -1800000000L || lon_max > 1800000000L) {
+        return false;
+    }
+    preload_io.lat_max = lat_max;
+    preload_io.lon_max = lon_max;
+
+    preload_io.rows = (int16_t *)calloc(2*TERRAIN_PRELOAD_MAX_COLS, sizeof(int16_t));
+    if (preload_io.rows == nullptr) {
+        return false;
+    }
+
+    // start at the south west degree cell
+    preload_io.lat_degrees = (h.lat<0?(h.lat-9999999L):h.lat) / (10*1000*1000L);
+    preload_io.lon_degrees = (h.lon<0?(h.lon-9999999L):h.lon) / (10*1000*1000L);
+    preload_setup_cell();
+    return true;
+}
+
+/*
+  release the pack
+ */
+void AP_Terrain::preload_close(void)
+{
+    if (preload_io.fd != -1) {
+        AP::FS().close(preload_io.fd);
+        preload_io.fd = -1;
+    }
+    free(preload_io.rows);
+    preload_io.rows = nullptr;
+}
+
+/*
+  work out the range of grid blocks of the current degree cell which
+  contain a part of the pack
+ */
+bool AP_Terrain::preload_setup_cell(void)
+{
+    const int32_t cell_lat = preload_io.lat_degrees*10*1000*1000L;
+    const int32_t cell_lon = preload_io.lon_degrees*10*1000*1000L;
+
+    Location sw, ne;
+    sw.lat = MAX(preload_io.header.lat, cell_lat);
+    sw.lng = MAX(preload_io.header.lon, cell_lon);
+    ne.lat = MIN(preload_io.lat_max, cell_lat + 10*1000*1000L - 1);
+    ne.lng = MIN(preload_io.lon_max, cell_lon + 10*1000*1000L - 1);
+    if (sw.lat > ne.lat || sw.lng > ne.lng) {
+        // pack doesn't reach into this cell
+        preload_io.grid_idx_x = 1;
+        preload_io.grid_idx_x_max = 0;
+        return false;
+    }
+
+    struct grid_info info_sw, info_ne;
+    calculate_grid_info(sw, info_sw);
+    calculate_grid_info(ne, info_ne);
+
+    preload_io.grid_idx_x = info_sw.grid_idx_x;
+    preload_io.grid_idx_y = info_sw.grid_idx_y;
+    preload_io.grid_idx_x_max = info_ne.grid_idx_x;
+    preload_io.grid_idx_y_min = info_sw.grid_idx_y;
+    preload_io.grid_idx_y_max = info_ne.grid_idx_y;
+    return true;
+}
+
+/*
+  fill in the header of the next grid block to import. Returns false
+  when the whole pack has been covered
+ */
+bool AP_Terrain::preload_next_block(struct grid_block &hdr)
+{
+    if (preload_io.grid_idx_y > preload_io.grid_idx_y_max) {
+        preload_io.grid_idx_y = preload_io.grid_idx_y_min;
+        preload_io.grid_idx_x++;
+    }
+    while (preload_io.grid_idx_x > preload_io.grid_idx_x_max) {
+        // move to the next degree cell, east first then north
+        const int32_t lat_max = preload_io.lat_max;
+        const int32_t lon_min = preload_io.header.lon;
+        const int32_t lon_max = preload_io.lon_max;
+        if (preload_io.lon_degrees < (lon_max<0?(lon_max-9999999L):lon_max) / (10*1000*1000L)) {
+            preload_io.lon_degrees++;
+        } else if (preload_io.lat_degrees < (lat_max<0?(lat_max-9999999L):lat_max) / (10*1000*1000L)) {
+            preload_io.lat_degrees++;
+            preload_io.lon_degrees = (lon_min<0?(lon_min-9999999L):lon_min) / (10*1000*1000L);
+        } else {
+            return false;
+        }
+        preload_setup_cell();
+    }
+
+    // south west corner of the block, as in calculate_grid_info()
+    Location ref;
+    ref.lat = preload_io.lat_degrees*10*1000*1000L;
+    ref.lng = preload_io.lon_degrees*10*1000*1000L;
+    ref.offset(preload_io.grid_idx_x * TERRAIN_GRID_BLOCK_SPACING_X * (float)grid_spacing,
+               preload_io.grid_idx_y * TERRAIN_GRID_BLOCK_SPACING_Y * (float)grid_spacing);
+
+    hdr.lat = ref.lat;
+    hdr.lon = ref.lng;
+    hdr.spacing = grid_spacing;
+    hdr.version = TERRAIN_GRID_FORMAT_VERSION;
+    hdr.grid_idx_x = preload_io.grid_idx_x;
+    hdr.grid_idx_y = preload_io.grid_idx_y;
+    hdr.lat_degrees = preload_io.lat_degrees;
+    hdr.lon_degrees = preload_io.lon_degrees;
+
+    preload_io.grid_idx_y++;
+    return true;
+}
+
+/*
+  read count samples starting at row/col of the pack
+ */
+bool AP_Terrain::preload_read_samples(uint16_t row, uint16_t col, uint16_t count, int16_t *buf)
+{
+    const off_t ofs = sizeof(struct preload_header) +
+        (off_t(row) * preload_io.header.cols + col) * off_t(sizeof(int16_t));
+    if (AP::FS().lseek(preload_io.fd, ofs, SEEK_SET) != ofs) {
+        return false;
+    }
+    const ssize_t len = count * sizeof(int16_t);
+    return AP::FS().read(preload_io.fd, buf, len) == len;
+}
+
+/*
+  resample the pack onto a grid block, setting the bitmap for each
+  4x4 grid that is fully covered. Returns true if any grid was filled
+ */
+bool AP_Terrain::preload_fill_block(struct grid_block &block)
+{
+    const struct preload_header &h = preload_io.header;
+
+    // the latitude of a grid point only depends on its row and the
+    // longitude only on its column, see Location::offset()
+    float row_pos[TERRAIN_GRID_BLOCK_SIZE_X];
+    float col_pos[TERRAIN_GRID_BLOCK_SIZE_Y];
+    Location sw;
+    sw.lat = block.lat;
+    sw.lng = block.lon;
+    for (uint8_t x=0; x<TERRAIN_GRID_BLOCK_SIZE_X; x++) {
+        Location loc = sw;
+        loc.offset(x*grid_spacing, 0);
+        row_pos[x] = (loc.lat - h.lat) / float(h.lat_step);
+    }
+    for (uint8_t y=0; y<TERRAIN_GRID_BLOCK_SIZE_Y; y++) {
+        Location loc = sw;
+        loc.offset(0, y*grid_spacing);
+        col_pos[y] = (loc.lng - h.lon) / float(h.lon_step);
+    }
+
+    // resampled heights and which of them are valid
+    int16_t height[TERRAIN_GRID_BLOCK_SIZE_X][TERRAIN_GRID_BLOCK_SIZE_Y];
+    bool valid[TERRAIN_GRID_BLOCK_SIZE_X][TERRAIN_GRID_BLOCK_SIZE_Y] {};
+
+    // span of pack columns touched by this block
+    int32_t col_min = INT32_MAX, col_max = -1;
+    for (uint8_t y=0; y<TERRAIN_GRID_BLOCK_SIZE_Y; y++) {
+        if (col_pos[y] >= 0 && col_pos[y] <= h.cols-1) {
+            const int32_t c = MIN(int32_t(col_pos[y]), h.cols-2);
+            col_min = MIN(col_min, c);
+            col_max = MAX(col_max, c+1);
+        }
+    }
+    if (col_max < 0) {
+        return false;
+    }
+    const uint16_t span = col_max + 1 - col_min;
+    int16_t *row0 = &preload_io.rows[0];
+    int16_t *row1 = &preload_io.rows[TERRAIN_PRELOAD_MAX_COLS];
+
+    for (uint8_t x=0; x<TERRAIN_GRID_BLOCK_SIZE_X; x++) {
+        if (row_pos[x] < 0 || row_pos[x] > h.rows-1) {
+            continue;
+        }
+        const uint16_t r = MIN(int32_t(row_pos[x]), h.rows-2);
+        const float frac_x = row_pos[x] - r;
+        const bool whole_span = span <= TERRAIN_PRELOAD_MAX_COLS;
+        if (whole_span &&
+            (!preload_read_samples(r,   col_min, span, row0) ||
+             !preload_read_samples(r+1, col_min, span, row1))) {
+            return false;
+        }
+        for (uint8_t y=0; y<TERRAIN_GRID_BLOCK_SIZE_Y; y++) {
+            if (col_pos[y] < 0 || col_pos[y] > h.cols-1) {
+                continue;
+            }
+            const uint16_t c = MIN(int32_t(col_pos[y]), h.cols-2);
+            const float frac_y = col_pos[y] - c;
+            int16_t h00, h01, h10, h11;
+            if (whole_span) {
+                h00 = row0[c-col_min];
+                h01 = row0[c-col_min+1];
+                h10 = row1[c-col_min];
+                h11 = row1[c-col_min+1];
+            } else {
+                // pack is much finer than the grid, read just the
+                // samples around this point
+                int16_t s[4];
+                if (!preload_read_samples(r,   c, 2, &s[0]) ||
+                    !preload_read_samples(r+1, c, 2, &s[2])) {
+                    return false;
+                }
+                h00 = s[0];
+                h01 = s[1];
+                h10 = s[2];
+                h11 = s[3];
+            }
+            if (h00 == h.nodata || h01 == h.nodata ||
+                h10 == h.nodata || h11 == h.nodata) {
+                continue;
+            }
+            // same dual linear interpolation as height_amsl()
+            const float avg1 = (1.0f-frac_x) * h00  + frac_x * h10;
+            const float avg2 = (1.0f-frac_x) * h01  + frac_x * h11;
+            height[x][y] = lrintf((1.0f-frac_y) * avg1 + frac_y * avg2);
+            valid[x][y] = true;
+        }
+    }
+
+    // copy in each 4x4 grid that is completely covered
+    bool filled = false;
+    for (uint8_t gx=0; gx<TERRAIN_GRID_BLOCK_MUL_X; gx++) {
+        for (uint8_t gy=0; gy<TERRAIN_GRID_BLOCK_MUL_Y; gy++) {
+            const uint8_t idx_x = gx * TERRAIN_GRID_MAVLINK_SIZE;
+            const uint8_t idx_y = gy * TERRAIN_GRID_MAVLINK_SIZE;
+            bool complete = true;
+            for (uint8_t x=0; x<TERRAIN_GRID_MAVLINK_SIZE && complete; x++) {
+                for (uint8_t y=0; y<TERRAIN_GRID_MAVLINK_SIZE; y++) {
+                    if (!valid[idx_x+x][idx_y+y]) {
+                        complete = false;
+                        break;
+                    }
+                }
+            }
+            if (!complete) {
+                continue;
+            }
+            for (uint8_t x=0; x<TERRAIN_GRID_MAVLINK_SIZE; x++) {
+                for (uint8_t y=0; y<TERRAIN_GRID_MAVLINK_SIZE; y++) {
+                    block.height[idx_x+x][idx_y+y] = height[idx_x+x][idx_y+y];
+                }
+            }
+            block.bitmap |= ((uint64_t)1) << grid_bitnum(idx_x, idx_y);
+            filled = true;
+        }
+    }
+    return filled;
+}
+
+#endif // AP_TERRAIN_AVAILABLE
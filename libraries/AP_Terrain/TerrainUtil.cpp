@@ -70,8 +70,10 @@ void AP_Terrain::calculate_grid_info(const Location &loc, struct grid_info &info
     ref.lat = info.lat_degrees*10*1000*1000L;
     ref.lng = info.lon_degrees*10*1000*1000L;
 
-    // find offset from reference
-    const Vector2f offset = ref.get_distance_NE(loc);
+    // find offset from reference. This can be over 100km so use
+    // postype_t to keep the fraction within the grid square accurate
+    // on boards with double precision
+    const Vector2p offset = ref.get_distance_NE_postype(loc);
 
     // get indices in terms of grid_spacing elements
     uint32_t idx_x = offset.x / grid_spacing;
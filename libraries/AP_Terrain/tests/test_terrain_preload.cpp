@@ -0,0 +1,131 @@
+/*
+ * This file is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <AP_gtest.h>
+
+#include <AP_HAL/AP_HAL.h>
+#include <AP_Mission/AP_Mission.h>
+#include <AP_Terrain/AP_Terrain.h>
+#include <AP_Filesystem/AP_Filesystem.h>
+
+const AP_HAL::HAL& hal = AP_HAL::get_HAL();
+
+#if AP_TERRAIN_AVAILABLE
+
+static AP_Mission mission{nullptr, nullptr, nullptr};
+static AP_Terrain terrain{mission};
+
+#define PACK_PATH HAL_BOARD_TERRAIN_DIRECTORY "/" TERRAIN_PRELOAD_FILENAME
+
+class TerrainPreloadTest : public ::testing::Test {
+protected:
+    typedef AP_Terrain::preload_header preload_header;
+
+    static const uint16_t rows = 5;
+    static const uint16_t cols = 7;
+
+    // height of each sample in the generated pack
+    static int16_t sample(uint16_t row, uint16_t col) {
+        return row * 100 + col;
+    }
+
+    void write_pack(const preload_header &h, bool with_samples) {
+        AP::FS().mkdir(HAL_BOARD_TERRAIN_DIRECTORY);
+        const int fd = AP::FS().open(PACK_PATH, O_WRONLY|O_CREAT|O_TRUNC);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(ssize_t(sizeof(h)), AP::FS().write(fd, &h, sizeof(h)));
+        if (with_samples) {
+            for (uint16_t r=0; r<h.rows; r++) {
+                int16_t row[cols];
+                for (uint16_t c=0; c<h.cols; c++) {
+                    row[c] = sample(r, c);
+                }
+                ASSERT_EQ(ssize_t(sizeof(row)), AP::FS().write(fd, row, sizeof(row)));
+            }
+        }
+        AP::FS().close(fd);
+    }
+
+    preload_header header() const {
+        preload_header h {};
+        h.magic = TERRAIN_PRELOAD_MAGIC;
+        h.version = TERRAIN_PRELOAD_VERSION;
+        h.lat = -353632610;
+        h.lon = 1491652300;
+        h.lat_step = 8333;
+        h.lon_step = 8333;
+        h.rows = rows;
+        h.cols = cols;
+        h.nodata = -32768;
+        return h;
+    }
+
+    bool open() { return terrain.preload_open(); }
+    void close() { terrain.preload_close(); }
+    bool read_samples(uint16_t row, uint16_t col, uint16_t count, int16_t *buf) {
+        return terrain.preload_read_samples(row, col, count, buf);
+    }
+
+    void TearDown() override {
+        terrain.preload_close();
+        AP::FS().unlink(PACK_PATH);
+    }
+};
+
+/*
+  samples are read from their row and column of the pack
+ */
+TEST_F(TerrainPreloadTest, ReadSamples)
+{
+    write_pack(header(), true);
+    ASSERT_TRUE(open());
+
+    int16_t buf[3];
+    ASSERT_TRUE(read_samples(3, 2, 3, buf));
+    EXPECT_EQ(sample(3, 2), buf[0]);
+    EXPECT_EQ(sample(3, 3), buf[1]);
+    EXPECT_EQ(sample(3, 4), buf[2]);
+
+    // last sample of the pack
+    ASSERT_TRUE(read_samples(rows-1, cols-2, 2, buf));
+    EXPECT_EQ(sample(rows-1, cols-1), buf[1]);
+
+    // past the end of the pack
+    EXPECT_FALSE(read_samples(rows, 0, 2, buf));
+}
+
+/*
+  a pack too large to seek in with a 32 bit off_t is refused
+ */
+TEST_F(TerrainPreloadTest, RejectLargePack)
+{
+    preload_header h = header();
+    h.lat_step = 100;
+    h.lon_step = 100;
+    h.rows = 65535;
+    h.cols = 65535;
+    write_pack(h, false);
+    EXPECT_FALSE(open());
+    close();
+
+    // 32767x32767 samples fit
+    h.rows = 32767;
+    h.cols = 32767;
+    write_pack(h, false);
+    EXPECT_TRUE(open());
+}
+
+#endif // AP_TERRAIN_AVAILABLE
+
+AP_GTEST_MAIN()
@@ -527,12 +527,57 @@ private:
     static const uint8_t no_bucket_to_send = -1;
     static const ap_message no_message_to_send = (ap_message)-1;
     uint8_t sending_bucket_id = no_bucket_to_send;
-    Bitmask<MSG_LAST> bucket_message_ids_to_send;
+    enum ap_message_priority_t : uint8_t {
+        PRIORITY_LOW = 0,
+        PRIORITY_NORMAL,
+        PRIORITY_HIGH,
+    };
+    // messages of the sending bucket still to be sent, split by
+    // priority so the next one is the first set bit of the highest
+    // non-empty set
+    Bitmask<MSG_LAST> bucket_message_ids_to_send[PRIORITY_HIGH+1];
+    void set_bucket_message_ids_to_send(const Bitmask<MSG_LAST> &ap_message_ids);
+    void clear_bucket_message_id_to_send(ap_message id);
+    bool bucket_message_ids_to_send_empty() const;
 
     ap_message next_deferred_bucket_message_to_send();
     void find_next_bucket_to_send();
     void remove_message_from_bucket(int8_t bucket, ap_message id);
 
+    // bandwidth budget for outgoing messages.  tokens are bytes which
+    // may be sent now and refill at rate_Bps, an estimate of the
+    // link's throughput.  The rate is lowered to the measured
+    // throughput when the UART fills up and raised again towards the
+    // port's nominal bandwidth while it keeps up.  When the budget
+    // runs out stream messages are shed, lowest priority first.
+    // Every byte written to the channel is charged, not just stream
+    // messages; charged holds the estimates already taken by
+    // send_budget_consume() since the last refill.
+    struct {
+        float tokens;
+        float charged;
+        float rate_Bps;
+        uint32_t bytes_sent;
+        uint32_t last_refill_ms;
+        uint32_t window_start_ms;
+        uint32_t window_bytes;
+        uint32_t measured_Bps;
+        uint16_t shed;
+        bool congested;
+    } send_budget;
+    static ap_message_priority_t ap_message_priority(const ap_message id);
+    // learned size in bytes of each ap_message, shared by all links
+    static uint8_t ap_message_size[MSG_LAST];
+    void send_budget_refill();
+    bool send_budget_allows(const ap_message id) const;
+    void send_budget_consume(const ap_message id, const uint16_t txspace_before);
+
+    // number of times each ap_message has been sent since the rates
+    // were last logged
+    uint16_t ap_message_sent_count[MSG_LAST];
+    uint32_t ap_message_rates_logged_ms;
+    void log_message_rates();
+
     // bitmask of IDs the code has spontaneously decided it wants to
     // send out.  Examples include HEARTBEAT (gcs_send_heartbeat)
     Bitmask<MSG_LAST> pushed_ap_message_ids;
@@ -616,6 +661,111 @@ private:
 
     uint8_t send_parameter_async_replies();
 
+    // MAVLink FTP server, see GCS_FTP.cpp
+    enum class FTP_OP : uint8_t {
+        None = 0,
+        TerminateSession = 1,
+        ResetSessions = 2,
+        ListDirectory = 3,
+        OpenFileRO = 4,
+        ReadFile = 5,
+        CreateFile = 6,
+        WriteFile = 7,
+        RemoveFile = 8,
+        CreateDirectory = 9,
+        RemoveDirectory = 10,
+        OpenFileWO = 11,
+        TruncateFile = 12,
+        Rename = 13,
+        CalcFileCRC32 = 14,
+        BurstReadFile = 15,
+        Ack = 128,
+        Nack = 129,
+    };
+
+    enum class FTP_ERROR : uint8_t {
+        None = 0,
+        Fail = 1,
+        FailErrno = 2,
+        InvalidDataSize = 3,
+        InvalidSession = 4,
+        NoSessionsAvailable = 5,
+        EndOfFile = 6,
+        UnknownCommand = 7,
+        FileExists = 8,
+        FileProtected = 9,
+        FileNotFound = 10,
+    };
+
+    struct pending_ftp {
+        uint32_t offset;
+        mavlink_channel_t chan;
+        uint16_t seq_number;
+        FTP_OP opcode;
+        FTP_OP req_opcode;
+        bool burst_complete;
+        uint8_t size;
+        uint8_t session;
+        uint8_t sysid;
+        uint8_t compid;
+        uint8_t data[239];
+    };
+
+    enum class FTP_STATE : uint8_t {
+        IDLE,           // waiting for a request
+        IO_PENDING,     // waiting for the filesystem IO thread
+        REPLY_READY,    // reply waiting for space on the link
+    };
+
+    struct ftp_state {
+        ObjectBuffer<pending_ftp> *requests;
+        pending_ftp request;    // request being serviced
+        pending_ftp reply;
+        pending_ftp last_reply;
+        bool last_reply_valid;
+        volatile FTP_STATE state;
+        uint32_t reply_ms;
+        int fd = -1;
+        uint8_t current_session;
+        uint32_t last_session_ms;
+
+        // burst read in progress
+        bool burst_active;
+        uint32_t burst_offset;
+        uint32_t burst_sent;
+        uint32_t burst_max_bytes;
+        uint8_t burst_read_size;
+
+        // CRC32 in progress
+        int crc_fd = -1;
+        uint32_t crc;
+        uint32_t crc_offset;
+    };
+    static struct ftp_state ftp;
+
+    void handle_file_transfer_protocol(const mavlink_message_t &msg);
+    bool ftp_init(void);
+    void ftp_update(void);
+    static bool ftp_send_reply(void);
+    static void ftp_reply_ready(void);
+    static void ftp_error(pending_ftp &response, FTP_ERROR error);
+    static void ftp_errno(pending_ftp &response, int err);
+    static void ftp_close_session(void);
+    void ftp_process_request(void);
+    void ftp_open_done(int32_t fd);
+    void ftp_close_done(int32_t ret);
+    void ftp_read_done(int32_t n);
+    void ftp_write_done(int32_t n);
+    void ftp_call_done(int32_t ret);
+    int32_t ftp_list_dir(void);
+    int32_t ftp_remove_file(void);
+    int32_t ftp_create_directory(void);
+    void ftp_crc32_open_done(int32_t fd);
+    bool ftp_crc32_read_next(void);
+    void ftp_crc32_read_done(int32_t n);
+    void ftp_crc32_finish(void);
+    void ftp_burst_next(void);
+
     void send_distance_sensor(const class AP_RangeFinder_Backend *sensor, const uint8_t instance) const;
 
     virtual bool handle_guided_request(AP_Mission::Mission_Command &cmd) = 0;
@@ -37,6 +37,8 @@
 #include <AP_VisualOdom/AP_VisualOdom.h>
 #include <AP_OpticalFlow/OpticalFlow.h>
 #include <AP_Baro/AP_Baro.h>
+#include <AP_Filesystem/AP_Filesystem.h>
+#include <StorageManager/StorageManager.h>
 
 #include <stdio.h>
 
@@ -847,6 +849,202 @@ uint16_t GCS_MAVLINK::get_reschedule_interval_ms(const deferred_message_bucket_t
     return interval_ms;
 }
 
+uint8_t GCS_MAVLINK::ap_message_size[MSG_LAST];
+
+/*
+  priority of stream messages when the link is short of bandwidth.
+  High priority messages are always sent, low priority ones are the
+  first to be shed
+ */
+GCS_MAVLINK::ap_message_priority_t GCS_MAVLINK::ap_message_priority(const ap_message id)
+{
+    switch (id) {
+    case MSG_HEARTBEAT:
+    case MSG_ATTITUDE:
+    case MSG_LOCATION:
+    case MSG_SYS_STATUS:
+    case MSG_GPS_RAW:
+    case MSG_VFR_HUD:
+    case MSG_CURRENT_WAYPOINT:
+    case MSG_EKF_STATUS_REPORT:
+    case MSG_EXTENDED_SYS_STATE:
+    case MSG_NEXT_MISSION_REQUEST_WAYPOINTS:
+    case MSG_NEXT_MISSION_REQUEST_RALLY:
+        return PRIORITY_HIGH;
+    case MSG_RAW_IMU:
+    case MSG_SCALED_IMU:
+    case MSG_SCALED_IMU2:
+    case MSG_SCALED_IMU3:
+    case MSG_SCALED_PRESSURE:
+    case MSG_SCALED_PRESSURE2:
+    case MSG_SCALED_PRESSURE3:
+    case MSG_SENSOR_OFFSETS:
+    case MSG_MEMINFO:
+    case MSG_POWER_STATUS:
+    case MSG_SYSTEM_TIME:
+    case MSG_SERVO_OUTPUT_RAW:
+    case MSG_RC_CHANNELS:
+    case MSG_RC_CHANNELS_RAW:
+    case MSG_SIMSTATE:
+    case MSG_AHRS2:
+    case MSG_AHRS3:
+    case MSG_HWSTATUS:
+    case MSG_PID_TUNING:
+    case MSG_VIBRATION:
+    case MSG_ESC_TELEMETRY:
+    case MSG_RPM:
+        return PRIORITY_LOW;
+    default:
+        return PRIORITY_NORMAL;
+    }
+}
+
+/*
+  add tokens to the send budget for the time since the last call, and
+  once a second adjust the refill rate to the measured throughput
+ */
+void GCS_MAVLINK::send_budget_refill()
+{
+    const uint32_t now_ms = AP_HAL::millis();
+    // nominal port bandwidth in bytes/second
+    const float nominal_Bps = _port->bw_in_kilobytes_per_second() * 1024.0f;
+
+    if (is_zero(send_budget.rate_Bps)) {
+        send_budget.rate_Bps = nominal_Bps;
+        send_budget.tokens = 0;
+        send_budget.last_refill_ms = now_ms;
+        send_budget.window_start_ms = now_ms;
+        send_budget.bytes_sent = mavlink_comm_bytes_sent[chan];
+    }
+
+    // charge everything written to the channel since the last refill
+    // (parameters, mission items, FTP, text and forwarded messages
+    // included), less the estimates already taken for stream messages
+    const uint32_t sent = mavlink_comm_bytes_sent[chan] - send_budget.bytes_sent;
+    send_budget.bytes_sent += sent;
+    send_budget.tokens -= sent - send_budget.charged;
+    send_budget.charged = 0;
+    send_budget.window_bytes += sent;
+
+    const uint32_t window_ms = now_ms - send_budget.window_start_ms;
+    if (window_ms >= 1000) {
+        send_budget.measured_Bps = send_budget.window_bytes * 1000U / window_ms;
+        if (send_budget.congested) {
+            // the UART could not keep up, so what we managed to send
+            // is the most the link can take
+            send_budget.rate_Bps = MAX(send_budget.measured_Bps, 100U);
+        } else {
+            // probe upwards slowly
+            send_budget.rate_Bps = MIN(send_budget.rate_Bps * 1.1f + 50, nominal_Bps);
+        }
+        send_budget.window_start_ms = now_ms;
+        send_budget.window_bytes = 0;
+        send_budget.congested = false;
+    }
+
+    const uint32_t dt_ms = now_ms - send_budget.last_refill_ms;
+    send_budget.last_refill_ms = now_ms;
+    // allow bursts of a quarter of a second, and a debt of a second
+    // from high priority messages
+    send_budget.tokens = constrain_float(send_budget.tokens + send_budget.rate_Bps * dt_ms * 0.001f,
+                                         -send_budget.rate_Bps,
+                                         send_budget.rate_Bps * 0.25f + 300);
+}
+
+/*
+  return true if the budget allows id to be sent now
+ */
+bool GCS_MAVLINK::send_budget_allows(const ap_message id) const
+{
+    const float size = ap_message_size[id] ? ap_message_size[id] : 32;
+    switch (ap_message_priority(id)) {
+    case PRIORITY_HIGH:
+        return true;
+    case PRIORITY_NORMAL:
+        return send_budget.tokens >= size;
+    case PRIORITY_LOW:
+        // keep a tenth of a second in reserve for normal priority messages
+        return send_budget.tokens >= size + send_budget.rate_Bps * 0.1f;
+    }
+    return true;
+}
+
+/*
+  charge the budget for a message just sent, learning its size from
+  the space it took in the UART buffer.  The charge is provisional
+  and is replaced by the bytes actually written on the next refill
+ */
+void GCS_MAVLINK::send_budget_consume(const ap_message id, const uint16_t txspace_before)
+{
+    const uint16_t txspace_after = comm_get_txspace(chan);
+    if (txspace_before > txspace_after && txspace_before - txspace_after <= UINT8_MAX) {
+        ap_message_size[id] = txspace_before - txspace_after;
+    }
+    const uint8_t size = ap_message_size[id] ? ap_message_size[id] : 32;
+    send_budget.tokens -= size;
+    send_budget.charged += size;
+    if (ap_message_sent_count[id] < UINT16_MAX) {
+        ap_message_sent_count[id]++;
+    }
+}
+
+/*
+  log requested and achieved rates of stream messages and the state of
+  the send budget
+ */
+void GCS_MAVLINK::log_message_rates()
+{
+    const uint32_t now_ms = AP_HAL::millis();
+    const uint32_t dt_ms = now_ms - ap_message_rates_logged_ms;
+    if (dt_ms < 10000) {
+        return;
+    }
+    ap_message_rates_logged_ms = now_ms;
+
+    AP_Logger *logger = AP_Logger::get_singleton();
+    if (logger == nullptr) {
+        return;
+    }
+    const uint64_t now_us = AP_HAL::micros64();
+    logger->Write("MAVB",
+                  "TimeUS,chan,Rate,Meas,Tok,Shed",
+                  "s#----",
+                  "F-----",
+                  "QBIIfH",
+                  now_us,
+                  (uint8_t)chan,
+                  (uint32_t)send_budget.rate_Bps,
+                  send_budget.measured_Bps,
+                  (double)send_budget.tokens,
+                  send_budget.shed);
+    send_budget.shed = 0;
+
+    // one record per stream message, only visiting the messages in
+    // each bucket
+    Bitmask<MSG_LAST> ids;
+    for (uint8_t i=0; i<ARRAY_SIZE(deferred_message_bucket); i++) {
+        const deferred_message_bucket_t &bucket = deferred_message_bucket[i];
+        if (bucket.interval_ms == 0) {
+            continue;
+        }
+        ids = bucket.ap_message_ids;
+        for (int16_t id = ids.first_set(); id != -1; id = ids.first_set()) {
+            ids.clear(id);
+            logger->Write("MAVR",
+                          "TimeUS,chan,Id,Req,Ach",
+                          "s#-zz",
+                          "F--00",
+                          "QBBff",
+                          now_us,
+                          (uint8_t)chan,
+                          (uint8_t)id,
+                          (double)(1000.0f / bucket.interval_ms),
+                          (double)(ap_message_sent_count[id] * 1000.0f / dt_ms));
+        }
+    }
+    memset(ap_message_sent_count, 0, sizeof(ap_message_sent_count));
+}
+
 // typical runtime on fmuv3: 5 microseconds for 3 buckets
 void GCS_MAVLINK::find_next_bucket_to_send()
 {
@@ -880,9 +1078,11 @@ void GCS_MAVLINK::find_next_bucket_to_send()
         }
     }
     if (sending_bucket_id != no_bucket_to_send) {
-        bucket_message_ids_to_send = deferred_message_bucket[sending_bucket_id].ap_message_ids;
+        set_bucket_message_ids_to_send(deferred_message_bucket[sending_bucket_id].ap_message_ids);
     } else {
-        bucket_message_ids_to_send.clearall();
+        for (Bitmask<MSG_LAST> &ids : bucket_message_ids_to_send) {
+            ids.clearall();
+        }
     }
 
 #if GCS_DEBUG_SEND_MESSAGE_TIMINGS
@@ -894,6 +1094,38 @@ void GCS_MAVLINK::find_next_bucket_to_send()
 #endif
 }
 
+/*
+  split the messages of the bucket about to be sent by priority. This
+  runs once per bucket rather than once per message sent
+ */
+void GCS_MAVLINK::set_bucket_message_ids_to_send(const Bitmask<MSG_LAST> &ap_message_ids)
+{
+    for (Bitmask<MSG_LAST> &ids : bucket_message_ids_to_send) {
+        ids.clearall();
+    }
+    Bitmask<MSG_LAST> ids;
+    ids = ap_message_ids;
+    for (int16_t id = ids.first_set(); id != -1; id = ids.first_set()) {
+        ids.clear(id);
+        bucket_message_ids_to_send[ap_message_priority((ap_message)id)].set(id);
+    }
+}
+
+void GCS_MAVLINK::clear_bucket_message_id_to_send(const ap_message id)
+{
+    bucket_message_ids_to_send[ap_message_priority(id)].clear(id);
+}
+
+bool GCS_MAVLINK::bucket_message_ids_to_send_empty() const
+{
+    for (const Bitmask<MSG_LAST> &ids : bucket_message_ids_to_send) {
+        if (!ids.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 ap_message GCS_MAVLINK::next_deferred_bucket_message_to_send()
 {
     if (sending_bucket_id == no_bucket_to_send) {
@@ -908,7 +1140,12 @@ ap_message GCS_MAVLINK::next_deferred_bucket_message_to_send()
         return no_message_to_send;
     }
 
-    const int16_t next = bucket_message_ids_to_send.first_set();
+    // send the highest priority message in the bucket first, so that
+    // shedding under congestion hits low priority messages
+    int16_t next = -1;
+    for (int8_t p=PRIORITY_HIGH; p>=PRIORITY_LOW && next == -1; p--) {
+        next = bucket_message_ids_to_send[p].first_set();
+    }
     if (next == -1) {
         // should not happen
 #if CONFIG_HAL_BOARD == HAL_BOARD_SITL
@@ -938,6 +1175,7 @@ bool GCS_MAVLINK::do_try_send_message(const ap_message id)
 #endif
     if (!try_send_message(id)) {
         // didn't fit in buffer...
+        send_budget.congested = true;
 #if GCS_DEBUG_SEND_MESSAGE_TIMINGS
         try_send_message_stats.no_space_for_message++;
         hal.scheduler->restore_interrupts(data);
@@ -1012,6 +1250,9 @@ void GCS_MAVLINK::update_send()
     if (!hal.scheduler->in_delay_callback()) {
         // AP_Logger will not send log data if we are armed.
         AP::logger().handle_log_send();
+#if HAVE_FILESYSTEM_SUPPORT
+        ftp_update();
+#endif
     }
 
     if (!deferred_messages_initialised) {
@@ -1023,6 +1264,8 @@ void GCS_MAVLINK::update_send()
     uint32_t retry_deferred_body_start = AP_HAL::micros();
 #endif
 
+    send_budget_refill();
+
     const uint32_t start = AP_HAL::millis();
     while (AP_HAL::millis() - start < 5) { // spend a max of 5ms sending messages.  This should never trigger - out_of_time() should become true
         if (gcs().out_of_time()) {
@@ -1039,10 +1282,13 @@ void GCS_MAVLINK::update_send()
         // check if any "specially handled" messages should be sent out
         {
             const int8_t next = deferred_message_to_send_index();
-            if (next != -1) {
+            if (next != -1 &&
+                (deferred_message[next].id == MSG_HEARTBEAT || send_budget.tokens >= 0)) {
+                const uint16_t txspace = comm_get_txspace(chan);
                 if (!do_try_send_message(deferred_message[next].id)) {
                     break;
                 }
+                send_budget_consume(deferred_message[next].id, txspace);
                 deferred_message[next].last_sent_ms += deferred_message[next].interval_ms;
                 next_deferred_message_to_send_cache = -1; // deferred_message_to_send will recalculate
 #if GCS_DEBUG_SEND_MESSAGE_TIMINGS
@@ -1061,9 +1307,11 @@ void GCS_MAVLINK::update_send()
         const int16_t fs = pushed_ap_message_ids.first_set();
         if (fs != -1) {
             ap_message next = (ap_message)fs;
+            const uint16_t txspace = comm_get_txspace(chan);
             if (!do_try_send_message(next)) {
                 break;
             }
+            send_budget_consume(next, txspace);
             pushed_ap_message_ids.clear(next);
 #if GCS_DEBUG_SEND_MESSAGE_TIMINGS
             const uint32_t stop = AP_HAL::micros();
@@ -1078,11 +1326,19 @@ void GCS_MAVLINK::update_send()
 
         ap_message next = next_deferred_bucket_message_to_send();
         if (next != no_message_to_send) {
-            if (!do_try_send_message(next)) {
-                break;
+            if (send_budget_allows(next)) {
+                const uint16_t txspace = comm_get_txspace(chan);
+                if (!do_try_send_message(next)) {
+                    break;
+                }
+                send_budget_consume(next, txspace);
+            } else {
+                // out of budget; skip this message until the bucket
+                // is next due
+                send_budget.shed++;
             }
-            bucket_message_ids_to_send.clear(next);
-            if (bucket_message_ids_to_send.count() == 0) {
+            clear_bucket_message_id_to_send(next);
+            if (bucket_message_ids_to_send_empty()) {
                 // we sent everything in the bucket.  Reschedule it.
                 deferred_message_bucket[sending_bucket_id].last_sent_ms +=
                     get_reschedule_interval_ms(deferred_message_bucket[sending_bucket_id]);
@@ -1124,7 +1380,7 @@ void GCS_MAVLINK::remove_message_from_bucket(int8_t bucket, ap_message id)
     deferred_message_bucket[bucket].ap_message_ids.clear(id);
 
     if (bucket == sending_bucket_id) {
-        bucket_message_ids_to_send.clear(id);
+        clear_bucket_message_id_to_send(id);
     }
 
     if (deferred_message_bucket[bucket].ap_message_ids.count() == 0) {
@@ -1238,7 +1494,7 @@ bool GCS_MAVLINK::set_ap_message_interval(enum ap_message id, uint16_t interval_
 
     if (sending_bucket_id == no_bucket_to_send) {
         sending_bucket_id = closest_bucket;
-        bucket_message_ids_to_send = deferred_message_bucket[closest_bucket].ap_message_ids;
+        set_bucket_message_ids_to_send(deferred_message_bucket[closest_bucket].ap_message_ids);
     }
 
     return true;
@@ -1376,6 +1632,7 @@ GCS_MAVLINK::update_receive(uint32_t max_time_us)
     if (is_active() || is_streaming()) {
         if (tnow - last_mavlink_stats_logged > 1000) {
             log_mavlink_stats();
+            log_message_rates();
             last_mavlink_stats_logged = tnow;
         }
     }
@@ -2480,6 +2737,9 @@ MAV_RESULT GCS_MAVLINK::handle_preflight_reboot(const mavlink_command_long_t &pa
     // flush pending parameter writes
     AP_Param::flush();
 
+    // write out storage without waiting for it to settle
+    StorageManager::flush(500);
+
     hal.scheduler->delay(200);
     
     // when packet.param1 == 3 we reboot to hold in bootloader
@@ -2987,6 +3247,12 @@ void GCS_MAVLINK::handle_common_message(const mavlink_message_t &msg)
     case MAVLINK_MSG_ID_TIMESYNC:
         handle_timesync(msg);
         break;
+
+#if HAVE_FILESYSTEM_SUPPORT
+    case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+        handle_file_transfer_protocol(msg);
+        break;
+#endif
     case MAVLINK_MSG_ID_LOG_REQUEST_LIST:
     case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
     case MAVLINK_MSG_ID_LOG_ERASE:
@@ -4659,6 +4925,10 @@ uint64_t GCS_MAVLINK::capabilities() const
     if (AP::rally()) {
         ret |= MAV_PROTOCOL_CAPABILITY_MISSION_RALLY;
     }
+
+#if HAVE_FILESYSTEM_SUPPORT
+    ret |= MAV_PROTOCOL_CAPABILITY_FTP;
+#endif
     return ret;
 }
 
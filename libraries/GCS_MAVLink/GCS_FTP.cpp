@@ -0,0 +1,659 @@
+/*
+   GCS MAVLink functions related to FTP
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <AP_HAL/AP_HAL.h>
+
+#include "GCS.h"
+
+#include <AP_Filesystem/AP_Filesystem.h>
+#include <AP_Filesystem/AP_Filesystem_Async.h>
+#include <AP_Math/crc.h>
+
+#if HAVE_FILESYSTEM_SUPPORT
+
+extern const AP_HAL::HAL& hal;
+
+// a session with no requests for this long may be taken over by a
+// new open
+#define FTP_SESSION_TIMEOUT_MS 3000
+
+// bytes of txspace left free during a burst so that heartbeats and
+// other messages still get through
+#define FTP_BURST_TX_RESERVE 256
+
+// how long to wait for space to send a reply before dropping it. The
+// GCS will retry
+#define FTP_REPLY_TIMEOUT_MS 500
+
+struct GCS_MAVLINK::ftp_state GCS_MAVLINK::ftp;
+
+bool GCS_MAVLINK::ftp_init(void)
+{
+    if (ftp.requests == nullptr) {
+        ftp.requests = new ObjectBuffer<pending_ftp>(5);
+        if (ftp.requests == nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+  decode a FILE_TRANSFER_PROTOCOL message and queue it. Requests are
+  taken one at a time by ftp_update(), with all file access done on
+  the filesystem IO thread as SD cards can take a long time to respond
+ */
+void GCS_MAVLINK::handle_file_transfer_protocol(const mavlink_message_t &msg)
+{
+    if (!ftp_init()) {
+        return;
+    }
+
+    mavlink_file_transfer_protocol_t packet;
+    mavlink_msg_file_transfer_protocol_decode(&msg, &packet);
+
+    pending_ftp request {};
+    request.chan = chan;
+    request.sysid = msg.sysid;
+    request.compid = msg.compid;
+    memcpy(&request.seq_number, &packet.payload[0], sizeof(request.seq_number));
+    request.session = packet.payload[2];
+    request.opcode = (FTP_OP)packet.payload[3];
+    request.size = packet.payload[4];
+    request.req_opcode = (FTP_OP)packet.payload[5];
+    request.burst_complete = packet.payload[6];
+    memcpy(&request.offset, &packet.payload[8], sizeof(request.offset));
+    memcpy(request.data, &packet.payload[12], sizeof(request.data));
+
+    ftp.requests->push(request);
+}
+
+/*
+  called from update_send(). Sends the reply to the current request
+  once there is space for it, then starts on the next request
+ */
+void GCS_MAVLINK::ftp_update(void)
+{
+    if (ftp.requests == nullptr) {
+        return;
+    }
+
+    if (ftp.state == FTP_STATE::REPLY_READY) {
+        if (!ftp_send_reply()) {
+            return;
+        }
+        if (ftp.burst_active) {
+            ftp.reply.seq_number++;
+            ftp_burst_next();
+            return;
+        }
+        if (ftp.reply.req_opcode != FTP_OP::BurstReadFile) {
+            ftp.last_reply = ftp.reply;
+            ftp.last_reply_valid = true;
+        }
+        ftp.state = FTP_STATE::IDLE;
+    }
+
+    if (ftp.state != FTP_STATE::IDLE || !ftp.requests->pop(ftp.request)) {
+        return;
+    }
+    const pending_ftp &request = ftp.request;
+
+    // a repeat of the last request means our reply was lost, so
+    // send it again rather than repeating a write
+    if (ftp.last_reply_valid &&
+        request.opcode != FTP_OP::BurstReadFile &&
+        request.chan == ftp.last_reply.chan &&
+        request.sysid == ftp.last_reply.sysid &&
+        uint16_t(request.seq_number + 1) == ftp.last_reply.seq_number &&
+        request.opcode == ftp.last_reply.req_opcode) {
+        ftp.reply = ftp.last_reply;
+        ftp_reply_ready();
+        return;
+    }
+
+    pending_ftp &response = ftp.reply;
+    response = pending_ftp {};
+    response.chan = request.chan;
+    response.sysid = request.sysid;
+    response.compid = request.compid;
+    response.seq_number = request.seq_number + 1;
+    response.session = request.session;
+    response.req_opcode = request.opcode;
+    response.offset = request.offset;
+    response.opcode = FTP_OP::Ack;
+
+    ftp.state = FTP_STATE::IO_PENDING;
+    ftp_process_request();
+}
+
+/*
+  send ftp.reply, returning false if it should be tried again
+  later. Bursts leave space on the link for other messages and stop
+  early if the GCS has sent something else, such as a TerminateSession
+ */
+bool GCS_MAVLINK::ftp_send_reply(void)
+{
+    pending_ftp &reply = ftp.reply;
+    const uint16_t len = packet_overhead_chan(reply.chan) + MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL_LEN;
+    const bool timed_out = AP_HAL::millis() - ftp.reply_ms > FTP_REPLY_TIMEOUT_MS;
+
+    if (ftp.burst_active && !reply.burst_complete) {
+        if (!ftp.requests->empty() || timed_out) {
+            reply.burst_complete = true;
+        } else if (comm_get_txspace(reply.chan) < len + FTP_BURST_TX_RESERVE) {
+            return false;
+        }
+    }
+    if (comm_get_txspace(reply.chan) < len) {
+        if (!timed_out) {
+            return false;
+        }
+        // drop it, the GCS will retry
+        ftp.burst_active = false;
+        return true;
+    }
+
+    uint8_t payload[251] {};
+    memcpy(&payload[0], &reply.seq_number, sizeof(reply.seq_number));
+    payload[2] = reply.session;
+    payload[3] = (uint8_t)reply.opcode;
+    payload[4] = reply.size;
+    payload[5] = (uint8_t)reply.req_opcode;
+    payload[6] = reply.burst_complete;
+    memcpy(&payload[8], &reply.offset, sizeof(reply.offset));
+    memcpy(&payload[12], reply.data, sizeof(reply.data));
+
+    mavlink_msg_file_transfer_protocol_send(reply.chan, 0, reply.sysid, reply.compid, payload);
+
+    if (reply.burst_complete) {
+        ftp.burst_active = false;
+    }
+    return true;
+}
+
+/*
+  hand ftp.reply to the main thread. Called from the IO thread when a
+  request completes
+ */
+void GCS_MAVLINK::ftp_reply_ready(void)
+{
+    ftp.reply_ms = AP_HAL::millis();
+    ftp.state = FTP_STATE::REPLY_READY;
+}
+
+void GCS_MAVLINK::ftp_error(pending_ftp &response, FTP_ERROR error)
+{
+    response.opcode = FTP_OP::Nack;
+    response.data[0] = (uint8_t)error;
+    response.size = 1;
+}
+
+void GCS_MAVLINK::ftp_errno(pending_ftp &response, int err)
+{
+    if (err == ENOENT) {
+        ftp_error(response, FTP_ERROR::FileNotFound);
+        return;
+    }
+    if (err == EEXIST) {
+        ftp_error(response, FTP_ERROR::FileExists);
+        return;
+    }
+    response.opcode = FTP_OP::Nack;
+    response.data[0] = (uint8_t)FTP_ERROR::FailErrno;
+    response.data[1] = (uint8_t)err;
+    response.size = 2;
+}
+
+/*
+  close the open file without waiting for the result
+ */
+void GCS_MAVLINK::ftp_close_session(void)
+{
+    if (ftp.fd != -1) {
+        AP::FS_async().close(ftp.fd, AP_Filesystem_Async::Priority::NORMAL, nullptr);
+        ftp.fd = -1;
+    }
+}
+
+/*
+  start on ftp.request, either replying straight away or queueing the
+  file access, in which case a completion callback on the IO thread
+  fills in the reply
+ */
+void GCS_MAVLINK::ftp_process_request(void)
+{
+    const pending_ftp &request = ftp.request;
+    pending_ftp &response = ftp.reply;
+    const auto prio = AP_Filesystem_Async::Priority::NORMAL;
+
+    char path[sizeof(request.data)+1];
+    const uint8_t path_len = MIN(request.size, sizeof(request.data));
+    memcpy(path, request.data, path_len);
+    path[path_len] = 0;
+
+    const bool session_valid = (request.session == ftp.current_session && ftp.fd != -1);
+    if (session_valid) {
+        ftp.last_session_ms = AP_HAL::millis();
+    }
+
+    switch (request.opcode) {
+    case FTP_OP::None:
+        break;
+
+    case FTP_OP::TerminateSession:
+    case FTP_OP::ResetSessions: {
+        if (request.opcode == FTP_OP::TerminateSession &&
+            request.session != ftp.current_session) {
+            ftp_error(response, FTP_ERROR::InvalidSession);
+            break;
+        }
+        if (ftp.fd == -1) {
+            break;
+        }
+        // wait for the close, so a failed write-behind is reported
+        if (AP::FS_async().close(ftp.fd, prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_close_done, void, int32_t))) {
+            ftp.fd = -1;
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+    }
+
+    case FTP_OP::ListDirectory:
+        if (AP::FS_async().call(FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_list_dir, int32_t),
+                                prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_call_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+
+    case FTP_OP::OpenFileRO:
+    case FTP_OP::CreateFile:
+    case FTP_OP::OpenFileWO: {
+        if (ftp.fd != -1) {
+            if (AP_HAL::millis() - ftp.last_session_ms < FTP_SESSION_TIMEOUT_MS) {
+                ftp_error(response, FTP_ERROR::NoSessionsAvailable);
+                break;
+            }
+            // the GCS that opened it has gone away
+            ftp_close_session();
+        }
+        int flags = O_RDONLY;
+        if (request.opcode == FTP_OP::CreateFile) {
+            flags = O_WRONLY | O_CREAT | O_TRUNC;
+        } else if (request.opcode == FTP_OP::OpenFileWO) {
+            flags = O_WRONLY;
+        }
+        if (strlen(path) >= FS_ASYNC_MAX_NAME) {
+            ftp_errno(response, ENAMETOOLONG);
+            break;
+        }
+        if (AP::FS_async().open(path, flags, prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_open_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+    }
+
+    case FTP_OP::ReadFile: {
+        if (!session_valid) {
+            ftp_error(response, FTP_ERROR::InvalidSession);
+            break;
+        }
+        const uint8_t count = MIN(request.size ? request.size : sizeof(response.data), sizeof(response.data));
+        if (AP::FS_async().read(ftp.fd, request.offset, response.data, count,
+                                prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_read_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+    }
+
+    case FTP_OP::WriteFile:
+        if (!session_valid) {
+            ftp_error(response, FTP_ERROR::InvalidSession);
+            break;
+        }
+        if (request.size > sizeof(request.data)) {
+            ftp_error(response, FTP_ERROR::InvalidDataSize);
+            break;
+        }
+        if (AP::FS_async().write(ftp.fd, request.offset, request.data, request.size,
+                                 prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_write_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+
+    case FTP_OP::RemoveFile:
+        if (AP::FS_async().call(FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_remove_file, int32_t),
+                                prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_call_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+
+    case FTP_OP::CreateDirectory:
+        if (AP::FS_async().call(FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_create_directory, int32_t),
+                                prio, FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_call_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+
+    case FTP_OP::CalcFileCRC32:
+        if (strlen(path) >= FS_ASYNC_MAX_NAME) {
+            ftp_errno(response, ENAMETOOLONG);
+            break;
+        }
+        // reads are queued at low priority one block at a time, so a
+        // large file doesn't hold up terrain and logging
+        if (AP::FS_async().open(path, O_RDONLY, AP_Filesystem_Async::Priority::LOW,
+                                FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_crc32_open_done, void, int32_t))) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+        break;
+
+    case FTP_OP::BurstReadFile: {
+        if (!session_valid) {
+            ftp_error(response, FTP_ERROR::InvalidSession);
+            break;
+        }
+        /*
+          stream the open file from request.offset without waiting
+          for acks. If the request carries a non-zero 4 byte count the
+          burst stops after that many bytes, otherwise at the end of
+          the file. The last packet has burst_complete set, and the
+          GCS fills any gaps with ReadFile or another burst
+         */
+        uint32_t max_bytes = 0;
+        if (request.size == sizeof(max_bytes)) {
+            memcpy(&max_bytes, request.data, sizeof(max_bytes));
+        }
+        ftp.burst_max_bytes = max_bytes ? max_bytes : UINT32_MAX;
+        ftp.burst_read_size = (request.size == 0 || request.size == sizeof(max_bytes)) ?
+            sizeof(response.data) : MIN(request.size, sizeof(response.data));
+        ftp.burst_offset = request.offset;
+        ftp.burst_sent = 0;
+        ftp.burst_active = true;
+        ftp.last_reply_valid = false;
+        ftp_burst_next();
+        return;
+    }
+
+    case FTP_OP::RemoveDirectory:
+    case FTP_OP::TruncateFile:
+    case FTP_OP::Rename:
+    case FTP_OP::Ack:
+    case FTP_OP::Nack:
+        ftp_error(response, FTP_ERROR::UnknownCommand);
+        break;
+    }
+
+    // replying without file access, or the filesystem queue is full
+    ftp_reply_ready();
+}
+
+/*
+  the functions below are called on the filesystem IO thread
+ */
+
+void GCS_MAVLINK::ftp_open_done(int32_t fd)
+{
+    pending_ftp &response = ftp.reply;
+    if (fd == -1) {
+        ftp_errno(response, errno);
+        ftp_reply_ready();
+        return;
+    }
+    if (ftp.request.opcode == FTP_OP::OpenFileRO) {
+        char path[sizeof(ftp.request.data)+1];
+        const uint8_t path_len = MIN(ftp.request.size, sizeof(ftp.request.data));
+        memcpy(path, ftp.request.data, path_len);
+        path[path_len] = 0;
+        struct stat st;
+        if (AP::FS().stat(path, &st) != 0) {
+            ftp_errno(response, errno);
+            AP::FS_async().close(fd, AP_Filesystem_Async::Priority::NORMAL, nullptr);
+            ftp_reply_ready();
+            return;
+        }
+        const uint32_t file_size = st.st_size;
+        memcpy(response.data, &file_size, sizeof(file_size));
+        response.size = sizeof(file_size);
+    }
+    ftp.fd = fd;
+    ftp.current_session++;
+    ftp.last_session_ms = AP_HAL::millis();
+    response.session = ftp.current_session;
+    ftp_reply_ready();
+}
+
+void GCS_MAVLINK::ftp_close_done(int32_t ret)
+{
+    if (ret != 0) {
+        ftp_errno(ftp.reply, errno);
+    }
+    ftp_reply_ready();
+}
+
+/*
+  completion of a ReadFile, or of one packet of a burst
+ */
+void GCS_MAVLINK::ftp_read_done(int32_t n)
+{
+    pending_ftp &response = ftp.reply;
+    if (ftp.burst_active) {
+        response.offset = ftp.burst_offset;
+        response.burst_complete = (n <= 0);
+    }
+    if (n < 0) {
+        ftp_errno(response, errno);
+    } else if (n == 0) {
+        ftp_error(response, FTP_ERROR::EndOfFile);
+    } else {
+        response.opcode = FTP_OP::Ack;
+        response.size = n;
+        if (ftp.burst_active) {
+            ftp.burst_offset += n;
+            ftp.burst_sent += n;
+            response.burst_complete = (ftp.burst_sent >= ftp.burst_max_bytes ||
+                                       n < ftp.burst_read_size);
+        }
+    }
+    ftp_reply_ready();
+}
+
+void GCS_MAVLINK::ftp_write_done(int32_t n)
+{
+    if (n != ftp.request.size) {
+        ftp_errno(ftp.reply, errno);
+    } else {
+        ftp.reply.size = 0;
+    }
+    ftp_reply_ready();
+}
+
+// ftp_list_dir() and friends fill in the reply themselves
+void GCS_MAVLINK::ftp_call_done(int32_t ret)
+{
+    ftp_reply_ready();
+}
+
+/*
+  list a directory. request.offset is the index of the first entry to
+  return. Entries are "F<name>\t<size>" for files and "D<name>" for
+  directories, each NUL terminated
+ */
+int32_t GCS_MAVLINK::ftp_list_dir(void)
+{
+    const pending_ftp &request = ftp.request;
+    pending_ftp &response = ftp.reply;
+
+    char dirname[sizeof(request.data)+1];
+    const uint8_t dirname_len = MIN(request.size, sizeof(request.data));
+    memcpy(dirname, request.data, dirname_len);
+    dirname[dirname_len] = 0;
+
+    DIR *dir = AP::FS().opendir(dirname);
+    if (dir == nullptr) {
+        ftp_errno(response, errno);
+        return -1;
+    }
+
+    uint32_t index = 0;
+    uint8_t ofs = 0;
+    struct dirent *de;
+    while ((de = AP::FS().readdir(dir)) != nullptr) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+            continue;
+        }
+        if (index++ < request.offset) {
+            continue;
+        }
+        char path[sizeof(dirname) + sizeof(de->d_name) + 2];
+        hal.util->snprintf(path, sizeof(path), "%s/%s", dirname, de->d_name);
+        struct stat st;
+        char entry[sizeof(de->d_name) + 14];
+        int len;
+        if (AP::FS().stat(path, &st) == 0 && !S_ISDIR(st.st_mode)) {
+            len = hal.util->snprintf(entry, sizeof(entry), "F%s\t%u", de->d_name, (unsigned)st.st_size);
+        } else {
+            len = hal.util->snprintf(entry, sizeof(entry), "D%s", de->d_name);
+        }
+        if (len < 0 || ofs + len + 1 > (int)sizeof(response.data)) {
+            break;
+        }
+        memcpy(&response.data[ofs], entry, len+1);
+        ofs += len+1;
+    }
+    AP::FS().closedir(dir);
+
+    if (ofs == 0) {
+        ftp_error(response, FTP_ERROR::EndOfFile);
+        return -1;
+    }
+    response.size = ofs;
+    return 0;
+}
+
+int32_t GCS_MAVLINK::ftp_remove_file(void)
+{
+    char path[sizeof(ftp.request.data)+1];
+    const uint8_t path_len = MIN(ftp.request.size, sizeof(ftp.request.data));
+    memcpy(path, ftp.request.data, path_len);
+    path[path_len] = 0;
+
+    const int ret = AP::FS().unlink(path);
+    if (ret != 0) {
+        ftp_errno(ftp.reply, errno);
+    }
+    return ret;
+}
+
+int32_t GCS_MAVLINK::ftp_create_directory(void)
+{
+    char path[sizeof(ftp.request.data)+1];
+    const uint8_t path_len = MIN(ftp.request.size, sizeof(ftp.request.data));
+    memcpy(path, ftp.request.data, path_len);
+    path[path_len] = 0;
+
+    const int ret = AP::FS().mkdir(path);
+    if (ret != 0) {
+        ftp_errno(ftp.reply, errno);
+    }
+    return ret;
+}
+
+/*
+  CRC32 of a whole file, using the same CRC as the rest of
+  ArduPilot. A GCS resuming a download checks the assembled file
+  against this. The file is read a block at a time from the
+  completion of the previous read, using the reply as the buffer
+ */
+void GCS_MAVLINK::ftp_crc32_open_done(int32_t fd)
+{
+    if (fd == -1) {
+        ftp_errno(ftp.reply, errno);
+        ftp_reply_ready();
+        return;
+    }
+    ftp.crc_fd = fd;
+    ftp.crc = 0;
+    ftp.crc_offset = 0;
+    if (!ftp_crc32_read_next()) {
+        ftp_error(ftp.reply, FTP_ERROR::Fail);
+        ftp_crc32_finish();
+    }
+}
+
+bool GCS_MAVLINK::ftp_crc32_read_next(void)
+{
+    return AP::FS_async().read(ftp.crc_fd, ftp.crc_offset, ftp.reply.data, sizeof(ftp.reply.data),
+                               AP_Filesystem_Async::Priority::LOW,
+                               FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_crc32_read_done, void, int32_t));
+}
+
+void GCS_MAVLINK::ftp_crc32_read_done(int32_t n)
+{
+    pending_ftp &response = ftp.reply;
+    if (n > 0) {
+        ftp.crc = crc_crc32(ftp.crc, response.data, n);
+        ftp.crc_offset += n;
+        if (ftp_crc32_read_next()) {
+            return;
+        }
+        ftp_error(response, FTP_ERROR::Fail);
+    } else if (n < 0) {
+        ftp_errno(response, errno);
+    } else {
+        memcpy(response.data, &ftp.crc, sizeof(ftp.crc));
+        response.size = sizeof(ftp.crc);
+    }
+    ftp_crc32_finish();
+}
+
+void GCS_MAVLINK::ftp_crc32_finish(void)
+{
+    AP::FS_async().close(ftp.crc_fd, AP_Filesystem_Async::Priority::LOW, nullptr);
+    ftp.crc_fd = -1;
+    ftp_reply_ready();
+}
+
+/*
+  read the next packet of a burst at low priority. Called from the
+  main thread
+ */
+void GCS_MAVLINK::ftp_burst_next(void)
+{
+    pending_ftp &response = ftp.reply;
+    response.opcode = FTP_OP::Ack;
+    response.size = 0;
+    const uint8_t count = MIN(uint32_t(ftp.burst_read_size), ftp.burst_max_bytes - ftp.burst_sent);
+    ftp.state = FTP_STATE::IO_PENDING;
+    if (!AP::FS_async().read(ftp.fd, ftp.burst_offset, response.data, count,
+                             AP_Filesystem_Async::Priority::LOW,
+                             FUNCTOR_BIND_MEMBER(&GCS_MAVLINK::ftp_read_done, void, int32_t))) {
+        ftp.burst_active = false;
+        response.burst_complete = true;
+        ftp_error(response, FTP_ERROR::Fail);
+        ftp_reply_ready();
+    }
+}
+
+#endif // HAVE_FILESYSTEM_SUPPORT
@@ -27,7 +27,28 @@ extern const AP_HAL::HAL& hal;
 #define ROUTING_DEBUG 0
 
 // constructor
-MAVLink_routing::MAVLink_routing(void) : num_routes(0) {}
+MAVLink_routing::MAVLink_routing(void) :
+    num_routes(0),
+    msg_entry_cache{}
+{
+    memset(sysid_hash, no_route, sizeof(sysid_hash));
+}
+
+/*
+  return the index of the first route learned for a sysid, or no_route
+*/
+uint8_t MAVLink_routing::first_route(uint8_t sysid) const
+{
+    uint8_t h = sysid & (MAVLINK_ROUTE_HASH_SIZE-1);
+    for (uint8_t n=0; n<MAVLINK_ROUTE_HASH_SIZE; n++) {
+        const uint8_t i = sysid_hash[h];
+        if (i == no_route || routes[i].sysid == sysid) {
+            return i;
+        }
+        h = (h+1) & (MAVLINK_ROUTE_HASH_SIZE-1);
+    }
+    return no_route;
+}
 
 /*
   forward a MAVLink message to the right port. This also
@@ -138,7 +159,10 @@ bool MAVLink_routing::check_and_forward(mavlink_channel_t in_channel, const mavl
     bool forwarded = false;
     bool sent_to_chan[MAVLINK_COMM_NUM_BUFFERS];
     memset(sent_to_chan, 0, sizeof(sent_to_chan));
-    for (uint8_t i=0; i<num_routes; i++) {
+    // a message for a specific system only needs that system's routes
+    for (uint8_t i = broadcast_system ? 0 : first_route(target_system);
+         i < num_routes;
+         i = broadcast_system ? i+1 : routes[i].next) {
     
         // Skip if channel is private and the target system or component IDs do not match
         if ((GCS_MAVLINK::is_private(routes[i].channel)) &&
@@ -190,8 +214,8 @@ void MAVLink_routing::send_to_components(const mavlink_message_t &msg)
     memset(sent_to_chan, 0, sizeof(sent_to_chan));
 
     // check learned routes
-    for (uint8_t i=0; i<num_routes; i++) {
-        if ((routes[i].sysid == mavlink_system.sysid) && !sent_to_chan[routes[i].channel]) {
+    for (uint8_t i=first_route(mavlink_system.sysid); i<num_routes; i=routes[i].next) {
+        if (!sent_to_chan[routes[i].channel]) {
             if (comm_get_txspace(routes[i].channel) >= ((uint16_t)msg.len) +
                 GCS_MAVLINK::packet_overhead_chan(routes[i].channel)) {
 #if ROUTING_DEBUG
@@ -239,9 +263,9 @@ void MAVLink_routing::learn_route(mavlink_channel_t in_channel, const mavlink_me
          msg.compid == mavlink_system.compid)) {
         return;
     }
-    for (i=0; i<num_routes; i++) {
-        if (routes[i].sysid == msg.sysid &&
-            routes[i].compid == msg.compid &&
+    const uint8_t first = first_route(msg.sysid);
+    for (i=first; i<num_routes; i=routes[i].next) {
+        if (routes[i].compid == msg.compid &&
             routes[i].channel == in_channel) {
             if (routes[i].mavtype == 0 && msg.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
                 routes[i].mavtype = mavlink_msg_heartbeat_get_type(&msg);
@@ -249,13 +273,21 @@ void MAVLink_routing::learn_route(mavlink_channel_t in_channel, const mavlink_me
             break;
         }
     }
-    if (i == num_routes && i<MAVLINK_MAX_ROUTES) {
+    if (i == no_route && num_routes<MAVLINK_MAX_ROUTES) {
+        i = num_routes;
         routes[i].sysid = msg.sysid;
         routes[i].compid = msg.compid;
         routes[i].channel = in_channel;
         if (msg.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
             routes[i].mavtype = mavlink_msg_heartbeat_get_type(&msg);
         }
+        // add to the front of the chain for this sysid
+        routes[i].next = first;
+        uint8_t h = msg.sysid & (MAVLINK_ROUTE_HASH_SIZE-1);
+        while (sysid_hash[h] != first) {
+            h = (h+1) & (MAVLINK_ROUTE_HASH_SIZE-1);
+        }
+        sysid_hash[h] = i;
         num_routes++;
 #if ROUTING_DEBUG
         ::printf("learned route %u %u via %u\n",
@@ -284,8 +316,8 @@ void MAVLink_routing::handle_heartbeat(mavlink_channel_t in_channel, const mavli
     mask &= ~no_route_mask;
     
     // mask out channels that are known sources for this sysid/compid
-    for (uint8_t i=0; i<num_routes; i++) {
-        if (routes[i].sysid == msg.sysid && routes[i].compid == msg.compid) {
+    for (uint8_t i=first_route(msg.sysid); i<num_routes; i=routes[i].next) {
+        if (routes[i].compid == msg.compid) {
             mask &= ~(1U<<((unsigned)(routes[i].channel-MAVLINK_COMM_0)));
         }
     }
@@ -322,9 +354,14 @@ void MAVLink_routing::handle_heartbeat(mavlink_channel_t in_channel, const mavli
 */
 void MAVLink_routing::get_targets(const mavlink_message_t &msg, int16_t &sysid, int16_t &compid)
 {
-    const mavlink_msg_entry_t *msg_entry = mavlink_get_msg_entry(msg.msgid);
-    if (msg_entry == nullptr) {
-        return;
+    const uint8_t slot = msg.msgid % ARRAY_SIZE(msg_entry_cache);
+    const mavlink_msg_entry_t *msg_entry = msg_entry_cache[slot];
+    if (msg_entry == nullptr || msg_entry->msgid != msg.msgid) {
+        msg_entry = mavlink_get_msg_entry(msg.msgid);
+        if (msg_entry == nullptr) {
+            return;
+        }
+        msg_entry_cache[slot] = msg_entry;
     }
     if (msg_entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) {
         sysid = _MAV_RETURN_uint8_t(&msg,  msg_entry->target_system_ofs);
@@ -10,6 +10,10 @@
 // we make more extensive use of MAVLink forwarding
 #define MAVLINK_MAX_ROUTES 20
 
+// size of the hash of routes by sysid, a power of two larger than
+// MAVLINK_MAX_ROUTES
+#define MAVLINK_ROUTE_HASH_SIZE 32
+
 /*
   object to handle MAVLink packet routing
  */
@@ -42,15 +46,29 @@ public:
     bool find_by_mavtype(uint8_t mavtype, uint8_t &sysid, uint8_t &compid, mavlink_channel_t &channel);
 
 private:
-    // a simple linear routing table. We don't expect to have a lot of
-    // routes, so a scalable structure isn't worthwhile yet.
+    // the routing table. Routes are never removed; routes with the
+    // same sysid are chained together through next, and the first
+    // route for each sysid is found through sysid_hash so targeted
+    // messages only look at the routes for their target system
     uint8_t num_routes;
     struct route {
         uint8_t sysid;
         uint8_t compid;
         mavlink_channel_t channel;
         uint8_t mavtype;
+        uint8_t next;
     } routes[MAVLINK_MAX_ROUTES];
+    static const uint8_t no_route = 0xFF;
+
+    // open addressed hash of the first route for each sysid
+    uint8_t sysid_hash[MAVLINK_ROUTE_HASH_SIZE];
+
+    // index of the first route for sysid, or no_route
+    uint8_t first_route(uint8_t sysid) const;
+
+    // cache of message table entries by msgid; looking up the
+    // message table is a binary search
+    const mavlink_msg_entry_t *msg_entry_cache[32];
     
     // a channel mask to block routing as required
     uint8_t no_route_mask;
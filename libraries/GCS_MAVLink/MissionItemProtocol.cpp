@@ -18,7 +18,20 @@ void MissionItemProtocol::init_send_requests(GCS_MAVLINK &_link,
 
     link = &_link;
 
-    timelast_request_ms = AP_HAL::millis();
+    window = constrain_int16(upload_window(), 1, upload_window_max);
+    if (window > 1 && window_items == nullptr) {
+        window_items = new mavlink_mission_item_int_t[upload_window_max];
+        if (window_items == nullptr) {
+            window = 1;
+        }
+    }
+    window_received = 0;
+    memset(window_request_ms, 0, sizeof(window_request_ms));
+
+    memset(&stats, 0, sizeof(stats));
+    stats.start_ms = AP_HAL::millis();
+    stats.items = _request_last + 1 - _request_first;
+
     link->send_message(next_item_ap_message_id());
 }
 
@@ -203,6 +216,14 @@ void MissionItemProtocol::handle_mission_item(const mavlink_message_t &msg, cons
         return;
     }
 
+    if (window > 1 && cmd.seq != request_i) {
+        // windowed uploads may see items out of order or more than once
+        if (msg.sysid == dest_sysid && msg.compid == dest_compid) {
+            buffer_item(cmd);
+        }
+        return;
+    }
+
     // check if this is the requested waypoint
     if (cmd.seq != request_i) {
         send_mission_ack(msg, MAV_MISSION_INVALID_SEQUENCE);
@@ -218,33 +239,39 @@ void MissionItemProtocol::handle_mission_item(const mavlink_message_t &msg, cons
         return;
     }
 
-    const uint16_t _item_count = item_count();
+    const uint32_t now_ms = AP_HAL::millis();
+    const uint32_t request_ms = window_request_ms[request_i % upload_window_max];
+    if (request_ms != 0) {
+        stats.rtt_total_ms += now_ms - request_ms;
+        stats.rtt_count++;
+    }
 
-    MAV_MISSION_RESULT result;
-    if (cmd.seq < _item_count) {
-        // command index is within the existing list, replace the command
-        result = replace_item(cmd);
-    } else if (cmd.seq == _item_count) {
-        // command is at the end of command list, add the command
-        result = append_item(cmd);
-    } else {
-        // beyond the end of the command list, return an error
-        result = MAV_MISSION_ERROR;
+    // store this item and any buffered items which follow it
+    MAV_MISSION_RESULT result = store_item(cmd);
+    while (result == MAV_MISSION_ACCEPTED) {
+        window_request_ms[request_i % upload_window_max] = 0;
+        request_i++;
+        window_received >>= 1;
+        if (request_i > request_last || !(window_received & 1U)) {
+            break;
+        }
+        result = store_item(window_items[request_i % upload_window_max]);
     }
     if (result != MAV_MISSION_ACCEPTED) {
         send_mission_ack(msg, result);
         receiving = false;
         link = nullptr;
+        upload_failed();
         return;
     }
 
     // update waypoint receiving state machine
-    timelast_receive_ms = AP_HAL::millis();
-    request_i++;
+    timelast_receive_ms = now_ms;
 
     if (request_i > request_last) {
         const MAV_MISSION_RESULT complete_result = complete(*link);
         send_mission_ack(msg, complete_result);
+        send_stats();
         receiving = false;
         link = nullptr;
         return;
@@ -257,6 +284,63 @@ void MissionItemProtocol::handle_mission_item(const mavlink_message_t &msg, cons
     }
 }
 
+/*
+  buffer an item received ahead of the next one needed in a windowed upload
+ */
+void MissionItemProtocol::buffer_item(const mavlink_mission_item_int_t &cmd)
+{
+    if (cmd.seq <= request_i || cmd.seq > request_last) {
+        // duplicate of an item already stored, or not part of this upload
+        return;
+    }
+    const uint16_t offset = cmd.seq - request_i;
+    if (offset >= window || (window_received & (1U<<offset))) {
+        return;
+    }
+    const uint8_t slot = cmd.seq % upload_window_max;
+    const uint32_t now_ms = AP_HAL::millis();
+    if (window_request_ms[slot] != 0) {
+        stats.rtt_total_ms += now_ms - window_request_ms[slot];
+        stats.rtt_count++;
+    }
+    window_items[slot] = cmd;
+    window_received |= (1U<<offset);
+    timelast_receive_ms = now_ms;
+}
+
+/*
+  store an item at the current request index
+ */
+MAV_MISSION_RESULT MissionItemProtocol::store_item(const mavlink_mission_item_int_t &cmd)
+{
+    const uint16_t _item_count = item_count();
+
+    if (cmd.seq < _item_count) {
+        // command index is within the existing list, replace the command
+        return replace_item(cmd);
+    }
+    if (cmd.seq == _item_count) {
+        // command is at the end of command list, add the command
+        return append_item(cmd);
+    }
+    // beyond the end of the command list, return an error
+    return MAV_MISSION_ERROR;
+}
+
+/*
+  report throughput and round trip time of a completed upload
+ */
+void MissionItemProtocol::send_stats() const
+{
+    const uint32_t dt_ms = MAX(AP_HAL::millis() - stats.start_ms, 1U);
+    link->send_text(MAV_SEVERITY_INFO, "Upload: %u items %.1fs %.1f/s rtt %ums rereq %u",
+                    (unsigned)stats.items,
+                    dt_ms * 0.001f,
+                    stats.items * 1000.0f / dt_ms,
+                    (unsigned)(stats.rtt_count ? stats.rtt_total_ms / stats.rtt_count : 0),
+                    (unsigned)stats.rerequests);
+}
+
 void MissionItemProtocol::send_mission_ack(const mavlink_message_t &msg,
                                            MAV_MISSION_RESULT result) const
 {
@@ -277,9 +361,37 @@ void MissionItemProtocol::send_mission_ack(const GCS_MAVLINK &_link,
                                  mission_type());
 }
 
+uint32_t MissionItemProtocol::resend_timeout_ms() const
+{
+    return 1000U + (link->get_stream_slowdown_ms()*20);
+}
+
+/*
+  returns true if an item in the window has not been requested yet,
+  or was requested too long ago
+ */
+bool MissionItemProtocol::request_due(const uint32_t now_ms) const
+{
+    const uint32_t timeout_ms = resend_timeout_ms();
+    for (uint8_t i=0; i<window; i++) {
+        const uint16_t seq = request_i + i;
+        if (seq > request_last) {
+            break;
+        }
+        if (window_received & (1U<<i)) {
+            continue;
+        }
+        const uint32_t request_ms = window_request_ms[seq % upload_window_max];
+        if (request_ms == 0 || now_ms - request_ms > timeout_ms) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
- * @brief Send the next pending waypoint, called from deferred message
- * handling code
+ * @brief Send the pending waypoint requests, called from deferred
+ * message handling code
  */
 void MissionItemProtocol::queued_request_send()
 {
@@ -293,13 +405,36 @@ void MissionItemProtocol::queued_request_send()
         AP::internalerror().error(AP_InternalError::error_t::gcs_bad_missionprotocol_link);
         return;
     }
-    mavlink_msg_mission_request_send(
-        link->get_chan(),
-        dest_sysid,
-        dest_compid,
-        request_i,
-        mission_type());
-    timelast_request_ms = AP_HAL::millis();
+    const uint32_t now_ms = AP_HAL::millis();
+    const uint32_t timeout_ms = resend_timeout_ms();
+    for (uint8_t i=0; i<window; i++) {
+        const uint16_t seq = request_i + i;
+        if (seq > request_last) {
+            break;
+        }
+        if (window_received & (1U<<i)) {
+            continue;
+        }
+        uint32_t &request_ms = window_request_ms[seq % upload_window_max];
+        if (request_ms != 0 && now_ms - request_ms <= timeout_ms) {
+            // still in flight
+            continue;
+        }
+        if (!HAVE_PAYLOAD_SPACE(link->get_chan(), MISSION_REQUEST)) {
+            // remaining requests are sent from update()
+            break;
+        }
+        if (request_ms != 0) {
+            stats.rerequests++;
+        }
+        mavlink_msg_mission_request_send(
+            link->get_chan(),
+            dest_sysid,
+            dest_compid,
+            seq,
+            mission_type());
+        request_ms = now_ms;
+    }
 }
 
 void MissionItemProtocol::update()
@@ -320,10 +455,8 @@ void MissionItemProtocol::update()
         link = nullptr;
         return;
     }
-    // resend request if we haven't gotten one:
-    const uint32_t wp_recv_timeout_ms = 1000U + (link->get_stream_slowdown_ms()*20);
-    if (tnow - timelast_request_ms > wp_recv_timeout_ms) {
-        timelast_request_ms = tnow;
+    // resend requests for items we haven't received
+    if (request_due(tnow)) {
         link->send_message(next_item_ap_message_id());
     }
 }
@@ -21,6 +21,12 @@
 // Starting of uploads (for the same protocol) is also blocked -
 // essentially the GCS uploading a set of items (e.g. a mission) has a
 // mutex over the mission.
+//
+// If upload_window() is greater than one, requests for that many
+// items are kept in flight.  Items are stored strictly in sequence;
+// items arriving ahead of the next one needed are buffered, and only
+// items which have not arrived within the resend timeout are
+// requested again.
 class MissionItemProtocol
 {
 public:
@@ -73,6 +79,9 @@ protected:
 
     uint16_t        request_last; // last request index
 
+    // maximum number of item requests that can be in flight
+    static const uint8_t upload_window_max = 16;
+
 private:
 
     virtual void truncate(const mavlink_mission_count_t &packet) = 0;
@@ -83,9 +92,29 @@ private:
     uint8_t         dest_sysid;  // where to send requests
     uint8_t         dest_compid; // "
     uint32_t        timelast_receive_ms;
-    uint32_t        timelast_request_ms;
     const uint16_t  upload_timeout_ms = 8000;
 
+    // windowed upload state
+    uint8_t         window;             // number of requests in flight for this upload
+    uint16_t        window_received;    // bit n set if item request_i+n has been buffered
+    uint32_t        window_request_ms[upload_window_max]; // time each item was last requested, 0 if not yet requested
+    mavlink_mission_item_int_t *window_items; // items received ahead of request_i, indexed by seq % upload_window_max
+
+    // transfer statistics, reported on completion
+    struct {
+        uint32_t start_ms;
+        uint16_t items;
+        uint16_t rerequests;
+        uint32_t rtt_total_ms;
+        uint16_t rtt_count;
+    } stats;
+
+    uint32_t resend_timeout_ms() const;
+    bool request_due(uint32_t now_ms) const;
+    void buffer_item(const mavlink_mission_item_int_t &cmd);
+    MAV_MISSION_RESULT store_item(const mavlink_mission_item_int_t &cmd);
+    void send_stats() const;
+
     // support for GCS getting waypoints etc from us:
     virtual MAV_MISSION_RESULT get_item(const GCS_MAVLINK &_link,
                                         const mavlink_message_t &msg,
@@ -110,6 +139,12 @@ private:
         return MAV_MISSION_ACCEPTED;
     };
     virtual void timeout() {};
+    // upload_failed() is called when an item is rejected and the
+    // upload is abandoned
+    virtual void upload_failed() {};
+    // upload_window() is the number of item requests to keep in
+    // flight during an upload
+    virtual uint8_t upload_window() const { return 1; }
 
     bool mavlink2_requirement_met(const GCS_MAVLINK &_link, const mavlink_message_t &msg) const;
 };
@@ -39,6 +39,8 @@ MAV_MISSION_RESULT MissionItemProtocol_Waypoints::append_item(const mavlink_miss
         }
     }
 
+    // items are written to storage in batches, see complete()
+    mission.begin_write_batch();
     if (!mission.add_cmd(cmd)) {
         return MAV_MISSION_ERROR;
     }
@@ -52,6 +54,7 @@ bool MissionItemProtocol_Waypoints::clear_all_items()
 
 MAV_MISSION_RESULT MissionItemProtocol_Waypoints::complete(const GCS_MAVLINK &_link)
 {
+    mission.flush();
     _link.send_text(MAV_SEVERITY_INFO, "Flight plan received");
     AP::logger().Write_EntireMission();
     return MAV_MISSION_ACCEPTED;
@@ -122,6 +125,7 @@ MAV_MISSION_RESULT MissionItemProtocol_Waypoints::replace_item(const mavlink_mis
             return MAV_MISSION_ERROR;
         }
     }
+    mission.begin_write_batch();
     if (!mission.replace_cmd(cmd.index, cmd)) {
         return MAV_MISSION_ERROR;
     }
@@ -130,9 +134,21 @@ MAV_MISSION_RESULT MissionItemProtocol_Waypoints::replace_item(const mavlink_mis
 
 void MissionItemProtocol_Waypoints::timeout()
 {
+    mission.flush();
     link->send_text(MAV_SEVERITY_WARNING, "Mission upload timeout");
 }
 
+uint8_t MissionItemProtocol_Waypoints::upload_window() const
+{
+    return mission.upload_window();
+}
+
+void MissionItemProtocol_Waypoints::upload_failed()
+{
+    // keep the items accepted before the failure
+    mission.flush();
+}
+
 void MissionItemProtocol_Waypoints::truncate(const mavlink_mission_count_t &packet)
 {
     // new mission arriving, truncate mission to be the same length
@@ -20,6 +20,12 @@ public:
     // timeout() is called by the base class in the case that the GCS
     // does not transfer all waypoints to the vehicle.
     void timeout() override;
+    // upload_failed() is called by the base class when an item is
+    // rejected part way through an upload
+    void upload_failed() override;
+    // upload_window() returns the number of item requests to keep in
+    // flight during an upload
+    uint8_t upload_window() const override;
     // truncate() is called to set the absolute number of items.  It
     // must be less than or equal to the current number of items (you
     // can't truncate-to a longer list)
@@ -9,6 +9,8 @@
 #include <AP_Common/AP_FWVersion.h>
 #include <AP_SerialManager/AP_SerialManager.h>
 
+#include <time.h>
+
 void setup();
 void loop();
 
@@ -25,6 +27,68 @@ const AP_Param::GroupInfo GCS_MAVLINK_Parameters::var_info[] = {
 
 static MAVLink_routing routing;
 
+/*
+  wall clock time in nanoseconds. SITL time is simulated and does not
+  advance while the benchmark loop runs, so use the host clock there
+ */
+static uint64_t bench_time_ns(void)
+{
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+    return AP_HAL::micros64() * 1000ULL;
+#endif
+}
+
+/*
+  push mixed traffic from a number of systems through the routing
+  layer and report the time per packet
+ */
+static void benchmark(void)
+{
+    static MAVLink_routing bench_routing;
+    const uint8_t num_systems = 16;
+    const uint32_t num_packets = 20000;
+    mavlink_message_t msgs[4];
+
+    // learn a route for each system
+    mavlink_heartbeat_t heartbeat {};
+    for (uint8_t i=0; i<num_systems; i++) {
+        mavlink_message_t msg;
+        mavlink_msg_heartbeat_encode(100+i, 1, &msg, &heartbeat);
+        bench_routing.check_and_forward(MAVLINK_COMM_0, msg);
+    }
+
+    // telemetry, a broadcast command, a command for another
+    // system and a command for us
+    mavlink_attitude_t attitude {};
+    mavlink_msg_attitude_encode(101, 1, &msgs[0], &attitude);
+    mavlink_param_set_t param_set {};
+    mavlink_msg_param_set_encode(102, 1, &msgs[1], &param_set);
+    param_set.target_system = 100 + num_systems - 1;
+    param_set.target_component = 1;
+    mavlink_msg_param_set_encode(103, 1, &msgs[2], &param_set);
+    param_set.target_system = mavlink_system.sysid;
+    param_set.target_component = mavlink_system.compid;
+    mavlink_msg_param_set_encode(104, 1, &msgs[3], &param_set);
+
+    uint32_t local = 0;
+    const uint64_t start_ns = bench_time_ns();
+    for (uint32_t i=0; i<num_packets; i++) {
+        if (bench_routing.check_and_forward(MAVLINK_COMM_0, msgs[i % ARRAY_SIZE(msgs)])) {
+            local++;
+        }
+    }
+    const uint64_t dt_ns = bench_time_ns() - start_ns;
+    hal.console->printf("routing: %u packets in %uus, %.1fns/packet, %u local\n",
+                        (unsigned)num_packets,
+                        (unsigned)(dt_ns / 1000),
+                        dt_ns / (double)num_packets,
+                        (unsigned)local);
+}
+
 void setup(void)
 {
     hal.console->printf("routing test startup...");
@@ -95,6 +159,9 @@ void loop(void)
     if (err_count == 0) {
         hal.console->printf("All OK\n");
     }
+
+    benchmark();
+
     hal.scheduler->delay(1000);
 }
 
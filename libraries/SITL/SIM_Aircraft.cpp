@@ -210,8 +210,11 @@ void Aircraft::setup_frame_time(float new_rate, float new_speedup)
     target_speedup = new_speedup;
     frame_time_us = static_cast<uint64_t>(1.0e6f/rate_hz);
 
-    scaled_frame_time_us = frame_time_us/target_speedup;
+    if (target_speedup > 0) {
+        scaled_frame_time_us = frame_time_us/target_speedup;
+    }
     last_wall_time_us = get_wall_time_us();
+    last_speedup_report_us = last_wall_time_us;
     achieved_rate_hz = rate_hz;
 }
 
@@ -221,7 +224,9 @@ void Aircraft::adjust_frame_time(float new_rate)
     if (!is_equal(rate_hz, new_rate)) {
         rate_hz = new_rate;
         frame_time_us = static_cast<uint64_t>(1.0e6f/rate_hz);
-        scaled_frame_time_us = frame_time_us/target_speedup;
+        if (target_speedup > 0) {
+            scaled_frame_time_us = frame_time_us/target_speedup;
+        }
     }
 }
 
@@ -230,6 +235,10 @@ void Aircraft::adjust_frame_time(float new_rate)
    into account desired speedup
    This tries to take account of possible granularity of
    get_wall_time_us() so it works reasonably well on windows
+
+   With a speedup of zero the simulation runs in lockstep: the clock
+   only advances by physics steps and we never sleep, so the vehicle
+   code runs as fast as the CPU allows
 */
 void Aircraft::sync_frame_time(void)
 {
@@ -239,6 +248,15 @@ void Aircraft::sync_frame_time(void)
         now > last_wall_time_us) {
         const float rate = frame_counter * 1.0e6f/(now - last_wall_time_us);
         achieved_rate_hz = (0.99f*achieved_rate_hz) + (0.01f * rate);
+        if (target_speedup <= 0) {
+            if (now - last_speedup_report_us > 10000000UL) {
+                last_speedup_report_us = now;
+                ::printf("SITL lockstep: speedup %.1f\n", static_cast<double>(achieved_rate_hz / rate_hz));
+            }
+            last_wall_time_us = now;
+            frame_counter = 0;
+            return;
+        }
         if (achieved_rate_hz < rate_hz * target_speedup) {
             scaled_frame_time_us *= 0.999f;
         } else {
@@ -384,7 +402,7 @@ void Aircraft::fill_fdm(struct sitl_fdm &fdm)
         }
     }
     
-    if (!is_equal(last_speedup, float(sitl->speedup)) && sitl->speedup > 0) {
+    if (!is_equal(last_speedup, float(sitl->speedup)) && sitl->speedup >= 0) {
         set_speedup(sitl->speedup);
         last_speedup = sitl->speedup;
     }
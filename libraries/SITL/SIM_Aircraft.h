@@ -181,6 +181,7 @@ protected:
     uint64_t frame_time_us;
     float scaled_frame_time_us;
     uint64_t last_wall_time_us;
+    uint64_t last_speedup_report_us;
     uint8_t instance;
     const char *autotest_dir;
     const char *frame;
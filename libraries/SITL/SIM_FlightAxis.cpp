@@ -86,7 +86,9 @@ FlightAxis::FlightAxis(const char *frame_str) :
     Aircraft(frame_str)
 {
     use_time_sync = false;
-    rate_hz = 250 / target_speedup;
+    // a speedup of 0 means "as fast as possible", but RealFlight
+    // only runs in real time
+    rate_hz = target_speedup > 0 ? 250 / target_speedup : 250;
     heli_demix = strstr(frame_str, "helidemix") != nullptr;
     rev4_servos = strstr(frame_str, "rev4") != nullptr;
     const char *colon = strchr(frame_str, ':');
@@ -415,9 +417,10 @@ void FlightAxis::update(const struct sitl_input &input)
                     -state.m_orientationQuaternion_Z);
     quat.rotation_matrix(dcm);
 
+    const float speedup = target_speedup > 0 ? target_speedup : 1;
     gyro = Vector3f(radians(constrain_float(state.m_rollRate_DEGpSEC, -2000, 2000)),
                     radians(constrain_float(state.m_pitchRate_DEGpSEC, -2000, 2000)),
-                    -radians(constrain_float(state.m_yawRate_DEGpSEC, -2000, 2000))) * target_speedup;
+                    -radians(constrain_float(state.m_yawRate_DEGpSEC, -2000, 2000))) * speedup;
 
     velocity_ef = Vector3f(state.m_velocityWorldU_MPS,
                              state.m_velocityWorldV_MPS,
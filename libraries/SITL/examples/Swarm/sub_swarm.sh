@@ -0,0 +1,70 @@
+#!/bin/bash
+
+# run a swarm of ArduSub vehicles in lockstep and report the combined
+# vehicles x speedup achieved on this host
+#
+# usage: libraries/SITL/examples/Swarm/sub_swarm.sh [--dir DIR] [NUM_VEHICLES] [SECONDS]
+#
+# Each vehicle runs in DIR/subN.  Without --dir a temporary directory
+# is created, and removed again when the run finishes.
+#
+# Each vehicle is a separate SITL process running with --speedup 0,
+# so it steps as fast as its core allows.  The vehicles share MAVLink
+# over multicast on uartA, so they all see each other and a GCS can
+# listen with "mavproxy.py --master mcast:".
+
+# assume we start the script from the root directory
+ROOTDIR=$PWD
+SUB=$ROOTDIR/build/sitl/bin/ardusub
+
+SWARM_DIR=""
+if [ "$1" = "--dir" ]; then
+    [ -n "$2" ] || {
+        echo "usage: $0 [--dir DIR] [NUM_VEHICLES] [SECONDS]"
+        exit 1
+    }
+    SWARM_DIR=$2
+    shift 2
+fi
+
+NUM_VEHICLES=${1:-4}
+DURATION=${2:-60}
+
+if [ -z "$SWARM_DIR" ]; then
+    SWARM_DIR=$(mktemp -d -t sub_swarm.XXXXXX) || exit 1
+    trap 'rm -rf "$SWARM_DIR"' EXIT
+fi
+
+[ -x "$SUB" ] || {
+    ./waf configure --board sitl
+    ./waf sub
+}
+
+SUB_DEFAULTS="$ROOTDIR/Tools/autotest/default_params/sub.parm"
+
+PIDS=""
+for i in $(seq 0 $((NUM_VEHICLES-1))); do
+    mkdir -p "$SWARM_DIR/sub$i" || exit 1
+    cat <<EOF2 > "$SWARM_DIR/sub$i/swarm.parm"
+SYSID_THISMAV $((i+1))
+EOF2
+    (cd "$SWARM_DIR/sub$i" && exec $SUB --model vectored --speedup 0 --uartA mcast: --instance $i \
+        --defaults $SUB_DEFAULTS,swarm.parm > sitl.log 2>&1) &
+    PIDS="$PIDS $!"
+done
+
+echo "Running $NUM_VEHICLES vehicles for ${DURATION}s in $SWARM_DIR"
+sleep $DURATION
+kill $PIDS 2>/dev/null
+wait 2>/dev/null
+
+# each instance prints its achieved speedup every 10 seconds
+for i in $(seq 0 $((NUM_VEHICLES-1))); do
+    grep "SITL lockstep: speedup" "$SWARM_DIR/sub$i/sitl.log" | tail -1 | awk '{print $4}'
+done | awk -v n=$NUM_VEHICLES '
+    { total += $1; count++ }
+    END {
+        if (count == 0) { print "no speedup reported"; exit 1 }
+        printf("%u vehicles reporting, mean speedup %.1f, vehicles x speedup %.1f\n",
+               count, total/count, total)
+    }'
@@ -103,6 +103,8 @@ const StorageManager::StorageArea StorageManager::layout_copter[STORAGE_NUM_AREA
 // setup default layout
 const StorageManager::StorageArea *StorageManager::layout = layout_default;
 
+uint32_t StorageManager::write_count;
+
 /*
   erase all storage
  */
@@ -125,6 +127,22 @@ void StorageManager::erase(void)
     
 }
 
+/*
+  ask the HAL to write out pending writes now, optionally waiting for
+  them to complete
+ */
+bool StorageManager::flush(uint32_t timeout_ms)
+{
+    const uint32_t start_ms = AP_HAL::millis();
+    while (!hal.storage->flush()) {
+        if (AP_HAL::millis() - start_ms >= timeout_ms) {
+            return false;
+        }
+        hal.scheduler->delay(1);
+    }
+    return true;
+}
+
 /*
   constructor for StorageAccess
  */
@@ -188,6 +206,7 @@ bool StorageAccess::read_block(void *data, uint16_t addr, size_t n) const
 bool StorageAccess::write_block(uint16_t addr, const void *data, size_t n) const
 {
     const uint8_t *b = (const uint8_t *)data;
+    StorageManager::write_count++;
     for (uint8_t i=0; i<STORAGE_NUM_AREAS; i++) {
         const StorageManager::StorageArea &area = StorageManager::layout[i];
         uint16_t length = area.length;
@@ -61,6 +61,14 @@ public:
     // setup for copter layout of storage
     static void set_layout_copter(void) { layout = layout_copter; }
 
+    // write out pending storage writes without waiting for them to
+    // settle, waiting up to timeout_ms for them to complete. Returns
+    // true if there is nothing left to write
+    static bool flush(uint32_t timeout_ms=0);
+
+    // number of block writes made through StorageAccess
+    static uint32_t get_write_count(void) { return write_count; }
+
 private:
     struct StorageArea {
         StorageType type;
@@ -72,6 +80,8 @@ private:
     static const StorageArea layout_copter[STORAGE_NUM_AREAS];
     static const StorageArea layout_default[STORAGE_NUM_AREAS];
     static const StorageArea *layout;
+
+    static uint32_t write_count;
 };
 
 /*